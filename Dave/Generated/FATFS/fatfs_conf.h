@@ -58,11 +58,11 @@
  **********************************************************************************************************************/
 #define FATFS_STANDARDLIBRARY    (0U)
 #define FF_FS_READONLY           (0U)
-#define FF_FS_LOCK               (2U)
-#define FF_USE_FIND               (0U)
+#define FF_FS_LOCK               (18U)
+#define FF_USE_FIND               (1U)
 #define FF_USE_MKFS               (0U)
-#define FF_USE_FASTSEEK           (0U)
-#define FF_USE_EXPAND           (0U)
+#define FF_USE_FASTSEEK           (1U)
+#define FF_USE_EXPAND           (1U)
 #define FF_USE_CHMOD           (0U)
 #define FF_USE_LABEL              (0U)
 #define FF_USE_FORWARD            (0U)
@@ -135,6 +135,9 @@ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR TH
 - moved EVE_cmd_newlist() to the group of commands that are not used for display lists
 - removed EVE_cmd_newlist_burst()
 
+5.1 (changes from RS)
+- added EVE_memRead_buffer() to read a block of memory with one transfer (uses spi_receive_buffer() if the target defines EVE_RECEIVE_BUFFER)
+
 */
 
 #include <stdint.h>
@@ -211,6 +214,29 @@ uint32_t EVE_memRead32(uint32_t ftAddress)
 }
 
 
+/* read a block of memory with a single transfer (the address increments automatically), much faster than one EVE_memRead32() per 4 bytes */
+void EVE_memRead_buffer(uint32_t ftAddress, uint8_t *data, uint32_t len)
+{
+	EVE_cs_set();
+	spi_transmit((uint8_t)(ftAddress >> 16) | MEM_READ); /* send Memory Read plus high address byte */
+	spi_transmit((uint8_t)(ftAddress >> 8)); /* send middle address byte */
+	spi_transmit((uint8_t)(ftAddress)); /* send low address byte */
+	spi_transmit(0x00);	/* send dummy byte */
+
+	#if defined (EVE_RECEIVE_BUFFER)
+	spi_receive_buffer(data, len); /* target receives the whole block at once */
+	#else
+	uint32_t count;
+	for(count=0;count<len;count++)
+	{
+		data[count] = spi_receive(0x00);
+	}
+	#endif
+
+	EVE_cs_clear();
+}
+
+
 void EVE_memWrite8(uint32_t ftAddress, uint8_t ftData8)
 {
 	EVE_cs_set();
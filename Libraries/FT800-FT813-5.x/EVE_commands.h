@@ -98,6 +98,7 @@ void EVE_cmdWrite(uint8_t command, uint8_t parameter);
 uint8_t EVE_memRead8(uint32_t ftAddress);
 uint16_t EVE_memRead16(uint32_t ftAddress);
 uint32_t EVE_memRead32(uint32_t ftAddress);
+void EVE_memRead_buffer(uint32_t ftAddress, uint8_t *data, uint32_t len);
 void EVE_memWrite8(uint32_t ftAddress, uint8_t ftData8);
 void EVE_memWrite16(uint32_t ftAddress, uint16_t ftData16);
 void EVE_memWrite32(uint32_t ftAddress, uint32_t ftData32);
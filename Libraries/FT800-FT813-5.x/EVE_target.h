@@ -61,6 +61,7 @@ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR TH
 
 5.1 (adapted from Rudolph Riedel base version 1.13 (this file V5.0) - below changes are from RS 2020/21)
 - added a section for XMC4700_F144x2048 (XMC4700 with Infineon DAVE)
+- added spi_receive_buffer() to the XMC4700 section (EVE_RECEIVE_BUFFER, used by EVE_memRead_buffer())
 
  */
 
@@ -250,6 +251,13 @@ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR TH
 				return (uint8_t) ReadData;
 			}
 
+			// Receive a block of bytes in one transfer (used by EVE_memRead_buffer)
+			#define EVE_RECEIVE_BUFFER
+			static inline void spi_receive_buffer(uint8_t *data, uint32_t len) {
+				SPI_MASTER_Receive(&SPI_MASTER_0, data, len);
+				while(SPI_MASTER_0.runtime->rx_busy){}
+			}
+
 			static inline uint8_t fetch_flash_byte(const uint8_t *data) {
 				return *data;
 			}
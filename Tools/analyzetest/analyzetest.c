@@ -0,0 +1,665 @@
+/*
+@file    		analyzetest.c
+@brief   		Host test: Cross-correlation (ground speed) and damping estimator of the DeflectionAnalyzer on synthetic signals and replayed recordings (see analyzecore.h)
+@version 		1.0
+@date    		2021-10-18
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -I../.. -o analyzetest analyzetest.c ../../analyzecore.c ../../recfmt.c -lm
+Usage:	analyzetest [REC.BIN]
+
+Without argument the firmware algorithms are checked against signals with known parameters:
+- Damping: damped sines after a step (known damping ratio and natural frequency, front and rear with different values, small noise) must give
+  every ring-down as one event with zeta within DAMP_TOL_ZETA and fn within DAMP_TOL_FN, the session averages must match as well.
+- Correlation: a random road profile on the front and the same profile delayed by a known number of samples on the rear (plus noise) must give
+  valid windows (XCORR_MIN_VALID after the first XCORR_WARMUP windows) with the lag of every window within XCORR_TOL_LAG and the mean lag within
+  XCORR_TOL_MEAN samples. A delay beyond ANALYZE_XCORR_MAXLAG must give no valid window, unrelated signals at most XCORR_MAX_FALSE.
+- Replay: the signals are written to a .BIN file (uncompressed and delta packed, with event lines in between, see recfmt.h), read back the way
+  a recording is replayed and must give exactly the results of the direct run.
+With a file the recording is replayed (channel 0 = front, 1 = rear, converted with the calibration fit and stages of the file header) and the
+damping events and the correlation windows are listed.
+Windows and samples are processed in the same order and with the same steps as analyze_tick does on the device.
+Returns 0 if all checks pass (or the file was replayed), 1 if a check failed, 2 if the file can't be read or has no valid header.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "analyzecore.h"
+#include "recfmt.h"
+
+#define INTERVAL		0.005f	// Time between two samples in seconds (MEASUREMENT_INTERVAL of the firmware)
+#define DAMP_TOL_ZETA	0.02f	// Allowed absolute error of the damping ratio of an event
+#define DAMP_TOL_FN		0.05f	// Allowed relative error of the natural frequency of an event
+#define DAMP_EVENT_GAP	8.0f	// Time between two ring-downs of the synthetic signal in seconds
+#define DAMP_EVENTS		5		// Ring-downs per synthetic signal
+#define XCORR_WARMUP	4		// Windows at the start not checked (the average of the cross spectrum builds up, see ANALYZE_XCORR_AVG_WEIGHT)
+#define XCORR_TOL_LAG	1.5f	// Allowed error of the lag of every checked window in samples
+#define XCORR_TOL_MEAN	0.3f	// Allowed error of the mean lag of the checked windows in samples
+#define XCORR_MIN_VALID	0.9f	// Share of the checked windows that must be valid
+#define XCORR_MAX_FALSE	0.05f	// Share of the checked windows of unrelated travels that may be valid (chance correlation of two short windows)
+#define XCORR_SAMPLES	12000	// Samples of a synthetic road profile (60s)
+#define NOISE			0.2f	// Amplitude of the noise added to every synthetic value in mm
+#define REPLAY_FILE		"analyzetest.bin"	// Temporary file of the replay check
+#define REPLAY_SCALE	0.05f	// Raw value to mm of the channels of the replay file (fit y = REPLAY_OFFSET + REPLAY_SCALE*x)
+#define REPLAY_OFFSET	-50.0f
+#define REPLAY_EVENT_EVERY 97	// An event group is written after every ... samples of the replay file
+
+// Layout of the firmware (see FIFO_... in globals.h)
+#define CHUNK_SIZE		1024
+#define CHUNK_HEADER	16
+#define LINE_SIZE		4
+#define EVENT_MARKER	0xFFFF
+
+// Analysis of two channels, fed sample by sample like analyze_tick does
+typedef struct {
+	dampState      damp[2];
+	analyze_dampingResult dampRes[2];
+	xcorrCore      xc;
+	analyze_xcorrResult xcorrRes;
+	float          hist[2][ANALYZE_XCORR_WINDOW];	// Last values of both channels (ring buffer, index = sample % ANALYZE_XCORR_WINDOW)
+	uint32_t       samples;							// Samples fed so far
+	uint32_t       lastStart;						// Sample at the start of the last window
+	uint32_t       validWindows;					// Windows with a valid result (after XCORR_WARMUP)
+	float          lagMin, lagMax, lagSum;			// Range and sum of the lag of these windows in samples
+	uint8_t        verbose;							// Print every event and window
+} analyzer;
+
+static int failed = 0;
+
+
+
+static void check(int ok, const char* name){
+	/// Print the result of a check and note a failure.
+
+
+	printf("%-70s %s\n", name, ok ? "OK" : "FAILED");
+	if(!ok)
+		failed = 1;
+}
+
+static float noise(void){
+	/// Uniform noise from -NOISE to NOISE (fixed seed, so every run is the same).
+
+
+	static uint32_t state = 12345;
+	state = state*1664525u + 1013904223u;
+	return NOISE * ((float)(state >> 8) / (1 << 23) - 1.0f);
+}
+
+static float quantize(float value){
+	/// Value as read back from a replay file (raw value of a channel converted with its fit), so the direct run and the replay see the same values.
+
+
+	float raw = (float)lrintf((value - REPLAY_OFFSET) / REPLAY_SCALE);
+	return REPLAY_OFFSET + REPLAY_SCALE*raw;
+}
+
+static void analyzer_init(analyzer* an, uint8_t verbose){
+	/// Start a new session.
+
+
+	memset(an, 0, sizeof(*an));
+	xcorr_init(&an->xc);
+	an->lagMin = 1e9f;
+	an->lagMax = -1e9f;
+	an->verbose = verbose;
+}
+
+static void analyzer_window(analyzer* an){
+	/// Correlate the last ANALYZE_XCORR_WINDOW values of both channels (all steps of the state machine of analyze_tick in one go).
+
+
+	for(uint8_t s = 0; s < 2; s++)
+		for(uint16_t n = 0; n < ANALYZE_XCORR_WINDOW; n++)
+			xcorr_set(&an->xc, s, n, an->hist[s][(an->samples + n) % ANALYZE_XCORR_WINDOW]);
+	xcorr_prepare(&an->xc);
+	for(uint8_t stage = 1; stage <= ANALYZE_XCORR_FFT_BITS; stage++)
+		xcorr_fftStage(&an->xc, stage);
+	xcorr_spectrum(&an->xc);
+	for(uint8_t stage = 1; stage <= ANALYZE_XCORR_FFT_BITS; stage++)
+		xcorr_fftStage(&an->xc, stage);
+	xcorr_peak(&an->xc, INTERVAL, &an->xcorrRes);
+
+	// Statistics of the valid windows
+	if(an->xcorrRes.valid && an->xcorrRes.windows > XCORR_WARMUP){
+		float lag = an->xcorrRes.lag / INTERVAL;
+		an->validWindows++;
+		an->lagSum += lag;
+		if(lag < an->lagMin) an->lagMin = lag;
+		if(lag > an->lagMax) an->lagMax = lag;
+	}
+	if(an->verbose)
+		printf("Window %5u  sample %8u  lag %7.4f s  confidence %.2f  speed %6.1f km/h%s\n", an->xcorrRes.windows, an->samples,
+				an->xcorrRes.lag, an->xcorrRes.confidence, an->xcorrRes.speed, an->xcorrRes.valid ? "" : "  (not valid)");
+}
+
+static void analyzer_sample(analyzer* an, const float* value, const uint8_t* ok){
+	/// Feed one sample of both channels. value is the converted value, ok is 0 for an error (skipped by the damping estimator, the last valid
+	/// value is used by the correlation - same as analyze.c).
+
+
+	for(uint8_t s = 0; s < 2; s++){
+		float* slot = &an->hist[s][an->samples % ANALYZE_XCORR_WINDOW];
+		if(ok[s]){
+			uint32_t events = an->dampRes[s].events;
+			damp_sample(&an->damp[s], &an->dampRes[s], value[s], an->samples, INTERVAL);
+			if(an->verbose && an->dampRes[s].events != events)
+				printf("Damping %s  sample %8u  zeta %.3f  fn %5.2f Hz  swings %2d\n", s ? "rear " : "front", an->samples,
+						an->dampRes[s].zeta, an->dampRes[s].fn, an->dampRes[s].swings);
+			*slot = value[s];
+		}
+		else
+			*slot = an->hist[s][(an->samples + ANALYZE_XCORR_WINDOW - 1) % ANALYZE_XCORR_WINDOW];
+	}
+	an->samples++;
+
+	// Next window every ANALYZE_XCORR_HOP samples
+	if(an->samples >= ANALYZE_XCORR_WINDOW && an->samples - an->lastStart >= ANALYZE_XCORR_HOP){
+		an->lastStart = an->samples;
+		analyzer_window(an);
+	}
+}
+
+static float convert(const recfmtChannel* ch, float x){
+	/// Conversion pipeline of a channel of the file header: calibration fit followed by the stages (same as measure_conv_evaluate).
+
+
+	float result = 0.0f;
+	for(int8_t i = ch->fitOrder; i >= 0; i--)
+		result = result*x + ch->fitCoefficients[i];
+	for(uint8_t s = 0; s < ch->convStages && s < RECFMT_STAGES_MAX; s++){
+		const recfmtStage* stage = &ch->stages[s];
+		if(stage->type == 1){
+			float y = 0.0f;
+			for(int8_t i = stage->order; i >= 0; i--)
+				y = y*result + stage->coefficients[i];
+			result = y;
+		}
+		else if(stage->type == 2)
+			result -= ch->originPoint + ch->operatingPoint;
+	}
+	return result;
+}
+
+static void replayBlock(analyzer* an, const recfmtLayout* lay, const recfmtFileHeader* hdr, const uint8_t* lines){
+	/// Feed the measurement lines of a block (event groups are skipped). Raw values of 0 or above the error threshold are errors.
+
+
+	for(uint16_t l = recfmt_nextSample(lay, lines, 0); l < lay->lines; l = recfmt_nextSample(lay, lines, l+1)){
+		float value[2];
+		uint8_t ok[2];
+		for(uint8_t s = 0; s < 2; s++){
+			uint16_t raw;
+			memcpy(&raw, lines + l*lay->lineSize + 2*s, 2);
+			ok[s] = (raw != 0 && raw <= hdr->channel[s].errorThreshold);
+			value[s] = convert(&hdr->channel[s], raw);
+		}
+		analyzer_sample(an, value, ok);
+	}
+}
+
+static int replay(const char* path, analyzer* an){
+	/// Replay a recording through the analyzer. After a corrupt or missing chunk the damping estimators start over (like a gap on the device).
+	/// Returns 0 if the file was read, 1 if chunks were lost, 2 if it can't be read
+
+
+	FILE* file = fopen(path, "rb");
+	if(file == NULL){
+		printf("Error: Could not open %s\n", path);
+		return 2;
+	}
+
+	// File header
+	static uint8_t first[65536];
+	size_t size = fread(first, 1, sizeof(first), file);
+	if(recfmt_checkHeader(first, size) != recfmtHeaderOK){
+		printf("Error: %s has no valid file header\n", path);
+		fclose(file);
+		return 2;
+	}
+	recfmtFileHeader hdr;
+	memcpy(&hdr, first, sizeof(hdr));
+	uint8_t codec = recfmt_codec(&hdr);
+	if(hdr.channels < 2 || hdr.channel[0].sampleType != recfmtSampleU16 || hdr.channel[1].sampleType != recfmtSampleU16 || codec > recfmtCodecDelta){
+		printf("Error: %s needs two u16 channels and a known codec\n", path);
+		fclose(file);
+		return 2;
+	}
+	if(fabsf(hdr.interval - INTERVAL*1000.0f) > 1e-3f)
+		printf("Note: interval of the file is %.3f ms, the analysis assumes %.3f ms\n", hdr.interval, INTERVAL*1000.0f);
+
+	// Layout and buffers (see recinfo)
+	uint16_t dataSize = hdr.chunkSize - hdr.chunkHeaderSize;
+	recfmtLayout lay = {.lines = dataSize / hdr.lineSize, .lineSize = hdr.lineSize, .eventMarker = hdr.eventMarker, .channels = hdr.channels};
+	uint32_t frameMax = RECFMT_FRAME_SIZE_MAX(&lay);
+	uint8_t* chunk = malloc(hdr.chunkSize);
+	uint8_t* frame = malloc(frameMax);
+	uint8_t* block = malloc(frameMax);
+	uint32_t seed = recfmt_chunkSeed(&hdr);
+
+	// Every chunk - uncompressed chunks are a block, packed chunks hold frames that may continue in the next chunk
+	uint32_t expected = 0, lost = 0;
+	uint16_t have = 0, need = 0;
+	fseek(file, hdr.chunkSize, SEEK_SET);
+	while(fread(chunk, 1, hdr.chunkSize, file) == hdr.chunkSize){
+		recfmtChunkHeader ch;
+		memcpy(&ch, chunk, RECFMT_CHUNK_HEADER_SIZE_V1);
+		uint8_t* data = chunk + hdr.chunkHeaderSize;
+		if(ch.magic != (codec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC) || ch.dataSize != dataSize ||
+		   recfmt_chunkCrc(chunk, hdr.chunkHeaderSize, seed) != ch.crc || ch.seq != expected){
+			// Gap - start over at the next chunk that is OK
+			lost++;
+			need = 0;
+			an->damp[0].direction = an->damp[1].direction = 0;
+			an->damp[0].phase = an->damp[1].phase = dampIdle;
+			if(ch.magic == (codec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC) && recfmt_chunkCrc(chunk, hdr.chunkHeaderSize, seed) == ch.crc)
+				expected = ch.seq;
+			else{
+				expected++;
+				continue;
+			}
+		}
+		expected++;
+
+		if(codec == recfmtCodecNone){
+			replayBlock(an, &lay, &hdr, data);
+			continue;
+		}
+		recfmtPackedPrefix prefix;
+		memcpy(&prefix, data, sizeof(prefix));
+		uint16_t end = (prefix.used < dataSize) ? prefix.used : dataSize;
+		uint16_t pos = sizeof(prefix);
+		if(need == 0){
+			if(prefix.frameStart == RECFMT_NO_FRAME)
+				continue;
+			pos = prefix.frameStart;
+			have = 0;
+			need = sizeof(recfmtFrameHeader);
+		}
+		while(pos < end && need > 0){
+			uint16_t n = end - pos;
+			if(n > need - have)
+				n = need - have;
+			memcpy(frame + have, data + pos, n);
+			pos += n;
+			have += n;
+			if(have < need)
+				break;
+
+			// Frame header complete - size of the frame
+			if(need == sizeof(recfmtFrameHeader)){
+				recfmtFrameHeader fh;
+				memcpy(&fh, frame, sizeof(fh));
+				need = (fh.size > sizeof(recfmtFrameHeader) && fh.size <= frameMax) ? fh.size : 0;
+				continue;
+			}
+
+			// Frame complete
+			if(recfmt_decodeFrame(&lay, frame, need, block))
+				replayBlock(an, &lay, &hdr, block);
+			else
+				lost++;
+			have = 0;
+			need = sizeof(recfmtFrameHeader);
+		}
+	}
+
+	fclose(file);
+	free(chunk);
+	free(frame);
+	free(block);
+	return lost ? 1 : 0;
+}
+
+static int writeReplayFile(const float (*value)[2], uint32_t count, uint8_t codec, uint32_t* pad){
+	/// Write the values (mm) as recording with the layout of the firmware: chunks of CHUNK_SIZE bytes, codec none or packed frames (see record_blockPacked).
+	/// An event group (sync event with two payload lines) follows every REPLAY_EVENT_EVERY samples. The rest of the last block is zero like
+	/// on the device, pad is set to the number of these lines (read as samples with errors).
+	/// Returns 0 on success
+
+
+	FILE* file = fopen(REPLAY_FILE, "wb");
+	if(file == NULL)
+		return 1;
+
+	// File header
+	static uint8_t first[CHUNK_SIZE];
+	recfmtFileHeader* hdr = (recfmtFileHeader*)first;
+	memset(first, 0, sizeof(first));
+	memcpy(hdr->magic, RECFMT_MAGIC, sizeof(hdr->magic));
+	hdr->version = RECFMT_VERSION;
+	hdr->headerSize = sizeof(recfmtFileHeader);
+	hdr->chunkSize = CHUNK_SIZE;
+	hdr->chunkHeaderSize = CHUNK_HEADER;
+	hdr->lineSize = LINE_SIZE;
+	hdr->eventMarker = EVENT_MARKER;
+	hdr->channels = 2;
+	hdr->interval = INTERVAL*1000.0f;
+	strcpy(hdr->firmware, "analyzetest");
+	hdr->codec = codec;
+	hdr->nonce = 0x5EED0000u | codec;
+	for(uint8_t s = 0; s < 2; s++){
+		recfmtChannel* ch = &hdr->channel[s];
+		strcpy(ch->name, s ? "rear" : "front");
+		ch->sampleType = recfmtSampleU16;
+		ch->sampleSize = 2;
+		ch->fitOrder = 1;
+		ch->errorThreshold = 4095;
+		ch->fitCoefficients[0] = REPLAY_OFFSET;
+		ch->fitCoefficients[1] = REPLAY_SCALE;
+	}
+	hdr->crc = recfmt_crc32(0, hdr, offsetof(recfmtFileHeader, crc));
+	uint32_t seed = recfmt_chunkSeed(hdr);
+	fwrite(first, 1, sizeof(first), file);
+
+	// Blocks of lines
+	recfmtLayout lay = {.lines = (CHUNK_SIZE - CHUNK_HEADER) / LINE_SIZE, .lineSize = LINE_SIZE, .eventMarker = EVENT_MARKER, .channels = 2};
+	static uint8_t chunk[CHUNK_SIZE];
+	static uint8_t frame[CHUNK_SIZE + sizeof(recfmtFrameHeader)];
+	uint8_t* data = chunk + CHUNK_HEADER;
+	recfmtPackedPrefix* prefix = (recfmtPackedPrefix*)data;
+	uint16_t dataSize = CHUNK_SIZE - CHUNK_HEADER;
+	uint16_t packPos = 0;
+	uint32_t seq = 0, frameSeq = 0, n = 0, sinceEvent = 0;
+	*pad = 0;
+	static uint8_t lines[CHUNK_SIZE - CHUNK_HEADER];
+	while(n < count){
+		// Fill a block - event groups are never split over two blocks
+		memset(lines, 0, sizeof(lines));
+		uint16_t l = 0;
+		while(l < lay.lines && n < count){
+			uint8_t* line = lines + l*LINE_SIZE;
+			if(sinceEvent == REPLAY_EVENT_EVERY){
+				if(l + 3 > lay.lines)
+					break;
+				uint16_t marker = EVENT_MARKER;
+				memcpy(line, &marker, 2);
+				line[2] = 2;	// fifoEventSync
+				line[3] = 2;	// Payload lines
+				memcpy(line + LINE_SIZE, &n, sizeof(n));
+				l += 3;
+				sinceEvent = 0;
+				continue;
+			}
+			for(uint8_t s = 0; s < 2; s++){
+				uint16_t raw = (uint16_t)lrintf((value[n][s] - REPLAY_OFFSET) / REPLAY_SCALE);
+				memcpy(line + 2*s, &raw, 2);
+			}
+			l++;
+			n++;
+			sinceEvent++;
+		}
+		if(n == count)
+			*pad = lay.lines - l;
+
+		// Uncompressed - the block is the chunk
+		if(codec == recfmtCodecNone){
+			memset(chunk, 0, sizeof(chunk));
+			memcpy(data, lines, sizeof(lines));
+			recfmtChunkHeader* ch = (recfmtChunkHeader*)chunk;
+			ch->magic = RECFMT_CHUNK_MAGIC;
+			ch->dataSize = dataSize;
+			ch->seq = seq++;
+			ch->crc = recfmt_chunkCrc(chunk, CHUNK_HEADER, seed);
+			fwrite(chunk, 1, sizeof(chunk), file);
+			continue;
+		}
+
+		// Packed - append the frame, write every full chunk (and the last one)
+		uint16_t size = recfmt_encodeFrame(&lay, lines, codec, frame);
+		const uint8_t* src = frame;
+		while(size > 0 || (n == count && packPos > 0)){
+			if(packPos == 0){
+				memset(chunk, 0, sizeof(chunk));
+				prefix->frameStart = RECFMT_NO_FRAME;
+				packPos = sizeof(recfmtPackedPrefix);
+			}
+			if(src == frame && size > 0 && prefix->frameStart == RECFMT_NO_FRAME){
+				prefix->frameStart = packPos;
+				prefix->frameSeq = frameSeq;
+			}
+			uint16_t len = dataSize - packPos;
+			if(len > size)
+				len = size;
+			memcpy(data + packPos, src, len);
+			packPos += len;
+			src += len;
+			size -= len;
+			if(packPos == dataSize || (size == 0 && n == count)){
+				prefix->used = packPos;
+				recfmtChunkHeader* ch = (recfmtChunkHeader*)chunk;
+				ch->magic = RECFMT_CHUNK_MAGIC_PACKED;
+				ch->dataSize = dataSize;
+				ch->seq = seq++;
+				ch->crc = recfmt_chunkCrc(chunk, CHUNK_HEADER, seed);
+				fwrite(chunk, 1, sizeof(chunk), file);
+				packPos = 0;
+			}
+		}
+		frameSeq++;
+	}
+
+	fclose(file);
+	return 0;
+}
+
+static void checkReplay(const float (*value)[2], uint32_t count, const char* what){
+	/// Write the values as recording with every codec, replay it and compare the results with a direct run over the same values.
+
+
+	static const char* codecs[] = {"uncompressed", "pack12", "delta"};
+	char name[100];
+	for(uint8_t codec = recfmtCodecNone; codec <= recfmtCodecDelta; codec += 2){
+		uint32_t pad;
+		if(writeReplayFile(value, count, codec, &pad) != 0){
+			printf("Error: Could not write %s\n", REPLAY_FILE);
+			failed = 1;
+			return;
+		}
+
+		// Direct run (the zero lines at the end of the file are errors)
+		static analyzer direct, an;
+		analyzer_init(&direct, 0);
+		uint8_t ok[2] = {1, 1}, error[2] = {0, 0};
+		float zero[2] = {REPLAY_OFFSET, REPLAY_OFFSET};
+		for(uint32_t n = 0; n < count; n++)
+			analyzer_sample(&direct, value[n], ok);
+		for(uint32_t n = 0; n < pad; n++)
+			analyzer_sample(&direct, zero, error);
+
+		// Replay
+		analyzer_init(&an, 0);
+		int res = replay(REPLAY_FILE, &an);
+		remove(REPLAY_FILE);
+		int same = (res == 0 && an.samples == direct.samples && an.xcorrRes.windows == direct.xcorrRes.windows && an.validWindows == direct.validWindows);
+		for(uint8_t s = 0; s < 2; s++){
+			const analyze_dampingResult* a = &an.dampRes[s];
+			const analyze_dampingResult* b = &direct.dampRes[s];
+			if(a->events != b->events || a->avgZeta != b->avgZeta || a->avgFn != b->avgFn)
+				same = 0;
+		}
+		if(an.lagMin != direct.lagMin || an.lagMax != direct.lagMax || an.lagSum != direct.lagSum || an.xcorrRes.lag != direct.xcorrRes.lag)
+			same = 0;
+		sprintf(name, "%s: replayed %s file gives the same results", what, codecs[codec]);
+		check(same, name);
+	}
+}
+
+static void testDamping(void){
+	/// Ring-downs with known damping ratio and natural frequency on both channels (front and rear with different parameters).
+
+
+	static const float cases[][5] = {	// zeta front, fn front, zeta rear, fn rear, step in mm
+		{0.05f, 1.5f, 0.10f, 2.0f, 50.0f},
+		{0.10f, 3.0f, 0.05f, 4.0f, 50.0f},
+		{0.20f, 2.0f, 0.25f, 3.0f, 50.0f},
+		{0.15f, 6.0f, 0.05f, 8.0f, 30.0f},
+		{0.30f, 2.5f, 0.35f, 1.5f, 120.0f},
+		{0.30f, 2.5f, 0.40f, 3.0f, 50.0f},	// Too few free swings above ANALYZE_DAMP_MIN_SWING - no event expected
+	};
+	const float rest = 60.0f;
+	uint32_t count = (uint32_t)(DAMP_EVENTS*DAMP_EVENT_GAP/INTERVAL);
+	float (*value)[2] = malloc(count*sizeof(*value));
+	char name[100];
+
+	for(uint8_t c = 0; c < sizeof(cases)/sizeof(cases[0]); c++){
+		// Step to rest+amp followed by the free oscillation back to rest, every DAMP_EVENT_GAP seconds
+		for(uint32_t n = 0; n < count; n++){
+			for(uint8_t s = 0; s < 2; s++){
+				float zeta = cases[c][2*s], fn = cases[c][2*s+1];
+				float t = fmodf(n*INTERVAL, DAMP_EVENT_GAP) - 0.5f;
+				float wn = 2.0f*(float)M_PI*fn, wd = wn*sqrtf(1.0f - zeta*zeta);
+				value[n][s] = quantize(rest + noise() + ((t >= 0.0f) ? cases[c][4]*expf(-zeta*wn*t)*(cosf(wd*t) + zeta/sqrtf(1.0f - zeta*zeta)*sinf(wd*t)) : 0.0f));
+			}
+		}
+
+		static analyzer an;
+		analyzer_init(&an, 0);
+		uint8_t ok[2] = {1, 1};
+		float maxErrZeta[2] = {0, 0}, maxErrFn[2] = {0, 0};
+		uint32_t events[2] = {0, 0};
+		for(uint32_t n = 0; n < count; n++){
+			analyzer_sample(&an, value[n], ok);
+			for(uint8_t s = 0; s < 2; s++){
+				if(an.dampRes[s].events == events[s])
+					continue;
+				events[s] = an.dampRes[s].events;
+				float errZeta = fabsf(an.dampRes[s].zeta - cases[c][2*s]);
+				float errFn = fabsf(an.dampRes[s].fn - cases[c][2*s+1]) / cases[c][2*s+1];
+				if(errZeta > maxErrZeta[s]) maxErrZeta[s] = errZeta;
+				if(errFn > maxErrFn[s]) maxErrFn[s] = errFn;
+			}
+		}
+
+		for(uint8_t s = 0; s < 2; s++){
+			const analyze_dampingResult* res = &an.dampRes[s];
+			float zeta = cases[c][2*s], fn = cases[c][2*s+1], amp = cases[c][4];
+			// Free swings after the input: the first goes from the peak after the step to the next one, every one is exp(-pi*zeta/sqrt(1-zeta^2)) of the one before
+			float decay = expf(-(float)M_PI*zeta/sqrtf(1.0f - zeta*zeta));
+			uint8_t swings = 0;
+			for(float swing = amp*decay*(1.0f + decay); swing >= ANALYZE_DAMP_MIN_SWING + 1.0f && swings < ANALYZE_DAMP_MAX_SWINGS; swing *= decay)
+				swings++;
+			uint32_t expected = (swings >= ANALYZE_DAMP_MIN_SWINGS) ? DAMP_EVENTS : 0;
+			printf("Damping %s zeta %.2f fn %.1f Hz step %3.0f mm: %u events, avg zeta %.3f fn %.2f Hz, max error zeta %.3f fn %.1f%%\n", s ? "rear " : "front",
+					zeta, fn, amp, res->events, res->avgZeta, res->avgFn, maxErrZeta[s], maxErrFn[s]*100.0f);
+			sprintf(name, "Damping %s zeta %.2f fn %.1f Hz step %3.0f mm: %s", s ? "rear " : "front", zeta, fn, amp, expected ? "one event per ring-down" : "no event");
+			check(res->events == expected, name);
+			if(expected == 0)
+				continue;
+			sprintf(name, "Damping %s zeta %.2f fn %.1f Hz step %3.0f mm: events and average in tolerance", s ? "rear " : "front", zeta, fn, amp);
+			check(maxErrZeta[s] <= DAMP_TOL_ZETA && maxErrFn[s] <= DAMP_TOL_FN && fabsf(res->avgZeta - zeta) <= DAMP_TOL_ZETA &&
+				  fabsf(res->avgFn - fn) <= DAMP_TOL_FN*fn, name);
+		}
+		if(c == 0)
+			checkReplay((const float (*)[2])value, count, "Damping");
+	}
+	free(value);
+}
+
+static void testXcorr(void){
+	/// Road profile on the front and the same profile delayed by a known number of samples on the rear.
+
+
+	static const int32_t delays[] = {10, 40, 100, ANALYZE_XCORR_MAXLAG + 30, -1};	// -1 = rear unrelated to front
+	float (*value)[2] = malloc(XCORR_SAMPLES*sizeof(*value));
+	static float road[XCORR_SAMPLES + 2*ANALYZE_XCORR_MAXLAG + 256];
+	char name[100];
+
+	for(uint8_t d = 0; d < sizeof(delays)/sizeof(delays[0]); d++){
+		int32_t delay = delays[d];
+
+		// Road: low pass filtered noise with a bump now and then (two independent roads for the unrelated case)
+		float level = 0.0f, slope = 0.0f;
+		uint32_t roadLen = sizeof(road)/sizeof(road[0]);
+		for(uint32_t i = 0; i < roadLen; i++){
+			slope += 0.05f*(50.0f*noise() - slope);
+			level += 0.1f*(slope - level);
+			road[i] = level + ((i % 331) < 20 ? 25.0f*sinf((float)M_PI*(i % 331)/20.0f) : 0.0f);
+		}
+		uint32_t offset = 2*ANALYZE_XCORR_MAXLAG + 200;
+		for(uint32_t n = 0; n < XCORR_SAMPLES; n++){
+			value[n][0] = quantize(40.0f + road[offset + n] + noise());
+			if(delay >= 0)
+				value[n][1] = quantize(40.0f + road[offset + n - delay] + noise());
+		}
+		if(delay < 0){
+			for(uint32_t i = 0; i < roadLen; i++){
+				slope += 0.05f*(50.0f*noise() - slope);
+				level += 0.1f*(slope - level);
+				road[i] = level;
+			}
+			for(uint32_t n = 0; n < XCORR_SAMPLES; n++)
+				value[n][1] = quantize(40.0f + road[offset + n] + noise());
+		}
+
+		static analyzer an;
+		analyzer_init(&an, 0);
+		uint8_t ok[2] = {1, 1};
+		for(uint32_t n = 0; n < XCORR_SAMPLES; n++)
+			analyzer_sample(&an, value[n], ok);
+
+		uint32_t checked = an.xcorrRes.windows - XCORR_WARMUP;
+		float mean = an.validWindows ? an.lagSum / an.validWindows : 0.0f;
+		if(delay < 0)
+			printf("Correlation unrelated signals: %u windows checked, %u valid\n", checked, an.validWindows);
+		else if(an.validWindows == 0)
+			printf("Correlation delay %3d samples (%.1f km/h): %u windows checked, none valid\n", delay, ANALYZE_WHEELBASE/(delay*INTERVAL)*3.6f, checked);
+		else
+			printf("Correlation delay %3d samples (%.1f km/h): %u windows checked, %u valid, lag %.2f to %.2f samples, mean %.2f\n", delay,
+					ANALYZE_WHEELBASE/(delay*INTERVAL)*3.6f, checked, an.validWindows, an.lagMin, an.lagMax, mean);
+		if(delay < 0){
+			sprintf(name, "Correlation unrelated signals: at most %.0f%% of the windows valid", XCORR_MAX_FALSE*100.0f);
+			check(an.validWindows <= XCORR_MAX_FALSE*checked, name);
+			continue;
+		}
+		if(delay >= ANALYZE_XCORR_MAXLAG){
+			sprintf(name, "Correlation delay %d samples (beyond the searched lags): no valid window", delay);
+			check(an.validWindows == 0, name);
+			continue;
+		}
+		sprintf(name, "Correlation delay %d samples: at least %.0f%% of the windows valid", delay, XCORR_MIN_VALID*100.0f);
+		check(an.validWindows >= XCORR_MIN_VALID*checked && an.validWindows > 0, name);
+		sprintf(name, "Correlation delay %d samples: lag within %.1f, mean within %.1f samples", delay, XCORR_TOL_LAG, XCORR_TOL_MEAN);
+		check(an.validWindows > 0 && fabsf(an.lagMin - delay) <= XCORR_TOL_LAG && fabsf(an.lagMax - delay) <= XCORR_TOL_LAG &&
+			  fabsf(mean - delay) <= XCORR_TOL_MEAN, name);
+		if(d == 1)
+			checkReplay((const float (*)[2])value, XCORR_SAMPLES, "Correlation");
+	}
+	free(value);
+}
+
+int main(int argc, char* argv[]){
+	/// Run all checks or replay the given file.
+
+
+	if(argc > 2){
+		printf("Usage: %s [REC.BIN]\n", argv[0]);
+		return 2;
+	}
+
+	// Replay a recording
+	if(argc == 2){
+		static analyzer an;
+		analyzer_init(&an, 1);
+		int res = replay(argv[1], &an);
+		if(res == 2)
+			return 2;
+		printf("Samples:     %u (%.1f s)%s\n", an.samples, an.samples*INTERVAL, res ? ", chunks lost" : "");
+		for(uint8_t s = 0; s < 2; s++)
+			printf("Damping %s %u events, avg zeta %.3f, avg fn %.2f Hz\n", s ? "rear: " : "front:", an.dampRes[s].events, an.dampRes[s].avgZeta, an.dampRes[s].avgFn);
+		printf("Correlation: %u windows, %u valid after the first %d", an.xcorrRes.windows, an.validWindows, XCORR_WARMUP);
+		if(an.validWindows > 0)
+			printf(", lag %.3f to %.3f s, mean %.3f s", an.lagMin*INTERVAL, an.lagMax*INTERVAL, an.lagSum/an.validWindows*INTERVAL);
+		printf("\n");
+		return 0;
+	}
+
+	testDamping();
+	testXcorr();
+	printf("%s\n", failed ? "FAILED" : "All checks passed");
+	return failed;
+}
@@ -0,0 +1,1022 @@
+/*
+@file    		codectest.c
+@brief   		Host test: Codec of packed .BIN recordings and the sidecars (.IDX, .LOD) of recordings of the DeflectionAnalyzer (see recfmt.h)
+@version 		1.0
+@date    		2021-10-24
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -I../.. -o codectest codectest.c ../../recfmt.c
+Usage:	codectest [REC.BIN ...]
+
+Without argument the codec is checked with synthetic blocks and recordings (layout of the firmware):
+- Frames: blocks at the limits of the codec (constant 0 and 4095, the biggest differences that still fit the delta mode, full scale steps,
+  random samples, samples above 12 bit, event groups at the start and the end of a block or cut by its end, a block of event groups only,
+  padding bytes behind the samples) must be encoded with the expected mode and decoded to the same lines (padding of measurement lines zero).
+  Nothing may be written behind the frame or the decoded lines.
+- Corrupt frames: a wrong size, a cut frame, an unknown mode and wrong event groups must be rejected. FUZZ_FRAMES frames with random bytes
+  changed must be rejected or decoded without writing behind the lines.
+- Chunks: a synthetic recording is written with every codec (like record_block/record_blockPacked do) and read back like recinfo does. A
+  changed byte in the file header or in a chunk, a chunk of another recording, a missing and a swapped chunk must be detected. All frames that
+  don't touch the lost chunk must still be decoded to the original blocks.
+With files every recording is decoded and its sidecars (same name with .IDX and .LOD, if they exist) are compared to the decoded lines:
+index entries must start at the first block of their chunk with the sample of the chunk header and hold the range and the number of marker
+events of the lines up to the next entry, every bucket of every level of the pyramid must be found where recfmt_lodPage says and hold the
+min/max/mean of its lines (also for files that weren't closed).
+Returns 0 if all checks pass, 1 if a check failed, 2 if a file can't be read or has no valid header.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "recfmt.h"
+
+// Layout of the firmware (FIFO_BLOCK_SIZE, FIFO_CHUNK_HEADER_SIZE, FIFO_LINE_SIZE, SENSORS_SIZE, fifoEventMarker in globals.h)
+#define CHUNK_SIZE		1024
+#define CHUNK_HEADER	16
+#define LINE_SIZE		4
+#define DATA_SIZE		(CHUNK_SIZE - CHUNK_HEADER)
+#define EVENT_MARKER	0xFFFF
+#define EVENT_SYNC		2		// fifoEventSync
+#define EVENT_MARK		3		// fifoEventMarker
+
+#define FILE_BLOCKS		60		// Blocks of a synthetic recording
+#define FILE_NONCE		0x5EED1000u	// Nonce of a synthetic recording (see recfmt_chunkSeed)
+#define FUZZ_FRAMES		200000	// Corrupt frames decoded
+#define GUARD			64		// Bytes behind every output buffer that must not be written
+
+// Block decoded from a recording (lines see recording.data)
+typedef struct {
+	uint32_t seq;			// Running number of the block (uncompressed: of its chunk, packed: of its frame)
+	uint32_t chunk;			// Running number of the data chunk the block starts in
+	uint32_t hdrSample;		// recfmtChunkHeader.sample of that chunk
+	uint8_t  first;			// 1 if it is the first block starting in the chunk (the one hdrSample belongs to)
+} blockInfo;
+
+// Recording read from memory (see readRecording)
+typedef struct {
+	recfmtFileHeader hdr;
+	recfmtLayout lay;
+	uint16_t  dataSize;		// Bytes behind the chunk header
+	uint32_t  chunks;		// Data chunks in the file
+	uint32_t  corrupt;		// Chunks with wrong magic, size or checksum
+	uint32_t  jumps;		// Chunks with an unexpected running number (missing or in the wrong order)
+	uint32_t  lost;			// Frames that couldn't be assembled or decoded
+	uint32_t  blocks;		// Decoded blocks
+	uint32_t  capacity;		// Blocks info and data have room for
+	blockInfo* info;
+	uint8_t*  data;			// Lines of the decoded blocks (dataSize bytes each)
+} recording;
+
+static const char* codecs[] = {"none", "pack12", "delta"};
+static int failed = 0;
+
+
+
+static void check(int ok, const char* name){
+	/// Print the result of a check and note a failure.
+
+
+	printf("%-70s %s\n", name, ok ? "OK" : "FAILED");
+	if(!ok)
+		failed = 1;
+}
+
+static uint32_t randomValue(void){
+	/// Pseudo random number (fixed seed, so every run is the same).
+
+
+	static uint32_t state = 12345;
+	state = state*1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static uint16_t rd16(const uint8_t* p){
+	/// Little endian 16 bit value
+
+
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void wr16(uint8_t* p, uint16_t v){
+	/// Store a little endian 16 bit value
+
+
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t blockLines(const recfmtLayout* lay, const uint8_t* lines, uint16_t* meas, uint8_t markType, uint16_t* marks){
+	/// Get the measurement lines of a block (their indices in meas, may be NULL) and count the event groups of the type markType (marks may be NULL).
+	/// An own walk over the lines instead of the functions of recfmt.c, so the files are checked against an independent reading of recfmt.h.
+	/// Returns the number of measurement lines
+
+
+	uint16_t n = 0;
+	if(marks != NULL)
+		*marks = 0;
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(rd16(line) == lay->eventMarker){
+			if(marks != NULL && markType != 0 && line[2] == markType)
+				(*marks)++;
+			l += 1 + line[3];
+			continue;
+		}
+		if(meas != NULL)
+			meas[n] = l;
+		n++;
+		l++;
+	}
+	return n;
+}
+
+static void expectedLines(const recfmtLayout* lay, const uint8_t* lines, uint8_t mode, uint8_t* expected){
+	/// Lines a frame of the given mode decodes to: the original lines, padding bytes of measurement lines are zero in the packed modes.
+
+
+	static uint16_t meas[DATA_SIZE];
+	memcpy(expected, lines, lay->lines*lay->lineSize);
+	if(mode == recfmtCodecNone)
+		return;
+	uint16_t n = blockLines(lay, lines, meas, 0, NULL);
+	for(uint16_t i = 0; i < n; i++)
+		memset(expected + meas[i]*lay->lineSize + 2*lay->channels, 0, lay->lineSize - 2*lay->channels);
+}
+
+static int guardOK(const uint8_t* p){
+	/// 1 if the GUARD bytes at p still hold the fill pattern
+
+
+	for(uint16_t i = 0; i < GUARD; i++){
+		if(p[i] != 0xA5)
+			return 0;
+	}
+	return 1;
+}
+
+static void checkBlock(const char* what, const recfmtLayout* lay, const uint8_t* lines, uint8_t maxMode, uint8_t expectMode){
+	/// Encode a block with modes up to maxMode and decode it again. The frame must have the expected mode, be no bigger than RECFMT_FRAME_SIZE_MAX
+	/// and decode to the original lines. Nothing may be written behind the frame or the decoded lines.
+
+
+	static uint8_t frame[sizeof(recfmtFrameHeader) + DATA_SIZE + GUARD];
+	static uint8_t decoded[DATA_SIZE + GUARD];
+	static uint8_t expected[DATA_SIZE];
+	char name[100];
+
+	memset(frame, 0xA5, sizeof(frame));
+	memset(decoded, 0xA5, sizeof(decoded));
+	uint16_t size = recfmt_encodeFrame(lay, lines, maxMode, frame);
+	recfmtFrameHeader fh;
+	memcpy(&fh, frame, sizeof(fh));
+	expectedLines(lay, lines, fh.mode, expected);
+	uint8_t ok = recfmt_decodeFrame(lay, frame, size, decoded);
+	sprintf(name, "%s: %s frame of %u bytes", what, (fh.mode <= recfmtCodecDelta) ? codecs[fh.mode] : "?", size);
+	check(fh.mode == expectMode && fh.size == size && size <= RECFMT_FRAME_SIZE_MAX(lay) && guardOK(frame + size) &&
+		  ok && memcmp(decoded, expected, lay->lines*lay->lineSize) == 0 && guardOK(decoded + lay->lines*lay->lineSize), name);
+}
+
+static uint16_t walkLine(uint16_t v, uint16_t step){
+	/// Next value of a random walk with steps up to +-step, limited to 0..4095
+
+
+	int32_t n = (int32_t)v + (int32_t)(randomValue() % (2*step + 1)) - step;
+	return (uint16_t)((n < 0) ? 0 : (n > 4095) ? 4095 : n);
+}
+
+static uint16_t putEvent(const recfmtLayout* lay, uint8_t* lines, uint16_t l, uint8_t type, uint8_t payload){
+	/// Write an event line with the given number of payload lines (random bytes) at line l. Returns the lines of the group (cut at the end of the block)
+
+
+	uint8_t* line = lines + l*lay->lineSize;
+	memset(line, 0, lay->lineSize);
+	wr16(line, lay->eventMarker);
+	line[2] = type;
+	line[3] = payload;
+	uint16_t n = 1 + payload;
+	if(l + n > lay->lines)
+		n = lay->lines - l;
+	for(uint16_t i = lay->lineSize; i < n*lay->lineSize; i++)
+		line[i] = (uint8_t)randomValue();
+	return n;
+}
+
+static void fillBlock(const recfmtLayout* lay, uint8_t* lines, uint16_t step, uint16_t eventEvery){
+	/// Fill a block with a random walk of every channel (steps up to +-step) and an event group after every eventEvery lines (0 = none).
+	/// Padding bytes of measurement lines are set to 0x5A (the decoder sets them to zero).
+
+
+	static uint16_t v[RECFMT_CHANNELS_MAX] = {2048, 2048, 2048, 2048, 2048, 2048};
+	uint16_t since = 0;
+	for(uint16_t l = 0; l < lay->lines; ){
+		uint8_t* line = lines + l*lay->lineSize;
+		if(eventEvery != 0 && since == eventEvery){
+			l += putEvent(lay, lines, l, (l & 1) ? EVENT_MARK : EVENT_SYNC, (uint8_t)(randomValue() % 5));
+			since = 0;
+			continue;
+		}
+		memset(line, 0x5A, lay->lineSize);
+		for(uint8_t c = 0; c < lay->channels; c++){
+			v[c] = walkLine(v[c], step);
+			wr16(line + 2*c, v[c]);
+		}
+		since++;
+		l++;
+	}
+}
+
+static void testFrames(void){
+	/// Encode and decode blocks at the limits of the codec and corrupt frames
+
+
+	recfmtLayout lay = {.lines = DATA_SIZE / LINE_SIZE, .lineSize = LINE_SIZE, .eventMarker = EVENT_MARKER, .channels = 2};
+	recfmtLayout layPad = {.lines = DATA_SIZE / 8, .lineSize = 8, .eventMarker = EVENT_MARKER, .channels = 3};
+	static uint8_t lines[DATA_SIZE];
+	static uint8_t frame[sizeof(recfmtFrameHeader) + DATA_SIZE + GUARD];
+	static uint8_t work[sizeof(recfmtFrameHeader) + DATA_SIZE + GUARD];
+	static uint8_t decoded[DATA_SIZE + GUARD];
+
+	// Constant blocks (smallest delta frame) and a ramp
+	memset(lines, 0, sizeof(lines));
+	checkBlock("Constant 0", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+	for(uint16_t l = 0; l < lay.lines; l++){
+		wr16(lines + l*LINE_SIZE, 4095);
+		wr16(lines + l*LINE_SIZE + 2, 4095);
+	}
+	checkBlock("Constant 4095", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+	for(uint16_t l = 0; l < lay.lines; l++){
+		wr16(lines + l*LINE_SIZE, l*16);
+		wr16(lines + l*LINE_SIZE + 2, 4095 - l*16);
+	}
+	checkBlock("Ramps up and down", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+
+	// Differences of +-1023 (11 bit zigzag, delta still smaller), +-2047 (12 bit, delta not smaller than pack12) and full scale steps
+	static const uint16_t steps[3] = {1023, 2047, 4095};
+	static const uint8_t stepModes[3] = {recfmtCodecDelta, recfmtCodecPack12, recfmtCodecPack12};
+	for(uint8_t i = 0; i < 3; i++){
+		char what[60];
+		for(uint16_t l = 0; l < lay.lines; l++){
+			wr16(lines + l*LINE_SIZE, (l & 1) ? steps[i] : 0);
+			wr16(lines + l*LINE_SIZE + 2, (l & 1) ? 4095 - steps[i] : 4095);
+		}
+		sprintf(what, "Alternating steps of %u", steps[i]);
+		checkBlock(what, &lay, lines, recfmtCodecDelta, stepModes[i]);
+	}
+
+	// Random samples, samples above 12 bit (stored verbatim), limited modes
+	for(uint16_t l = 0; l < lay.lines; l++){
+		wr16(lines + l*LINE_SIZE, randomValue() & 0xFFF);
+		wr16(lines + l*LINE_SIZE + 2, randomValue() & 0xFFF);
+	}
+	checkBlock("Random 12 bit samples", &lay, lines, recfmtCodecDelta, recfmtCodecPack12);
+	fillBlock(&lay, lines, 3, 0);
+	wr16(lines + 100*LINE_SIZE + 2, 4096);
+	checkBlock("One sample of 4096", &lay, lines, recfmtCodecDelta, recfmtCodecNone);
+	wr16(lines + 100*LINE_SIZE + 2, 0xFFFE);
+	checkBlock("One sample of 0xFFFE", &lay, lines, recfmtCodecDelta, recfmtCodecNone);
+	fillBlock(&lay, lines, 3, 0);
+	checkBlock("Small differences, max. mode none", &lay, lines, recfmtCodecNone, recfmtCodecNone);
+	checkBlock("Small differences, max. mode pack12", &lay, lines, recfmtCodecPack12, recfmtCodecPack12);
+	checkBlock("Small differences", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+
+	// Event groups at the first and the last lines (the last one cut by the end of the block) and many small groups
+	fillBlock(&lay, lines, 3, 0);
+	putEvent(&lay, lines, 0, EVENT_SYNC, 2);
+	putEvent(&lay, lines, 120, EVENT_MARK, 4);
+	putEvent(&lay, lines, lay.lines - 2, EVENT_MARK, 4);
+	checkBlock("Event groups at the start and cut by the end", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+	fillBlock(&lay, lines, 3, 0);
+	putEvent(&lay, lines, lay.lines - 1, EVENT_SYNC, 0);
+	checkBlock("Event line without payload as last line", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+	fillBlock(&lay, lines, 3, 0);
+	for(uint16_t l = 2; l < lay.lines; l += 3)
+		putEvent(&lay, lines, l, EVENT_SYNC, 0);
+	checkBlock("Event line after every second line", &lay, lines, recfmtCodecDelta, recfmtCodecDelta);
+	for(uint16_t l = 0; l < lay.lines; )
+		l += putEvent(&lay, lines, l, EVENT_SYNC, 2);
+	checkBlock("Event groups only", &lay, lines, recfmtCodecDelta, recfmtCodecNone);
+
+	// Padding behind the samples (3 channels in 8 byte lines)
+	fillBlock(&layPad, lines, 5, 40);
+	checkBlock("Padding bytes, 3 channels", &layPad, lines, recfmtCodecDelta, recfmtCodecDelta);
+	checkBlock("Padding bytes, 3 channels, max. mode pack12", &layPad, lines, recfmtCodecPack12, recfmtCodecPack12);
+
+	// Corrupt frames - a delta frame with event groups
+	fillBlock(&lay, lines, 5, 30);
+	uint16_t size = recfmt_encodeFrame(&lay, lines, recfmtCodecDelta, frame);
+	recfmtFrameHeader fh;
+	memcpy(&fh, frame, sizeof(fh));
+	memcpy(work, frame, size);
+	check(fh.mode == recfmtCodecDelta && fh.events > 0 && recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: original frame decoded");
+	check(!recfmt_decodeFrame(&lay, work, size - 1, decoded) && !recfmt_decodeFrame(&lay, work, 3, decoded), "Corrupt frames: size not matching the frame header rejected");
+	wr16(work, size - 1);
+	check(!recfmt_decodeFrame(&lay, work, size - 1, decoded), "Corrupt frames: cut frame rejected");
+	memcpy(work, frame, size);
+	work[2] = recfmtCodecDelta + 1;
+	check(!recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: unknown mode rejected");
+	work[2] = recfmtCodecNone;
+	check(!recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: verbatim frame with wrong size rejected");
+	memcpy(work, frame, size);
+	work[3]++;
+	check(!recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: more event groups than stored rejected");
+	memcpy(work, frame, size);
+	wr16(work + sizeof(recfmtFrameHeader), lay.lines);
+	check(!recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: event group behind the block rejected");
+	memcpy(work, frame, size);
+	wr16(work + sizeof(recfmtFrameHeader), lay.lines - 1);
+	work[sizeof(recfmtFrameHeader) + 2] = 3;
+	check(!recfmt_decodeFrame(&lay, work, size, decoded), "Corrupt frames: event group crossing the end of the block rejected");
+
+	// Random bytes changed in frames of every mode (size field restored in half of them, so the decoder gets past the first check)
+	static uint8_t frames[3][sizeof(recfmtFrameHeader) + DATA_SIZE];
+	static uint16_t sizes[3];
+	for(uint16_t l = 0; l < lay.lines; l++){
+		wr16(lines + l*LINE_SIZE, randomValue() & 0xFFF);
+		wr16(lines + l*LINE_SIZE + 2, randomValue() & 0xFFF);
+	}
+	putEvent(&lay, lines, 7, EVENT_MARK, 3);
+	sizes[0] = recfmt_encodeFrame(&lay, lines, recfmtCodecNone, frames[0]);
+	sizes[1] = recfmt_encodeFrame(&lay, lines, recfmtCodecDelta, frames[1]);
+	sizes[2] = size;
+	memcpy(frames[2], frame, size);
+	uint32_t rejected = 0, overwritten = 0;
+	for(uint32_t i = 0; i < FUZZ_FRAMES; i++){
+		uint8_t f = i % 3;
+		memcpy(work, frames[f], sizes[f]);
+		memset(work + sizes[f], 0xA5, GUARD);
+		for(uint8_t n = 1 + randomValue() % 4; n > 0; n--)
+			work[randomValue() % sizes[f]] ^= (uint8_t)(1 + randomValue() % 255);
+		if(i & 1)
+			wr16(work, sizes[f]);
+		memset(decoded, 0xA5, sizeof(decoded));
+		if(!recfmt_decodeFrame(&lay, work, sizes[f], decoded))
+			rejected++;
+		if(!guardOK(decoded + lay.lines*lay.lineSize) || !guardOK(work + sizes[f]))
+			overwritten++;
+	}
+	char name[100];
+	sprintf(name, "Corrupt frames: %d random changes, %u rejected, none written behind", FUZZ_FRAMES, rejected);
+	check(overwritten == 0, name);
+}
+
+static void addBlock(recording* rec, uint32_t seq, uint32_t chunk, uint32_t hdrSample, uint8_t first, const uint8_t* lines){
+	/// Append a decoded block to the recording
+
+
+	if(rec->blocks == rec->capacity){
+		rec->capacity = rec->capacity ? 2*rec->capacity : 64;
+		rec->info = realloc(rec->info, rec->capacity*sizeof(blockInfo));
+		rec->data = realloc(rec->data, (size_t)rec->capacity*rec->dataSize);
+	}
+	blockInfo* b = &rec->info[rec->blocks];
+	b->seq = seq;
+	b->chunk = chunk;
+	b->hdrSample = hdrSample;
+	b->first = first;
+	memcpy(rec->data + (size_t)rec->blocks*rec->dataSize, lines, rec->dataSize);
+	rec->blocks++;
+}
+
+static void freeRecording(recording* rec){
+	/// Free the decoded blocks
+
+
+	free(rec->info);
+	free(rec->data);
+	rec->info = NULL;
+	rec->data = NULL;
+	rec->blocks = rec->capacity = 0;
+}
+
+static int readRecording(const uint8_t* file, uint32_t size, recording* rec){
+	/// Read a recording from memory the way recinfo does: every chunk is checked on its own, the frames of packed chunks are assembled and
+	/// decoded, decoding restarts at recfmtPackedPrefix.frameStart after a corrupt or missing chunk. The decoded blocks are appended to rec.
+	/// Returns 0 if the file was read (rec holds the number of lost chunks and frames), 2 if it has no valid header
+
+
+	memset(rec, 0, sizeof(recording));
+	if(recfmt_checkHeader(file, size) != recfmtHeaderOK)
+		return 2;
+	const recfmtFileHeader* fileHdr = (const recfmtFileHeader*)file;
+	memcpy(&rec->hdr, file, (fileHdr->headerSize < sizeof(recfmtFileHeader)) ? fileHdr->headerSize : sizeof(recfmtFileHeader));
+	recfmtFileHeader* hdr = &rec->hdr;
+	uint8_t codec = recfmt_codec(hdr);
+	if(codec > recfmtCodecDelta)
+		return 2;
+	rec->dataSize = hdr->chunkSize - hdr->chunkHeaderSize;
+	rec->lay.lines = rec->dataSize / hdr->lineSize;
+	rec->lay.lineSize = hdr->lineSize;
+	rec->lay.eventMarker = hdr->eventMarker;
+	rec->lay.channels = hdr->channels;
+	uint32_t seed = recfmt_chunkSeed(hdr);
+	uint32_t frameMax = RECFMT_FRAME_SIZE_MAX(&rec->lay);
+	uint8_t* frame = malloc(frameMax);
+	uint8_t* block = calloc(1, rec->dataSize);
+
+	uint32_t expected = 0, frameSeq = 0, frameChunk = 0, frameSample = 0;
+	uint8_t  frameFirst = 0;
+	uint16_t have = 0, need = 0;	// Bytes of the frame being assembled, bytes needed (0 = waiting for a frame start)
+	for(uint32_t at = hdr->chunkSize; at + hdr->chunkSize <= size; at += hdr->chunkSize){
+		const uint8_t* chunk = file + at;
+		const uint8_t* data = chunk + hdr->chunkHeaderSize;
+		recfmtChunkHeader ch;
+		memset(&ch, 0, sizeof(ch));
+		memcpy(&ch, chunk, (hdr->chunkHeaderSize < sizeof(ch)) ? hdr->chunkHeaderSize : sizeof(ch));
+		rec->chunks++;
+		if(ch.magic != (codec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC) || ch.dataSize != rec->dataSize ||
+		   recfmt_chunkCrc(chunk, hdr->chunkHeaderSize, seed) != ch.crc){
+			rec->corrupt++;
+			expected++;
+			need = 0;
+			continue;
+		}
+		if(ch.seq != expected){
+			rec->jumps++;
+			need = 0;
+		}
+		expected = ch.seq + 1;
+
+		// Uncompressed - the chunk is the block
+		if(codec == recfmtCodecNone){
+			addBlock(rec, ch.seq, ch.seq, ch.sample, 1, data);
+			continue;
+		}
+
+		// Packed - continue the frame being assembled or restart at the first frame of the chunk
+		recfmtPackedPrefix prefix;
+		memcpy(&prefix, data, sizeof(prefix));
+		uint16_t end = (prefix.used < rec->dataSize) ? prefix.used : rec->dataSize;
+		uint16_t pos = sizeof(prefix);
+		if(need == 0){
+			if(prefix.frameStart == RECFMT_NO_FRAME)
+				pos = end;
+			else{
+				pos = prefix.frameStart;
+				if(prefix.frameSeq > frameSeq)
+					rec->lost += prefix.frameSeq - frameSeq;
+				frameSeq = prefix.frameSeq;
+				have = 0;
+				need = sizeof(recfmtFrameHeader);
+			}
+		}
+		while(pos < end && need > 0){
+			if(have == 0){
+				frameChunk = ch.seq;
+				frameFirst = (pos == prefix.frameStart);
+				frameSample = ch.sample;
+			}
+			uint16_t n = end - pos;
+			if(n > need - have)
+				n = need - have;
+			memcpy(frame + have, data + pos, n);
+			pos += n;
+			have += n;
+			if(have < need)
+				break;
+
+			// Frame header complete - get size of the frame
+			if(need == sizeof(recfmtFrameHeader)){
+				recfmtFrameHeader fh;
+				memcpy(&fh, frame, sizeof(fh));
+				need = fh.size;
+				if(need <= sizeof(recfmtFrameHeader) || need > frameMax){
+					rec->lost++;
+					frameSeq++;
+					need = 0;
+				}
+				continue;
+			}
+
+			// Frame complete - decode
+			if(recfmt_decodeFrame(&rec->lay, frame, need, block))
+				addBlock(rec, frameSeq, frameChunk, frameSample, frameFirst, block);
+			else
+				rec->lost++;
+			frameSeq++;
+			have = 0;
+			need = sizeof(recfmtFrameHeader);
+		}
+	}
+
+	free(frame);
+	free(block);
+	return 0;
+}
+
+static uint32_t writeRecording(uint8_t codec, uint32_t nonce, const uint8_t (*blocks)[DATA_SIZE], uint8_t* file, uint32_t* frameFirst, uint32_t* frameLast){
+	/// Write the blocks as recording with the layout of the firmware to file: chunks of the lines (codec none) or packed frames (see record_blockPacked).
+	/// frameFirst/frameLast get the running number of the first and the last data chunk of every block. Returns the size of the file
+
+
+	recfmtLayout lay = {.lines = DATA_SIZE / LINE_SIZE, .lineSize = LINE_SIZE, .eventMarker = EVENT_MARKER, .channels = 2};
+
+	// File header
+	recfmtFileHeader* hdr = (recfmtFileHeader*)file;
+	memset(file, 0, CHUNK_SIZE);
+	memcpy(hdr->magic, RECFMT_MAGIC, sizeof(hdr->magic));
+	hdr->version = RECFMT_VERSION;
+	hdr->headerSize = sizeof(recfmtFileHeader);
+	hdr->chunkSize = CHUNK_SIZE;
+	hdr->chunkHeaderSize = CHUNK_HEADER;
+	hdr->lineSize = LINE_SIZE;
+	hdr->eventMarker = EVENT_MARKER;
+	hdr->channels = 2;
+	hdr->interval = 5.0f;
+	strcpy(hdr->firmware, "codectest");
+	hdr->codec = codec;
+	hdr->nonce = nonce;
+	for(uint8_t c = 0; c < 2; c++){
+		hdr->channel[c].sampleType = recfmtSampleU16;
+		hdr->channel[c].sampleSize = 2;
+	}
+	hdr->crc = recfmt_crc32(0, hdr, offsetof(recfmtFileHeader, crc));
+	uint32_t seed = recfmt_chunkSeed(hdr);
+
+	// Data chunks
+	static uint8_t frame[sizeof(recfmtFrameHeader) + DATA_SIZE];
+	uint8_t* chunk = file + CHUNK_SIZE;
+	recfmtChunkHeader* ch = (recfmtChunkHeader*)chunk;
+	recfmtPackedPrefix* prefix = (recfmtPackedPrefix*)(chunk + CHUNK_HEADER);
+	uint32_t seq = 0, sample = 0;
+	uint16_t packPos = 0;
+	for(uint32_t f = 0; f < FILE_BLOCKS; f++){
+		// Uncompressed - the block is the chunk
+		if(codec == recfmtCodecNone){
+			memset(chunk, 0, CHUNK_SIZE);
+			memcpy(chunk + CHUNK_HEADER, blocks[f], DATA_SIZE);
+			ch->sample = sample;
+			frameFirst[f] = frameLast[f] = seq;
+		}
+
+		// Packed - append the frame, every full chunk is finished
+		else{
+			uint16_t size = recfmt_encodeFrame(&lay, blocks[f], codec, frame);
+			const uint8_t* src = frame;
+			while(size > 0){
+				if(packPos == 0){
+					memset(chunk, 0, CHUNK_SIZE);
+					prefix->frameStart = RECFMT_NO_FRAME;
+					packPos = sizeof(recfmtPackedPrefix);
+				}
+				if(src == frame){
+					frameFirst[f] = seq;
+					if(prefix->frameStart == RECFMT_NO_FRAME){
+						prefix->frameStart = packPos;
+						prefix->frameSeq = f;
+						ch->sample = sample;
+					}
+				}
+				uint16_t len = DATA_SIZE - packPos;
+				if(len > size)
+					len = size;
+				memcpy(chunk + CHUNK_HEADER + packPos, src, len);
+				packPos += len;
+				src += len;
+				size -= len;
+				frameLast[f] = seq;
+				if(packPos < DATA_SIZE)
+					break;
+				prefix->used = packPos;
+				ch->magic = RECFMT_CHUNK_MAGIC_PACKED;
+				ch->dataSize = DATA_SIZE;
+				ch->seq = seq++;
+				ch->crc = recfmt_chunkCrc(chunk, CHUNK_HEADER, seed);
+				chunk += CHUNK_SIZE;
+				ch = (recfmtChunkHeader*)chunk;
+				prefix = (recfmtPackedPrefix*)(chunk + CHUNK_HEADER);
+				packPos = 0;
+			}
+			sample += blockLines(&lay, blocks[f], NULL, 0, NULL);
+			if(f + 1 < FILE_BLOCKS || packPos == 0)
+				continue;
+			prefix->used = packPos;
+		}
+
+		// Finish the chunk
+		ch->magic = codec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC;
+		ch->dataSize = DATA_SIZE;
+		ch->seq = seq++;
+		ch->crc = recfmt_chunkCrc(chunk, CHUNK_HEADER, seed);
+		if(codec == recfmtCodecNone)
+			sample += blockLines(&lay, blocks[f], NULL, 0, NULL);
+		chunk += CHUNK_SIZE;
+		ch = (recfmtChunkHeader*)chunk;
+	}
+	return (uint32_t)(chunk - file);
+}
+
+static int sameBlocks(const recording* rec, uint8_t codec, const uint8_t (*blocks)[DATA_SIZE], const uint32_t* frameFirst, const uint32_t* frameLast,
+					  uint32_t lostFirst, uint32_t lostLast){
+	/// 1 if every decoded block equals its original block and exactly the blocks that don't touch the data chunks lostFirst to lostLast were decoded
+	/// (lostFirst > lostLast: all blocks)
+
+
+	static uint8_t expected[DATA_SIZE];
+	static uint8_t seen[FILE_BLOCKS];
+	recfmtLayout lay = {.lines = DATA_SIZE / LINE_SIZE, .lineSize = LINE_SIZE, .eventMarker = EVENT_MARKER, .channels = 2};
+	memset(seen, 0, sizeof(seen));
+	for(uint32_t b = 0; b < rec->blocks; b++){
+		uint32_t f = rec->info[b].seq;
+		if(f >= FILE_BLOCKS || seen[f])
+			return 0;
+		seen[f] = 1;
+		expectedLines(&lay, blocks[f], codec, expected);
+		if(memcmp(rec->data + (size_t)b*rec->dataSize, expected, DATA_SIZE) != 0)
+			return 0;
+	}
+	for(uint32_t f = 0; f < FILE_BLOCKS; f++){
+		uint8_t touched = (lostFirst <= lostLast && frameFirst[f] <= lostLast && frameLast[f] >= lostFirst);
+		if(seen[f] == touched)
+			return 0;
+	}
+	return 1;
+}
+
+static void testChunks(void){
+	/// Write synthetic recordings with every codec, read them back and check that damaged files are detected and decoded as far as possible
+
+
+	recfmtLayout lay = {.lines = DATA_SIZE / LINE_SIZE, .lineSize = LINE_SIZE, .eventMarker = EVENT_MARKER, .channels = 2};
+	static uint8_t blocks[FILE_BLOCKS][DATA_SIZE];
+	static uint32_t frameFirst[FILE_BLOCKS], frameLast[FILE_BLOCKS], otherFirst[FILE_BLOCKS], otherLast[FILE_BLOCKS];
+	static uint8_t file[(2*FILE_BLOCKS + 2)*CHUNK_SIZE], other[(2*FILE_BLOCKS + 2)*CHUNK_SIZE], work[(2*FILE_BLOCKS + 2)*CHUNK_SIZE];
+	recording rec;
+	char name[100];
+
+	// Blocks of every frame mode: small and bigger differences with event groups, random samples, samples above 12 bit
+	for(uint32_t f = 0; f < FILE_BLOCKS; f++){
+		switch(f % 5){
+			case 0: fillBlock(&lay, blocks[f], 2, 0); break;
+			case 1: fillBlock(&lay, blocks[f], 40, 37); break;
+			case 2: fillBlock(&lay, blocks[f], 200, 11); break;
+			case 3:
+				fillBlock(&lay, blocks[f], 5, 60);
+				wr16(blocks[f] + 3*LINE_SIZE, 5000);
+				break;
+			default:
+				for(uint16_t l = 0; l < lay.lines; l++){
+					wr16(blocks[f] + l*LINE_SIZE, randomValue() & 0xFFF);
+					wr16(blocks[f] + l*LINE_SIZE + 2, randomValue() & 0xFFF);
+				}
+		}
+	}
+
+	for(uint8_t codec = recfmtCodecNone; codec <= recfmtCodecDelta; codec++){
+		uint32_t size = writeRecording(codec, FILE_NONCE, blocks, file, frameFirst, frameLast);
+		uint32_t chunks = size / CHUNK_SIZE - 1;
+		uint32_t k = chunks / 2;
+
+		// Undamaged
+		int res = readRecording(file, size, &rec);
+		sprintf(name, "Chunks %s: %u blocks in %u chunks decoded", codecs[codec], FILE_BLOCKS, chunks);
+		check(res == 0 && rec.chunks == chunks && rec.corrupt == 0 && rec.jumps == 0 && rec.lost == 0 &&
+			  sameBlocks(&rec, codec, blocks, frameFirst, frameLast, 1, 0), name);
+		freeRecording(&rec);
+
+		// Every byte of the file header changed
+		uint32_t missed = 0;
+		memcpy(work, file, size);
+		for(uint32_t i = 0; i < sizeof(recfmtFileHeader); i++){
+			work[i] ^= (uint8_t)(1 + randomValue() % 255);
+			if(readRecording(work, size, &rec) != 2)
+				missed++;
+			freeRecording(&rec);
+			work[i] = file[i];
+		}
+		sprintf(name, "Chunks %s: every changed byte of the file header detected", codecs[codec]);
+		check(missed == 0, name);
+
+		// Every byte of a data chunk changed - only the blocks touching it are lost
+		missed = 0;
+		for(uint32_t i = (k+1)*CHUNK_SIZE; i < (k+2)*CHUNK_SIZE; i++){
+			work[i] ^= (uint8_t)(1 + randomValue() % 255);
+			if(readRecording(work, size, &rec) != 0 || rec.corrupt != 1 || !sameBlocks(&rec, codec, blocks, frameFirst, frameLast, k, k))
+				missed++;
+			freeRecording(&rec);
+			work[i] = file[i];
+		}
+		sprintf(name, "Chunks %s: every changed byte of chunk %u detected, other blocks decoded", codecs[codec], k);
+		check(missed == 0, name);
+
+		// Chunk of another recording (same content, other nonce)
+		writeRecording(codec, FILE_NONCE + 1, blocks, other, otherFirst, otherLast);
+		memcpy(work + (k+1)*CHUNK_SIZE, other + (k+1)*CHUNK_SIZE, CHUNK_SIZE);
+		res = readRecording(work, size, &rec);
+		sprintf(name, "Chunks %s: chunk of another recording detected", codecs[codec]);
+		check(res == 0 && rec.corrupt == 1 && sameBlocks(&rec, codec, blocks, frameFirst, frameLast, k, k), name);
+		freeRecording(&rec);
+
+		// Missing chunk
+		memcpy(work, file, (k+1)*CHUNK_SIZE);
+		memcpy(work + (k+1)*CHUNK_SIZE, file + (k+2)*CHUNK_SIZE, size - (k+2)*CHUNK_SIZE);
+		res = readRecording(work, size - CHUNK_SIZE, &rec);
+		sprintf(name, "Chunks %s: missing chunk detected, other blocks decoded", codecs[codec]);
+		check(res == 0 && rec.corrupt == 0 && rec.jumps == 1 && sameBlocks(&rec, codec, blocks, frameFirst, frameLast, k, k), name);
+		freeRecording(&rec);
+
+		// Swapped chunks - detected, no block decoded wrong (which ones are still decoded depends on the frames in them)
+		memcpy(work, file, size);
+		memcpy(work + (k+1)*CHUNK_SIZE, file + (k+2)*CHUNK_SIZE, CHUNK_SIZE);
+		memcpy(work + (k+2)*CHUNK_SIZE, file + (k+1)*CHUNK_SIZE, CHUNK_SIZE);
+		res = readRecording(work, size, &rec);
+		uint32_t wrong = 0;
+		static uint8_t expected[DATA_SIZE];
+		for(uint32_t b = 0; b < rec.blocks; b++){
+			expectedLines(&lay, blocks[rec.info[b].seq % FILE_BLOCKS], codec, expected);
+			if(rec.info[b].seq >= FILE_BLOCKS || memcmp(rec.data + (size_t)b*rec.dataSize, expected, DATA_SIZE) != 0)
+				wrong++;
+		}
+		sprintf(name, "Chunks %s: swapped chunks detected, no block decoded wrong", codecs[codec]);
+		check(res == 0 && rec.jumps > 0 && wrong == 0, name);
+		freeRecording(&rec);
+	}
+}
+
+static uint8_t* loadFile(const char* path, uint32_t* size){
+	/// Read a whole file. Returns the content (free it) or NULL if it can't be read
+
+
+	FILE* f = fopen(path, "rb");
+	if(f == NULL)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	long n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t* buf = malloc((n > 0) ? n : 1);
+	if(n < 0 || fread(buf, 1, n, f) != (size_t)n){
+		free(buf);
+		fclose(f);
+		return NULL;
+	}
+	fclose(f);
+	*size = (uint32_t)n;
+	return buf;
+}
+
+static void sidecarName(const char* path, const char* ext, char* name){
+	/// Name of a sidecar of a recording (extension replaced, lower case if the extension of the recording is lower case)
+
+
+	strcpy(name, path);
+	char* dot = strrchr(name, '.');
+	if(dot == NULL || strchr(dot, '/') != NULL)
+		dot = name + strlen(name);
+	uint8_t lower = (dot[0] == '.' && dot[1] >= 'a' && dot[1] <= 'z');
+	for(uint8_t i = 0; i < 4; i++)
+		dot[i] = (lower && ext[i] >= 'A' && ext[i] <= 'Z') ? ext[i] - 'A' + 'a' : ext[i];
+	dot[4] = '\0';
+}
+
+static void checkIndex(const char* path, const recording* rec, const uint32_t* blockSample, const uint16_t* values, uint32_t start, uint32_t end){
+	/// Compare the index of a recording (see recfmt.h) with the decoded blocks. values holds the lines from sample start to end.
+
+
+	char idxName[1024], name[1200];
+	uint32_t size;
+	sidecarName(path, ".IDX", idxName);
+	uint8_t* idx = loadFile(idxName, &size);
+	if(idx == NULL){
+		printf("%s: no index\n", path);
+		return;
+	}
+
+	// Header
+	recfmtIndexHeader ih;
+	memset(&ih, 0, sizeof(ih));
+	memcpy(&ih, idx, (size < sizeof(ih)) ? size : sizeof(ih));
+	uint8_t ch = rec->lay.channels;
+	uint8_t ok = (size >= sizeof(ih) && memcmp(ih.magic, RECFMT_INDEX_MAGIC, sizeof(ih.magic)) == 0 && ih.version == RECFMT_INDEX_VERSION &&
+		  ih.headerSize >= sizeof(ih) && ih.headerSize <= size && ih.entrySize >= offsetof(recfmtIndexEntry, marks) && ih.chunks > 0 &&
+		  ih.chunkSize == rec->hdr.chunkSize && ih.channels == ch);
+	sprintf(name, "%s: index header", idxName);
+	check(ok, name);
+	if(!ok){
+		free(idx);
+		return;
+	}
+	uint32_t entries = (size - ih.headerSize) / ih.entrySize;
+	uint8_t marksValid = (ih.markType != 0 && ih.entrySize >= sizeof(recfmtIndexEntry));
+
+	// Entries - the block of every entry, then the range and marks of the lines up to the next entry
+	uint32_t* entryBlock = malloc((entries + 1)*sizeof(uint32_t));
+	uint32_t badStart = 0, badRange = 0, badMarks = 0, totalMarks = 0, b = 0;
+	for(uint32_t i = 0; i < entries; i++){
+		recfmtIndexEntry e;
+		memcpy(&e, idx + ih.headerSize + i*ih.entrySize, sizeof(e));
+		while(b < rec->blocks && !(rec->info[b].first && rec->info[b].chunk >= e.chunk))
+			b++;
+		entryBlock[i] = b;
+		if(b == rec->blocks || rec->info[b].chunk != e.chunk || e.sample != blockSample[b] || e.sample != rec->info[b].hdrSample)
+			badStart++;
+		if(i > 0){
+			recfmtIndexEntry prev;
+			memcpy(&prev, idx + ih.headerSize + (i-1)*ih.entrySize, sizeof(prev));
+			if(e.chunk < prev.chunk - prev.chunk % ih.chunks + ih.chunks)
+				badStart++;
+		}
+	}
+	entryBlock[entries] = rec->blocks;
+	for(uint32_t i = 0; i < entries && badStart == 0; i++){
+		recfmtIndexEntry e;
+		memcpy(&e, idx + ih.headerSize + i*ih.entrySize, sizeof(e));
+		uint16_t min[RECFMT_CHANNELS_MAX], max[RECFMT_CHANNELS_MAX];
+		uint32_t marks = 0;
+		memset(min, 0xFF, sizeof(min));
+		memset(max, 0, sizeof(max));
+		for(uint32_t k = entryBlock[i]; k < entryBlock[i+1]; k++){
+			uint16_t m;
+			blockLines(&rec->lay, rec->data + (size_t)k*rec->dataSize, NULL, ih.markType, &m);
+			marks += m;
+		}
+		uint32_t last = (i + 1 < entries) ? blockSample[entryBlock[i+1]] : end;
+		for(uint32_t s = blockSample[entryBlock[i]]; s < last; s++){
+			const uint16_t* v = values + (size_t)(s - start)*ch;
+			for(uint8_t c = 0; c < ch; c++){
+				if(v[c] < min[c])
+					min[c] = v[c];
+				if(v[c] > max[c])
+					max[c] = v[c];
+			}
+		}
+		// The last entry of a file that wasn't closed may end before the end of the file (the entries behind it weren't written)
+		for(uint8_t c = 0; c < ch; c++){
+			if((i + 1 < entries && (e.min[c] != min[c] || e.max[c] != max[c])) || (i + 1 == entries && (e.min[c] < min[c] || e.max[c] > max[c])))
+				badRange++;
+		}
+		if(marksValid && ((i + 1 < entries) ? e.marks != marks : e.marks > marks))
+			badMarks++;
+		totalMarks += e.marks;
+	}
+	// An index without entries is valid (entries are written with the syncs, a file that wasn't closed may have none yet)
+	sprintf(name, "%s: %u entries start at the first block of their chunk", idxName, entries);
+	check(badStart == 0, name);
+	sprintf(name, "%s: range of the lines of every entry", idxName);
+	check(badStart == 0 && badRange == 0, name);
+	if(marksValid){
+		sprintf(name, "%s: %u marker events in the entries", idxName, totalMarks);
+		check(badStart == 0 && badMarks == 0, name);
+	}
+	free(entryBlock);
+	free(idx);
+}
+
+static void checkPyramid(const char* path, const recording* rec, const uint16_t* values, uint32_t samples){
+	/// Compare the pyramid of a recording (see recfmt.h) with the decoded lines
+
+
+	char lodName[1024], name[1200];
+	uint32_t size;
+	sidecarName(path, ".LOD", lodName);
+	uint8_t* lod = loadFile(lodName, &size);
+	if(lod == NULL){
+		printf("%s: no pyramid\n", path);
+		return;
+	}
+
+	// Header and buckets in the file
+	recfmtLodHeader lh;
+	recfmtLodContent content;
+	memset(&lh, 0, sizeof(lh));
+	memcpy(&lh, lod, (size < sizeof(lh)) ? size : sizeof(lh));
+	uint8_t ch = rec->lay.channels;
+	uint8_t ok = (size >= sizeof(lh) && lh.pageSize > 0 && recfmt_lodContent(&lh, (size - lh.pageSize) / lh.pageSize, &content) && lh.channels == ch);
+	sprintf(name, "%s: pyramid header (%s, %u lines)", lodName, lh.complete ? "closed" : "not closed", lh.complete ? lh.samples : samples);
+	check(ok && (!lh.complete || lh.samples == samples), name);
+	if(!ok){
+		free(lod);
+		return;
+	}
+
+	// Every bucket of every level
+	uint32_t perPage = RECFMT_LOD_PAGE_BUCKETS(&lh);
+	uint32_t buckets = 0, bad = 0;
+	uint64_t span = lh.base;
+	for(uint8_t l = 0; l < lh.levels; l++, span *= lh.factor){
+		for(uint32_t i = 0; i < content.buckets[l]; i++){
+			buckets++;
+			uint32_t pos = recfmt_lodPage(&lh, &content, l, i / perPage);
+			recfmtLodPage page;
+			if(pos == 0 || (uint64_t)(pos + 1)*lh.pageSize > size){
+				bad++;
+				continue;
+			}
+			memcpy(&page, lod + pos*lh.pageSize, sizeof(page));
+			if(page.level != l || page.first != i / perPage * perPage || i - page.first >= page.buckets){
+				bad++;
+				continue;
+			}
+
+			// Lines of the bucket - a file that wasn't closed holds full buckets only
+			uint64_t from = i*span, to = from + span;
+			if(to > samples)
+				to = (lh.complete && from < samples) ? samples : 0;
+			if(to == 0){
+				bad++;
+				continue;
+			}
+			const uint8_t* val = lod + pos*lh.pageSize + sizeof(recfmtLodPage) + (i - page.first)*lh.bucketSize;
+			for(uint8_t c = 0; c < ch; c++){
+				uint16_t min = 0xFFFF, max = 0;
+				uint64_t sum = 0;
+				for(uint64_t s = from; s < to; s++){
+					uint16_t v = values[s*ch + c];
+					min = (v < min) ? v : min;
+					max = (v > max) ? v : max;
+					sum += v;
+				}
+				recfmtLodValue lv;
+				memcpy(&lv, val + c*sizeof(recfmtLodValue), sizeof(lv));
+				if(lv.min != min || lv.max != max || lv.mean != (uint16_t)((sum + (to - from)/2) / (to - from)))
+					bad++;
+			}
+		}
+	}
+	sprintf(name, "%s: %u buckets of %u levels hold min/max/mean of their lines", lodName, buckets, lh.levels);
+	check(bad == 0 && (samples < lh.base || buckets > 0), name);
+	free(lod);
+}
+
+static int checkFile(const char* path){
+	/// Decode a recording and compare its sidecars with it. Returns 2 if the file can't be read or has no valid header, 0 otherwise
+
+
+	char name[1200];
+	uint32_t size;
+	uint8_t* file = loadFile(path, &size);
+	if(file == NULL){
+		printf("Error: Could not open %s\n", path);
+		return 2;
+	}
+	recording rec;
+	if(readRecording(file, size, &rec) != 0){
+		printf("Error: %s has no valid file header\n", path);
+		free(file);
+		return 2;
+	}
+	free(file);
+	sprintf(name, "%s: %u chunks, %u blocks decoded (%s)", path, rec.chunks, rec.blocks, codecs[recfmt_codec(&rec.hdr)]);
+	check(rec.corrupt == 0 && rec.jumps == 0 && rec.lost == 0, name);
+
+	// Samples of every block (counted from the first one) and the values of all measurement lines
+	uint8_t ch = rec.lay.channels;
+	uint32_t* blockSample = malloc((rec.blocks + 1)*sizeof(uint32_t));
+	uint16_t* meas = malloc(rec.lay.lines*sizeof(uint16_t));
+	uint32_t samples = 0, badSample = 0;
+	for(uint32_t b = 0; b < rec.blocks; b++)
+		samples += blockLines(&rec.lay, rec.data + (size_t)b*rec.dataSize, NULL, 0, NULL);
+	uint16_t* values = malloc(((size_t)samples + 1)*ch*sizeof(uint16_t));
+	uint32_t start = (rec.blocks > 0) ? rec.info[0].hdrSample : 0;
+	samples = 0;
+	for(uint32_t b = 0; b < rec.blocks; b++){
+		const uint8_t* lines = rec.data + (size_t)b*rec.dataSize;
+		blockSample[b] = start + samples;
+		if(rec.info[b].first && rec.info[b].hdrSample != blockSample[b])
+			badSample++;
+		uint16_t n = blockLines(&rec.lay, lines, meas, 0, NULL);
+		for(uint16_t i = 0; i < n; i++){
+			for(uint8_t c = 0; c < ch; c++)
+				values[(size_t)(samples + i)*ch + c] = rd16(lines + meas[i]*rec.lay.lineSize + 2*c);
+		}
+		samples += n;
+	}
+	blockSample[rec.blocks] = start + samples;
+	uint8_t hasSample = (rec.hdr.chunkHeaderSize >= sizeof(recfmtChunkHeader));
+	if(hasSample){
+		sprintf(name, "%s: chunk headers hold the sample of their first block", path);
+		check(badSample == 0, name);
+	}
+
+	// Sidecars (only if the file was decoded completely, the positions in them are relative to the first sample of the file)
+	if(hasSample && rec.corrupt == 0 && rec.jumps == 0 && rec.lost == 0){
+		checkIndex(path, &rec, blockSample, values, start, start + samples);
+		checkPyramid(path, &rec, values, samples);
+	}
+
+	free(blockSample);
+	free(meas);
+	free(values);
+	freeRecording(&rec);
+	return 0;
+}
+
+int main(int argc, char* argv[]){
+	/// Run all checks or check the given recordings and their sidecars.
+
+
+	if(argc > 1){
+		int res = 0;
+		for(int i = 1; i < argc; i++){
+			if(checkFile(argv[i]) != 0)
+				res = 2;
+		}
+		printf("%s\n", failed ? "FAILED" : res ? "Files not read" : "All checks passed");
+		return failed ? 1 : res;
+	}
+
+	testFrames();
+	testChunks();
+	printf("%s\n", failed ? "FAILED" : "All checks passed");
+	return failed;
+}
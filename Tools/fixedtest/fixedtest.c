@@ -0,0 +1,110 @@
+/*
+@file    		fixedtest.c
+@brief   		Host test: Quantization round trip of the 16bit fixed-point buffers of the DeflectionAnalyzer (see fixedpt.h, MEASURE_FIXED_BUFFERS)
+@version 		1.0
+@date    		2021-10-18
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -I../.. -o fixedtest fixedtest.c ../../fixedpt.c -lm
+Usage:	fixedtest
+
+Every value of a range is stored and read back with the formats the firmware uses and compared to the error bounds documented in globals.h:
+filtered values (fixed range 0 to 4096 counts, max. error 0.032 counts) and converted values (range of the conversion table plus the margin of
+fixed_formatRange, e.g. -40 to 160mm with max. error 0.0016mm). Also checks that the stored value never decreases with the value, that every
+ADC count reads back as the same integer, that values outside of the range saturate to its ends and that an empty range still works.
+Returns 0 if all checks pass, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "fixedpt.h"
+
+#define FILTER_MAX		4096.0f	// Range of the filtered values (CONV_LUT_INPUT_MAX of the firmware)
+#define FILTER_BOUND	0.032f	// Documented max. error of the filtered values in counts
+#define CONV_MIN		-40.0f	// Example range of a conversion table in mm (documented in globals.h)
+#define CONV_MAX		160.0f
+#define CONV_BOUND		0.0016f	// Documented max. error of the converted values in mm
+#define SWEEP_STEPS		2000000	// Values checked per range
+
+static int failed = 0;
+
+
+
+static void check(int ok, const char* name){
+	/// Print the result of a check and note a failure.
+
+
+	printf("%-58s %s\n", name, ok ? "OK" : "FAILED");
+	if(!ok)
+		failed = 1;
+}
+
+static float sweep(fixedFormat fmt, float min, float max, int* monotonic){
+	/// Store and read back SWEEP_STEPS values evenly spread from min to max. Returns the largest error, monotonic is 0 if a bigger value was
+	/// ever stored as a smaller integer.
+
+
+	float maxErr = 0.0f;
+	int32_t last = -32769;
+	*monotonic = 1;
+	for(int32_t i = 0; i <= SWEEP_STEPS; i++){
+		float value = min + (max - min) * (float)i / SWEEP_STEPS;
+		int16_t stored = FIXEDPT_FROM_FLOAT(fmt, value);
+		float err = fabsf(FIXEDPT_TO_FLOAT(fmt, stored) - value);
+		if(err > maxErr)
+			maxErr = err;
+		if(stored < last)
+			*monotonic = 0;
+		last = stored;
+	}
+	return maxErr;
+}
+
+int main(void){
+	/// Run all checks.
+
+
+	char name[80];
+	int monotonic;
+
+	// Filtered values - fixed format of the firmware (see globals.c)
+	fixedFormat filter = FIXED_FORMAT_RANGE(0.0f, FILTER_MAX);
+	float err = sweep(filter, 0.0f, FILTER_MAX, &monotonic);
+	printf("Filtered:  step %.6f counts, max. error %.6f counts\n", filter.scale, err);
+	sprintf(name, "Filtered error <= half a step and <= %.3f counts", FILTER_BOUND);
+	check(err <= filter.scale*0.5f*1.001f + FILTER_MAX*1e-6f && err <= FILTER_BOUND, name);
+	check(monotonic, "Filtered values monotonic");
+
+	// Every ADC count reads back as the same integer (a filter over equal raw values doesn't drift)
+	int exact = 1;
+	for(int raw = 0; raw < 4096; raw++){
+		if(lrintf(FIXEDPT_TO_FLOAT(filter, FIXEDPT_FROM_FLOAT(filter, (float)raw))) != raw)
+			exact = 0;
+	}
+	check(exact, "Every ADC count reads back as the same integer");
+
+	// Converted values - format of measure_conv_compile (range of the table plus margin)
+	fixedFormat conv = fixed_formatRange(CONV_MIN, CONV_MAX);
+	err = sweep(conv, CONV_MIN, CONV_MAX, &monotonic);
+	printf("Converted: step %.6f mm, max. error %.6f mm (range %.2f to %.2f)\n", conv.scale, err,
+			FIXEDPT_TO_FLOAT(conv, -32768), FIXEDPT_TO_FLOAT(conv, 32767));
+	sprintf(name, "Converted error <= half a step and <= %.4f mm", CONV_BOUND);
+	check(err <= conv.scale*0.5f*1.001f + CONV_MAX*1e-6f && err <= CONV_BOUND, name);
+	check(monotonic, "Converted values monotonic");
+
+	// Values in the margin are stored without saturation, values outside of it saturate to the ends of the format
+	float margin = (CONV_MAX - CONV_MIN) * FIXED_FORMAT_MARGIN;
+	check(FIXEDPT_FROM_FLOAT(conv, CONV_MIN - margin*0.9f) > -32768 && FIXEDPT_FROM_FLOAT(conv, CONV_MAX + margin*0.9f) < 32767,
+			"Values in the margin not saturated");
+	check(FIXEDPT_FROM_FLOAT(conv, CONV_MIN - 2*margin) == -32768 && FIXEDPT_FROM_FLOAT(conv, CONV_MAX + 2*margin) == 32767 &&
+		  FIXEDPT_FROM_FLOAT(conv, -1e30f) == -32768 && FIXEDPT_FROM_FLOAT(conv, 1e30f) == 32767,
+			"Values outside of the range saturate");
+
+	// Empty range (e.g. a constant conversion table) still gives a usable format
+	fixedFormat flat = fixed_formatRange(5.0f, 5.0f);
+	check(flat.scale > 0.0f && fabsf(FIXEDPT_TO_FLOAT(flat, FIXEDPT_FROM_FLOAT(flat, 5.0f)) - 5.0f) <= flat.scale, "Empty range usable");
+
+	printf("%s\n", failed ? "FAILED" : "All checks passed");
+	return failed;
+}
@@ -0,0 +1,231 @@
+/*
+@file    		recinfo.c
+@brief   		Host tool: Show the header of a .BIN recording of the DeflectionAnalyzer and check all data chunks (see recfmt.h)
+@version 		1.0
+@date    		2021-10-22
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -I../.. -o recinfo recinfo.c ../../recfmt.c
+Usage:	recinfo [-b] REC.BIN
+
+Every chunk is checked on its own (position is known from its running number), so the output lists exactly which chunks are corrupt or missing.
+Compressed files are decoded frame by frame as well (the device uses the same decoder, see record_convertNextFrame).
+-b	Benchmark of the codec: every block of the file is encoded again with each mode (compression ratio, time per block, check of the decoding).
+Returns 0 if all chunks are OK, 1 if chunks are corrupt or missing, 2 if the file can't be read or has no valid header.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "recfmt.h"
+
+#define BENCH_REPEAT	50		// Encodings per block and mode (clock() is too coarse for a single block)
+
+static const char* sampleTypes[] = {"none", "u16", "i16", "u32"};
+static const char* codecs[] = {"none", "pack12", "delta"};
+
+// Benchmark results per mode (see benchBlock)
+static uint32_t benchBlocks = 0;
+static uint64_t benchBytes[3];
+static double   benchTime[3];
+static uint32_t benchErrors[3];
+
+
+
+static void benchBlock(const recfmtLayout* lay, const uint8_t* lines, uint8_t* frame, uint8_t* decoded){
+	/// Encode the lines of a block with every mode, measure the time and check that the decoded lines are equal to the original ones.
+
+
+	benchBlocks++;
+	for(uint8_t mode = recfmtCodecNone; mode <= recfmtCodecDelta; mode++){
+		uint16_t size = 0;
+		clock_t start = clock();
+		for(int i = 0; i < BENCH_REPEAT; i++)
+			size = recfmt_encodeFrame(lay, lines, mode, frame);
+		benchTime[mode] += (double)(clock() - start) / CLOCKS_PER_SEC / BENCH_REPEAT;
+		benchBytes[mode] += size;
+		if(!recfmt_decodeFrame(lay, frame, size, decoded) || memcmp(decoded, lines, lay->lines * lay->lineSize) != 0)
+			benchErrors[mode]++;
+	}
+}
+
+int main(int argc, char* argv[]){
+	/// Print the file header and the result of the chunk check.
+
+
+	uint8_t bench = (argc == 3 && strcmp(argv[1], "-b") == 0);
+	if(argc != 2 && !bench){
+		printf("Usage: %s [-b] REC.BIN\n", argv[0]);
+		return 2;
+	}
+	FILE* file = fopen(argv[argc-1], "rb");
+	if(file == NULL){
+		printf("Error: Could not open %s\n", argv[argc-1]);
+		return 2;
+	}
+
+	// File header (at most 64kB, chunk size is a 16 bit value)
+	static uint8_t first[65536];
+	size_t size = fread(first, 1, sizeof(first), file);
+	uint8_t state = recfmt_checkHeader(first, size);
+	if(state != recfmtHeaderOK){
+		printf("Error: %s\n", (state == recfmtHeaderNone) ? "No file header (recorded before the recording format)" : "File header corrupt");
+		return 2;
+	}
+	recfmtFileHeader* hdr = (recfmtFileHeader*)first;
+	uint8_t codec = recfmt_codec(hdr);
+	printf("Version:   %d (%s)\n", hdr->version, hdr->firmware);
+	printf("Layout:    chunk %d bytes (header %d), line %d bytes (pad %d), event marker 0x%04X, codec %s\n",
+			hdr->chunkSize, hdr->chunkHeaderSize, hdr->lineSize, hdr->linePad, hdr->eventMarker, (codec < 3) ? codecs[codec] : "?");
+	printf("Interval:  %.3f ms, post processing flags 0x%02X\n", hdr->interval, hdr->postProcess);
+	for(uint8_t i = 0; i < hdr->channels; i++){
+		recfmtChannel* ch = &hdr->channel[i];
+		printf("Channel %d: %-12.12s %s, filter %d, threshold %d, fit order %d (%g %g %g %g), origin %g, operating %g, %d stages\n",
+				i, ch->name, (ch->sampleType < 4) ? sampleTypes[ch->sampleType] : "?", ch->avgFilterInterval, ch->errorThreshold,
+				ch->fitOrder, ch->fitCoefficients[0], ch->fitCoefficients[1], ch->fitCoefficients[2], ch->fitCoefficients[3],
+				ch->originPoint, ch->operatingPoint, ch->convStages);
+	}
+	if(codec > recfmtCodecDelta){
+		printf("Error: Unknown codec %d\n", codec);
+		return 2;
+	}
+
+	// Layout of a block and buffers of a frame being assembled, a decoded block and one for the benchmark
+	uint16_t dataSize = hdr->chunkSize - hdr->chunkHeaderSize;
+	recfmtLayout lay = {
+		.lines = dataSize / hdr->lineSize,
+		.lineSize = hdr->lineSize,
+		.eventMarker = hdr->eventMarker,
+		.channels = hdr->channels
+	};
+	uint32_t frameMax = RECFMT_FRAME_SIZE_MAX(&lay);
+	uint8_t* chunk = malloc(hdr->chunkSize);
+	uint8_t* frame = malloc(frameMax);
+	uint8_t* block = malloc(frameMax);
+	uint8_t* benchFrame = malloc(frameMax);
+	uint8_t* benchLines = malloc(frameMax);
+	uint32_t seed = recfmt_chunkSeed(hdr);
+	uint8_t benchOK = 1;
+	for(uint8_t i = 0; i < hdr->channels; i++){
+		if(hdr->channel[i].sampleType != recfmtSampleU16)
+			benchOK = 0;
+	}
+
+	// Check data chunks (and decode the frames of packed chunks)
+	uint32_t chunks = 0, corrupt = 0, missing = 0, expected = 0;
+	uint32_t frames = 0, framesLost = 0, frameSeq = 0, frameBytes = 0;
+	uint16_t have = 0, need = 0;	// Bytes of the frame being assembled, bytes needed (0 = waiting for a frame start)
+	fseek(file, hdr->chunkSize, SEEK_SET);
+	while(fread(chunk, 1, hdr->chunkSize, file) == hdr->chunkSize){
+		recfmtChunkHeader ch;
+		memcpy(&ch, chunk, RECFMT_CHUNK_HEADER_SIZE_V1);
+		uint8_t* data = chunk + hdr->chunkHeaderSize;
+		if(ch.magic != (codec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC) || ch.dataSize != dataSize || recfmt_chunkCrc(chunk, hdr->chunkHeaderSize, seed) != ch.crc){
+			printf("Chunk %u: corrupt\n", expected);
+			corrupt++;
+			need = 0;
+		}
+		else{
+			if(ch.seq != expected){
+				printf("Chunk %u: running number %u (%d chunks missing)\n", expected, ch.seq, (int)(ch.seq - expected));
+				missing += (ch.seq > expected) ? ch.seq - expected : 0;
+				need = 0;
+			}
+			expected = ch.seq;
+
+			// Uncompressed - the chunk is the block
+			if(codec == recfmtCodecNone){
+				if(bench && benchOK)
+					benchBlock(&lay, data, benchFrame, benchLines);
+			}
+			// Packed - continue the frame being assembled or restart at the first frame of the chunk
+			else{
+				recfmtPackedPrefix prefix;
+				memcpy(&prefix, data, sizeof(prefix));
+				uint16_t end = (prefix.used < dataSize) ? prefix.used : dataSize;
+				uint16_t pos = sizeof(prefix);
+				if(need == 0){
+					if(prefix.frameStart == RECFMT_NO_FRAME)
+						pos = end;
+					else{
+						pos = prefix.frameStart;
+						if(prefix.frameSeq != frameSeq)
+							framesLost += prefix.frameSeq - frameSeq;
+						frameSeq = prefix.frameSeq;
+						have = 0;
+						need = sizeof(recfmtFrameHeader);
+					}
+				}
+				while(pos < end && need > 0){
+					uint16_t n = end - pos;
+					if(n > need - have)
+						n = need - have;
+					memcpy(frame + have, data + pos, n);
+					pos += n;
+					have += n;
+					if(have < need)
+						break;
+
+					// Frame header complete - get size of the frame
+					if(need == sizeof(recfmtFrameHeader)){
+						recfmtFrameHeader fh;
+						memcpy(&fh, frame, sizeof(fh));
+						need = fh.size;
+						if(need <= sizeof(recfmtFrameHeader) || need > frameMax){
+							printf("Frame %u: bad size %u\n", frameSeq, need);
+							need = 0;
+						}
+						continue;
+					}
+
+					// Frame complete - decode
+					if(recfmt_decodeFrame(&lay, frame, need, block)){
+						frames++;
+						frameBytes += need;
+						if(bench && benchOK)
+							benchBlock(&lay, block, benchFrame, benchLines);
+					}
+					else{
+						printf("Frame %u: can't be decoded\n", frameSeq);
+						framesLost++;
+					}
+					frameSeq++;
+					have = 0;
+					need = sizeof(recfmtFrameHeader);
+				}
+			}
+		}
+		expected++;
+		chunks++;
+	}
+	fclose(file);
+
+	// Results
+	uint32_t lines = chunks * lay.lines;
+	if(codec == recfmtCodecNone)
+		printf("Chunks:    %u (%u corrupt, %u missing), up to %u lines = %.2f s\n", chunks, corrupt, missing, lines, lines*hdr->interval/1000.0);
+	else{
+		lines = frames * lay.lines;
+		printf("Chunks:    %u (%u corrupt, %u missing), %u frames decoded (%u lost), up to %u lines = %.2f s\n",
+				chunks, corrupt, missing, frames, framesLost, lines, lines*hdr->interval/1000.0);
+		if(chunks > 0 && frames > 0)
+			printf("Ratio:     %.2f (blocks/chunks), %.2f (frames, %.0f bytes per block)\n", (double)frames/chunks, (double)frames*dataSize/frameBytes, (double)frameBytes/frames);
+	}
+	if(bench && !benchOK)
+		printf("Benchmark: only possible with u16 samples\n");
+	else if(bench && benchBlocks > 0){
+		printf("Benchmark: %u blocks of %u bytes\n", benchBlocks, dataSize);
+		for(uint8_t mode = recfmtCodecNone; mode <= recfmtCodecDelta; mode++)
+			printf("  %-7s ratio %.2f, %.0f bytes per block, encoding %.2f us per block, %u decoding errors\n", codecs[mode],
+					(double)benchBlocks*dataSize/benchBytes[mode], (double)benchBytes[mode]/benchBlocks, benchTime[mode]*1e6/benchBlocks, benchErrors[mode]);
+	}
+
+	free(chunk);
+	free(frame);
+	free(block);
+	free(benchFrame);
+	free(benchLines);
+	return (corrupt || missing || framesLost) ? 1 : 0;
+}
@@ -0,0 +1,445 @@
+/*
+@file    		sdqueuetest.c
+@brief   		Host test: Write queue of the recording (see sdqueue.h) with a simulated SD-card
+@version 		1.0
+@date    		2021-10-26
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -I../.. -o sdqueuetest sdqueuetest.c ../../sdqueue.c
+Usage:	sdqueuetest [busy [stall [every [interval]]]]
+		busy	 ... Programming time of the card per write in us (default 3000)
+		stall	 ... Additional busy time of every n-th write in us, like the internal housekeeping of a card (default 250000)
+		every	 ... n of stall (default 16, 0 = no stalls)
+		interval ... Time between two finished FIFO blocks in us (default 100000, the firmware needs about 1.3s per block without codec)
+
+The card runs on a virtual clock: a write takes a command time, a transfer time per sector and the busy time, a poll costs a few us and the
+card can refuse the next write for a moment after the last one (deferred start). The data is copied to the card image only when the write is
+done, so a buffer that is reused before the queue reported it as written shows up as wrong data.
+Checked are the order and content of the writes, the merging of consecutive requests, a full queue, deferred starts and the handling of a
+failed write. Then a recording is simulated (FIFO of 4 blocks of 2 sectors, main loop tick of 5ms with touch and display work) once with
+blocking writes like SDMMC_BLOCK_WriteBlock and once with the queue polled by the main loop, the longest stall of the main loop and FIFO
+overruns of both are compared.
+Returns 0 if all checks pass, 1 otherwise.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdqueue.h"
+
+#define CARD_SECTORS	4096	// Size of the simulated card
+#define FIFO_BLOCKS		4		// Blocks of the FIFO of the recording (FIFO_BLOCKS of the firmware)
+#define BLOCK_SECTORS	2		// Sectors of a FIFO block (FIFO_BLOCK_SIZE 1024)
+#define SIM_BLOCKS		400		// FIFO blocks recorded by the simulation
+#define TICK_TIME		5000	// Main loop tick in us (MEASUREMENT_INTERVAL)
+#define TOUCH_TIME		100		// TFT_touch per tick in us
+#define DISPLAY_TIME	9000	// TFT_display every 4th tick in us (monitoring screen)
+
+// Timing of the simulated card in us
+typedef struct {
+	uint32_t command;	// Command and response
+	uint32_t sector;	// Transfer of a sector
+	uint32_t busy;		// Programming after the last sector
+	uint32_t stall;		// Additional busy time of every n-th write
+	uint32_t every;		// n of stall (0 = none)
+	uint32_t release;	// Time after a write in which the card refuses the next one
+	uint32_t poll;		// CPU time of a poll
+	uint32_t failAt;	// Write that fails (0 = none)
+} cardTiming;
+
+static cardTiming card;
+static uint64_t simTime;							// Virtual clock in us
+static uint8_t  image[CARD_SECTORS*SDQUEUE_SECTOR_SIZE];	// Content of the card
+static uint64_t cardFree;							// Time the card takes the next write
+static uint32_t cardWrites;							// Writes started on the card
+
+// Write in progress
+static struct {
+	const uint8_t* buf;
+	uint32_t sector;
+	uint32_t count;
+	uint64_t done;
+	int      running;
+} cw;
+
+static int failed = 0;
+
+
+
+static void check(int ok, const char* name){
+	/// Print the result of a check and note a failure.
+
+
+	printf("%-70s %s\n", name, ok ? "OK" : "FAILED");
+	if(!ok)
+		failed = 1;
+}
+
+static void card_reset(void){
+	/// Empty card, clock at 0, no write running.
+
+
+	memset(image, 0, sizeof(image));
+	memset(&cw, 0, sizeof(cw));
+	simTime = cardFree = 0;
+	cardWrites = 0;
+}
+
+static uint32_t card_duration(uint32_t count){
+	/// Time of the next write of count sectors (command, transfer, programming and the stall of every n-th write).
+
+
+	cardWrites++;
+	uint32_t t = card.command + count*card.sector + card.busy;
+	if(card.every > 0 && cardWrites % card.every == 0)
+		t += card.stall;
+	return t;
+}
+
+static uint8_t card_start(const void* buf, uint32_t sector, uint32_t count){
+	/// sdqueueDevice.start of the simulated card (costs the time of a poll).
+
+
+	simTime += card.poll;
+	if(cw.running || simTime < cardFree)
+		return sdqueueBusy;
+	if(count == 0 || sector + count > CARD_SECTORS)
+		return sdqueueError;
+	cw.buf = (const uint8_t*)buf;
+	cw.sector = sector;
+	cw.count = count;
+	cw.done = simTime + card_duration(count);
+	cw.running = 1;
+	return sdqueueIdle;
+}
+
+static uint8_t card_poll(void){
+	/// sdqueueDevice.poll of the simulated card - the data is taken when the write is done.
+
+
+	simTime += card.poll;
+	if(!cw.running)
+		return sdqueueIdle;
+	if(simTime < cw.done)
+		return sdqueueBusy;
+	cw.running = 0;
+	cardFree = simTime + card.release;
+	if(card.failAt > 0 && cardWrites == card.failAt)
+		return sdqueueError;
+	memcpy(image + cw.sector*SDQUEUE_SECTOR_SIZE, cw.buf, cw.count*SDQUEUE_SECTOR_SIZE);
+	return sdqueueIdle;
+}
+
+static void card_write(const void* buf, uint32_t sector, uint32_t count){
+	/// Blocking write (like SDMMC_BLOCK_WriteBlock): waits until the card takes it and until it is programmed.
+
+
+	if(simTime < cardFree)
+		simTime = cardFree;
+	simTime += card_duration(count);
+	memcpy(image + sector*SDQUEUE_SECTOR_SIZE, buf, count*SDQUEUE_SECTOR_SIZE);
+	cardFree = simTime + card.release;
+}
+
+static const sdqueueDevice cardDevice = {card_start, card_poll};
+
+static void fill(uint8_t* buf, uint32_t sectors, uint32_t seed){
+	/// Fill sectors with a pattern depending on seed.
+
+
+	for(uint32_t i = 0; i < sectors*SDQUEUE_SECTOR_SIZE; i++)
+		buf[i] = (uint8_t)(seed*131 + i*7 + (i >> 8));
+}
+
+static uint32_t drain(sdqueue* q){
+	/// Poll until the queue is empty or failed. Returns the number of sectors reported as written.
+
+
+	uint32_t total = 0, written;
+	uint8_t res;
+	do{
+		res = sdqueue_poll(q, &written);
+		total += written;
+	}while(res == sdqueueBusy);
+	return total;
+}
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Recording simulation         ---------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// The measurement handler finishes a FIFO block every interval us (fixed times, it runs in an interrupt). The main loop works in ticks of
+/// TICK_TIME: the recording (blocking: all finished blocks are written before the tick continues, queued: they are submitted and the queue is
+/// polled), touch, another poll of the queue (main.c) and every 4th tick the display. A block that is finished while the next block of the FIFO
+/// still waits to be written is an overrun (the firmware stops the recording), the simulation stops there as well.
+
+typedef struct {
+	uint32_t maxStall;	// Longest time of the recording part of a tick
+	uint64_t sumStall;	// Sum of it
+	uint32_t ticks;
+	uint32_t overruns;	// 0 or 1 (simulation stops)
+	uint32_t blocks;	// Blocks written
+	uint32_t writes;	// Writes of the card
+	uint32_t deferred;	// Deferred starts of the queue
+	int      imageOK;	// Card holds the written blocks in order
+} simResult;
+
+static uint8_t  simFifo[FIFO_BLOCKS][BLOCK_SECTORS*SDQUEUE_SECTOR_SIZE];
+static uint8_t  simFin[FIFO_BLOCKS];
+static uint8_t  simWriteBlock;
+static uint32_t simProduced;
+static uint64_t simNextBlock;
+
+static int sim_measure(uint32_t interval){
+	/// Finish all blocks due until now. Returns 0 on overrun.
+
+
+	while(simProduced < SIM_BLOCKS && simNextBlock <= simTime){
+		if(simFin[simWriteBlock])
+			return 0;
+		fill(simFifo[simWriteBlock], BLOCK_SECTORS, simProduced);
+		simFin[simWriteBlock] = 1;
+		simWriteBlock = (simWriteBlock + 1) % FIFO_BLOCKS;
+		simProduced++;
+		simNextBlock += interval;
+	}
+	return 1;
+}
+
+static simResult sim_record(int queued, uint32_t interval){
+	/// Record SIM_BLOCKS blocks with blocking or queued writes.
+
+
+	simResult r;
+	memset(&r, 0, sizeof(r));
+	card_reset();
+	memset(simFin, 0, sizeof(simFin));
+	simWriteBlock = 0;
+	simProduced = 0;
+	simNextBlock = interval;
+
+	sdqueue q;
+	sdqueue_init(&q, &cardDevice);
+	uint8_t recordBlock = 0, submitBlock = 0, pending = 0;
+	uint32_t fileBlock = 0;
+	uint32_t written;
+	int ok = 1;
+
+	while(ok && (simProduced < SIM_BLOCKS || r.blocks < SIM_BLOCKS)){
+		uint64_t tickStart = simTime;
+		ok = sim_measure(interval);
+
+		// Recording part of the tick
+		if(!queued){
+			// All finished blocks, contiguous ones with one write (until the end of the FIFO)
+			while(ok && simFin[recordBlock]){
+				uint8_t count = 0;
+				while(recordBlock + count < FIFO_BLOCKS && simFin[recordBlock + count])
+					count++;
+				card_write(simFifo[recordBlock], fileBlock*BLOCK_SECTORS, count*BLOCK_SECTORS);
+				ok = sim_measure(interval);
+				for(uint8_t i = 0; i < count; i++)
+					simFin[recordBlock + i] = 0;
+				recordBlock = (recordBlock + count) % FIFO_BLOCKS;
+				fileBlock += count;
+				r.blocks += count;
+			}
+		}
+		else{
+			// Submit finished blocks one by one (the queue merges them) and poll
+			while(pending < FIFO_BLOCKS && simFin[submitBlock]){
+				if(sdqueue_submit(&q, simFifo[submitBlock], fileBlock*BLOCK_SECTORS, BLOCK_SECTORS) != sdqueueIdle)
+					break;
+				submitBlock = (submitBlock + 1) % FIFO_BLOCKS;
+				fileBlock++;
+				pending++;
+			}
+		}
+		uint64_t stall = simTime - tickStart;
+
+		// Touch, poll (main.c), display - the poll is part of the time of the recording
+		simTime += TOUCH_TIME;
+		if(queued){
+			uint64_t t = simTime;
+			if(sdqueue_poll(&q, &written) == sdqueueError)
+				ok = 0;
+			for(uint32_t i = 0; i < written/BLOCK_SECTORS; i++){
+				simFin[recordBlock] = 0;
+				recordBlock = (recordBlock + 1) % FIFO_BLOCKS;
+				pending--;
+				r.blocks++;
+			}
+			stall += simTime - t;
+		}
+		if(r.ticks % 4 == 0)
+			simTime += DISPLAY_TIME;
+		if(ok)
+			ok = sim_measure(interval);
+
+		if(stall > r.maxStall)
+			r.maxStall = (uint32_t)stall;
+		r.sumStall += stall;
+		r.ticks++;
+
+		// Next tick
+		if(simTime < tickStart + TICK_TIME)
+			simTime = tickStart + TICK_TIME;
+	}
+	r.overruns = ok ? 0 : 1;
+	r.writes = cardWrites;
+	r.deferred = q.deferred;
+
+	// Blocks on the card in order
+	uint8_t expect[BLOCK_SECTORS*SDQUEUE_SECTOR_SIZE];
+	r.imageOK = 1;
+	for(uint32_t b = 0; b < r.blocks && r.imageOK; b++){
+		fill(expect, BLOCK_SECTORS, b);
+		r.imageOK = (memcmp(image + b*BLOCK_SECTORS*SDQUEUE_SECTOR_SIZE, expect, sizeof(expect)) == 0);
+	}
+	return r;
+}
+
+
+
+int main(int argc, char* argv[]){
+	/// Run all checks.
+
+
+	// Timing of the card (typical class 10 card with a slow housekeeping write now and then)
+	card.command = 50;
+	card.sector = 40;
+	card.busy = (argc > 1) ? (uint32_t)atol(argv[1]) : 3000;
+	card.stall = (argc > 2) ? (uint32_t)atol(argv[2]) : 250000;
+	card.every = (argc > 3) ? (uint32_t)atol(argv[3]) : 16;
+	uint32_t interval = (argc > 4) ? (uint32_t)atol(argv[4]) : 100000;
+	card.release = 0;
+	card.poll = 5;
+	card.failAt = 0;
+	if(interval == 0){
+		printf("Usage: %s [busy [stall [every [interval]]]]\n", argv[0]);
+		return 1;
+	}
+	printf("Card: busy %lu us, stall %lu us every %lu writes, block every %lu us\n",
+			(unsigned long)card.busy, (unsigned long)card.stall, (unsigned long)card.every, (unsigned long)interval);
+
+	static uint8_t buf[16][8*SDQUEUE_SECTOR_SIZE];
+	static uint8_t expect[CARD_SECTORS*SDQUEUE_SECTOR_SIZE];
+	sdqueue q;
+	uint32_t written;
+
+	// Separate requests - written in order, reported sectors match, nothing is written before the first poll
+	card_reset();
+	memset(expect, 0, sizeof(expect));
+	sdqueue_init(&q, &cardDevice);
+	uint32_t sectors[3] = {100, 10, 300}, counts[3] = {4, 1, 8};
+	int ok = 1;
+	for(int i = 0; i < 3; i++){
+		fill(buf[i], counts[i], i);
+		memcpy(expect + sectors[i]*SDQUEUE_SECTOR_SIZE, buf[i], counts[i]*SDQUEUE_SECTOR_SIZE);
+		ok &= (sdqueue_submit(&q, buf[i], sectors[i], counts[i]) == sdqueueIdle);
+	}
+	check(ok && sdqueue_pending(&q) == 13 && cardWrites == 0, "Submit queues without writing");
+	uint32_t total = 0, order = 1;
+	uint8_t res;
+	do{
+		res = sdqueue_poll(&q, &written);
+		total += written;
+
+		// Requests reported as written are on the card, the following ones aren't yet
+		uint32_t reported = 0;
+		for(uint32_t i = 0; i < 3; i++){
+			reported += counts[i];
+			int onCard = (memcmp(image + sectors[i]*SDQUEUE_SECTOR_SIZE, buf[i], counts[i]*SDQUEUE_SECTOR_SIZE) == 0);
+			if(onCard != (reported <= total))
+				order = 0;
+		}
+	}while(res == sdqueueBusy);
+	check(res == sdqueueIdle && total == 13 && sdqueue_pending(&q) == 0, "All sectors reported as written");
+	check(order, "Requests written in submit order");
+	check(memcmp(image, expect, sizeof(image)) == 0, "Card image correct");
+	check(q.writes == 3 && cardWrites == 3, "One card write per separate request");
+
+	// Consecutive requests (next sectors, next bytes of the buffer) are merged as long as they aren't started
+	card_reset();
+	sdqueue_init(&q, &cardDevice);
+	fill(buf[0], 8, 7);
+	ok = 1;
+	for(int i = 0; i < 4; i++)
+		ok &= (sdqueue_submit(&q, buf[0] + i*2*SDQUEUE_SECTOR_SIZE, 500 + i*2, 2) == sdqueueIdle);
+	check(ok && q.count == 1 && sdqueue_pending(&q) == 8, "Consecutive requests merged");
+	sdqueue_poll(&q, &written);
+	ok = (sdqueue_submit(&q, buf[1], 508, 2) == sdqueueIdle);
+	fill(buf[1], 2, 8);
+	check(ok && q.count == 2, "Request behind a started one not merged into it");
+	total = drain(&q);
+	check(total == 10 && cardWrites == 2 && memcmp(image + 500*SDQUEUE_SECTOR_SIZE, buf[0], 8*SDQUEUE_SECTOR_SIZE) == 0 &&
+		  memcmp(image + 508*SDQUEUE_SECTOR_SIZE, buf[1], 2*SDQUEUE_SECTOR_SIZE) == 0, "Merged request written with one card write");
+
+	// Full queue - the next submit is refused until a request is done
+	card_reset();
+	sdqueue_init(&q, &cardDevice);
+	ok = 1;
+	for(int i = 0; i < SDQUEUE_LENGTH; i++)
+		ok &= (sdqueue_submit(&q, buf[i], i*10, 1) == sdqueueIdle);
+	check(ok && sdqueue_submit(&q, buf[SDQUEUE_LENGTH], 200, 1) == sdqueueBusy, "Full queue refuses a request");
+	do{
+		res = sdqueue_poll(&q, &written);
+	}while(res == sdqueueBusy && written == 0);
+	check(written == 1 && sdqueue_submit(&q, buf[SDQUEUE_LENGTH], 200, 1) == sdqueueIdle, "Request accepted after the oldest one is done");
+	check(drain(&q) == SDQUEUE_LENGTH, "Rest of the full queue written");
+
+	// Card refuses the next write for a while - start deferred to a later poll, nothing lost
+	card_reset();
+	card.release = 2000;
+	sdqueue_init(&q, &cardDevice);
+	memset(expect, 0, sizeof(expect));
+	for(int i = 0; i < 4; i++){
+		fill(buf[i], 1, 20 + i);
+		memcpy(expect + (i*3)*SDQUEUE_SECTOR_SIZE, buf[i], SDQUEUE_SECTOR_SIZE);
+		sdqueue_submit(&q, buf[i], i*3, 1);
+	}
+	total = drain(&q);
+	check(total == 4 && q.deferred > 0 && memcmp(image, expect, sizeof(image)) == 0, "Deferred starts retried, all data written");
+	card.release = 0;
+
+	// Failed write - reported by the poll, queue stays stopped (submit refused) until sdqueue_init, later requests are not written
+	card_reset();
+	card.failAt = 2;
+	sdqueue_init(&q, &cardDevice);
+	for(int i = 0; i < 3; i++){
+		fill(buf[i], 1, 30 + i);
+		sdqueue_submit(&q, buf[i], 1000 + i*2, 1);
+	}
+	total = 0;
+	do{
+		res = sdqueue_poll(&q, &written);
+		total += written;
+	}while(res == sdqueueBusy);
+	check(res == sdqueueError && total == 1 && sdqueue_pending(&q) == 2, "Failed write reported, only the requests before it written");
+	check(sdqueue_submit(&q, buf[3], 1100, 1) == sdqueueError && sdqueue_poll(&q, &written) == sdqueueError && cardWrites == 2,
+		  "Queue stays stopped after a failure");
+	card.failAt = 0;
+	sdqueue_init(&q, &cardDevice);
+	check(sdqueue_submit(&q, buf[3], 1100, 1) == sdqueueIdle && drain(&q) == 1, "Queue usable again after sdqueue_init");
+
+	// Recording - blocking writes against the queue
+	simResult blocking = sim_record(0, interval);
+	simResult queued = sim_record(1, interval);
+	printf("Blocking: max loop stall %7lu us, avg %5lu us/tick, %4lu card writes, %lu overruns, %lu of %d blocks\n",
+			(unsigned long)blocking.maxStall, (unsigned long)(blocking.sumStall/blocking.ticks), (unsigned long)blocking.writes,
+			(unsigned long)blocking.overruns, (unsigned long)blocking.blocks, SIM_BLOCKS);
+	printf("Queued:   max loop stall %7lu us, avg %5lu us/tick, %4lu card writes, %lu overruns, %lu of %d blocks, %lu deferred polls\n",
+			(unsigned long)queued.maxStall, (unsigned long)(queued.sumStall/queued.ticks), (unsigned long)queued.writes,
+			(unsigned long)queued.overruns, (unsigned long)queued.blocks, SIM_BLOCKS, (unsigned long)queued.deferred);
+	check(queued.imageOK, "Queued recording written in order");
+	check(queued.blocks == SIM_BLOCKS || blocking.overruns > 0, "Queued recording complete unless blocking writes overrun as well");
+	check(queued.overruns <= blocking.overruns, "Queued recording has no more overruns than blocking writes");
+	check(queued.maxStall < TICK_TIME && queued.maxStall < blocking.maxStall, "Main loop never stalls a tick with the queue");
+
+	printf("%s\n", failed ? "FAILED" : "All checks passed");
+	return failed;
+}
@@ -0,0 +1,205 @@
+/*
+@file    		syncalign.c
+@brief   		Host tool: Align two recordings of the DeflectionAnalyzer (or any device writing the same .EVT format) by their sync events
+@version 		1.0
+@date    		2021-10-20
+@author 		Rene Santeler @ MCI 2020/21
+
+Build:	gcc -O2 -o syncalign syncalign.c -lm
+Usage:	syncalign A.EVT B.EVT [-s sourceA sourceB] [-c B.CSV out.CSV]
+		sourceA/B ... Source of the sync events that belong together (IN or OUT, default IN IN). E.g. "OUT IN" if the sync output of A
+					  is connected to the sync input of B, "IN IN" if both inputs are connected to the same external signal (camera flash, ...)
+		B.CSV	  ... If given, the CSV file of B is copied to out.CSV with its Time column converted to the time base of A
+
+Both event files are read in a single pass. The n-th sync event of A (by its running number Seq) is paired with the n-th event of B, events
+that were lost on one side (gap in Seq) are skipped. A least-squares line tA = offset + rate*tB is fitted on the fly (no event list is stored),
+the rate covers the drift between the clocks of both loggers.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define LINE_LENGTH 256
+#define SAMPLE_INTERVAL (0.005)	// Time between two samples in seconds (MEASUREMENT_INTERVAL of the logger)
+
+// One sync event read from an .EVT file
+typedef struct {
+	double   time;		// Time in seconds in the time base of its recording (sample + fraction)
+	uint32_t index;		// Running number of the event since the first one (Seq with 8 bit overflows removed)
+} syncEvent;
+
+// Reader state of an .EVT file
+typedef struct {
+	FILE*   file;
+	char*   source;		// Only events of this source are used (IN or OUT)
+	int     lastSeq;	// Seq of the last event (-1 = none read yet)
+	uint32_t index;		// Running number of the last event
+} evtReader;
+
+
+
+static int evt_next(evtReader* rd, syncEvent* ev){
+	/// Read the next sync event of the selected source. Returns 1 if an event was read, 0 at end of file.
+	///
+	///	rd	...	Reader state (file must be open)
+	///	ev	...	Output event
+
+
+	char line[LINE_LENGTH];
+	while(fgets(line, sizeof(line), rd->file) != NULL){
+		double time;
+		char event[16], source[16];
+		int seq;
+		unsigned long sample;
+		unsigned int fraction;
+
+		// Skip header and other event types
+		if(sscanf(line, "%lf;%15[^;];%15[^;];%d;%lu;%u", &time, event, source, &seq, &sample, &fraction) != 6)
+			continue;
+		if(strcmp(event, "SYNC") != 0 || strcmp(source, rd->source) != 0)
+			continue;
+
+		// Use sample and fraction instead of the (rounded) time column
+		time = ((double)sample + fraction/65536.0) * SAMPLE_INTERVAL;
+
+		// Running number - a gap in Seq means events were lost
+		if(rd->lastSeq < 0)
+			rd->index = 0;
+		else
+			rd->index += (uint8_t)(seq - rd->lastSeq);
+		rd->lastSeq = seq;
+
+		ev->time = time;
+		ev->index = rd->index;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]){
+	/// Pair the sync events of both files, fit offset and rate and optionally convert the CSV file of B to the time base of A.
+
+
+	// Parse arguments
+	evtReader rdA = {NULL, "IN", -1, 0};
+	evtReader rdB = {NULL, "IN", -1, 0};
+	char* csvIn = NULL;
+	char* csvOut = NULL;
+	int argOK = (argc >= 3);
+	for(int arg = 3; arg < argc && argOK; arg += 3){
+		if(arg+2 >= argc)
+			argOK = 0;
+		else if(strcmp(argv[arg], "-s") == 0){
+			rdA.source = argv[arg+1];
+			rdB.source = argv[arg+2];
+		}
+		else if(strcmp(argv[arg], "-c") == 0){
+			csvIn = argv[arg+1];
+			csvOut = argv[arg+2];
+		}
+		else
+			argOK = 0;
+	}
+	if(!argOK){
+		printf("Usage: %s A.EVT B.EVT [-s sourceA sourceB] [-c B.CSV out.CSV]\n", argv[0]);
+		return 1;
+	}
+
+	// Open event files
+	rdA.file = fopen(argv[1], "r");
+	rdB.file = fopen(argv[2], "r");
+	if(rdA.file == NULL || rdB.file == NULL){
+		printf("Error: Could not open event files\n");
+		return 1;
+	}
+
+	// Merge both event streams by running number and accumulate the sums of the least-squares fit (centered on the first pair for precision)
+	syncEvent evA, evB;
+	int okA = evt_next(&rdA, &evA);
+	int okB = evt_next(&rdB, &evB);
+	uint32_t pairs = 0;
+	double refA = 0, refB = 0;
+	double sumB = 0, sumA = 0, sumBB = 0, sumBA = 0, sumAA = 0;
+	while(okA && okB){
+		// Skip events that have no partner
+		if(evA.index < evB.index){
+			okA = evt_next(&rdA, &evA);
+			continue;
+		}
+		if(evB.index < evA.index){
+			okB = evt_next(&rdB, &evB);
+			continue;
+		}
+
+		// Pair found
+		if(pairs == 0){
+			refA = evA.time;
+			refB = evB.time;
+		}
+		double a = evA.time - refA;
+		double b = evB.time - refB;
+		sumB += b;
+		sumA += a;
+		sumBB += b*b;
+		sumBA += b*a;
+		sumAA += a*a;
+		pairs++;
+
+		okA = evt_next(&rdA, &evA);
+		okB = evt_next(&rdB, &evB);
+	}
+	fclose(rdA.file);
+	fclose(rdB.file);
+
+	if(pairs == 0){
+		printf("Error: No matching sync events found\n");
+		return 1;
+	}
+
+	// Fit tA = offset + rate*tB (only the offset is known if there is just one pair)
+	double rate = 1.0;
+	double denom = pairs*sumBB - sumB*sumB;
+	if(pairs > 1 && denom > 1e-12)
+		rate = (pairs*sumBA - sumB*sumA) / denom;
+	double offsetCentered = (sumA - rate*sumB) / pairs;
+	double offset = refA + offsetCentered - rate*refB;
+
+	// Residual (RMS of tA - fit) from the sums
+	double sse = sumAA - 2*offsetCentered*sumA - 2*rate*sumBA + pairs*offsetCentered*offsetCentered + 2*offsetCentered*rate*sumB + rate*rate*sumBB;
+	double rms = (sse > 0) ? sqrt(sse/pairs) : 0.0;
+
+	printf("Pairs:    %u\n", pairs);
+	printf("Offset:   %.6f s (tA = offset + rate*tB)\n", offset);
+	printf("Rate:     %.9f (drift %.1f ppm)\n", rate, (rate-1.0)*1e6);
+	printf("Residual: %.6f s RMS\n", rms);
+
+	// Convert the time column of the CSV file of B
+	if(csvIn != NULL){
+		FILE* in = fopen(csvIn, "r");
+		FILE* out = fopen(csvOut, "w");
+		if(in == NULL || out == NULL){
+			printf("Error: Could not open CSV files\n");
+			return 1;
+		}
+
+		// Copy header, convert the first column of every other line
+		static char line[4096];
+		uint32_t lines = 0;
+		if(fgets(line, sizeof(line), in) != NULL)
+			fputs(line, out);
+		while(fgets(line, sizeof(line), in) != NULL){
+			char* rest;
+			double time = strtod(line, &rest);
+			fprintf(out, "%.6f%s", offset + rate*time, rest);
+			lines++;
+		}
+		fclose(in);
+		fclose(out);
+		printf("Converted %u lines to %s\n", lines, csvOut);
+	}
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+@file    		analyze.c
+@brief   		Analysis of the measured data that runs in the main loop beside the menu (implemented for XMC4700 and DAVE)
+@version 		1.0
+@date    		2021-10-18
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <DAVE.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "globals.h"
+#include "analyze.h"
+
+/// Implemented in globals:
+// struct's: sensor
+// #define's: MEASUREMENT_INTERVAL, SENSORS_SIZE
+extern volatile sensor* sensors[];			// array of all sensors (index 0 = front, 1 = rear)
+extern volatile measureModes measureMode;	// state of the measurement (purpose: none, monitoring or recording)
+extern volatile uint32_t measurementCounter;
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Front/rear cross-correlation         ----------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// The last ANALYZE_XCORR_WINDOW converted values of both sensors are correlated by the functions of analyzecore.c. All steps are done by a
+/// state machine in analyze_tick, that only executes a small part per call (see xcorrStates), so the main loop can spread the work over the
+/// ticks where no display refresh is done.
+
+// Result of the correlation (used by the menu)
+analyze_xcorrResult analyze_xcorr = {0};
+
+// Work buffers of the correlation
+static xcorrCore xcorr_core;
+
+// States of the correlation. Every call of analyze_tick executes the current state (or a part of it) and moves on.
+enum xcorrStates{xcorrIdle=0, xcorrCopy, xcorrFFT, xcorrSpectrum, xcorrIFFT, xcorrPeak};
+typedef enum xcorrStates xcorrStates;
+static xcorrStates xcorr_state = xcorrIdle;
+static uint8_t  xcorr_nextStage = 0;		// Next FFT stage to be computed (1 to ANALYZE_XCORR_FFT_BITS)
+static uint32_t xcorr_lastStart = 0;		// measurementCounter at start of the last window
+
+
+
+void analyze_init(void){
+	/// Initialize the analysis (twiddle factors of the FFT, averages and damping estimator). Must be called once before analyze_tick is used.
+
+
+	xcorr_init(&xcorr_core);
+	xcorr_state = xcorrIdle;
+	memset(&analyze_xcorr, 0, sizeof(analyze_xcorr));
+	analyze_damping_reset();
+}
+
+static void analyze_xcorr_copy(void){
+	/// Copy the last window of both sensors to the work buffer of the correlation and prepare it (mean, energy, zero padding).
+	/// Raw values that are marked as error (0 or above the threshold) are replaced by the last valid value.
+
+
+	// Snapshot of the current buffer index (the measurement handler keeps writing - the window is far away from the current index)
+	volatile sensor* sens;
+	for(uint8_t s = 0; s < 2; s++){
+		sens = sensors[s];
+		int32_t idx = sens->bufIdx - (ANALYZE_XCORR_WINDOW-1);
+		if(idx < 0) idx += sens->bufMaxIdx+1;
+
+		// Convert and store every value of the window
+		float last = NAN;
+		for(uint16_t n = 0; n < ANALYZE_XCORR_WINDOW; n++){
+			int_buffer_t raw = sens->bufRaw[idx];
+			if(raw != 0 && raw <= sens->errorThreshold)
+				last = measure_conv((sensor*)sens, raw);
+			else if(isnan(last))
+				last = 0.0f;
+			xcorr_set(&xcorr_core, s, n, last);
+
+			// Next index with roll-over check
+			idx++;
+			if(idx > sens->bufMaxIdx) idx = 0;
+		}
+	}
+
+	// Remove mean, average energy and zero pad
+	xcorr_prepare(&xcorr_core);
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Damping estimator         ---------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// Every new sample of both sensors is converted and passed to the estimator of analyzecore.c (O(1) per sample).
+
+// Results of both sensors (used by the menu)
+analyze_dampingResult analyze_damping[2] = {0};
+
+// State of the estimator of both sensors
+static dampState damp_state[2];
+
+// Number of the last sample processed (measurementCounter)
+static uint32_t damp_lastCounter = 0;
+
+
+
+void analyze_damping_reset(void){
+	/// Start a new session: Reset the results, their averages and the state of the estimator. Called at start of a recording.
+	///
+	///	Uses globals variables: measurementCounter
+
+
+	memset(analyze_damping, 0, sizeof(analyze_damping));
+	memset(damp_state, 0, sizeof(damp_state));
+	damp_lastCounter = measurementCounter;
+}
+
+static void analyze_damping_update(void){
+	/// Feed all samples measured since the last call to the estimator (at most ANALYZE_DAMP_MAX_CATCHUP per call).
+	/// Raw values that are marked as error (0 or above the threshold) are skipped.
+	///
+	///	Uses globals variables: sensors, measurementCounter
+
+
+	// Snapshot of counter and buffer indices (consistent - the measurement handler must not run in between)
+	__disable_irq();
+	uint32_t counter = measurementCounter;
+	uint16_t idx[2] = {sensors[0]->bufIdx, sensors[1]->bufIdx};
+	__enable_irq();
+
+	// Number of new samples (counter was reset or too much was missed -> start over)
+	uint32_t count = counter - damp_lastCounter;
+	damp_lastCounter = counter;
+	if(count > ANALYZE_DAMP_MAX_CATCHUP){
+		damp_state[0].direction = damp_state[1].direction = 0;
+		damp_state[0].phase = damp_state[1].phase = dampIdle;
+		count = 1;
+	}
+
+	// Process new samples of both sensors from oldest to newest
+	for(uint8_t s = 0; s < 2; s++){
+		volatile sensor* sens = sensors[s];
+		int32_t i = idx[s] - (int32_t)(count-1);
+		if(i < 0) i += sens->bufMaxIdx+1;
+		for(uint32_t n = counter - count; n != counter; n++){
+			int_buffer_t raw = sens->bufRaw[i];
+			if(raw != 0 && raw <= sens->errorThreshold)
+				damp_sample(&damp_state[s], &analyze_damping[s], measure_conv((sensor*)sens, raw), n, MEASUREMENT_INTERVAL/1000.0f);
+
+			// Next index with roll-over check
+			i++;
+			if(i > sens->bufMaxIdx) i = 0;
+		}
+	}
+}
+
+
+
+void analyze_tick(void){
+	/// Execute the next step of the analysis. Meant to be called by the main loop on ticks without display refresh, so the time of
+	/// TFT_display is never extended. One call takes at most ANALYZE_XCORR_STAGES_PER_TICK FFT stages or one copy/spectrum/peak step.
+	/// A whole window needs 2+2*ceil(ANALYZE_XCORR_FFT_BITS/ANALYZE_XCORR_STAGES_PER_TICK) calls, which is far below ANALYZE_XCORR_HOP.
+	///
+	///	Uses globals variables: measureMode, measurementCounter, sensors (health flags)
+
+
+	// Damping estimator - processes every new sample (cheap)
+	if(measureMode == measureModeMonitoring || measureMode == measureModeRecording)
+		analyze_damping_update();
+
+	switch(xcorr_state){
+		// Wait for next window (no measurement -> no analysis)
+		case xcorrIdle:
+			if(measureMode != measureModeMonitoring && measureMode != measureModeRecording)
+				break;
+			if(measurementCounter - xcorr_lastStart < ANALYZE_XCORR_HOP)
+				break;
+			xcorr_lastStart = measurementCounter;
+			// Skip window if a sensor is flagged by the health monitor (result would be meaningless)
+			if(sensors[0]->health.flags != 0 || sensors[1]->health.flags != 0){
+				analyze_xcorr.valid = 0;
+				analyze_xcorr.speed = 0.0f;
+				break;
+			}
+			xcorr_state = xcorrCopy;
+			// fall through
+		// Copy window
+		case xcorrCopy:
+			analyze_xcorr_copy();
+			xcorr_nextStage = 1;
+			xcorr_state = xcorrFFT;
+			break;
+		// Forward or inverse FFT - some stages per call
+		case xcorrFFT:
+		case xcorrIFFT:
+			for(uint8_t i = 0; i < ANALYZE_XCORR_STAGES_PER_TICK && xcorr_nextStage <= ANALYZE_XCORR_FFT_BITS; i++)
+				xcorr_fftStage(&xcorr_core, xcorr_nextStage++);
+			if(xcorr_nextStage > ANALYZE_XCORR_FFT_BITS){
+				xcorr_nextStage = 1;
+				xcorr_state = (xcorr_state == xcorrFFT) ? xcorrSpectrum : xcorrPeak;
+			}
+			break;
+		// Separate/average spectrum
+		case xcorrSpectrum:
+			xcorr_spectrum(&xcorr_core);
+			xcorr_state = xcorrIFFT;
+			break;
+		// Evaluate result
+		case xcorrPeak:
+			xcorr_peak(&xcorr_core, MEASUREMENT_INTERVAL/1000.0f, &analyze_xcorr);
+			xcorr_state = xcorrIdle;
+			break;
+		default:
+			xcorr_state = xcorrIdle;
+			break;
+	}
+}
@@ -0,0 +1,23 @@
+/*
+ * analyze.h
+ *
+ *  Created on: 18 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef ANALYZE_H_
+#define ANALYZE_H_
+
+#include "analyzecore.h"	// Settings, results and algorithms of the cross-correlation and the damping estimator
+
+/// Front/rear cross-correlation of the last converted values of both sensors (see analyzecore.h). Result used by the menu.
+extern analyze_xcorrResult analyze_xcorr;
+
+/// Damping estimator fed with every new converted value of both sensors (see analyzecore.h). Results (index 0 = front, 1 = rear) used by the menu.
+extern analyze_dampingResult analyze_damping[];
+
+void analyze_init(void);
+void analyze_tick(void);
+void analyze_damping_reset(void);
+
+#endif /* ANALYZE_H_ */
@@ -0,0 +1,324 @@
+/*
+@file    		analyzecore.c
+@brief   		Cross-correlation and damping estimator working on plain values (shared by the firmware and the host tools, see analyzecore.h)
+@version 		1.0
+@date    		2021-10-18
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "analyzecore.h"
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Front/rear cross-correlation         ----------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// A window of ANALYZE_XCORR_WINDOW values of both sensors is packed into one complex signal (front = real, rear = imaginary part)
+/// so only one FFT is needed for both spectra. The cross spectrum is exponentially averaged over the windows and transformed back with
+/// the same FFT (conjugated input). The lag at the maximum of the correlation is the delay of the rear to the front wheel.
+/// Every step is a function of its own (xcorr_set/prepare, xcorr_fftStage per stage, xcorr_spectrum, xcorr_peak), so the caller can spread
+/// the work of a window over several calls (see analyze_tick).
+
+
+
+static inline uint32_t xcorr_bitrev(uint32_t n){
+	/// Bit reversed index n of the FFT (rbit instruction of the Cortex-M4, loop on the host).
+
+
+#if defined(__ARM_ARCH_7EM__)
+	uint32_t r;
+	__asm("rbit %0, %1" : "=r" (r) : "r" (n));
+	return r >> (32-ANALYZE_XCORR_FFT_BITS);
+#else
+	uint32_t r = 0;
+	for(uint8_t b = 0; b < ANALYZE_XCORR_FFT_BITS; b++){
+		r = (r << 1) | (n & 1);
+		n >>= 1;
+	}
+	return r;
+#endif
+}
+
+void xcorr_init(xcorrCore* xc){
+	/// Calculate the twiddle factors and reset the averages.
+
+
+	// Twiddle factors exp(-j*2*pi*k/N)
+	for(uint16_t k = 0; k < ANALYZE_XCORR_FFT_SIZE/2; k++){
+		xc->twiddleCos[k] =  cosf(2.0f*(float)M_PI*k/ANALYZE_XCORR_FFT_SIZE);
+		xc->twiddleSin[k] = -sinf(2.0f*(float)M_PI*k/ANALYZE_XCORR_FFT_SIZE);
+	}
+
+	// Reset averages
+	memset(xc->avgSpectrum, 0, sizeof(xc->avgSpectrum));
+	xc->avgEnergy[0] = xc->avgEnergy[1] = 0.0f;
+}
+
+void xcorr_set(xcorrCore* xc, uint8_t s, uint16_t n, float value){
+	/// Store value n (0 to ANALYZE_XCORR_WINDOW-1, oldest first) of sensor s (0 = front, 1 = rear) of the next window in the work buffer
+	/// (bit reversed order as needed by the FFT). All values of both sensors must be set before xcorr_prepare.
+
+
+	xc->buf[2*xcorr_bitrev(n) + s] = value;
+}
+
+void xcorr_prepare(xcorrCore* xc){
+	/// Remove the mean of the window, average its energy and zero pad the rest of the work buffer.
+	/// Bit reversed, the values 0 to N/2-1 are at the even and the padding at the odd positions (the highest bit of n becomes the lowest).
+
+
+	// Mean of the windows
+	float mean[2] = {0.0f, 0.0f};
+	for(uint16_t i = 0; i < ANALYZE_XCORR_FFT_SIZE; i += 2){
+		mean[0] += xc->buf[2*i];
+		mean[1] += xc->buf[2*i+1];
+	}
+	mean[0] /= ANALYZE_XCORR_WINDOW;
+	mean[1] /= ANALYZE_XCORR_WINDOW;
+
+	// Remove mean, calculate energy of the windows and zero pad the rest
+	float energy[2] = {0.0f, 0.0f};
+	for(uint16_t i = 0; i < ANALYZE_XCORR_FFT_SIZE; i += 2){
+		float* val = &xc->buf[2*i];
+		val[0] -= mean[0];
+		val[1] -= mean[1];
+		energy[0] += val[0]*val[0];
+		energy[1] += val[1]*val[1];
+		val[2] = val[3] = 0.0f;
+	}
+
+	// Average energy
+	for(uint8_t s = 0; s < 2; s++)
+		xc->avgEnergy[s] += ANALYZE_XCORR_AVG_WEIGHT * (energy[s] - xc->avgEnergy[s]);
+}
+
+void xcorr_fftStage(xcorrCore* xc, uint8_t stage){
+	/// Compute one stage (1 to ANALYZE_XCORR_FFT_BITS) of an in-place radix-2 decimation in time FFT on the work buffer (input must be bit reversed).
+
+
+	uint16_t half = 1 << (stage-1);
+	uint16_t twStep = ANALYZE_XCORR_FFT_SIZE >> stage;
+	for(uint16_t start = 0; start < ANALYZE_XCORR_FFT_SIZE; start += 2*half){
+		for(uint16_t k = 0; k < half; k++){
+			float* a = &xc->buf[2*(start+k)];
+			float* b = &xc->buf[2*(start+k+half)];
+			float wr = xc->twiddleCos[k*twStep];
+			float wi = xc->twiddleSin[k*twStep];
+			// t = w * b
+			float tr = wr*b[0] - wi*b[1];
+			float ti = wr*b[1] + wi*b[0];
+			// b = a - t, a = a + t
+			b[0] = a[0] - tr;	b[1] = a[1] - ti;
+			a[0] += tr;			a[1] += ti;
+		}
+	}
+}
+
+void xcorr_spectrum(xcorrCore* xc){
+	/// Separate the spectra of front and rear from the packed FFT result, average the cross spectrum conj(F)*R and write the conjugated
+	/// full spectrum back in bit reversed order. The following forward FFT then gives N times the correlation (inverse FFT by conjugation).
+
+
+	// Separate and average (only bins 0 to N/2 are needed - the correlation is real)
+	for(uint16_t k = 0; k <= ANALYZE_XCORR_FFT_SIZE/2; k++){
+		float* zk = &xc->buf[2*k];
+		float* zm = &xc->buf[2*((ANALYZE_XCORR_FFT_SIZE-k) & (ANALYZE_XCORR_FFT_SIZE-1))];
+		// F = (Z[k] + conj(Z[N-k]))/2,  R = (Z[k] - conj(Z[N-k]))/2j
+		float fr = 0.5f*(zk[0] + zm[0]);
+		float fi = 0.5f*(zk[1] - zm[1]);
+		float rr = 0.5f*(zk[1] + zm[1]);
+		float ri = 0.5f*(zm[0] - zk[0]);
+		// C = conj(F) * R
+		float* avg = &xc->avgSpectrum[2*k];
+		avg[0] += ANALYZE_XCORR_AVG_WEIGHT * ((fr*rr + fi*ri) - avg[0]);
+		avg[1] += ANALYZE_XCORR_AVG_WEIGHT * ((fr*ri - fi*rr) - avg[1]);
+	}
+
+	// Write conjugated full spectrum (X[N-k] = conj(X[k])) bit reversed
+	for(uint16_t k = 0; k <= ANALYZE_XCORR_FFT_SIZE/2; k++){
+		float* avg = &xc->avgSpectrum[2*k];
+		float* dst = &xc->buf[2*xcorr_bitrev(k)];
+		dst[0] = avg[0];
+		dst[1] = -avg[1];
+		if(k != 0 && k != ANALYZE_XCORR_FFT_SIZE/2){
+			dst = &xc->buf[2*xcorr_bitrev(ANALYZE_XCORR_FFT_SIZE-k)];
+			dst[0] = avg[0];
+			dst[1] = avg[1];
+		}
+	}
+}
+
+static inline float xcorr_at(xcorrCore* xc, uint16_t n){
+	/// Correlation at lag n (real part of the result at index n). Only ANALYZE_XCORR_WINDOW-n values of both windows overlap at lag n, so the sum
+	/// is scaled to the whole window (unbiased estimate). Otherwise the sum falls with the lag and the peak is pulled to smaller lags.
+
+
+	return xc->buf[2*n] * ((float)ANALYZE_XCORR_WINDOW / (ANALYZE_XCORR_WINDOW - n));
+}
+
+void xcorr_peak(xcorrCore* xc, float interval, analyze_xcorrResult* res){
+	/// Search the maximum of the correlation (lag 1 to ANALYZE_XCORR_MAXLAG), interpolate its position and calculate confidence and speed.
+	/// interval is the time between two values in seconds.
+
+
+	// Find maximum
+	uint16_t peakIdx = 1;
+	float peak = xcorr_at(xc, 1);
+	for(uint16_t n = 2; n <= ANALYZE_XCORR_MAXLAG; n++){
+		float y = xcorr_at(xc, n);
+		if(y > peak){
+			peak = y;
+			peakIdx = n;
+		}
+	}
+
+	// Parabolic interpolation of the peak position between its neighbours
+	float y0 = xcorr_at(xc, peakIdx-1), y1 = peak, y2 = xcorr_at(xc, peakIdx+1);
+	float denom = y0 - 2.0f*y1 + y2;
+	float offset = (denom < 0.0f) ? 0.5f*(y0 - y2)/denom : 0.0f;
+
+	// Normalize peak with energies of the whole windows (forward FFT used as inverse -> scale by 1/N). The sum without scaling to the overlap
+	// is used, so a delayed copy gives (ANALYZE_XCORR_WINDOW-lag)/ANALYZE_XCORR_WINDOW and unrelated windows don't reach the confidence at big lags.
+	float norm = sqrtf(xc->avgEnergy[0]*xc->avgEnergy[1]);
+	res->confidence = (norm > 0.0f) ? (xc->buf[2*peakIdx]/ANALYZE_XCORR_FFT_SIZE)/norm : 0.0f;
+	if(res->confidence < 0.0f) res->confidence = 0.0f;
+	if(res->confidence > 1.0f) res->confidence = 1.0f;
+
+	// Calculate lag and speed. A peak at either end of the searched range is no real maximum (e.g. unrelated travels that correlate best at lag 0).
+	res->lag = (peakIdx + offset) * interval;
+	res->valid = (res->confidence >= ANALYZE_XCORR_MIN_CONFIDENCE && peakIdx > 1 && peakIdx < ANALYZE_XCORR_MAXLAG && res->lag > 0.0f);
+	if(res->valid)
+		res->speed = ANALYZE_WHEELBASE / res->lag * 3.6f;
+	else
+		res->speed = 0.0f;
+	res->windows++;
+}
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Damping estimator         ---------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// Every sample is smoothed and passed through a turning point detection with hysteresis (O(1) per sample).
+/// The difference between two successive turning points is a swing. A swing bigger than ANALYZE_DAMP_START_SWING is the sharp input,
+/// the following swings are the free ring-down. For a damped oscillation every swing is exp(-delta/2) times the one before (delta =
+/// logarithmic decrement per period), independent of the resting position. ln(swing) over the swing number is therefore a line whose
+/// slope is -delta/2. It is fitted by least squares on the fly, so only the sums are stored. The ring-down ends when a swing doesn't decay,
+/// gets too small, its half period deviates from the first one or no turning point follows in time.
+///   damping ratio      zeta = delta / sqrt(4*pi^2 + delta^2)
+///   natural frequency  fn   = 1 / (2*halfPeriod*sqrt(1 - zeta^2))
+
+
+
+static void damp_finish(dampState* st, analyze_dampingResult* res, float interval){
+	/// End the ring-down. If it had enough swings, calculate damping ratio and natural frequency and update the averages of the session.
+
+
+	st->phase = dampIdle;
+	if(st->swings < ANALYZE_DAMP_MIN_SWINGS)
+		return;
+
+	// Slope of ln(swing) over the swing number
+	float n = st->swings;
+	float denom = n*st->sumKK - st->sumK*st->sumK;
+	if(denom <= 0.0f)
+		return;
+	float slope = (n*st->sumKY - st->sumK*st->sumY) / denom;
+	if(slope >= 0.0f)
+		return;
+
+	// Damping ratio, mean half period and natural frequency
+	float delta = -2.0f*slope;
+	float zeta = delta / sqrtf(4.0f*(float)M_PI*(float)M_PI + delta*delta);
+	float halfPeriod = (float)(st->lastTurnSample - st->startSample) / n * interval;
+	float fn = 1.0f / (2.0f*halfPeriod*sqrtf(1.0f - zeta*zeta));
+
+	// Result and running averages of the session
+	res->zeta = zeta;
+	res->fn = fn;
+	res->swings = st->swings;
+	res->events++;
+	res->avgZeta += (zeta - res->avgZeta) / res->events;
+	res->avgFn += (fn - res->avgFn) / res->events;
+}
+
+static void damp_turn(dampState* st, analyze_dampingResult* res, float value, uint32_t sample, float interval){
+	/// Handle a turning point: Start, continue or end a ring-down based on the swing since the last turning point.
+
+
+	float swing = fabsf(value - st->lastTurn);
+	uint32_t half = sample - st->lastTurnSample;
+
+	// Continue ring-down if the swing decays, is big enough and has about the same half period as the first one
+	if(st->phase == dampRingdown){
+		if(swing < st->lastSwing && swing >= ANALYZE_DAMP_MIN_SWING && st->swings < ANALYZE_DAMP_MAX_SWINGS &&
+		   fabsf((float)half - st->firstHalf) <= ANALYZE_DAMP_PERIOD_TOLERANCE*st->firstHalf){
+			float k = st->swings;
+			float y = logf(swing);
+			st->sumK += k;	st->sumKK += k*k;
+			st->sumY += y;	st->sumKY += k*y;
+			st->swings++;
+		}
+		else
+			damp_finish(st, res, interval);
+	}
+	// First free swing after the input - reference for the half period
+	else if(st->phase == dampArmed){
+		if(swing >= ANALYZE_DAMP_MIN_SWING && half <= ANALYZE_DAMP_MAX_HALFPERIOD){
+			st->phase = dampRingdown;
+			st->firstHalf = half;
+			st->startSample = st->lastTurnSample;
+			st->swings = 1;
+			st->sumK = st->sumKK = st->sumKY = 0.0f;
+			st->sumY = logf(swing);
+		}
+		else
+			st->phase = dampIdle;
+	}
+
+	// A big swing is a (new) sharp input - the next swings will be evaluated
+	if(st->phase == dampIdle && swing >= ANALYZE_DAMP_START_SWING && half <= ANALYZE_DAMP_MAX_HALFPERIOD)
+		st->phase = dampArmed;
+
+	st->lastSwing = swing;
+	st->lastTurn = value;
+	st->lastTurnSample = sample;
+}
+
+void damp_sample(dampState* st, analyze_dampingResult* res, float value, uint32_t sample, float interval){
+	/// Process one converted sample (constant time): smoothing and turning point detection with hysteresis. A finished ring-down updates res.
+	/// sample is the running number of the value, interval the time between two samples in seconds.
+
+
+	// Initialize with first value
+	if(st->direction == 0){
+		st->smooth = st->extreme = st->lastTurn = value;
+		st->extremeSample = st->lastTurnSample = sample;
+		st->direction = 1;
+		return;
+	}
+
+	// Smooth travel
+	st->smooth += ANALYZE_DAMP_SMOOTHING * (value - st->smooth);
+
+	// Track extreme in current direction. If the travel moved back more than the hysteresis the extreme was a turning point
+	if((st->direction > 0 && st->smooth > st->extreme) || (st->direction < 0 && st->smooth < st->extreme)){
+		st->extreme = st->smooth;
+		st->extremeSample = sample;
+	}
+	else if(fabsf(st->extreme - st->smooth) > ANALYZE_DAMP_HYSTERESIS){
+		damp_turn(st, res, st->extreme, st->extremeSample, interval);
+		st->direction = -st->direction;
+		st->extreme = st->smooth;
+		st->extremeSample = sample;
+	}
+
+	// The ring-down has settled if no turning point follows in time
+	if(st->phase != dampIdle && sample - st->lastTurnSample > ANALYZE_DAMP_MAX_HALFPERIOD)
+		damp_finish(st, res, interval);
+}
@@ -0,0 +1,96 @@
+/*
+ * analyzecore.h
+ *
+ *  Created on: 18 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef ANALYZECORE_H_
+#define ANALYZECORE_H_
+
+#include <stdint.h>
+
+/// Algorithms of the analysis (see analyze.c) working on plain values. analyze.c feeds them with the converted values of the sensors, the host
+/// tools with synthetic signals or replayed recordings (see Tools/analyzetest), therefore this file must not depend on DAVE or globals.h.
+
+/// Front/rear cross-correlation. A bump hit by the front wheel reaches the rear wheel wheelbase/speed seconds later, the lag at the
+/// peak of the cross-correlation of both travels therefore gives the ground speed. See analyzecore.c for details.
+#define ANALYZE_WHEELBASE				(1.45f)	// Distance between front and rear axle in meters
+#define ANALYZE_XCORR_WINDOW			256		// Number of samples of every sensor used per correlation window. Must be a power of 2 and not bigger than S_BUF_SIZE!
+#define ANALYZE_XCORR_FFT_SIZE			(2*ANALYZE_XCORR_WINDOW) // Window is zero padded to double size to get the linear (not circular) correlation
+#define ANALYZE_XCORR_FFT_BITS			9		// log2(ANALYZE_XCORR_FFT_SIZE)
+#define ANALYZE_XCORR_HOP				128		// A new window is started every ... samples (must be more than the ticks needed for one window, see analyze_tick)
+#define ANALYZE_XCORR_MAXLAG			128		// Biggest searched lag in samples (128*5ms=0.64s -> 8km/h at 1.45m wheelbase)
+#define ANALYZE_XCORR_AVG_WEIGHT		(0.3f)	// Weight of the newest window in the exponential average of the cross spectrum (1 = no averaging)
+#define ANALYZE_XCORR_MIN_CONFIDENCE	(0.4f)	// Results with a lower normalized correlation at the peak are not used to calculate the speed
+#define ANALYZE_XCORR_STAGES_PER_TICK	3		// FFT stages computed per call of analyze_tick (one stage is ANALYZE_XCORR_FFT_SIZE/2 butterflies)
+
+typedef struct {
+	float    lag;			// Delay of the rear to the front travel at the correlation peak in seconds (parabolic interpolated)
+	float    confidence;	// Normalized correlation coefficient at the peak (0 = no relation, 1 = rear is a delayed copy of front)
+	float    speed;			// Ground speed in km/h (wheelbase/lag). 0 if the confidence is below ANALYZE_XCORR_MIN_CONFIDENCE
+	uint8_t  valid;			// 1 if speed is based on a result with enough confidence
+	uint32_t windows;		// Number of evaluated windows since start
+} analyze_xcorrResult;
+
+// Work buffers of the correlation (about 7kB)
+typedef struct {
+	float buf[2*ANALYZE_XCORR_FFT_SIZE];					// Work buffer of the FFT (interleaved real and imaginary part)
+	float avgSpectrum[2*(ANALYZE_XCORR_FFT_SIZE/2+1)];	// Averaged cross spectrum (bins 0 to N/2, the rest is conjugate symmetric)
+	float twiddleCos[ANALYZE_XCORR_FFT_SIZE/2];			// Twiddle factors of the FFT
+	float twiddleSin[ANALYZE_XCORR_FFT_SIZE/2];
+	float avgEnergy[2];									// Averaged energy of the front and rear window (used to normalize the correlation)
+} xcorrCore;
+
+/// Damping estimator (logarithmic decrement). After a sharp input the suspension rings down. The decay of the peak-to-peak swings between
+/// successive turning points of the converted travel gives the damping ratio, their spacing the damped natural frequency. See analyzecore.c for details.
+/// An event needs ANALYZE_DAMP_MIN_SWINGS free swings above ANALYZE_DAMP_MIN_SWING, so heavy damping needs a big input (e.g. a 50mm step is
+/// evaluated up to a damping ratio of about 0.25, a 120mm step up to about 0.3 - see Tools/analyzetest).
+#define ANALYZE_DAMP_SMOOTHING			(0.3f)	// Weight of the newest value in the exponential smoothing of the travel before the turning point detection
+#define ANALYZE_DAMP_HYSTERESIS			(2.0f)	// A turning point is accepted when the travel moved back more than this (converted unit, mm)
+#define ANALYZE_DAMP_START_SWING		(15.0f)	// A swing of at least this size is treated as sharp input that starts a ring-down (mm)
+#define ANALYZE_DAMP_MIN_SWING			(4.0f)	// The ring-down ends when a swing gets smaller than this (mm)
+#define ANALYZE_DAMP_MIN_SWINGS			3		// Minimum number of free swings for a valid event
+#define ANALYZE_DAMP_MAX_SWINGS			16		// The ring-down evaluation ends after this many swings
+#define ANALYZE_DAMP_PERIOD_TOLERANCE	(0.3f)	// Allowed relative deviation of a half period from the first half period of the ring-down
+#define ANALYZE_DAMP_MAX_HALFPERIOD		100		// Longest half period in samples (100*5ms -> 1Hz lowest natural frequency). Also ends a ring-down if no turning point follows.
+#define ANALYZE_DAMP_MAX_CATCHUP		64		// Maximum number of samples processed per call of analyze_tick (more are skipped - must be far below the buffer size)
+
+typedef struct {
+	float    zeta;			// Damping ratio of the last event
+	float    fn;			// Natural frequency of the last event in Hz
+	uint8_t  swings;		// Number of swings used for the last event
+	uint32_t events;		// Number of valid events since start of the session
+	float    avgZeta;		// Running average of the damping ratio of the session
+	float    avgFn;			// Running average of the natural frequency of the session
+} analyze_dampingResult;
+
+// Phases of the ring-down detection
+enum dampPhases{dampIdle=0, dampArmed, dampRingdown};
+typedef enum dampPhases dampPhases;
+
+// State of the estimator of one sensor (bounded - no sample history is stored). A zeroed state starts over with the next sample.
+typedef struct {
+	float      smooth;			// Smoothed travel
+	float      extreme;			// Extreme of the travel since the last turning point
+	uint32_t   extremeSample;	// Sample of extreme
+	int8_t     direction;		// Current direction of the travel (1 = rising, -1 = falling, 0 = not initialized)
+	float      lastTurn;		// Travel at the last turning point
+	uint32_t   lastTurnSample;	// Sample of the last turning point
+	dampPhases phase;			// Phase of the ring-down detection
+	float      lastSwing;		// Size of the last swing
+	uint32_t   firstHalf;		// Half period of the first free swing in samples
+	uint32_t   startSample;		// Sample of the turning point the first free swing started at
+	uint8_t    swings;			// Number of free swings of the current ring-down
+	float      sumK, sumKK, sumY, sumKY;	// Sums of the least squares fit of ln(swing) over the swing number k
+} dampState;
+
+void xcorr_init(xcorrCore* xc);
+void xcorr_set(xcorrCore* xc, uint8_t s, uint16_t n, float value);
+void xcorr_prepare(xcorrCore* xc);
+void xcorr_fftStage(xcorrCore* xc, uint8_t stage);
+void xcorr_spectrum(xcorrCore* xc);
+void xcorr_peak(xcorrCore* xc, float interval, analyze_xcorrResult* res);
+void damp_sample(dampState* st, analyze_dampingResult* res, float value, uint32_t sample, float interval);
+
+#endif /* ANALYZECORE_H_ */
@@ -0,0 +1,35 @@
+/*
+@file    		fixedpt.c
+@brief   		16bit fixed-point storage of float values (shared by the firmware and the host tools, see fixedpt.h)
+@version 		1.0
+@date    		2021-10-18
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <stdint.h>
+#include "fixedpt.h"
+
+
+
+int16_t fixed_fromFloat(float steps){
+	/// Round the given number of steps to the nearest int16 and saturate it to the int16 range. Used to store values in fixed-point buffers (see FIXEDPT_FROM_FLOAT).
+
+
+	if(steps >= 32767.0f)
+		return 32767;
+	if(steps <= -32768.0f)
+		return -32768;
+	return (steps >= 0) ? (int16_t)(steps + 0.5f) : (int16_t)(steps - 0.5f);
+}
+
+fixedFormat fixed_formatRange(float min, float max){
+	/// Format that covers the given range plus FIXED_FORMAT_MARGIN on both sides (values a little outside of the range, e.g. noise at the end of
+	/// a conversion table, aren't saturated). An empty range gets a minimal width, so the format stays usable.
+
+
+	float margin = (max - min) * FIXED_FORMAT_MARGIN;
+	if(margin < 0.001f)
+		margin = 0.001f;
+	fixedFormat fmt = FIXED_FORMAT_RANGE(min - margin, max + margin);
+	return fmt;
+}
@@ -0,0 +1,29 @@
+/*
+ * fixedpt.h
+ *
+ *  Created on: 18 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef FIXEDPT_H_
+#define FIXEDPT_H_
+
+#include <stdint.h>
+
+/// 16bit fixed-point storage of float values (filtered and converted buffers, see MEASURE_FIXED_BUFFERS in globals.h). A value is stored as
+/// int16 with a scale and offset (value = stored*scale + offset), the 65535 steps span the range of the format. Shared by the firmware and the
+/// host tools (see Tools/fixedtest), therefore this file must not depend on DAVE or globals.h.
+typedef struct {
+	float scale;				// Value of one step of the stored integer
+	float invScale;				// 1/scale (avoids a division when storing)
+	float offset;				// Value represented by a stored 0
+} fixedFormat;
+#define FIXED_FORMAT_RANGE(min, max) {.scale = ((max)-(min))/65535.0f, .invScale = 65535.0f/((max)-(min)), .offset = ((max)+(min))/2.0f} // Initializer of a fixedFormat covering min to max
+#define FIXED_FORMAT_MARGIN		0.01f	// Margin added on both sides of a range by fixed_formatRange (relative to the range)
+#define FIXEDPT_FROM_FLOAT(fmt, value)	fixed_fromFloat(((value) - (fmt).offset) * (fmt).invScale)	// Stored integer of a value (rounded, saturated)
+#define FIXEDPT_TO_FLOAT(fmt, stored)	((float)(stored) * (fmt).scale + (fmt).offset)				// Value of a stored integer
+
+int16_t fixed_fromFloat(float steps);
+fixedFormat fixed_formatRange(float min, float max);
+
+#endif /* FIXEDPT_H_ */
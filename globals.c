@@ -8,6 +8,7 @@
 
 #include <DAVE.h>
 #include <math.h>
+#include <string.h>
 #include <globals.h>
 
 /*  SYSTEM VARIABLEs */
@@ -20,8 +21,11 @@ volatile uint8_t monitorSensorIdx = 0;
 
 // Sensor 1 Front
 int_buffer_t   s1_buf_0raw   [S_BUF_SIZE] = { 0 }; // all elements 0
-float_buffer_t s1_buf_1filter[S_BUF_SIZE] = { 0.0 };
-float_buffer_t s1_buf_2conv  [S_BUF_SIZE] = { 0.0 };
+conv_buffer_t  s1_buf_1filter[S_BUF_SIZE] = { 0 };
+conv_buffer_t  s1_buf_2conv  [S_BUF_SIZE] = { 0 };
+float_buffer_t s1_buf_3vel   [S_BUF_SIZE] = { 0.0 };
+float_buffer_t s1_buf_4acc   [S_BUF_SIZE] = { 0.0 };
+historyLevel   s1_history  [HISTORY_LEVELS] = { {.factor = HISTORY_FACTOR_0}, {.factor = HISTORY_FACTOR_1}, {.factor = HISTORY_FACTOR_2} };
 #define S1_FILENAME_CURLEN 6
 char    s1_filename_cal[STR_SPEC_MAXLEN] = "S1.CAL"; // Note: File extension must be 3 characters long or an error will occur (fatfs lib?)
 volatile sensor sensor1 = {
@@ -31,10 +35,16 @@ volatile sensor sensor1 = {
 	.bufIdx = 0,
 	.bufMaxIdx = S_BUF_SIZE-1,
 	.bufRaw    = (int_buffer_t*)&s1_buf_0raw,
-	.bufFilter = (float_buffer_t*)&s1_buf_1filter,
-	.bufConv   = (float_buffer_t*)&s1_buf_2conv,
+	.bufFilter = (conv_buffer_t*)&s1_buf_1filter,
+	.bufConv   = (conv_buffer_t*)&s1_buf_2conv,
+	.filterFormat = FIXED_FORMAT_RANGE(0.0f, CONV_LUT_INPUT_MAX),
+	.convFormat   = FIXED_FORMAT_RANGE(-200.0f, 200.0f), // Replaced by the range of the conversion table at reading of the CAL file (measure_conv_compile)
+	.bufVel    = (float_buffer_t*)&s1_buf_3vel,
+	.bufAcc    = (float_buffer_t*)&s1_buf_4acc,
+	.history   = (historyLevel*)&s1_history,
 	.originPoint = 0,
 	.operatingPoint = 0,
+	.trackerTheta = MEASURE_TRACKER_THETA_DEFAULT, // Gains are calculated from this at reading of the CAL file (measure_tracker_setGains)
 	.errorOccured = 0,
 	.errorThreshold = 3900, // Raw value above this threshold will be considered invalid ( errorOccured=1 ). The stored value will be linear interpolated on the last Filter values.
 	.avgFilterInterval = 5,
@@ -45,13 +55,18 @@ volatile sensor sensor1 = {
 	.fitCoefficients[0] = 0,
 	.fitCoefficients[1] = 0,
 	.fitCoefficients[2] = 0,
-	.fitCoefficients[3] = 0
+	.fitCoefficients[3] = 0,
+	.convStages[0].type = convStageOffset, // Default pipeline: calibration fit followed by origin/operating point offset. The table is built at reading of the CAL file (measure_conv_compile)
+	.convStages_size = 1
 };
 
 // Sensor 2 Rear
 int_buffer_t   s2_buf_0raw   [S_BUF_SIZE] = { 0 }; // all elements 0
-float_buffer_t s2_buf_1filter[S_BUF_SIZE] = { 0.0 };
-float_buffer_t s2_buf_2conv  [S_BUF_SIZE] = { 0.0 };
+conv_buffer_t  s2_buf_1filter[S_BUF_SIZE] = { 0 };
+conv_buffer_t  s2_buf_2conv  [S_BUF_SIZE] = { 0 };
+float_buffer_t s2_buf_3vel   [S_BUF_SIZE] = { 0.0 };
+float_buffer_t s2_buf_4acc   [S_BUF_SIZE] = { 0.0 };
+historyLevel   s2_history  [HISTORY_LEVELS] = { {.factor = HISTORY_FACTOR_0}, {.factor = HISTORY_FACTOR_1}, {.factor = HISTORY_FACTOR_2} };
 #define S2_FILENAME_CURLEN 6
 char    s2_filename_cal[STR_SPEC_MAXLEN] = "S2.CAL"; // Note: File extension must be 3 characters long or an error will occur (fatfs lib?)
 volatile sensor sensor2 = {
@@ -61,10 +76,16 @@ volatile sensor sensor2 = {
 	.bufIdx = 0,
 	.bufMaxIdx = S_BUF_SIZE-1,
 	.bufRaw    = (int_buffer_t*)&s2_buf_0raw,
-	.bufFilter = (float_buffer_t*)&s2_buf_1filter,
-	.bufConv   = (float_buffer_t*)&s2_buf_2conv,
+	.bufFilter = (conv_buffer_t*)&s2_buf_1filter,
+	.bufConv   = (conv_buffer_t*)&s2_buf_2conv,
+	.filterFormat = FIXED_FORMAT_RANGE(0.0f, CONV_LUT_INPUT_MAX),
+	.convFormat   = FIXED_FORMAT_RANGE(-200.0f, 200.0f), // Replaced by the range of the conversion table at reading of the CAL file (measure_conv_compile)
+	.bufVel    = (float_buffer_t*)&s2_buf_3vel,
+	.bufAcc    = (float_buffer_t*)&s2_buf_4acc,
+	.history   = (historyLevel*)&s2_history,
 	.originPoint = 0,
 	.operatingPoint = 0,
+	.trackerTheta = MEASURE_TRACKER_THETA_DEFAULT, // Gains are calculated from this at reading of the CAL file (measure_tracker_setGains)
 	.errorOccured = 0,
 	.errorThreshold = 3900, // Raw value above this threshold will be considered invalid ( errorOccured=1 ). The stored value will be linear interpolated on the last Filter values.
 	.avgFilterInterval = 5,
@@ -75,7 +96,9 @@ volatile sensor sensor2 = {
 	.fitCoefficients[0] = 0,
 	.fitCoefficients[1] = 0,
 	.fitCoefficients[2] = 0,
-	.fitCoefficients[3] = 0
+	.fitCoefficients[3] = 0,
+	.convStages[0].type = convStageOffset, // Default pipeline: calibration fit followed by origin/operating point offset. The table is built at reading of the CAL file (measure_conv_compile)
+	.convStages_size = 1
 };
 
 // Array of all sensor objects to be used in measurement handler
@@ -91,6 +114,9 @@ volatile uint16_t fifo_writeBufIdx = 0;					// The index inside the fifo_buf whe
 volatile uint8_t fifo_writeBlock = 0;					// The current block (multiple of BLOCK_SIZE) inside the fifo_buf the measurement handler is writing to
 volatile uint8_t fifo_recordBlock = 0;					// The current block (multiple of BLOCK_SIZE) inside the fifo_buf that shall be written to SD-Card (as soon as finBlock==logBlock)
 volatile uint8_t fifo_finBlock[FIFO_BLOCKS] = {0};		// An array with an element for every Block in fifo_buf. Each corresponding element represents if a block is ready to recorded
+volatile fifoEvent fifo_eventQueue[FIFO_EVENT_QUEUE_SIZE];	// Ring buffer of events waiting to be written to the FIFO by the measurement handler
+volatile uint8_t fifo_eventHead = 0;					// Index in fifo_eventQueue where the next event will be queued
+volatile uint8_t fifo_eventTail = 0;					// Index in fifo_eventQueue of the next event to be written
 
 
 ///*  MENU AND USER INTERFACE */
@@ -107,7 +133,7 @@ void delay_ms(uint32_t ms){
 
 float poly_calc (float c_x, float* f_Coefficients, uint8_t order){
 	/// Calculate the result of an polynomial based on the x value, the coefficients and the order (1=linear(2 coefficients used), 2=square(3 coefficients used)...)
-	/// NOTE: A specialized version (inline and only for sensor struct's) of this code is implemented in measure.c because inline functions must be static to avoid compiler error (https://stackoverflow.com/questions/28606847/global-inline-function-between-two-c-files)
+	/// NOTE: The measurement handler doesn't use this directly but the compiled conversion table of the sensor (see measure_conv_compile)
 
 
 	// Temporary sum and result value, marked to be stored in a register to enhance speed (multiple successive access!). Use first coefficient (constant) as init value.
@@ -138,13 +164,264 @@ float_buffer_t measure_movAvgFilter_clean(sensor* sens, uint16_t filterInterval,
 	}
 
 	// Calculate average and return it
+	float_buffer_t result;
 	if(compFilterOrder != 0)
-		sens->bufFilter[sens->bufIdx] = sens->avgFilterSum / compFilterOrder;
+		result = sens->avgFilterSum / compFilterOrder;
 	else if(filterInterval != 0)
-		sens->bufFilter[sens->bufIdx] = sens->avgFilterSum / filterInterval;
+		result = sens->avgFilterSum / filterInterval;
 	else
-		sens->bufFilter[sens->bufIdx] = 0;
+		result = 0;
+	SENS_SET_FILTER(sens, sens->bufIdx, result);
+
+	// Memoized values might be based on another filter interval
+	measure_lazy_invalidate(sens);
+
+	// Return result (not quantized)
+	return result;
+}
+
+void measure_tracker_setGains(sensor* sens){
+	/// Calculate the fixed gains of the alpha-beta-gamma tracker from the smoothing parameter trackerTheta of the given sensor.
+	/// The gains of a critically damped (fading memory) filter are used. This makes the tracker stable for every theta between 0 and 1
+	/// and reduces the tuning to one parameter (0 = follow every measurement, towards 1 = heavy smoothing but more lag and overshoot).
+	///   alpha = 1-theta^3,  beta = 1.5*(1-theta)^2*(1+theta),  gamma = 0.5*(1-theta)^3
+	/// The stored gains already include the division by the time step, so the tracker update needs no division.
+	///
+	///	Uses globals variables: MEASURE_TRACKER_T
+
+
+	// Limit theta to the stable range
+	if(sens->trackerTheta < 0.0f) sens->trackerTheta = 0.0f;
+	if(sens->trackerTheta > 0.99f) sens->trackerTheta = 0.99f;
+
+	// Calculate gains
+	float theta = sens->trackerTheta;
+	float oneMinusTheta = 1.0f - theta;
+	sens->trackerGains[0] = 1.0f - (theta*theta*theta);
+	sens->trackerGains[1] = 1.5f * oneMinusTheta*oneMinusTheta * (1.0f + theta) / MEASURE_TRACKER_T;
+	sens->trackerGains[2] = 2.0f * 0.5f * oneMinusTheta*oneMinusTheta*oneMinusTheta / (MEASURE_TRACKER_T*MEASURE_TRACKER_T);
+}
+
+void measure_tracker_reset(sensor* sens){
+	/// Reset the state of the tracker and the velocity/acceleration buffers (e.g. before a conversion or after the calibration changed).
+	/// The tracker will settle again within a few samples after this.
+
+
+	// Reset state. The position is marked invalid (NAN) so the tracker initializes itself to the next valid measurement (no settling from 0)
+	sens->trackerState[0] = NAN;
+	sens->trackerState[1] = sens->trackerState[2] = 0.0f;
+
+	// Reset buffers
+	memset(sens->bufVel, 0, (sens->bufMaxIdx+1)*sizeof(float_buffer_t));
+	memset(sens->bufAcc, 0, (sens->bufMaxIdx+1)*sizeof(float_buffer_t));
+}
+
+float measure_conv_evaluate(sensor* sens, float x, uint8_t withOffsets){
+	/// Evaluate the whole conversion pipeline of the sensor directly (calibration fit followed by every conversion stage).
+	/// This is slow compared to measure_conv() and is meant to build the conversion table or to get intermediate values (e.g. setting of the origin point).
+	///
+	/// x			... Input value (filtered raw value)
+	/// withOffsets	... If 0 the evaluation stops before the first offset stage. Returns the value the offsets are subtracted from,
+	///					which is used to determine the origin/operating point (stages after the offset never see an absolute value).
+
+
+	// Calibration fit
+	float result = poly_calc(x, sens->fitCoefficients, sens->fitOrder);
+
+	// Every following stage in order
+	for(uint8_t s = 0; s < sens->convStages_size && s < CONV_STAGES_MAX; s++){
+		convStage* stage = &sens->convStages[s];
+		if(stage->type == convStagePoly)
+			result = poly_calc(result, stage->coefficients, stage->order);
+		else if(stage->type == convStageOffset){
+			if(!withOffsets)
+				break;
+			result -= sens->originPoint + sens->operatingPoint;
+		}
+	}
 
 	// Return result
-	return sens->bufFilter[sens->bufIdx];
+	return result;
+}
+
+void measure_conv_compile(sensor* sens){
+	/// Compile the conversion pipeline of the sensor into its conversion table. Must be called every time the calibration, a stage or an offset changes.
+	/// The table holds CONV_LUT_SEGMENTS+1 points over the input range 0 to CONV_LUT_INPUT_MAX, values in between are linear interpolated (see measure_conv).
+	/// With 256 segments one segment spans 16 ADC counts, the interpolation error of a smooth polynomial of low order is far below the noise of the sensor.
+	/// The new table is calculated in a temporary buffer and copied with interrupts disabled, so the measurement handler never uses a half written table.
+	///
+	///	Uses globals variables: CONV_LUT_SEGMENTS, CONV_LUT_INPUT_MAX
+
+
+	// Calculate new table and its range (0 is always included - errors are stored as 0)
+	static float lutTmp[CONV_LUT_SEGMENTS+1];
+	float lutMin = 0, lutMax = 0;
+	for(uint16_t i = 0; i <= CONV_LUT_SEGMENTS; i++){
+		lutTmp[i] = measure_conv_evaluate(sens, i * (CONV_LUT_INPUT_MAX/CONV_LUT_SEGMENTS), 1);
+		if(lutTmp[i] < lutMin) lutMin = lutTmp[i];
+		if(lutTmp[i] > lutMax) lutMax = lutTmp[i];
+	}
+
+	// Fixed-point format of the converted buffer covers the range of the table with a margin (see MEASURE_FIXED_BUFFERS)
+	fixedFormat convFormat = fixed_formatRange(lutMin, lutMax);
+
+	// Copy table and format (atomic for the measurement handler)
+	__disable_irq();
+	memcpy(sens->convLut, lutTmp, sizeof(lutTmp));
+	sens->convFormat = convFormat;
+	__enable_irq();
+
+	// Memoized values are based on the old table
+	measure_lazy_invalidate(sens);
+}
+
+float measure_conv(sensor* sens, float x){
+	/// Convert the given input value (filtered raw value) with the conversion table of the sensor (same as MEASURE_LUTCONVERSION in measure.c).
+	/// Inputs outside of the table range are extrapolated with the first/last segment.
+
+
+	// Get segment and position inside of it
+	float pos = x * (CONV_LUT_SEGMENTS/CONV_LUT_INPUT_MAX);
+	int32_t seg = (int32_t)pos;
+	if(seg < 0) seg = 0;
+	if(seg > CONV_LUT_SEGMENTS-1) seg = CONV_LUT_SEGMENTS-1;
+
+	// Linear interpolation
+	return sens->convLut[seg] + (pos - seg) * (sens->convLut[seg+1] - sens->convLut[seg]);
+}
+
+void measure_lazy_fillRange(sensor* sens, uint16_t count){
+	/// Make sure the filtered and converted values of the newest 'count' samples of the sensor are up to date (lazy conversion, see MEASURE_LAZY_CONVERSION).
+	/// Only indexes without valid bit are calculated. The moving sum of the filter is built once at the first invalid index of the range and then slid along,
+	/// so filling the whole buffer for a graph costs about one addition/subtraction and one table conversion per missing value. Nulled errors are excluded
+	/// from the average (MEASURE_RAW_COUNTS) and the values are stored by MEASURE_FILTER_STORE, so they are identical to the ones of measure_postProcessing.
+	/// The filter interval of the oldest samples of a full buffer may reach behind the buffer - only its part that is still in the buffer is used then
+	/// (like at the start of a measurement). A value is only stored if the measurement handler didn't overwrite its index or a raw value of its filter
+	/// interval meanwhile (checked with interrupts disabled), otherwise it stays invalid. Can be called by the measurement handler as well.
+	/// Does nothing if the lazy conversion is deactivated (the measurement handler already calculated every value).
+	///
+	/// count	... Number of samples to be filled, ending at the newest one (1 = only the current value, S_BUF_SIZE = whole buffer)
+	///
+	///	Uses globals variables: MEASURE_LAZY_CONVERSION
+#if MEASURE_LAZY_CONVERSION == 1
+
+
+	// Limit range to the buffer
+	uint16_t size = sens->bufMaxIdx + 1;
+	if(count > size)
+		count = size;
+	uint16_t interval = sens->avgFilterInterval;
+	if(count == 0 || interval == 0 || interval > size)
+		return;
+
+	// Snapshot of the newest index (the measurement handler only writes behind it). Samples are addressed by their age (0 = newest) from here on.
+	uint16_t newest = sens->bufIdx;
+
+	// Moving sum and number of valid values in the filter interval of the current sample (built at first use)
+	uint32_t sum = 0;
+	uint16_t valid = 0;
+	uint8_t  windowReady = 0;
+
+	for(int32_t age = count-1; age >= 0; age--){
+		// Index of the sample and age of the oldest value of its filter interval that is in the buffer
+		int32_t idx = newest - age;
+		if(idx < 0) idx += size;
+		uint16_t oldest = (age + interval - 1 < size) ? age + interval - 1 : size - 1;
+
+		// Calculate value if it isn't memoized
+		if((sens->lazyValid[idx >> 5] & (1UL << (idx & 31))) == 0){
+			// Build sum over the filter interval of the sample
+			if(!windowReady){
+				for(uint16_t a = age; a <= oldest; a++){
+					int32_t j = newest - a;
+					if(j < 0) j += size;
+					if(MEASURE_RAW_COUNTS(sens->bufRaw[j])){
+						sum += sens->bufRaw[j];
+						valid++;
+					}
+				}
+				windowReady = 1;
+			}
+
+			// Store filtered and converted value and mark it as valid - unless new samples of the measurement handler overwrote the oldest value used
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			uint16_t arrived = (sens->bufIdx + size - newest) % size;
+			if(oldest + arrived < size){
+				MEASURE_FILTER_STORE(sens, idx, sum, valid);
+				sens->lazyValid[idx >> 5] |= (1UL << (idx & 31));
+				sens->lazyComputed++;
+			}
+			__set_PRIMASK(primask);
+		}
+
+		// Slide the filter interval to the next sample (add its value, remove the oldest one if it was in the buffer)
+		if(windowReady && age > 0){
+			int32_t j = newest - (age-1);
+			if(j < 0) j += size;
+			if(MEASURE_RAW_COUNTS(sens->bufRaw[j])){
+				sum += sens->bufRaw[j];
+				valid++;
+			}
+			if(age + interval - 1 < size){
+				j = newest - (age + interval - 1);
+				if(j < 0) j += size;
+				if(MEASURE_RAW_COUNTS(sens->bufRaw[j])){
+					sum -= sens->bufRaw[j];
+					valid--;
+				}
+			}
+		}
+	}
+#endif
+}
+
+void measure_lazy_invalidate(sensor* sens){
+	/// Clear the memoized filtered/converted values of the sensor (lazy conversion). Must be called every time the conversion table or the filter changes.
+	/// The values are recalculated by the next measure_lazy_fillRange().
+
+
+	// Clear all valid bits (atomic for the measurement handler)
+	__disable_irq();
+	memset(sens->lazyValid, 0, sizeof(sens->lazyValid));
+	__enable_irq();
+}
+
+uint8_t fifo_event_enqueue(uint8_t type, const void* payload, uint8_t size){
+	/// Queue an event to be stored in-band in the recording (see FIFO_EVENT_MARKER). Takes constant time and is safe to use from interrupts.
+	/// Returns 1 if the event was queued, 0 if the queue is full or the payload is too big (event is dropped).
+	///
+	/// type	... Type of the event (see fifoEventTypes)
+	/// payload	... Pointer to the payload (may be NULL if size is 0)
+	/// size	... Size of the payload in bytes (at most FIFO_EVENT_PAYLOAD_MAX*FIFO_LINE_SIZE)
+	///
+	///	Uses globals variables: fifo_eventQueue, fifo_eventHead, fifo_eventTail
+
+
+	// Check payload size
+	if(size > FIFO_EVENT_PAYLOAD_MAX*FIFO_LINE_SIZE)
+		return 0;
+
+	// Disable interrupts (restore previous state afterwards - might be called from an interrupt)
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// Check if queue is full
+	uint8_t next = (fifo_eventHead + 1) & (FIFO_EVENT_QUEUE_SIZE-1);
+	uint8_t queued = 0;
+	if(next != fifo_eventTail){
+		// Store event (unused payload bytes are 0)
+		volatile fifoEvent* ev = &fifo_eventQueue[fifo_eventHead];
+		ev->type = type;
+		ev->lines = (size + FIFO_LINE_SIZE - 1) / FIFO_LINE_SIZE;
+		memset((void*)ev->payload, 0, sizeof(ev->payload));
+		if(size)
+			memcpy((void*)ev->payload, payload, size);
+		fifo_eventHead = next;
+		queued = 1;
+	}
+
+	// Restore interrupts
+	__set_PRIMASK(primask);
+	return queued;
 }
@@ -6,12 +6,14 @@
 @author 		Rene Santeler @ MCI 2020/21
  */
 #include <DAVE.h>
+#include "fixedpt.h"
 
 #ifndef GLOBALS_H_
 #define GLOBALS_H_
 
 /*  MACROS - DEFINEs */
 #define DEBUG_ENABLE   // self implemented Debug flag
+#define FIRMWARE_VERSION "DeflectionAnalyzer 1.0" // Version string stored in the header of every recording (see recfmt.h)
 #define INPUT_STANDARD // Defines which signal shall be retrieved in ADC_measurement_handler. INPUT_STANDARD = current adc value, INPUT_TESTIMPULSE = generated impulse signal, INPUT_TESTSAWTOOTH = generated saw signal, INPUT_TESTSINE = generated sine signal
 #define MEASUREMENT_INTERVAL (5.0) // Time between measurements in ms. Must be same as is set in TIMER_0 DAVE App!
 #define S_BUF_SIZE (480-20-20) // =440 values stored, next every 5ms -> 2.2sec storage
@@ -36,6 +38,125 @@ volatile uint8_t monitorSensorIdx;
 // are errors shall be calculated (if filter order is greater than occurred errors)
 #define POSTPROCESS_BUGGED_VALUES 1
 
+// Tracker (alpha-beta-gamma filter) settings. The tracker runs on every converted sample and outputs position, velocity and acceleration without the lag of the average filter.
+#define MEASURE_TRACKER_T ((float)(MEASUREMENT_INTERVAL/1000.0)) // Time between two tracker updates in seconds
+#define MEASURE_TRACKER_OUTPUT_SCALE (0.001f) // Scale applied to velocity/acceleration before storing them in bufVel/bufAcc (converted values in mm -> m/s and m/s^2)
+#define MEASURE_TRACKER_THETA_DEFAULT (0.8f)  // Default smoothing parameter used if no CAL file is available
+
+// Conversion pipeline. After the calibration fit (fitCoefficients) every sensor applies a chain of further conversion stages
+// (e.g. a motion ratio/leverage curve from sensor travel to wheel travel and the origin/operating point offsets). The whole chain
+// is compiled into one lookup table per sensor by measure_conv_compile(), so every user gets the final value in one evaluation.
+// NOTE: The stages can only be changed in the CAL file of the sensor (see record_readCalFile), the menu only sets the origin/operating point.
+#define CONV_STAGES_MAX 4		// Maximum number of stages after the calibration fit
+#define CONV_LUT_SEGMENTS 256	// Number of linear interpolated segments of the conversion table (the table holds one more point)
+#define CONV_LUT_INPUT_MAX (4096.0f) // Input value (filtered raw) represented by the last point of the table (12bit ADC range)
+enum convStageTypes{convStageNone=0, convStagePoly, convStageOffset};
+typedef enum convStageTypes convStageTypes;
+typedef struct {
+	uint8_t type;				// Type of the stage (see convStageTypes). convStagePoly = polynomial (e.g. motion ratio curve), convStageOffset = subtract origin and operating point of the sensor
+	uint8_t order;				// Order of the polynomial (only used by convStagePoly)
+	float   coefficients[4];	// Coefficients of the polynomial (only used by convStagePoly)
+} convStage;
+
+// Lazy conversion. If activated the measurement handler only stores the raw value (plus error marking and tracker) in monitoring mode. Filtered and
+// converted values are calculated on demand by measure_lazy_fillRange() for the range that is actually shown and memoized per index (one valid
+// bit per index, cleared by the measurement handler for every new sample and for all indexes at calibration/filter changes - measure_lazy_invalidate).
+// Error handling and the calculation of a value are shared with measure_postProcessing, so both ways give identical values (see MEASURE_FILTER_STORE).
+// Recording and BIN->CSV conversion are not affected.
+#define MEASURE_LAZY_CONVERSION 1	// 1 = calculate filtered/converted values on demand, 0 = calculate them for every sample in the measurement handler
+#define MEASURE_LAZY_WORDS ((S_BUF_SIZE+31)/32) // Number of 32bit words of the valid bit field
+
+// Storage of the filtered and converted buffers. With MEASURE_FIXED_BUFFERS the values are stored as int16 with a per-sensor scale and offset
+// (value = stored*scale + offset, see fixedpt.h) instead of float. This saves 4 bytes per sample and sensor: 14 instead of 18 bytes (raw 2, filtered
+// and converted 2 instead of 4 each, the velocity and acceleration buffers stay float with 4 each) -> 3520 bytes for two sensors with S_BUF_SIZE 440.
+// Always access the buffers with the SENS_GET_/SENS_SET_ macros (and srcTypeFixed or TFT_graph_pixeldata_fixed for display elements).
+// Quantization error (half a step of 65535 steps over the range of the format, checked by Tools/fixedtest):
+//   Filtered:  Fixed range 0 to CONV_LUT_INPUT_MAX -> step 0.0625 counts -> max. error 0.032 counts with the float rounding near 4096 (far below
+//              the 1 count resolution of the ADC)
+//   Converted: Range of the conversion table of the sensor including 0 (+1% margin on both sides, set by measure_conv_compile) -> e.g. -40 to 160mm
+//              gives a step of 0.0031mm -> max. error 0.0016mm. Values outside of the range (extrapolation) are saturated.
+#define MEASURE_FIXED_BUFFERS 1		// 1 = int16 fixed-point filtered/converted buffers, 0 = float buffers
+#if MEASURE_FIXED_BUFFERS == 1
+typedef int16_t conv_buffer_t;
+#define FIXED_FROM_FLOAT(fmt, value)	FIXEDPT_FROM_FLOAT(fmt, value)
+#define FIXED_TO_FLOAT(fmt, stored)		FIXEDPT_TO_FLOAT(fmt, stored)
+#else
+typedef float conv_buffer_t;
+#define FIXED_FROM_FLOAT(fmt, value)	(value)
+#define FIXED_TO_FLOAT(fmt, stored)		(stored)
+#endif
+// Access of the filtered/converted buffers of a sensor (independent of the storage mode)
+#define SENS_GET_FILTER(sens, idx)			FIXED_TO_FLOAT((sens)->filterFormat, (sens)->bufFilter[idx])
+#define SENS_SET_FILTER(sens, idx, value)	((sens)->bufFilter[idx] = FIXED_FROM_FLOAT((sens)->filterFormat, (value)))
+#define SENS_GET_CONV(sens, idx)			FIXED_TO_FLOAT((sens)->convFormat, (sens)->bufConv[idx])
+#define SENS_SET_CONV(sens, idx, value)		((sens)->bufConv[idx] = FIXED_FROM_FLOAT((sens)->convFormat, (value)))
+
+/// 1 if a raw value of the buffer counts for the moving average: errors are nulled with POSTPROCESS_CHANGEORDER_AT_ERRORS, otherwise they are interpolated
+/// and every value counts.
+#define MEASURE_RAW_COUNTS(raw)	(POSTPROCESS_CHANGEORDER_AT_ERRORS != 1 || (raw) != 0)
+
+/// Store the filtered and converted value of a buffer index from the sum and the number of the valid raw values in its filter interval (MEASURE_RAW_COUNTS).
+/// Used by measure_postProcessing and measure_lazy_fillRange, so the eager and the lazy conversion give identical values. Both are 0 if there is no
+/// valid value (or the raw value at idx is an error and POSTPROCESS_BUGGED_VALUES is 0). The table conversion uses the stored filtered value.
+#define MEASURE_FILTER_STORE(sens, idx, sum, valid)												\
+	if((valid) > 0 && (POSTPROCESS_BUGGED_VALUES == 1 || (sens)->bufRaw[idx] != 0)){			\
+		SENS_SET_FILTER(sens, idx, (float)(sum) / (valid));										\
+		SENS_SET_CONV(sens, idx, measure_conv((sensor*)(sens), SENS_GET_FILTER(sens, idx)));	\
+	}																							\
+	else{																						\
+		SENS_SET_FILTER(sens, idx, 0);															\
+		SENS_SET_CONV(sens, idx, 0);															\
+	}
+
+// Sensor health monitor. Rolling metrics are updated by the measurement handler at every sample with a handful of operations (see MEASURE_HEALTH in measure.c)
+// and latched into rates and flags once per window. Flagged sensors are excluded from derived analytics (see analyze) and the metrics are stored in the recording as events.
+#define HEALTH_WINDOW			200			// Samples per evaluation window (200*5ms = 1s -> rates are per second)
+#define HEALTH_NOISE_ALPHA		(1.0f/64.0f)// Weight of the newest squared first difference in the exponential average of the noise floor
+#define HEALTH_NOISE_MAX		(25.0f)		// RMS noise floor in raw counts above which the sensor is flagged noisy
+#define HEALTH_ERRORRATE_MAX	10			// Errors (raw above errorThreshold) per window above which the sensor is flagged as dropping out
+#define HEALTH_STUCK_SAMPLES	400			// Number of successive equal raw values after which the sensor is flagged stuck (400*5ms = 2s)
+#define HEALTH_SAT_MARGIN		4			// Raw values this close to 0 or HEALTH_RAW_RAIL are considered saturated
+#define HEALTH_SATRATE_MAX		10			// Saturated values per window above which the sensor is flagged saturated
+#define HEALTH_RAW_RAIL			4095		// Highest possible raw value (12bit ADC)
+enum healthFlags{healthNoise=0x01, healthDropout=0x02, healthStuck=0x04, healthSaturation=0x08};
+typedef struct {
+	int_buffer_t lastRaw;		// Raw value of the last sample (for first difference and stuck detection)
+	uint16_t windowCount;		// Samples in the current window
+	uint16_t errorCount;		// Errors in the current window
+	uint16_t satCount;			// Saturated values in the current window
+	uint16_t stuckCount;		// Successive samples without change of the raw value
+	float    noiseVar;			// Exponential average of the squared first difference (high-pass) of the raw value
+	float    noiseRms;			// Latched RMS noise floor in raw counts (first difference of white noise has double the variance)
+	uint16_t errorRate;			// Latched errors per window
+	uint16_t satRate;			// Latched saturated values per window
+	uint8_t  flags;				// Latched health flags (see healthFlags, 0 = healthy)
+} sensorHealth;
+
+// Long-horizon history. Beside the S_BUF_SIZE buffers every sensor keeps a multi-resolution history of its raw value: min/max/mean per bucket for
+// HISTORY_LEVELS levels of HISTORY_SIZE buckets each (one bucket per graph pixel). Level 0 is filled by the measurement handler (see MEASURE_HISTORY
+// in measure.c), every finished bucket is also added to the level above. Memory is fixed per level, the update cost is amortized O(1) per sample.
+// All buckets start empty (see measure_history_init).
+#define HISTORY_LEVELS	3
+#define HISTORY_SIZE	S_BUF_SIZE	// Buckets per level (one per pixel of the monitor graph)
+#define HISTORY_FACTOR_0	5		// Samples per bucket of level 0 (25ms -> 11s per level)
+#define HISTORY_FACTOR_1	6		// Buckets of level 0 per bucket of level 1 (150ms -> 66s per level)
+#define HISTORY_FACTOR_2	10		// Buckets of level 1 per bucket of level 2 (1.5s -> 11min per level)
+typedef struct {
+	int_buffer_t min;			// Smallest valid raw value in the bucket (bigger than max if the bucket holds no valid value)
+	int_buffer_t max;			// Biggest valid raw value in the bucket
+	int_buffer_t mean;			// Mean of the valid raw values in the bucket
+} historyBucket;
+typedef struct {
+	historyBucket buckets[HISTORY_SIZE]; // Ring buffer of finished buckets
+	uint16_t idx;				// Index of the newest finished bucket
+	uint16_t factor;			// Inputs (samples or buckets of the level below) per bucket
+	uint16_t accInputs;			// Inputs in the current bucket
+	uint16_t accCount;			// Valid samples in the current bucket
+	uint32_t accSum;			// Sum of the valid samples in the current bucket
+	int_buffer_t accMin;		// Smallest valid sample in the current bucket
+	int_buffer_t accMax;		// Biggest valid sample in the current bucket
+} historyLevel;
+
 // Sensor data definition
 #define SENSOR_RAW_SIZE sizeof(int_buffer_t) // Bytes. Size of the a variable that represents the raw value. FIFO_BLOCK_SIZE MUST BE DIVISIBLE BY THIS!
 #define STR_SPEC_MAXLEN 20
@@ -46,18 +167,34 @@ typedef struct {
 	uint16_t        bufIdx; 		// Index of current value in buffers
 	uint16_t        bufMaxIdx; 		// Maximum index of all buffers
 	int_buffer_t*   bufRaw; 		// The raw value buffer
-	float_buffer_t* bufFilter; 		// The filtered value buffer
-	float_buffer_t* bufConv; 		// The converted value buffer
-	float_buffer_t  originPoint; 	// Offset to actual zero point
+	conv_buffer_t*  bufFilter; 		// The filtered value buffer (use SENS_GET_FILTER/SENS_SET_FILTER, see MEASURE_FIXED_BUFFERS)
+	conv_buffer_t*  bufConv; 		// The converted value buffer (output of the whole conversion pipeline, see convStages. Use SENS_GET_CONV/SENS_SET_CONV)
+	fixedFormat     filterFormat;	// Scale and offset of the stored filtered values (only used with MEASURE_FIXED_BUFFERS)
+	fixedFormat     convFormat;		// Scale and offset of the stored converted values. Set by measure_conv_compile() (only used with MEASURE_FIXED_BUFFERS)
+	float_buffer_t* bufVel; 		// The velocity buffer estimated by the tracker (see MEASURE_TRACKER_OUTPUT_SCALE for unit)
+	float_buffer_t* bufAcc; 		// The acceleration buffer estimated by the tracker (see MEASURE_TRACKER_OUTPUT_SCALE for unit)
+	historyLevel*   history;		// Long-horizon history of the raw value (array of HISTORY_LEVELS levels)
+	float_buffer_t  originPoint; 	// Offset to actual zero point (in units of the stage before the offset stage)
 	float_buffer_t  operatingPoint; // Offset from origin to operating point
+	float   trackerTheta;			// Smoothing parameter of the alpha-beta-gamma tracker (0 = follow measurement, towards 1 = heavy smoothing). Gains are derived from this by measure_tracker_setGains()
+	float   trackerGains[3];		// Precomputed tracker gains {alpha, beta/T, 2*gamma/T^2}
+	float   trackerState[3];		// Current tracker state {position, velocity, acceleration} in converted units per second (e.g. mm, mm/s, mm/s^2)
 	uint8_t	 	  errorOccured;	  	// Number of error-measurements that occurred since last valid value. If this is 0 the current value is valid.
 	int_buffer_t  errorThreshold; 	// Raw value above this threshold will be considered as invalid ( errorOccured=1 ). The stored value will be linear interpolated on the last Filter values.
+	float   errorLastValid;			// Slope of the linear interpolation of errors (only used with POSTPROCESS_INTERPOLATE_ERRORS)
+	sensorHealth health;			// Rolling health metrics of the sensor (see sensorHealth)
 	float     avgFilterSum; 		// Sum of all values in filter interval (moving)
 	uint16_t  avgFilterInterval; 	// Size of the filter interval
 	char*   fitFilename; 			// Filename of the CAL file
 	uint8_t fitFilename_curLen; 	// Length of the CAL filename
 	uint8_t fitOrder; 				// Function order for curve fit
 	float   fitCoefficients[4]; 	// Estimated coefficients of the polynomial
+	convStage convStages[CONV_STAGES_MAX]; // Conversion stages applied after the calibration fit (in this order)
+	uint8_t   convStages_size;		// Number of used conversion stages
+	float   convLut[CONV_LUT_SEGMENTS+1]; // Fused conversion table of the calibration fit and all stages. Built by measure_conv_compile() - never write directly
+	uint32_t lazyValid[MEASURE_LAZY_WORDS]; // One bit per buffer index: 1 = bufFilter/bufConv at this index are up to date (only used with MEASURE_LAZY_CONVERSION)
+	uint16_t lazyComputed;			// Number of filtered/converted values calculated in the current health window (only used with MEASURE_LAZY_CONVERSION)
+	uint8_t  lazySkipped;			// Percentage of samples in the last health window that never needed to be filtered/converted - a share of samples, not of CPU time (only used with MEASURE_LAZY_CONVERSION)
 	float*  dp_x; 					// X-value of data points used for fit
 	float*  dp_y; 					// Y-value of data points used for fit
 	uint16_t dp_size; 				// Number of data points used for fit
@@ -67,19 +204,29 @@ typedef struct {
 char s1_filename_cal[STR_SPEC_MAXLEN];
 volatile sensor sensor1;
 extern int_buffer_t s1_buf_0raw[];
-extern float_buffer_t s1_buf_1filter[];
-extern float_buffer_t s1_buf_2conv[];
+extern conv_buffer_t  s1_buf_1filter[];
+extern conv_buffer_t  s1_buf_2conv[];
+extern float_buffer_t s1_buf_3vel[];
+extern float_buffer_t s1_buf_4acc[];
+extern historyLevel   s1_history[];
 
 // Sensor 2 Rear
 char s2_filename_cal[STR_SPEC_MAXLEN];
 volatile sensor sensor2;
 extern int_buffer_t s2_buf_0raw[];
-extern float_buffer_t s2_buf_1filter[];
-extern float_buffer_t s2_buf_2conv[];
+extern conv_buffer_t  s2_buf_1filter[];
+extern conv_buffer_t  s2_buf_2conv[];
+extern float_buffer_t s2_buf_3vel[];
+extern float_buffer_t s2_buf_4acc[];
+extern historyLevel   s2_history[];
 
 // Array of all sensor objects to be used in measurement handler
 #define SENSORS_SIZE 2
 extern volatile sensor* sensors[];
+// Extension of the binary calibration file written next to the CAL file (same name, see record_writeCalFile). It is loaded with one read
+// instead of parsing the CAL file, which is only read if the binary file is missing, broken or older (e.g. edited on a PC). Delete the binary
+// file to use a restored CAL backup (renaming keeps the old date)
+#define RECORD_CAL_BIN_EXT "CLB"
 
 /*  RECORDING FIFO AND FILENAME */
 #define FILENAME_REC_MAXLEN 10
@@ -87,29 +234,122 @@ extern char filename_rec[FILENAME_REC_MAXLEN];
 uint8_t filename_rec_curLength;
 // Size of buffers used for filename handling (change this if Long File Names - LFN is activated)
 #define FILENAME_BUFFER_LENGTH 20
+// File objects for short file operations beside the recording and the background conversion (CAL files, screenshot - see record_poolOpen).
+// Every one needs about 550 bytes (file object with sector buffer). FF_FS_LOCK (fatfs_conf.h) must cover them
+#define RECORD_FILE_POOL 3
+// Highest number of a backup of a file (name + number, see record_backupFile - 8.3 names might allow less) and number of base names whose next free
+// backup number is cached while the card stays mounted (see record_backupNext)
+#define RECORD_BACKUP_MAX 9999
+#define RECORD_BACKUP_CACHE 4
 // Size of buffers used to generate a line for the CSV File. Adapt if line gets longer (more sensors, values, etc).
 #define CSVLINE_BUFFER_LENGTH 200
+// Conversion of a .BIN file to CSV (record_convertTick): bytes read from the .BIN file at once (rounded down to whole chunks) and bytes written
+// to the CSV file at once (multiple of the sector size, e.g. a cluster - writes of whole aligned sectors go directly to the card)
+#define RECORD_CONV_READ_SIZE	(8*1024)
+#define RECORD_CONV_WRITE_SIZE	(4*1024)
+// Lines of the .BIN file converted per main loop tick (runs in the background, a line costs some 10us) and lines per tick while the already
+// converted part is replayed after a power cycle (no output - only the filter state is rebuilt)
+#define RECORD_CONV_LINES_PER_TICK			8
+#define RECORD_CONV_REPLAY_LINES_PER_TICK	64
+// Lines of the .BIN file between two checkpoints of the conversion (CSV/EVT written and synced, progress marker updated)
+#define RECORD_CONV_CHECKPOINT_LINES		20000
+// Progress marker of the conversion (.BIN name, converted lines, sizes of CSV and EVT file) - resumed at startup if present
+#define RECORD_CONV_PROGRESS_FILE			"CONVERT.PRG"
 
 // Note: FIFO_BLOCK_SIZE times FIFO_BLOCKS must always be a power of 2! Otherwise the overleap check with &= doesn't work anymore
 #define FIFO_BLOCK_SIZE 1024			// Number of bytes in one block
 #define FIFO_BLOCKS 	4				// Number of blocks that are used (total RAM usage = FIFO_BLOCK_SIZE*FIFO_BLOCKS)
 #define FIFO_BITS_ONE_BLOCK (FIFO_BLOCK_SIZE-1)		         // = 0b000 0111 1111 1111 for 1024BS. Represents the used bits of the uint16_t which represents the index in one block. Use '&' to check if a number is a multiple of the block size or to ignore higher bits
 #define FIFO_BITS_ALL_BLOCK	((FIFO_BLOCK_SIZE*FIFO_BLOCKS)-1)// = 0b000 0011 1111 1111 for 1024BS and 4Blocks. Represents the used bits of the uint16_t which represents the index in whole buffer. Use '&' to ignore higher bits
+#define RECORD_PREALLOC_SIZE	(16UL*1024*1024)	// Bytes preallocated (contiguous) for a recording file. Must be a multiple of FIFO_BLOCK_SIZE (16MB = 5.8h at 800 bytes/s, see record_writeBlocks)
+#define RECORD_WRITE_ALIGN_BLOCKS	2		// Coalesced SD writes end at a multiple of this many blocks in the file if possible (2*1024 = 4 sectors, see record_block)
+#define RECORD_SEGMENT_SIZE		RECORD_PREALLOC_SIZE	// Bytes of a segment of a recording - the next segment (own .BIN file, see record_segmentSwitch) is started before this is exceeded
+#define RECORD_SEGMENT_DURATION	1800		// Seconds of measurement time of a segment (0 = segments are limited by size only)
+#define RECORD_SYNC_INTERVAL	1000		// Time in ms between two syncs of the recording file (see record_sync). At most this plus two FIFO blocks of measurement time are lost at power failure
+#define RECORD_PREPARE_HEADROOM	2000		// Measurement time in ms the FIFO must be able to hold before a step of the preparation of the next segment is done (the preallocation can take long on a full card, see record_segmentPrepare)
+#define RECORD_OPEN_FILE		"RECORD.OPN"	// Marker of the open recording (.BIN name, chunks complete at the last sync) - deleted at stop, repaired at startup if present (see record_recover)
+#define RECORD_RECOVER_SCAN_BLOCKS	((uint32_t)(2*RECORD_SYNC_INTERVAL/MEASUREMENT_INTERVAL)*FIFO_LINE_SIZE/FIFO_BLOCK_SIZE + FIFO_BLOCKS + 1) // Chunks behind the last sync checked by
+											// record_recover (covers the chunks of one sync interval - a bigger value risks to take stale chunks of the preallocated clusters)
+#define RECORD_INDEX_CHUNKS		16		// Data chunks between two entries of the index of a recording (.IDX, see record_indexBlock). A seek reads at most this many chunk headers
+#define RECORD_INDEX_BUFFER		8		// Finished index entries held in RAM until they are written with the next sync (see record_sync)
+#define RECORD_SEEK_CLMT_SIZE	32		// Size of the cluster link map table (DWORDs) of a file opened for seeking (FF_USE_FASTSEEK) - (size-2)/2 fragments
+#define RECORD_LOD_BASE			32		// Measurement lines of a bucket of the lowest level of the min/max/mean pyramid of a recording (.LOD, see record_lodBlock)
+#define RECORD_LOD_FACTOR		16		// Buckets of a level in one bucket of the next level of the pyramid
+#define RECORD_LOD_LEVELS		5		// Levels of the pyramid (buckets of 32, 512, 8192, 131072 and 2097152 lines). At most RECFMT_LOD_LEVELS_MAX
+#define RECORD_LOD_PAGE_SIZE	512		// Bytes of a page of the pyramid (one sector). Size of the pyramid: pageSize/((pageSize-8)/(6*SENSORS_SIZE)) bytes per bucket,
+										// about 0.41 bytes per line for 2 sensors (10% of the .BIN file without codec)
+#define RECORD_LOD_QUEUE		8		// Full pages of the pyramid held in RAM until they are written with the next sync. At least RECORD_LOD_LEVELS+2 (see record_segmentSwitch)
+#define RECORD_CODEC			2		// Lossless compression of the recording (recfmtCodecs, see recfmt.h): 0 = FIFO blocks are written as they are, 1 = 12 bit packing,
+											// 2 = delta/zigzag bit packing (or 12 bit packing if smaller). Blocks are encoded by record_block in the main loop and packed into chunks
+#define RECORD_PACK_CHUNKS		4		// Buffers of packed chunks (RECORD_CODEC) - full ones are held for a coalesced write or wait in the write queue while the next one is filled
+											// (see record_packWrite). Multiple of RECORD_WRITE_ALIGN_BLOCKS, at least twice of it and at most SDQUEUE_LENGTH
 #define FIFO_LINE_SIZE 		4				// Number of bytes that represent one measurement line. This MUST be a clean divider of the FIFO_BLOCK_SIZE and must be adapted if more or less sensors are recorded.
 #define FIFO_LINE_SIZE_PAD 	0				// Number of bytes that are added after the content of each measurement line. Might or might not be needed to fill a line to FIFO_LINE_SIZE. This MUST be adapted if more or less sensors are recorded or the size changes.
+#define FIFO_CHUNK_HEADER_SIZE	(((16)+FIFO_LINE_SIZE-1)/FIFO_LINE_SIZE*FIFO_LINE_SIZE) // Bytes left free at the start of every block for the chunk header of the .BIN file (sizeof(recfmtChunkHeader) rounded up to whole lines, see recfmt.h)
 volatile uint8_t volatile * volatile fifo_buf;
 volatile uint16_t fifo_writeBufIdx;
 volatile uint8_t fifo_writeBlock;
 volatile uint8_t fifo_recordBlock;
 extern volatile uint8_t fifo_finBlock[];
 
+// Events are stored in-band in the recording. An event line starts with FIFO_EVENT_MARKER instead of the first raw value (never a valid raw value),
+// followed by the event type and the number of payload lines (one byte each). The payload lines follow directly. Event lines don't advance the time.
+// Events are queued by fifo_event_enqueue (from anywhere, also interrupts) and written by the measurement handler (at most one per measurement).
+#define FIFO_EVENT_MARKER		0xFFFF	// Value of the first raw value of an event line
+#define FIFO_EVENT_QUEUE_SIZE	8		// Number of events that can be queued. Must be a power of 2!
+#define FIFO_EVENT_PAYLOAD_MAX	4		// Maximum number of payload lines of an event (FIFO_LINE_SIZE bytes each)
+enum fifoEventTypes{fifoEventNone=0, fifoEventHealth, fifoEventSync, fifoEventMarker};
+typedef struct {
+	uint8_t type;		// Type of the event (see fifoEventTypes)
+	uint8_t lines;		// Number of payload lines
+	uint8_t payload[FIFO_EVENT_PAYLOAD_MAX*FIFO_LINE_SIZE];
+} fifoEvent;
+// Payload of a fifoEventHealth event (latched health metrics of one sensor)
+typedef struct {
+	uint8_t  sensorIdx;	// Index of the sensor
+	uint8_t  flags;		// Health flags
+	uint16_t noiseRms;	// RMS noise floor in 0.1 raw counts
+	uint16_t errorRate;	// Errors per window
+	uint16_t satRate;	// Saturated values per window
+} fifoEventHealthPayload;
+// Payload of a fifoEventSync event (edge on the sync input or pulse on the sync output, see sync.c)
+typedef struct {
+	uint32_t sample;	// Index of the recorded sample (line) the edge follows
+	uint16_t fraction;	// Offset of the edge after that sample in 1/65536 of the sample interval
+	uint8_t  source;	// Sync input or output (see syncSources)
+	uint8_t  seq;		// Running number of the edges of this source (detects lost events)
+} fifoEventSyncPayload;
+// Payload of a fifoEventMarker event (marker set by the user while recording, see sync_marker). Also counted in the index (see recfmtIndexEntry.marks).
+#define FIFO_MARKER_LABEL_SIZE	10	// Characters of the label of a marker (zero terminated if shorter)
+enum fifoMarkerTypes{fifoMarkerNote=0, fifoMarkerSection, fifoMarkerSetup};
+typedef struct {
+	uint32_t sample;	// Index of the recorded sample (line) the marker follows
+	uint8_t  type;		// Type of the marker (see fifoMarkerTypes)
+	uint8_t  seq;		// Running number of the markers (detects lost events)
+	char     label[FIFO_MARKER_LABEL_SIZE];	// Short text of the marker
+} fifoEventMarkerPayload;
+extern volatile fifoEvent fifo_eventQueue[];
+volatile uint8_t fifo_eventHead;
+volatile uint8_t fifo_eventTail;
+
 /// BIN to CSV conversion
 // The header text to be written once at first line of CSV file. Must include all columns of all sensors! Do not add the "Time" column or the line break at the end (will be automatically added).
-#define RECORD_CSV_HEADER		"S1_RAW;S1_FILTERED;S1_CONVERTED;S1_EO;S2_RAW;S2_FILTERED;S2_CONVERTED;S2_EO"
+#define RECORD_CSV_HEADER		"S1_RAW;S1_FILTERED;S1_CONVERTED;S1_EO;S1_TRACKED;S1_VELOCITY;S1_ACCELERATION;S1_HEALTH;S2_RAW;S2_FILTERED;S2_CONVERTED;S2_EO;S2_TRACKED;S2_VELOCITY;S2_ACCELERATION;S2_HEALTH"
 // The 'sprintf' arguments that are used to generate the output string. Used repetitive for every sensor! Must match Header!
-#define RECORD_CSV_ARGUMENTS	sensArray[i]->bufRaw[sensArray[i]->bufIdx], sensArray[i]->bufFilter[sensArray[i]->bufIdx], sensArray[i]->bufConv[sensArray[i]->bufIdx], sensArray[i]->errorOccured
+#define RECORD_CSV_ARGUMENTS	sensArray[i]->bufRaw[sensArray[i]->bufIdx], SENS_GET_FILTER(sensArray[i], sensArray[i]->bufIdx), SENS_GET_CONV(sensArray[i], sensArray[i]->bufIdx), sensArray[i]->errorOccured, sensArray[i]->trackerState[0], sensArray[i]->bufVel[sensArray[i]->bufIdx], sensArray[i]->bufAcc[sensArray[i]->bufIdx], sensArray[i]->health.flags
 // The 'sprintf' format that is used to generate the output string. Used repetitive for every sensor! Must match Header!
-#define RECORD_CSV_FORMAT		"%d;%.1f;%.2f;%d"
+#define RECORD_CSV_FORMAT		"%d;%.1f;%.2f;%d;%.2f;%.3f;%.2f;%d"
+// Header and format of the event file (.EVT) written beside the CSV file. Time is the time of the event in the CSV time base, Sample the
+// line in the CSV file it follows and Fraction the offset after that line in 1/65536 of MEASUREMENT_INTERVAL (see fifoEventSyncPayload).
+// GAP events mark lost chunks of the .BIN file (Source CRC = corrupt, SEQ = missing, CUT = end of file cut, FRAME = packed frame not decodable, Seq = running number of the chunk or frame, see recfmt.h).
+// MARK events are the markers set while recording (Source = type NOTE, SECTION or SETUP, Label = its text, see fifoEventMarkerPayload).
+#define RECORD_EVT_HEADER		"Time;Event;Source;Seq;Sample;Fraction;Label"
+#define RECORD_EVT_FORMAT		"%.6f;%s;%s;%d;%lu;%u;%s"
+// Session index (.SES) beside the first .BIN file of a recording: one line per segment with its number, file, index of its first measurement
+// line and its start time in s. Lines have a fixed size (RECORD_SES_LINE_SIZE), so segment n is at strlen(RECORD_SES_HEADER)+1 + n*RECORD_SES_LINE_SIZE
+#define RECORD_SES_HEADER		"Seg;File        ;Sample    ;Time"
+#define RECORD_SES_FORMAT		"%3u;%-12s;%10lu;%12.3f"
+#define RECORD_SES_LINE_SIZE	(3+1+12+1+10+1+12+1)
 
 /*  MENU AND USER INTERFACE */
 // Data Acquisition Mode
@@ -126,6 +366,8 @@ sdStates sdState;
 #if defined (DEBUG_ENABLE)
 	extern void initialise_monitor_handles(void);
 	uint8_t menu_doScreenshot; // Record screenshot marker
+	#define SCREENSHOT_RGB565 1		// Format of a screenshot (see TFT_recordScreenshot): 1 = 16 bit RGB565 (half the size and read time), 0 = 32 bit ARGB8
+	#define SCREENSHOT_CHUNK (8*1024)	// Bytes of a screenshot read from the display with one burst and written at once (multiple of the sector size)
 #else
 	#define printf(...) { ; }
 #endif
@@ -138,5 +380,13 @@ void delay_ms(uint32_t ms); // Delay execution by given milliseconds - used in t
 
 float poly_calc (float c_x, float* f_coefficients, uint8_t order);
 float_buffer_t measure_movAvgFilter_clean(sensor* sens, uint16_t filterInterval, uint8_t compFilterOrder);
+void measure_tracker_setGains(sensor* sens);
+void measure_tracker_reset(sensor* sens);
+float measure_conv_evaluate(sensor* sens, float x, uint8_t withOffsets);
+void measure_conv_compile(sensor* sens);
+float measure_conv(sensor* sens, float x);
+void measure_lazy_fillRange(sensor* sens, uint16_t count);
+void measure_lazy_invalidate(sensor* sens);
+uint8_t fifo_event_enqueue(uint8_t type, const void* payload, uint8_t size);
 
 #endif /* GLOBALS_H_ */
@@ -18,6 +18,8 @@
 #include <measure.h>	// Everything related to the measurement, filtering and conversion of data by Rene Santeler
 #include <record.h>		// Everything related to SD-Card handling and read/write by Rene Santeler
 #include <tft.h> 		// Implementation of a display menu framework by Rene Santeler using the EVE Library of Rudolph Riedel
+#include <analyze.h>	// Analysis of the measured data in the main loop (e.g. ground speed) by Rene Santeler
+#include <sync.h>		// External sync input/output to align recordings by Rene Santeler
 
 // This file is kept as clean as possible. All variables and functions used by more than one component are stated in the 'globals' files.
 // See "globals" for details on how everything works together
@@ -25,6 +27,7 @@
 ///*  INTERRUPT HANDLER */
 // SysTick_Handler in "globals"
 // Adc_Measurement_Handler in "measure"
+// ERU1_3_IRQHandler in "sync"
 
 extern volatile uint8_t volatile * volatile fifo_buf;
 
@@ -67,8 +70,22 @@ int main(void)
 		sensors[i]->dp_x = (float*)malloc(1*sizeof(float));
 		// Load sensor calibration
 		record_readCalFile(sensors[i]);
+		// Empty long-horizon history (buckets without values aren't drawn)
+		measure_history_init(sensors[i]->history);
 	}
 
+	// Resume a conversion that was interrupted by a power cycle (if there is a progress marker on the SD-Card)
+	record_convertResume();
+
+	// Repair a recording that was interrupted by a power loss (and convert it after the resumed conversion)
+	record_recover();
+
+	// Initialize analysis (FFT tables)
+	analyze_init();
+
+	// Initialize sync input capture and sync output (must be done before the sample clock is started)
+	sync_init();
+
 	// Start ADC measurement interrupt routine
 	TIMER_Start(&TIMER_0);
 
@@ -87,22 +104,16 @@ int main(void)
 			#endif
 
 			/// RECORD HANDLING
-			// If recording mode is active and there is something to record (current block is finished) write block to SD-Card
+			// Marker if this tick is already used by the recording of a block
+			uint8_t blockRecorded = 0;
+
+			// If recording mode is active and there is something to record (current block is finished) write all finished blocks to SD-Card
 			if(measureMode == measureModeRecording && fifo_finBlock[fifo_recordBlock] == 1){
 				// Timing measurement pin high
 				DIGITAL_IO_SetOutputHigh(&IO_6_4);
 
-				// Record current block
-				record_block();
-
-				// Mark Block as processed (if a block isn't processed before the measurement handler tries to write to it again the record fails)
-				fifo_finBlock[fifo_recordBlock] = 0;
-
-				// Mark next block as current record block
-				fifo_recordBlock++;
-				// Overleap correction of the current block index
-				if(fifo_recordBlock == FIFO_BLOCKS)
-					fifo_recordBlock = 0;
+				// Record finished blocks (coalesced into as few writes as possible - might wait for the next block to align the write)
+				blockRecorded = (record_block(0) > 0);
 
 				// Timing measurement pin low
 				DIGITAL_IO_SetOutputLow(&IO_6_4);
@@ -111,6 +122,9 @@ int main(void)
 			else if(measureMode == measureModeRecordError)
 				// Stop recording
 				record_stop(1);
+			// If recording and no block is pending sync the file from time to time (crash safety, see RECORD_SYNC_INTERVAL)
+			else if(measureMode == measureModeRecording)
+				blockRecorded = record_sync();
 
 
 			/// Menu and HMI HANDLING
@@ -120,12 +134,23 @@ int main(void)
 			// Evaluate touches
 			TFT_touch(); // ~100us with no touch
 
+			// Pass the next sectors of queued block writes to the SD-card (the card writes them while the display is drawn)
+			if(measureMode == measureModeRecording)
+				record_writePoll(); // some 10us per sector the SDMMC host takes (see sdwrite_poll)
+
 			// Evaluate and rewrite display content
 			display_ticker++;
 			if(measurementCounter % 4 == 0) { // 4*5ms=20ms,  1/20ms=50Hz refresh rate
 				display_ticker = 0;
 				TFT_display(); // ~9000us at Monitoring, 800us at Dashboard(empty), 1440us at Setup
 			}
+			// Analysis of the measured data - only on ticks without display refresh or block record to not extend their time
+			else if(!blockRecorded){
+				analyze_tick(); // some 100us at most (see ANALYZE_XCORR_STAGES_PER_TICK)
+
+				// Convert some lines of a finished recording to CSV in the background
+				record_convertTick(); // some 100us at most (see RECORD_CONV_LINES_PER_TICK)
+			}
 
 			// Timing measurement pin low
 			DIGITAL_IO_SetOutputLow(&IO_6_6);
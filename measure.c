@@ -11,12 +11,14 @@
 #include <stdint.h>
 #include <malloc.h>
 #include <math.h>
+#include <string.h>
 #include "globals.h"
 #include "measure.h"
+#include "sync.h"
 
 /// Implemented in globals:
 // struct's: sensor
-// #define's: FIFO_LINE_SIZE_PAD, FIFO_BITS_ALL_BLOCK, FIFO_BITS_ONE_BLOCK, FIFO_BLOCKS, SENSOR_RAW_SIZE, SENSORS_SIZE and
+// #define's: FIFO_LINE_SIZE_PAD, FIFO_BITS_ALL_BLOCK, FIFO_BITS_ONE_BLOCK, FIFO_BLOCKS, FIFO_CHUNK_HEADER_SIZE, SENSOR_RAW_SIZE, SENSORS_SIZE and
 //            POSTPROCESS_INTERPOLATE_ERRORS or POSTPROCESS_CHANGEORDER_AT_ERRORS,
 //            INPUT_STANDARD or other STANDARD_...
 extern volatile uint8_t main_trigger;			// triggers main slope execution
@@ -27,39 +29,229 @@ extern volatile uint8_t volatile * volatile fifo_buf;	// FIFO buffer
 extern volatile uint16_t fifo_writeBufIdx;				// index in FIFO buffer
 extern volatile uint8_t fifo_writeBlock;				// current block to write
 extern volatile uint8_t fifo_finBlock[];				// array of which block is finished an can be recorded
+extern volatile fifoEvent fifo_eventQueue[];			// events to be written in-band to the FIFO
+extern volatile uint8_t fifo_eventHead;					// index of next event to be queued
+extern volatile uint8_t fifo_eventTail;					// index of next event to be written
 
 
 /// Implementation of an moving average filter on an ring-buffer. This version is very fast but it needs to be started on an 0'd out buffer and the filter interval sum must not be changed outside of this!!!
 /// If this gets out of sync, use the slow version measure_movAvgFilter_clean before using this again (globals.h).
-/// Note: This only subtracts the oldest and adds the newest entry to the stored sum before dividing.
-#define MEASURE_MOVAVGFILTER(sens, divider)                       				\
+/// Note: This only subtracts the oldest and adds the newest entry to the stored sum (the value is stored by MEASURE_FILTER_STORE in globals).
+#define MEASURE_MOVAVGSUM(sens)                       							\
 	/* Get index of oldest element, which shall be removed
 	 * (current index - filter interval with roll-over check) */					\
 	int32_t oldIdx = sens->bufIdx - sens->avgFilterInterval;					\
 	if(oldIdx < 0) oldIdx += sens->bufMaxIdx+1;									\
 	/* Subtract oldest element and add newest to sum */							\
-	sens->avgFilterSum += sens->bufRaw[sens->bufIdx] - sens->bufRaw[oldIdx];	\
-	/* Calculate average and return it */										\
-	sens->bufFilter[sens->bufIdx] = sens->avgFilterSum / divider;
+	sens->avgFilterSum += sens->bufRaw[sens->bufIdx] - sens->bufRaw[oldIdx];
+
+/// Convert a value with the conversion table of the sensor (calibration fit, motion ratio, offsets... see measure_conv_compile in globals)
+/// and store it to result. Linear interpolation between the two neighbouring table points, inputs outside of the table are extrapolated.
+#define MEASURE_LUTCONVERSION(sens, value, result)									\
+	{																				\
+		register float pos = (value) * (CONV_LUT_SEGMENTS/CONV_LUT_INPUT_MAX);	\
+		register int32_t seg = (int32_t)pos;										\
+		if(seg < 0) seg = 0;														\
+		if(seg > CONV_LUT_SEGMENTS-1) seg = CONV_LUT_SEGMENTS-1;					\
+		result = sens->convLut[seg] + (pos - seg) * (sens->convLut[seg+1] - sens->convLut[seg]);	\
+	}
+
+/// Update the rolling health metrics of the sensor with the newest raw value (before error handling changes it). A handful of operations per sample,
+/// the rates and flags are latched by measure_health_latch once every HEALTH_WINDOW samples.
+#define MEASURE_HEALTH(sens, raw)																\
+	/* Error and saturation count of the window */												\
+	if((raw) > sens->errorThreshold)															\
+		sens->health.errorCount++;																\
+	else{																						\
+		/* Noise floor: exponential average of the squared first difference (high-pass) */	\
+		register float diff = (float)(raw) - (float)sens->health.lastRaw;						\
+		sens->health.noiseVar += HEALTH_NOISE_ALPHA * (diff*diff - sens->health.noiseVar);		\
+	}																							\
+	if((raw) <= HEALTH_SAT_MARGIN || (raw) >= HEALTH_RAW_RAIL-HEALTH_SAT_MARGIN)				\
+		sens->health.satCount++;																\
+	/* Stuck: count successive samples without change */										\
+	if((raw) != sens->health.lastRaw)															\
+		sens->health.stuckCount = 0;															\
+	else if(sens->health.stuckCount != 0xFFFF)													\
+		sens->health.stuckCount++;																\
+	sens->health.lastRaw = (raw);																\
+	/* End of window */																			\
+	if(++sens->health.windowCount >= HEALTH_WINDOW)												\
+		measure_health_latch(sens);
+
+/// Add the newest raw value to the current bucket of the level 0 history (errors are counted as input but not as valid value).
+/// If the bucket is full it is stored and cascaded to the higher levels by measure_history_push.
+#define MEASURE_HISTORY(sens, raw)																\
+	if((raw) <= sens->errorThreshold){															\
+		historyLevel* lvl0 = sens->history;														\
+		if(lvl0->accCount == 0 || (raw) < lvl0->accMin) lvl0->accMin = (raw);					\
+		if(lvl0->accCount == 0 || (raw) > lvl0->accMax) lvl0->accMax = (raw);					\
+		lvl0->accSum += (raw);																	\
+		lvl0->accCount++;																		\
+	}																							\
+	if(++sens->history->accInputs >= sens->history->factor)										\
+		measure_history_push(sens->history, 0);
+
+/// Finish a line in the FIFO: overleap correction of the index and check for block end (lines are always a divider of the block size).
+/// The first FIFO_CHUNK_HEADER_SIZE bytes of every block are skipped (chunk header of the .BIN file, see recfmt.h).
+/// If the next block isn't recorded yet, the recording "crashes" and is stopped by the main loop (measureModeRecordError).
+#define MEASURE_FIFO_LINEEND()																	\
+	/* Overleap check and correction -> ignore all bits that are higher than the used ones */	\
+	fifo_writeBufIdx &= FIFO_BITS_ALL_BLOCK;													\
+	/* Check for block end -> happens if the index is a multiple of the block size (e.g. 1024)
+	 * -> for powers of 2 this is every time the bits representing e.g 1023 (001111111111) are all 1's
+	 * Note: This only holds if the block size is a power of 2!!! */								\
+	if((fifo_writeBufIdx & FIFO_BITS_ONE_BLOCK) == 0){ /*fifo_writeBufIdx % 1024 == 0*/		\
+		/* Mark current block as finished (ready to be written) */								\
+		fifo_finBlock[fifo_writeBlock] = 1;														\
+		/* Mark next block as current write block (with overleap correction) */				\
+		fifo_writeBlock++;																		\
+		if(fifo_writeBlock == FIFO_BLOCKS)														\
+			fifo_writeBlock = 0;																\
+		/* Leave space for the chunk header of the new block (filled by record_block) */		\
+		fifo_writeBufIdx += FIFO_CHUNK_HEADER_SIZE;												\
+		/* Check if the write block has been recorded, if not a "crash" occurs and the process must be stopped */	\
+		if(fifo_finBlock[fifo_writeBlock] == 1)													\
+			measureMode = measureModeRecordError;												\
+	}
+
+/// Fixed gain alpha-beta-gamma tracker. Predicts position, velocity and acceleration one interval ahead and corrects them with the
+/// weighted residual of the new measurement (gains see measure_tracker_setGains in globals). Takes constant time per sample and adds
+/// no lag like the average filter does. If the measurement is invalid (error) only the prediction is used, while the acceleration is
+/// dropped to avoid a runaway during longer dropouts. An invalid (NAN) position initializes the tracker to the measurement.
+#define MEASURE_ABGTRACKER(sens, measValue, measValid)											\
+	/* Predict state at current time */														\
+	sens->trackerState[0] += MEASURE_TRACKER_T * (sens->trackerState[1] + (0.5f*MEASURE_TRACKER_T) * sens->trackerState[2]);	\
+	sens->trackerState[1] += MEASURE_TRACKER_T * sens->trackerState[2];							\
+	if(measValid){																				\
+		/* Initialize to measurement if state is invalid (after reset) */						\
+		if(isnan(sens->trackerState[0])){														\
+			sens->trackerState[0] = (measValue);												\
+			sens->trackerState[1] = sens->trackerState[2] = 0.0f;								\
+		}																						\
+		/* Correct prediction with the weighted residual */										\
+		register float residual = (measValue) - sens->trackerState[0];							\
+		sens->trackerState[0] += sens->trackerGains[0] * residual;								\
+		sens->trackerState[1] += sens->trackerGains[1] * residual;								\
+		sens->trackerState[2] += sens->trackerGains[2] * residual;								\
+	}																							\
+	else																						\
+		sens->trackerState[2] = 0.0f;															\
+	/* Save velocity and acceleration */														\
+	sens->bufVel[sens->bufIdx] = sens->trackerState[1] * MEASURE_TRACKER_OUTPUT_SCALE;			\
+	sens->bufAcc[sens->bufIdx] = sens->trackerState[2] * MEASURE_TRACKER_OUTPUT_SCALE;
+
+/// Update the tracker with the current raw value converted by the table (no filter lag). Errors are represented by a 0 raw value.
+#define MEASURE_RAWTRACKER(sens)																\
+	{																							\
+		/* Convert current raw value */															\
+		register float measValue;																\
+		MEASURE_LUTCONVERSION(sens, sens->bufRaw[sens->bufIdx], measValue);						\
+		/* Update tracker and store velocity/acceleration */									\
+		MEASURE_ABGTRACKER(sens, measValue, (sens->bufRaw[sens->bufIdx] != 0));					\
+	}
+
+
+
+
+static void measure_history_push(historyLevel* history, uint8_t level){
+	/// Store the finished current bucket of the given history level to its ring buffer and add it to the current bucket of the level above
+	/// (which is stored as well if it is full). Called by MEASURE_HISTORY every HISTORY_FACTOR_0 samples, higher levels even less often.
+
+
+	historyLevel* lvl = &history[level];
 
-/// Compute filtered raw value to converted value and save it
-#define MEASURE_POLYCONVERSION(sens, sensBufIdx)			\
-	/* Value of sum and result are stored in register to
-	 *  enhance speed (multiple successive access). Use
-	 *  first coefficient (constant) as init value.*/		\
-	register float result = sens->fitCoefficients[0];		\
-	register float pow_x = 1;								\
-	/* Calculate every term and add it to the result*/		\
-	for(register uint8_t i = 1; i < sens->fitOrder+1; i++){	\
-		pow_x *= sens->bufFilter[sensBufIdx];				\
-		result += sens->fitCoefficients[i] * pow_x; 		\
-	}														\
-	/* Save result*/										\
-	sens->bufConv[sensBufIdx] = result;
+	// Store finished bucket (an empty bucket gets min > max)
+	uint16_t idx = lvl->idx + 1;
+	if(idx >= HISTORY_SIZE) idx = 0;
+	historyBucket* bucket = &lvl->buckets[idx];
+	if(lvl->accCount != 0){
+		bucket->min = lvl->accMin;
+		bucket->max = lvl->accMax;
+		bucket->mean = lvl->accSum / lvl->accCount;
+	}
+	else{
+		bucket->min = 0xFFFF;
+		bucket->max = bucket->mean = 0;
+	}
+	lvl->idx = idx;
+
+	// Add bucket to the current bucket of the next level
+	if(level+1 < HISTORY_LEVELS){
+		historyLevel* next = &history[level+1];
+		if(lvl->accCount != 0){
+			if(next->accCount == 0 || lvl->accMin < next->accMin) next->accMin = lvl->accMin;
+			if(next->accCount == 0 || lvl->accMax > next->accMax) next->accMax = lvl->accMax;
+			next->accSum += lvl->accSum;
+			next->accCount += lvl->accCount;
+		}
+		if(++next->accInputs >= next->factor)
+			measure_history_push(history, level+1);
+	}
 
+	// Reset current bucket
+	lvl->accInputs = lvl->accCount = 0;
+	lvl->accSum = 0;
+}
 
+void measure_history_init(historyLevel* history){
+	/// Mark all buckets of all history levels as empty (min > max, see measure_history_push), so buckets that weren't filled yet aren't drawn.
+	/// Must be called before the measurement handler is started.
 
 
+	for(uint8_t level = 0; level < HISTORY_LEVELS; level++){
+		historyLevel* lvl = &history[level];
+		for(uint16_t i = 0; i < HISTORY_SIZE; i++){
+			lvl->buckets[i].min = 0xFFFF;
+			lvl->buckets[i].max = lvl->buckets[i].mean = 0;
+		}
+		lvl->idx = lvl->accInputs = lvl->accCount = 0;
+		lvl->accSum = 0;
+	}
+}
+
+static void measure_health_latch(volatile sensor* sens){
+	/// Latch the health metrics of the current window into rates and flags, reset the window and queue a health event if recording.
+	/// Called by MEASURE_HEALTH once every HEALTH_WINDOW samples (not inline to keep the measurement handler small).
+	///
+	///	Uses globals variables: HEALTH_[...], measureMode
+
+
+	// Latch rates and noise floor
+	sens->health.errorRate = sens->health.errorCount;
+	sens->health.satRate = sens->health.satCount;
+	sens->health.noiseRms = sqrtf(0.5f * sens->health.noiseVar);
+
+	// Set flags
+	uint8_t flags = 0;
+	if(sens->health.noiseRms > HEALTH_NOISE_MAX)			flags |= healthNoise;
+	if(sens->health.errorRate > HEALTH_ERRORRATE_MAX)		flags |= healthDropout;
+	if(sens->health.stuckCount >= HEALTH_STUCK_SAMPLES)		flags |= healthStuck;
+	if(sens->health.satRate > HEALTH_SATRATE_MAX)			flags |= healthSaturation;
+	sens->health.flags = flags;
+
+	// Reset window
+	sens->health.windowCount = sens->health.errorCount = sens->health.satCount = 0;
+
+#if MEASURE_LAZY_CONVERSION == 1
+	// Latch share of samples that didn't need to be filtered/converted in this window
+	sens->lazySkipped = (sens->lazyComputed < HEALTH_WINDOW) ? 100 - (sens->lazyComputed * 100) / HEALTH_WINDOW : 0;
+	sens->lazyComputed = 0;
+#endif
+
+	// Store metrics in recording
+	if(measureMode == measureModeRecording){
+		fifoEventHealthPayload payload = {
+			.sensorIdx = sens->index,
+			.flags = flags,
+			.noiseRms = (sens->health.noiseRms < 6553.0f) ? (uint16_t)(sens->health.noiseRms*10.0f) : 0xFFFF,
+			.errorRate = sens->health.errorRate,
+			.satRate = sens->health.satRate
+		};
+		fifo_event_enqueue(fifoEventHealth, &payload, sizeof(payload));
+	}
+}
+
 void measure_IRQ_handler(void){
 	/// Interrupt handler - Do measurements, filter/convert them and store result in buffers. Allows to 'measure' self produced test signal based on value in global variable InputType
 	/// Start Timer after init and make sure initial conversion in ADC_MEASUREMENT APP is deactivated
@@ -69,6 +261,9 @@ void measure_IRQ_handler(void){
 	// Timing measurement pin high
 	DIGITAL_IO_SetOutputHigh(&IO_6_2_TIMING);
 
+	// Period match of this sample is handled (tells the sync input which sample a captured edge follows, see sync_capture_IRQ_handler)
+	XMC_CCU4_SLICE_ClearEvent(TIMER_0.ccu4_slice_ptr, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+
 
 	// Check
 	uint8_t sensIdx = 0;
@@ -114,14 +309,30 @@ void measure_IRQ_handler(void){
 			// Store raw value
 			sens->bufRaw[sensBufIdx] = bufRaw;
 
+			// Update health metrics of the sensor
+			MEASURE_HEALTH(sens, bufRaw);
+
+			// Update long-horizon history of the sensor
+			MEASURE_HISTORY(sens, bufRaw);
+
+#if MEASURE_LAZY_CONVERSION == 1
+			// Memoized filtered/converted value of this index is outdated now (see measure_lazy_fillRange)
+			sens->lazyValid[sensBufIdx >> 5] &= ~(1UL << (sensBufIdx & 31));
+#endif
+
 
 			// (Consideration) Everything past here could be moved to the main slope. It would require a "last processed value" index and had to process every missed value between. The interrupt here would get much shorter though...
 
 
 			// If system is in monitoring mode, filter/convert row values and fill corresponding buffers (+ error recognition)
 			if(measureMode == measureModeMonitoring){
+#if MEASURE_LAZY_CONVERSION == 1
+				// Error handling and tracker only - filtered/converted values are calculated on demand
+				measure_postProcessingLazy(sens);
+#else
 				// Error handling and calculation of raw/filtered/converted value
 				measure_postProcessing(sens);
+#endif
 			}
 			// If system is in recording mode store current raw value in FIFO
 			else if(measureMode == measureModeRecording){
@@ -142,26 +353,34 @@ void measure_IRQ_handler(void){
 	if(measureMode == measureModeRecording){
 		// Ignore rest of space on the current "line" defined by FIFO_LINE_SIZE. This is done to have the values of a measurement line inside a defined width, which must be a divider of the block size (a block must perfectly be fillable with n lines!)
 		fifo_writeBufIdx += FIFO_LINE_SIZE_PAD;
-
-		// Overleap check and correction -> ignore all bits that are higher than the used ones
-		fifo_writeBufIdx &= FIFO_BITS_ALL_BLOCK;
-
-		// Check for block end -> happens if the index is a multiple of the block size (e.g. 1024)
-		// -> for powers of 2 this is every time the bits representing e.g 1023 (001111111111) are all 1's
-		// Note: This only holds if the block size is a power of 2!!!
-		if((fifo_writeBufIdx & FIFO_BITS_ONE_BLOCK) == 0){ //fifo_writeBufIdx % 1024 == 0
-			// Mark current block as finished (ready to be written)
-			fifo_finBlock[fifo_writeBlock] = 1;
-			// Mark next block as current write block
-			fifo_writeBlock++;
-			// Overleap correction of the current block index
-			if(fifo_writeBlock == FIFO_BLOCKS)
-				fifo_writeBlock = 0;
-			// Check if the write block has been recorded, if not a "crash" occurs and the process must be stopped
-			if(fifo_finBlock[fifo_writeBlock] == 1){
-				// Stop recording
-				measureMode = measureModeRecordError;
+		MEASURE_FIFO_LINEEND();
+
+		// Count recorded sample and generate sync output pulse (see sync.c)
+		sync_outputTick();
+
+		// Write one queued event (header line followed by its payload lines) - see fifo_event_enqueue.
+		// An event is never split over two blocks (every block can be encoded on its own, see RECORD_CODEC) - if it doesn't fit it waits for the next block.
+		if(fifo_eventHead != fifo_eventTail && measureMode == measureModeRecording &&
+		   (FIFO_BLOCK_SIZE - (fifo_writeBufIdx & FIFO_BITS_ONE_BLOCK)) >= (1 + fifo_eventQueue[fifo_eventTail].lines)*FIFO_LINE_SIZE){
+			volatile fifoEvent* ev = &fifo_eventQueue[fifo_eventTail];
+
+			// Header line: marker, type and number of payload lines
+			memset((void*)(fifo_buf + fifo_writeBufIdx), 0, FIFO_LINE_SIZE);
+			*(int_buffer_t*)(fifo_buf + fifo_writeBufIdx) = FIFO_EVENT_MARKER;
+			fifo_buf[fifo_writeBufIdx + SENSOR_RAW_SIZE] = ev->type;
+			fifo_buf[fifo_writeBufIdx + SENSOR_RAW_SIZE + 1] = ev->lines;
+			fifo_writeBufIdx += FIFO_LINE_SIZE;
+			MEASURE_FIFO_LINEEND();
+
+			// Payload lines
+			for(uint8_t l = 0; l < ev->lines && measureMode == measureModeRecording; l++){
+				memcpy((void*)(fifo_buf + fifo_writeBufIdx), (void*)&ev->payload[l*FIFO_LINE_SIZE], FIFO_LINE_SIZE);
+				fifo_writeBufIdx += FIFO_LINE_SIZE;
+				MEASURE_FIFO_LINEEND();
 			}
+
+			// Remove event from queue
+			fifo_eventTail = (fifo_eventTail + 1) & (FIFO_EVENT_QUEUE_SIZE-1);
 		}
 	}
 
@@ -185,20 +404,13 @@ void measure_IRQ_handler(void){
 
 
 
-void measure_postProcessing(volatile sensor* sens){
-	/// Uses the raw buffer and current raw-value to detect errors, filter the data and convert. The processing of the
-	/// filtered and converted value is designed to be fast and accurate enough for monitoring. However for actual
-	/// precise results the raw value must be post-processed externally! The error handling is somewhat complicated
-	/// and can be controlled by global defined macros. In this context this is only necessary because the filter would
-	/// otherwise get confused by faulty values. This also allows "clear" lines to be printed to on the monitoring graph.
-	///
-	/// Input: Takes the array of sensors to be processed. Make sure the newest raw is already in buffer.
-	///
-	///	 Uses measure-global macros:
-	///		MEASURE_MOVAVGFILTER, MEASURE_POLYCONVERSION
+static int16_t measure_errorHandling(volatile sensor* sens){
+	/// Error handling of the newest raw value, shared by measure_postProcessing and measure_postProcessingLazy (both ways treat errors identically).
+	/// The way is chosen by the global macros POSTPROCESS_CHANGEORDER_AT_ERRORS and POSTPROCESS_INTERPOLATE_ERRORS.
+	/// Returns the number of valid values in the filter interval (divider of the moving average)
 	///
 	///	 Uses global variables macros:
-	///		POSTPROCESS_CHANGEORDER_AT_ERRORS, POSTPROCESS_INTERPOLATE_ERRORS, POSTPROCESS_BUGGED_VALUES
+	///		POSTPROCESS_CHANGEORDER_AT_ERRORS, POSTPROCESS_INTERPOLATE_ERRORS, MEASURE_LAZY_CONVERSION
 
 
 #if POSTPROCESS_CHANGEORDER_AT_ERRORS == 1
@@ -250,28 +462,35 @@ void measure_postProcessing(volatile sensor* sens){
 	/// struct must be recorded as well!
 
 	// Filter interval is never changed with this approach
-	static int16_t compFilterInterval = sens->avgFilterInterval;
+	int16_t compFilterInterval = sens->avgFilterInterval;
 
 	/// Check if newest value in filter interval (to be added) is an error
-	if(sens->bufRaw[sensBufIdx] > sens->errorThreshold){
+	if(sens->bufRaw[sens->bufIdx] > sens->errorThreshold){
 		// Mark current measurement as error
 		sens->errorOccured++;
 
 		// Calculate last index and check for over leap
-		int32_t pre1Idx = sensBufIdx - 1;
+		int32_t pre1Idx = sens->bufIdx - 1;
 		if(pre1Idx < 0) pre1Idx += sens->bufMaxIdx + 1;
 
 		// If this is the the first error after an valid value, calculate/store last OK value and slope for linear interpolation
 		if(sens->errorOccured == 1){
 			// Calculate second to last index and check for over leap
-			int32_t pre2Idx = sensBufIdx - 2;
+			int32_t pre2Idx = sens->bufIdx - 2;
 			if(pre2Idx < 0) pre2Idx += sens->bufMaxIdx + 1;
 
+#if MEASURE_LAZY_CONVERSION == 1
+			// The filtered values of the last two samples are needed (lazy conversion - fill them, the wrong value of this index is invalidated below)
+			measure_lazy_fillRange((sensor*)sens, 3);
+#endif
 			// Store last valid value and slope, to be used till the next valid value comes
-			sens->errorLastValid = sens->bufFilter[pre1Idx] - sens->bufFilter[pre2Idx];
+			sens->errorLastValid = SENS_GET_FILTER(sens, pre1Idx) - SENS_GET_FILTER(sens, pre2Idx);
 		}
 		// Linear interpolation of current value (needed to satisfy filter, otherwise the missing value would interfere for [avgFilterOrder] measurements)
-		sens->bufRaw[sensBufIdx] = sens->bufRaw[pre1Idx] + sens->errorLastValid;
+		sens->bufRaw[sens->bufIdx] = sens->bufRaw[pre1Idx] + sens->errorLastValid;
+#if MEASURE_LAZY_CONVERSION == 1
+		sens->lazyValid[sens->bufIdx >> 5] &= ~(1UL << (sens->bufIdx & 31));
+#endif
 	}
 	else {
 		sens->errorOccured = 0;
@@ -280,28 +499,53 @@ void measure_postProcessing(volatile sensor* sens){
 #error "Error: Global macro POSTPROCESS_INTERPOLATE_ERRORS or POSTPROCESS_CHANGEORDER_AT_ERRORS must be set to 1!"
 #endif
 
-	/// Post processing: Calculate filtered/converted value and fill corresponding buffers
-#if POSTPROCESS_BUGGED_VALUES == 1
-	// Always calculate filtered and converted value if possible (even if current value was an error)
-	if(compFilterInterval){
-#else
-	// Only calculate filtered and converted value if no error are in filter interval
-	if(compFilterInterval && sens->bufRaw[sens->bufIdx] != 0){
-#endif
-		// Set current filter value
-		MEASURE_MOVAVGFILTER(sens, compFilterInterval);
+	return compFilterInterval;
+}
 
-		// Set current converted value
-		MEASURE_POLYCONVERSION(sens, sens->bufIdx);
-	}
-	// compFilterOrder is 0 - no data available
-	else{
-		// Set current filter value to 0 (current value is unusable)
-		MEASURE_MOVAVGFILTER(sens, 1); // Only to keep sum up to date - result must be ignored
-		sens->bufFilter[sens->bufIdx] = 0;
+void measure_postProcessing(volatile sensor* sens){
+	/// Uses the raw buffer and current raw-value to detect errors, filter the data and convert. The processing of the
+	/// filtered and converted value is designed to be fast and accurate enough for monitoring. However for actual
+	/// precise results the raw value must be post-processed externally! The error handling is somewhat complicated
+	/// and can be controlled by global defined macros. In this context this is only necessary because the filter would
+	/// otherwise get confused by faulty values. This also allows "clear" lines to be printed to on the monitoring graph.
+	///
+	/// Input: Takes the array of sensors to be processed. Make sure the newest raw is already in buffer.
+	///
+	///	 Uses measure-global macros:
+	///		MEASURE_MOVAVGSUM, MEASURE_FILTER_STORE, MEASURE_ABGTRACKER
+	///
+	///	 Uses global variables macros:
+	///		POSTPROCESS_CHANGEORDER_AT_ERRORS, POSTPROCESS_INTERPOLATE_ERRORS, POSTPROCESS_BUGGED_VALUES
 
-		// Set current converted value to 0 (current value is unusable)
-		sens->bufConv[sens->bufIdx] = 0;
-	}
+
+	// Error handling (errors are nulled or interpolated) and number of valid values in the filter interval
+	int16_t compFilterInterval = measure_errorHandling(sens);
+
+	/// Post processing: Calculate filtered/converted value and fill corresponding buffers (the moving sum is always kept up to date, the values are
+	/// 0 if compFilterInterval is 0 - or the current value is an error and POSTPROCESS_BUGGED_VALUES isn't set, see MEASURE_FILTER_STORE)
+	MEASURE_MOVAVGSUM(sens);
+	MEASURE_FILTER_STORE(sens, sens->bufIdx, sens->avgFilterSum, compFilterInterval);
+
+	/// Tracker: Uses the converted unfiltered raw value (no filter lag) - errors are represented by a 0 raw value
+	MEASURE_RAWTRACKER(sens);
+}
+
+void measure_postProcessingLazy(volatile sensor* sens){
+	/// Reduced post processing used with MEASURE_LAZY_CONVERSION. Only handles errors (the same way as measure_postProcessing) and
+	/// updates the tracker, which needs every sample in order. The filtered and converted values are calculated on demand by
+	/// measure_lazy_fillRange (globals) for the samples that are actually used by the menus. The valid bit of the index is already
+	/// cleared by the measurement handler.
+	///
+	/// Input: Takes the sensor to be processed. Make sure the newest raw is already in buffer.
+	///
+	///	 Uses measure-global macros:
+	///		MEASURE_RAWTRACKER
+
+
+	// Error handling like measure_postProcessing (nulled errors are excluded from the average at the fill)
+	measure_errorHandling(sens);
+
+	// Tracker: Uses the converted unfiltered raw value (no filter lag)
+	MEASURE_RAWTRACKER(sens);
 }
 
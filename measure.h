@@ -14,5 +14,7 @@ extern volatile uint8_t* volatile fifo_buf;
 void measure_IRQ_handler(void);
 
 void measure_postProcessing(volatile sensor* sens);
+void measure_postProcessingLazy(volatile sensor* sens);
+void measure_history_init(historyLevel* history);
 
 #endif /* MEASURE_H_ */
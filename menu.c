@@ -18,6 +18,8 @@
 #include "polyfit/polyfit.h"
 #include "record.h"
 #include "menu.h"
+#include "analyze.h"
+#include "sync.h"
 
 
 
@@ -146,6 +148,13 @@ menu* menu_objects[TFT_MENU_SIZE] = {&menu_0monitor, &menu_1dashboard, &menu_2se
 #define TEXTBOX_PAD_V 8		// offset of the text from vertical border in pixel
 #endif
 
+// Graph of a filtered/converted buffer of a sensor (float or fixed-point storage, see MEASURE_FIXED_BUFFERS)
+#if MEASURE_FIXED_BUFFERS == 1
+#define MENU_GRAPH_CONVBUFFER(gph, buf, fmt, buf_size, buf_curidx, datacolor) TFT_graph_pixeldata_fixed(gph, buf, buf_size, buf_curidx, fmt, datacolor)
+#else
+#define MENU_GRAPH_CONVBUFFER(gph, buf, fmt, buf_size, buf_curidx, datacolor) TFT_graph_pixeldata_f(gph, buf, buf_size, buf_curidx, datacolor)
+#endif
+
 /////////// Debug
 uint16_t display_list_size = 0; // Current size of the display-list from register. Used by the TFT_display() menu specific functions
 uint32_t tracker = 0; // Value of tracker register (1.byte=tag, 2.byte=value). Used by the TFT_display() menu specific functions
@@ -156,6 +165,22 @@ float_buffer_t r_deflection = 0.0;
 
 int16_t record_time = 0;
 
+// Ground speed and its confidence estimated by front/rear cross-correlation (see analyze)
+float dash_speed = 0.0;
+float dash_speedConfidence = 0.0;
+
+// Session averages of damping ratio and natural frequency of the front and rear suspension (see analyze)
+float dash_dampZeta[2] = {0.0, 0.0};
+float dash_dampFn[2] = {0.0, 0.0};
+
+// Share of samples whose filtered/converted value never had to be calculated (lazy conversion, shown in the header of every main menu)
+label lbl_lazyStats = {
+		.x = 470,		.y = 3,
+		.font = 20,		.options = EVE_OPT_RIGHTX,	.text = "",
+		.ignoreScroll = 1,
+		.numSrc.srcType = srcTypeNone
+};
+
 
 
 
@@ -173,18 +198,31 @@ uint8_t inputType = 0;
 
 #define BTN_INPUT_TAG 13
 control btn_input = {
-	.x = 180,		.y = 17,
-	.w0 = 70,		.h0 = 30,
+	.x = 175,		.y = 17,
+	.w0 = 65,		.h0 = 30,
 	.mytag = BTN_INPUT_TAG,	.font = 27, .options = 0, .state = 0,
 	.text = "Raw1",
 	.controlType = Button,
 	.ignoreScroll = 1
 };
 
+// Time window of the monitoring graph. 0 = live buffer (2.2s), every further window shows one level of the long-horizon history (see historyLevel)
+#define MENU_MONITOR_WINDOWS (HISTORY_LEVELS+1)
+uint8_t monitorWindow = 0;
+#define BTN_WINDOW_TAG 14
+control btn_window = {
+	.x = 245,		.y = 17,
+	.w0 = 45,		.h0 = 30,
+	.mytag = BTN_WINDOW_TAG,	.font = 26, .options = 0, .state = 0,
+	.text = "2.2s",
+	.controlType = Button,
+	.ignoreScroll = 1
+};
+
 #define BTN_GRAPHMODE_TAG 12
 control tgl_graphMode = {
-	.x = 270,		.y = 26,
-	.w0 = 60,		.h0 = 27,
+	.x = 300,		.y = 26,
+	.w0 = 50,		.h0 = 27,
 	.mytag = BTN_GRAPHMODE_TAG,	.font = 27, .options = 0, .state = 0,
 	.text = "Frame",
 	.controlType = Toggle,
@@ -312,6 +350,150 @@ label lbl_dash_r_d = { //deflection rear value
 		.fracExp = 0
 };
 
+label lbl_dash_speed = { //ground speed
+		.x = M_COL_1,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2),
+		.font = 27,		.options = 0,		.text = "Speed",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeNone,
+		.numSrc.floatSrc = NULL,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+label lbl_dash_speed_val = { //ground speed value
+		.x = M_COL_1 + 170,			.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2),
+		.font = 27,		.options = EVE_OPT_RIGHTX,		.text = "%d km/h",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_speed,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+label lbl_dash_speedConf = { //confidence of ground speed
+		.x = M_COL_1,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*3) - 10,
+		.font = 26,		.options = 0,		.text = "Correlation",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeNone,
+		.numSrc.floatSrc = NULL,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+label lbl_dash_speedConf_val = { //confidence of ground speed value
+		.x = M_COL_1 + 170,			.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*3) - 10,
+		.font = 26,		.options = EVE_OPT_RIGHTX,		.text = "%d.%.2d",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_speedConfidence,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 2
+};
+
+label lbl_dash_damp = { //damping ratio
+		.x = 200,					.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2),
+		.font = 26,		.options = 0,		.text = "Damp. F/R",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeNone,
+		.numSrc.floatSrc = NULL,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+label lbl_dash_damp_f = { //damping ratio front value
+		.x = 200 + 95,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2),
+		.font = 26,		.options = EVE_OPT_RIGHTX,		.text = "%d.%.2d",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_dampZeta[0],
+		.numSrc.srcOffset = NULL,
+		.fracExp = 2
+};
+label lbl_dash_damp_r = { //damping ratio rear value
+		.x = 200 + 140,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2),
+		.font = 26,		.options = EVE_OPT_RIGHTX,		.text = "%d.%.2d",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_dampZeta[1],
+		.numSrc.srcOffset = NULL,
+		.fracExp = 2
+};
+label lbl_dash_dampFn = { //natural frequency
+		.x = 200,					.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*3) - 10,
+		.font = 26,		.options = 0,		.text = "fn F/R",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeNone,
+		.numSrc.floatSrc = NULL,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+label lbl_dash_dampFn_f = { //natural frequency front value
+		.x = 200 + 85,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*3) - 10,
+		.font = 26,		.options = EVE_OPT_RIGHTX,		.text = "%d.%.1d",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_dampFn[0],
+		.numSrc.srcOffset = NULL,
+		.fracExp = 1
+};
+label lbl_dash_dampFn_r = { //natural frequency rear value
+		.x = 200 + 145,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*3) - 10,
+		.font = 26,		.options = EVE_OPT_RIGHTX,		.text = "%d.%.1d Hz",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeFloat,
+		.numSrc.floatSrc = (float_buffer_t*)&dash_dampFn[1],
+		.numSrc.srcOffset = NULL,
+		.fracExp = 1
+};
+
+label lbl_dash_conv = { //progress of the background conversion of the last recording (text see menu_display_1dash)
+		.x = M_COL_1,				.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*4) - 10,
+		.font = 26,		.options = 0,		.text = "",
+		.ignoreScroll = 0,
+		.numSrc.srcType = srcTypeNone,
+		.numSrc.floatSrc = NULL,
+		.numSrc.srcOffset = NULL,
+		.fracExp = 0
+};
+#define BTN_CONVCANCEL_TAG 11
+control btn_convCancel = {
+	.x = 350,	.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*4) - 20,
+	.w0 = 90,		.h0 = 40,
+	.mytag = BTN_CONVCANCEL_TAG,	.font = 27,	.options = 0, .state = 0,
+	.text = "Cancel",
+	.controlType = Button,
+	.ignoreScroll = 1
+};
+
+#define BTN_MARK_TAG 12
+control btn_mark = { //sets a marker in the recording (only shown while recording, see sync_marker)
+	.x = 350,	.y = M_UPPER_PAD + M_1_UPPERBOND + (M_ROW_DIST*2) + 22,
+	.w0 = 90,		.h0 = 34,
+	.mytag = BTN_MARK_TAG,	.font = 27,	.options = 0, .state = 0,
+	.text = "Mark",
+	.controlType = Button,
+	.ignoreScroll = 1
+};
+static uint8_t dash_marks = 0; // Markers set with btn_mark in the current recording
+#define BTN_MARKTYPE_TAG 13
+control btn_markType = { //cycles the type of the markers set with btn_mark (only shown while recording)
+	.x = 350,	.y = M_UPPER_PAD + M_1_UPPERBOND + (M_ROW_DIST*2) - 16,
+	.w0 = 40,		.h0 = 30,
+	.mytag = BTN_MARKTYPE_TAG,	.font = 26,	.options = 0, .state = 0,
+	.text = "",
+	.controlType = Button,
+	.ignoreScroll = 1
+};
+#define BTN_MARKLABEL_TAG 14
+control btn_markLabel = { //cycles the preset label of the markers set with btn_mark (only shown while recording)
+	.x = 394,	.y = M_UPPER_PAD + M_1_UPPERBOND + (M_ROW_DIST*2) - 16,
+	.w0 = 46,		.h0 = 30,
+	.mytag = BTN_MARKLABEL_TAG,	.font = 26,	.options = 0, .state = 0,
+	.text = "",
+	.controlType = Button,
+	.ignoreScroll = 1
+};
+static const char* dash_markTypeNames[] = {"Note", "Sect", "Setup"};	// Short names of fifoMarkerTypes (shown on btn_markType)
+static const char* dash_markLabels[] = SYNC_MARK_BTN_LABELS;		// Preset labels of btn_mark (shown on btn_markLabel)
+static uint8_t dash_markType = SYNC_MARK_BTN_TYPE;	// Type of the next marker of btn_mark (see fifoMarkerTypes)
+static uint8_t dash_markLabel = 0;					// Index of the label of the next marker of btn_mark in dash_markLabels
+
 
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -368,6 +550,11 @@ label lbl_curveset_S1 = {
 		.font = 26,		.options = 0,		.text = "Curve fit:",
 		.ignoreScroll = 0
 };
+label lbl_health_S1 = { // health status of sensor 1 (text is set at display)
+		.x = M_COL_1,	.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2) + FONT_COMP*1,
+		.font = 26,		.options = 0,		.text = "",
+		.ignoreScroll = 0
+};
 #define BTN_CURVESET_S1_TAG 22
 control btn_curveset_S1 = {
 	.x = 270,	.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*2) - TEXTBOX_PAD_V + FONT_COMP*1,
@@ -414,6 +601,11 @@ label lbl_curveset_S2 = {
 		.font = 26,		.options = 0,		.text = "Curve fit:",
 		.ignoreScroll = 0
 };
+label lbl_health_S2 = { // health status of sensor 2 (text is set at display)
+		.x = M_COL_1,	.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*4) + FONT_COMP*1,
+		.font = 26,		.options = 0,		.text = "",
+		.ignoreScroll = 0
+};
 #define BTN_CURVESET_S2_TAG 25
 control btn_curveset_S2 = {
 	.x = 270,	.y = M_UPPER_PAD + M_SETUP_UPPERBOND + (M_ROW_DIST*4) - TEXTBOX_PAD_V + FONT_COMP*1,
@@ -820,6 +1012,7 @@ void filterset_setEditMode(uint8_t editMode);
 // Pointer to the currently being recorded sensor - set at prepare and e.g. used when getting the nominal value at display function or storing of the fit values
 sensor*  filterset_sens = NULL;
 uint16_t filter_errorThreshold = 4095;
+float filter_trackerTheta = MEASURE_TRACKER_THETA_DEFAULT;
 
 label lbl_filterset = {
 		.x = 20,		.y = 9,
@@ -848,7 +1041,7 @@ graph gph_filterset = {
 	.x = 10,		// 10 px from left to leave some room
 	.y = 30 + M_UPPER_PAD,		// end of banner plus 10 to leave some room  (e.g. for Y1=66: 66+15=81)
 	.width  = (0 + EVE_HSIZE - 10 - (2*G_PADDING) - 10),		// actual width of the data area, therefore x and the paddings left and right must me accommodated to "fill" the whole main area. Additional 10 px from right to leave some room (for 480x272: 480-10-20-10=440)
-	.height = (0 + EVE_VSIZE - 15 - (2*G_PADDING) - 10 - (M_ROW_DIST*2)), 	// actual height of the data area, therefore y and the paddings top and bottom must me accommodated to "fill" the whole main area. Additional 10 px from bottom to leave some room (for 480x272: 272-66+15-20-10=161)
+	.height = (0 + EVE_VSIZE - 15 - (2*G_PADDING) - 10 - (M_ROW_DIST*3)), 	// actual height of the data area, therefore y and the paddings top and bottom must me accommodated to "fill" the whole main area. Additional 10 px from bottom to leave some room. Two rows of controls are below.
 	.padding = G_PADDING,
 	.x_label = "time",
 	.y_label = "ADC values",
@@ -941,6 +1134,28 @@ textbox tbx_error_threshold = {
 	.numSrc.srcOffset = NULL,
 	.numSrcFormat = "%d"
 };
+#define STR_TRACKER_THETA_MAXLEN 5
+char str_tracker_theta[STR_TRACKER_THETA_MAXLEN] = "0.80";
+uint8_t str_tracker_theta_curLength = 4;
+#define TBX_FILTER_TRACKER_THETA_TAG 26
+textbox tbx_tracker_theta = {
+	.x = M_COL_1,
+	.y = EVE_VSIZE - M_UPPER_PAD - (M_ROW_DIST*2) + 5,
+	.width = 55,
+	.labelOffsetX = 145,
+	.labelText = "Tracker smoothing:",
+	.mytag = 0,
+	.text = str_tracker_theta,
+	.text_maxlen = STR_TRACKER_THETA_MAXLEN,
+	.text_curlen = &str_tracker_theta_curLength,
+	.keypadType = Numeric,
+	.active = 0,
+	.numSrc.srcType = srcTypeFloat,
+	.numSrc.floatSrc = &filter_trackerTheta,
+	.numSrc.srcOffset = NULL,
+	.numSrcFormat = "%d.%.2d",
+	.fracExp = 2
+};
 
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //		End of Element definition         ----------------------------------------------------------------------------------------------------------------------------------
@@ -964,39 +1179,78 @@ textbox tbx_error_threshold = {
 #ifdef DEBUG_ENABLE
 void TFT_recordScreenshot(void){
 	/// Create a screenshot and write it to sd-card
+	/// The snapshot is read from the display memory in bursts of SCREENSHOT_CHUNK bytes that are written to the file at once (sector aligned, see record_openBMP).
+	/// A running recording is served between the chunks like in the main loop, so no FIFO block is lost.
 	printf("Making screenshot\n");
-	// Open/create bmp file
-	uint8_t openOK = record_openBMP("SC.BMP");
-	if (openOK == 1){
-		// Number of pixels an bytes
-		#define SS_PIXELS (EVE_HSIZE * EVE_VSIZE)
-		#define SS_BYTES (SS_PIXELS * 4) // 32 bit
+	uint32_t start = SYSTIMER_GetTime();
+
+	// Number of bits per pixel and bytes
+	#if SCREENSHOT_RGB565 == 1
+		#define SS_BITS 16
+	#else
+		#define SS_BITS 32
+	#endif
+	#define SS_BYTES (EVE_HSIZE * EVE_VSIZE * (SS_BITS/8))
 
+	// Open/create bmp file and get a buffer for the chunks
+	uint8_t* buf = (uint8_t*)malloc(SCREENSHOT_CHUNK);
+	uint8_t openOK = (buf != NULL) ? record_openBMP("SC.BMP", EVE_HSIZE, EVE_VSIZE, SS_BITS) : 0;
+	if (openOK == 1){
 		// Create Screenshot in display memory
-		EVE_cmd_snapshot2(0x20, 0, 0, 0, EVE_HSIZE*2, EVE_VSIZE);
+		#if SCREENSHOT_RGB565 == 1
+			EVE_cmd_snapshot2(EVE_RGB565, 0, 0, 0, EVE_HSIZE, EVE_VSIZE);
+		#else
+			EVE_cmd_snapshot2(0x20, 0, 0, 0, EVE_HSIZE*2, EVE_VSIZE); // ARGB8 needs twice the width
+		#endif
 
-		// Get pixel per pixel (32bit) from display and write it to sd-card
+		// Read chunk by chunk from display and write it to sd-card
 		printf("Writing screenshot\n");
-		uint32_t bmp = 0;
-		for (uint32_t i = 0; i < SS_PIXELS; i++) {
-			bmp = EVE_memRead32(0 + (i*4));
-			record_writeBMP(&bmp, 4);
-			if(i % 1000 == 0)
-				printf("%d\n", (int)i);
+		for (uint32_t pos = 0; pos < SS_BYTES; pos += SCREENSHOT_CHUNK) {
+			uint32_t size = (SS_BYTES - pos < SCREENSHOT_CHUNK) ? SS_BYTES - pos : SCREENSHOT_CHUNK;
+			EVE_memRead_buffer(0 + pos, buf, size);
+			record_writeBMP((uint32_t*)buf, size);
+
+			// Keep a running recording going (record finished blocks or sync)
+			if(measureMode == measureModeRecording && fifo_finBlock[fifo_recordBlock] == 1)
+				record_block(0);
+			else if(measureMode == measureModeRecording)
+				record_sync();
 		}
-		printf("Finished\n");
 
 		// Close bmp file
 		record_closeBMP();
+		printf("Finished: %lu bytes in %lu ms\n", (uint32_t)SS_BYTES, (SYSTIMER_GetTime() - start)/1000);
 
 		// Refresh display
 		TFT_setMenu(-1);
 	}
 	else
 		printf("Unable to open screenshot\n");
+	free(buf);
 }
 #endif
 
+void menu_display_lazyStats(void){
+	/// Show the share of samples skipped by the lazy conversion per sensor (percentage of samples of the last health window that didn't need to be
+	/// filtered/converted). This is a count of samples, not of CPU time (the values that are filled have their own cost, see measure_lazy_fillRange).
+	/// Nothing is shown if the lazy conversion is deactivated.
+#if MEASURE_LAZY_CONVERSION == 1
+
+
+	static char lazyStats_text[14 + SENSORS_SIZE*10];
+
+	// Build text of all sensors
+	uint8_t len = sprintf(lazyStats_text, "Lazy skipped:");
+	for(uint8_t i = 0; i < SENSORS_SIZE; i++)
+		len += sprintf(lazyStats_text + len, " S%d %d%%", i+1, sensors[i]->lazySkipped);
+
+	// Display in header
+	lbl_lazyStats.text = lazyStats_text;
+	TFT_setColor(1, MAIN_TEXTCOLOR, -1, -1, -1);
+	TFT_label_display(1, &lbl_lazyStats);
+#endif
+}
+
 void TFT_display_get_values(void){
 	// Get size of last display list to be printed on screen (section "Debug Values")
 	display_list_size = EVE_memRead16(REG_CMD_DL);
@@ -1019,68 +1273,113 @@ void TFT_display_get_values(void){
 //		Monitoring          --------------------------------------------------------------------------------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-enum menuMonitorInput{menuMonitorInputS1Raw=0, menuMonitorInputS1, menuMonitorInputS2Raw, menuMonitorInputS2};
+// Inputs of the monitoring menu. Every sensor has MENU_MONITOR_INPUTS_PER_SENSOR successive inputs (raw, converted, velocity, acceleration), the input index divided by this is the sensor index.
+enum menuMonitorInput{menuMonitorInputRaw=0, menuMonitorInputConv, menuMonitorInputVel, menuMonitorInputAcc};
 typedef enum menuMonitorInput menuMonitorInput;
+#define MENU_MONITOR_INPUTS_PER_SENSOR 4
+#define MENU_MONITOR_INPUTS_SIZE (MENU_MONITOR_INPUTS_PER_SENSOR*SENSORS_SIZE)
+#define menuMonitorInputS1Raw (0*MENU_MONITOR_INPUTS_PER_SENSOR + menuMonitorInputRaw)
+void menu_monitor_setWindow(uint8_t window);
 void menu_monitor_setInput(uint8_t inputTyp){
 	/// Set the main graph settings and link to the specific input
-	/// inputTyp ... Is the index of the wanted input (see inputType in globals)
+	/// inputTyp ... Is the index of the wanted input (see inputType in globals). Sensor index = inputTyp / MENU_MONITOR_INPUTS_PER_SENSOR, kind of value = inputTyp % MENU_MONITOR_INPUTS_PER_SENSOR (see menuMonitorInput)
+
+	// Button texts for every input (sensor name followed by kind of value)
+	static char btn_input_texts[MENU_MONITOR_INPUTS_SIZE][12];
 
 	// Set global input type mark
 	inputType = inputTyp;
 
+	// Get sensor and kind of value
+	volatile sensor* sens = sensors[inputTyp / MENU_MONITOR_INPUTS_PER_SENSOR];
+	menuMonitorInput kind = inputTyp % MENU_MONITOR_INPUTS_PER_SENSOR;
+	monitorSensorIdx = sens->index;
+
+	// Link value label to the current index of the sensor (ignore volatile here)
+	lbl_sensor_val.numSrc.srcOffset = (uint16_t*)&sens->bufIdx;
+
+	// Signed graph range is only used by velocity and acceleration
+	gph_monitor.y_min = gph_monitor.amp_min = 0.0;
+
 	// Change graph settings
-	if(inputTyp == menuMonitorInputS1Raw){
-		monitorSensorIdx = sensor1.index;
-		btn_input.text = "S1 Raw";
+	if(kind == menuMonitorInputRaw){
+		sprintf(btn_input_texts[inputTyp], "S%d Raw", sens->index+1);
 		lbl_sensor_val.text = "%d";
 		lbl_sensor_val.numSrc.srcType = srcTypeInt;
-		lbl_sensor_val.numSrc.intSrc = (int_buffer_t*)sensor1.bufRaw;
-		lbl_sensor_val.numSrc.srcOffset = (uint16_t*)&sensor1.bufIdx; // (ignore volatile here)
+		lbl_sensor_val.numSrc.intSrc = (int_buffer_t*)sens->bufRaw;
 		lbl_sensor_val.fracExp = 1;
 
 		gph_monitor.amp_max = 5.2;
 		gph_monitor.y_max = 4095.0;
 		gph_monitor.y_label = "V";
 	}
-	else if(inputTyp == menuMonitorInputS1){
-		monitorSensorIdx = sensor1.index;
-		btn_input.text = "S1 Front";
+	else if(kind == menuMonitorInputConv){
+		sprintf(btn_input_texts[inputTyp], "S%d %s", sens->index+1, sens->name);
 		lbl_sensor_val.text = "%d.%.2d mm";
+#if MEASURE_FIXED_BUFFERS == 1
+		lbl_sensor_val.numSrc.srcType = srcTypeFixed;
+		lbl_sensor_val.numSrc.fixedSrc = (int16_t*)sens->bufConv;
+		lbl_sensor_val.numSrc.fixedFmt = (fixedFormat*)&sens->convFormat;
+#else
 		lbl_sensor_val.numSrc.srcType = srcTypeFloat;
-		lbl_sensor_val.numSrc.floatSrc = (float_buffer_t*)sensor1.bufConv;
-		lbl_sensor_val.numSrc.srcOffset = (uint16_t*)&sensor1.bufIdx; // (ignore volatile here)
+		lbl_sensor_val.numSrc.floatSrc = (float_buffer_t*)sens->bufConv;
+#endif
 		lbl_sensor_val.fracExp = 2;
 
+		// Converted value is relative to the operating point (see conversion pipeline) and might be negative
+		gph_monitor.amp_min = gph_monitor.y_min = -40;
 		gph_monitor.amp_max = 160;
 		gph_monitor.y_max = 160;
 		gph_monitor.y_label = "mm";
 	}
-	else if(inputTyp == menuMonitorInputS2Raw){
-		monitorSensorIdx = sensor2.index;
-		btn_input.text = "S2 Raw";
-		lbl_sensor_val.text = "%d";
-		lbl_sensor_val.numSrc.srcType = srcTypeInt;
-		lbl_sensor_val.numSrc.intSrc = (int_buffer_t*)sensor2.bufRaw;
-		lbl_sensor_val.numSrc.srcOffset = (uint16_t*)&sensor2.bufIdx; // (ignore volatile here)
-		lbl_sensor_val.fracExp = 1;
+	else if(kind == menuMonitorInputVel){
+		sprintf(btn_input_texts[inputTyp], "S%d Vel", sens->index+1);
+		lbl_sensor_val.text = "%d.%.2d m/s";
+		lbl_sensor_val.numSrc.srcType = srcTypeFloat;
+		lbl_sensor_val.numSrc.floatSrc = (float_buffer_t*)sens->bufVel;
+		lbl_sensor_val.fracExp = 2;
 
-		gph_monitor.amp_max = 5.2;
-		gph_monitor.y_max = 4095.0;
-		gph_monitor.y_label = "V";
+		gph_monitor.amp_min = gph_monitor.y_min = -2.0;
+		gph_monitor.amp_max = gph_monitor.y_max = 2.0;
+		gph_monitor.y_label = "m/s";
 	}
-	else if(inputTyp == menuMonitorInputS2){
-		monitorSensorIdx = sensor2.index;
-		btn_input.text = "S2 Rear";
-		lbl_sensor_val.text = "%d.%.2d mm";
+	else if(kind == menuMonitorInputAcc){
+		sprintf(btn_input_texts[inputTyp], "S%d Acc", sens->index+1);
+		lbl_sensor_val.text = "%d.%.1d m/s2";
 		lbl_sensor_val.numSrc.srcType = srcTypeFloat;
-		lbl_sensor_val.numSrc.floatSrc = (float_buffer_t*)sensor2.bufConv;
-		lbl_sensor_val.numSrc.srcOffset = (uint16_t*)&sensor2.bufIdx; // (ignore volatile here)
-		lbl_sensor_val.fracExp = 2;
+		lbl_sensor_val.numSrc.floatSrc = (float_buffer_t*)sens->bufAcc;
+		lbl_sensor_val.fracExp = 1;
 
-		gph_monitor.amp_max = 160;
-		gph_monitor.y_max = 160;
-		gph_monitor.y_label = "mm";
+		gph_monitor.amp_min = gph_monitor.y_min = -100.0;
+		gph_monitor.amp_max = gph_monitor.y_max = 100.0;
+		gph_monitor.y_label = "m/s2";
 	}
+	btn_input.text = btn_input_texts[inputTyp];
+
+	// History is only kept for the raw value (converted values are derived from it) - show live buffer for the other inputs
+	if(kind != menuMonitorInputRaw && kind != menuMonitorInputConv)
+		monitorWindow = 0;
+	menu_monitor_setWindow(monitorWindow);
+}
+void menu_monitor_setWindow(uint8_t window){
+	/// Set the time window of the monitoring graph (x-axis scale and button text)
+	/// window ... 0 = live buffer, 1 to HISTORY_LEVELS = history level window-1
+
+	// Button text, shown time and vertical grid lines per window
+	static char* window_texts[MENU_MONITOR_WINDOWS] = {"2.2s", "11s", "66s", "11m"};
+	static const float window_grid[MENU_MONITOR_WINDOWS] = {2.2, 5.5, 6.6, 6.6}; // grid line every 1s, 2s, 10s, 100s
+
+	// Time of one pixel (bucket) of the window
+	float pixelTime = MEASUREMENT_INTERVAL/1000.0;
+	if(window >= 1) pixelTime *= HISTORY_FACTOR_0;
+	if(window >= 2) pixelTime *= HISTORY_FACTOR_1;
+	if(window >= 3) pixelTime *= HISTORY_FACTOR_2;
+
+	// Set window
+	monitorWindow = window;
+	btn_window.text = window_texts[window];
+	gph_monitor.cx_max = pixelTime * S_BUF_SIZE;
+	gph_monitor.v_grid_lines = window_grid[window];
 }
 void menu_display_static_0monitor(void){
 	// Set configuration for current menu
@@ -1109,25 +1408,46 @@ void menu_display_0monitor(void){
 
 	// Buttons
 	TFT_control_display(&btn_input);
+	TFT_control_display(&btn_window);
 	TFT_control_display(&tgl_graphMode);
 
 	/////////////// Debug Values
 	//TFT_label(1, &lbl_DLsize_val);
+	menu_display_lazyStats();
+
+	// Fill the converted values that are shown (lazy conversion) - whole buffer for the live graph, else only the current value for the label.
+	// The graph uses the index the fill ended at (newer values might not be filled yet)
+	volatile sensor* sens = sensors[monitorSensorIdx];
+	uint16_t filledIdx = sens->bufIdx;
+	if(inputType % MENU_MONITOR_INPUTS_PER_SENSOR == menuMonitorInputConv)
+		measure_lazy_fillRange((sensor*)sens, (monitorWindow == 0) ? S_BUF_SIZE : 1);
 
 	// Write current sensor value with unit
+	TFT_setColor(1, MAIN_BTNTXTCOLOR, -1, -1, -1);
 	TFT_label_display(1, &lbl_sensor_val);
 
 	/////////////// GRAPH
 	///// Print dynamic part of the Graph (data & marker)
-	if(inputType == menuMonitorInputS1Raw)
-		TFT_graph_pixeldata_i(&gph_monitor, sensors[monitorSensorIdx]->bufRaw, S_BUF_SIZE, (uint16_t*)&sensors[monitorSensorIdx]->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
-	else if(inputType == menuMonitorInputS1)
-		TFT_graph_pixeldata_f(&gph_monitor, sensors[monitorSensorIdx]->bufConv, S_BUF_SIZE, (uint16_t*)&sensors[monitorSensorIdx]->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
-	else if(inputType == menuMonitorInputS2Raw)
-		TFT_graph_pixeldata_i(&gph_monitor, sensors[monitorSensorIdx]->bufRaw, S_BUF_SIZE, (uint16_t*)&sensors[monitorSensorIdx]->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
-	else if(inputType == menuMonitorInputS2)
-		TFT_graph_pixeldata_f(&gph_monitor, sensors[monitorSensorIdx]->bufConv, S_BUF_SIZE, (uint16_t*)&sensors[monitorSensorIdx]->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
-
+	// Long-horizon history (raw or converted by the conversion table)
+	if(monitorWindow != 0){
+		historyLevel* lvl = &sens->history[monitorWindow-1];
+		sensor* convSens = (inputType % MENU_MONITOR_INPUTS_PER_SENSOR == menuMonitorInputConv) ? (sensor*)sens : NULL;
+		TFT_graph_envelope(&gph_monitor, lvl->buckets, HISTORY_SIZE, &lvl->idx, convSens, GRAPH_DATA2COLORLIGHT, GRAPH_DATA1COLOR);
+	}
+	else switch(inputType % MENU_MONITOR_INPUTS_PER_SENSOR){
+		case menuMonitorInputRaw:
+			TFT_graph_pixeldata_i(&gph_monitor, sens->bufRaw, S_BUF_SIZE, (uint16_t*)&sens->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
+			break;
+		case menuMonitorInputConv:
+			MENU_GRAPH_CONVBUFFER(&gph_monitor, sens->bufConv, (fixedFormat*)&sens->convFormat, S_BUF_SIZE, &filledIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
+			break;
+		case menuMonitorInputVel:
+			TFT_graph_pixeldata_f(&gph_monitor, sens->bufVel, S_BUF_SIZE, (uint16_t*)&sens->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
+			break;
+		case menuMonitorInputAcc:
+			TFT_graph_pixeldata_f(&gph_monitor, sens->bufAcc, S_BUF_SIZE, (uint16_t*)&sens->bufIdx, GRAPH_DATA1COLOR); // ignore volatile sensor
+			break;
+	}
 }
 void menu_touch_0monitor(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgress, uint8_t *swipeEvokedBy, int32_t *swipeDistance_X, int32_t *swipeDistance_Y){
 	/// Menu specific touch code. This will run if the corresponding menu is active and the main tft_touch() registers an unknown tag value
@@ -1153,6 +1473,21 @@ void menu_touch_0monitor(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgr
 				}
 			}
 			break;
+		// time window button
+		case BTN_WINDOW_TAG:
+			if(*toggle_lock == 0) {
+				printf("Switch time window\n");
+				*toggle_lock = 42;
+
+				// Next window (history is only available for raw and converted input)
+				uint8_t kind = inputType % MENU_MONITOR_INPUTS_PER_SENSOR;
+				if(kind == menuMonitorInputRaw || kind == menuMonitorInputConv)
+					menu_monitor_setWindow((monitorWindow + 1) % MENU_MONITOR_WINDOWS);
+
+				// Refresh menu (needed to reprint static part of graph)
+				TFT_setMenu(-1);
+			}
+			break;
 		// signal switcher button
 		case 13:
 			if(*toggle_lock == 0) {
@@ -1161,11 +1496,11 @@ void menu_touch_0monitor(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgr
 
 				// Switch signal type
 				inputType++;
-				// Do not allow view of converted values in recording mode (they are not captured!)
-				if(measureMode == measureModeRecording && inputType % 2 != 0)
-					inputType++;
+				// Do not allow view of converted/tracked values in recording mode (they are not captured!) - skip to next raw input
+				if(measureMode == measureModeRecording && inputType % MENU_MONITOR_INPUTS_PER_SENSOR != menuMonitorInputRaw)
+					inputType += MENU_MONITOR_INPUTS_PER_SENSOR - (inputType % MENU_MONITOR_INPUTS_PER_SENSOR);
 				// Overleap correction
-				if(inputType > 3){ inputType = 0; }
+				if(inputType >= MENU_MONITOR_INPUTS_SIZE){ inputType = 0; }
 
 				// Switch label of button to new input type
 				menu_monitor_setInput(inputType);
@@ -1210,22 +1545,34 @@ void menu_display_1dash(void){
 			float_buffer_t s1_fil_tmp = measure_movAvgFilter_clean((sensor*)&sensor1, sensor1.avgFilterInterval, 0);
 			float_buffer_t s2_fil_tmp = measure_movAvgFilter_clean((sensor*)&sensor2, sensor1.avgFilterInterval, 0);
 
-			// Calculate current deflection from temp filtered value
-			f_deflection = poly_calc(s1_fil_tmp, (float*)sensor1.fitCoefficients, sensor1.fitOrder) - sensor1.originPoint - sensor1.operatingPoint;
-			r_deflection = poly_calc(s2_fil_tmp, (float*)sensor2.fitCoefficients, sensor2.fitOrder) - sensor2.originPoint - sensor2.operatingPoint;
+			// Calculate current deflection from temp filtered value (conversion pipeline includes the offsets)
+			f_deflection = measure_conv((sensor*)&sensor1, s1_fil_tmp);
+			r_deflection = measure_conv((sensor*)&sensor2, s2_fil_tmp);
 
 			// Refresh time
 			record_time = measurementCounter * (MEASUREMENT_INTERVAL/1000);
 		}
 		else if(measureMode == measureModeMonitoring){
-			// Calculate current deflection from current value in buffer
-			f_deflection = (float)sensor1.bufConv[sensor1.bufIdx] - sensor1.originPoint - sensor1.operatingPoint;
-			r_deflection = (float)sensor2.bufConv[sensor2.bufIdx] - sensor2.originPoint - sensor2.operatingPoint;
+			// Current deflection is the current converted value in buffer (conversion pipeline includes the offsets)
+			measure_lazy_fillRange((sensor*)&sensor1, 1);
+			measure_lazy_fillRange((sensor*)&sensor2, 1);
+			f_deflection = SENS_GET_CONV(&sensor1, sensor1.bufIdx);
+			r_deflection = SENS_GET_CONV(&sensor2, sensor2.bufIdx);
 		}
 		else{
 			// Produce a NAN
 			f_deflection = r_deflection = 0.0 / 0.0;
 		}
+
+		// Ground speed of the last correlation window
+		dash_speed = analyze_xcorr.speed;
+		dash_speedConfidence = analyze_xcorr.confidence;
+
+		// Damping of the front and rear suspension (average of all ring-downs of the session)
+		for(uint8_t s = 0; s < 2; s++){
+			dash_dampZeta[s] = analyze_damping[s].avgZeta;
+			dash_dampFn[s] = analyze_damping[s].avgFn;
+		}
 	}
 
 	// Change record button name if needed
@@ -1282,6 +1629,58 @@ void menu_display_1dash(void){
 	TFT_label_display(1, &lbl_dash_r);
 	TFT_label_display(1, &lbl_record_time);
 
+	// Ground speed (grey if the correlation is too weak)
+	if(analyze_xcorr.valid == 0)
+		TFT_setColor(1, LIGHTGREY, -1, -1, -1);
+	TFT_label_display(1, &lbl_dash_speed_val);
+	TFT_label_display(1, &lbl_dash_speedConf_val);
+	TFT_setColor(1, BLACK, -1, -1, -1);
+	TFT_label_display(1, &lbl_dash_speed);
+	TFT_label_display(1, &lbl_dash_speedConf);
+
+	// Damping of front and rear (each grey as long as no ring-down of the sensor was evaluated)
+	TFT_setColor(1, (analyze_damping[0].events == 0) ? LIGHTGREY : BLACK, -1, -1, -1);
+	TFT_label_display(1, &lbl_dash_damp_f);
+	TFT_label_display(1, &lbl_dash_dampFn_f);
+	TFT_setColor(1, (analyze_damping[1].events == 0) ? LIGHTGREY : BLACK, -1, -1, -1);
+	TFT_label_display(1, &lbl_dash_damp_r);
+	TFT_label_display(1, &lbl_dash_dampFn_r);
+	TFT_setColor(1, BLACK, -1, -1, -1);
+	TFT_label_display(1, &lbl_dash_damp);
+	TFT_label_display(1, &lbl_dash_dampFn);
+
+	// Background conversion of the last recording (progress and cancel button - only while active)
+	uint8_t convPercent;
+	uint8_t convState = record_convertStatus(&convPercent);
+	if(convState != convIdle){
+		static char conv_text[24];
+		sprintf(conv_text, "%s CSV %d%%", (convState == convResuming) ? "Resuming" : "Converting", convPercent);
+		lbl_dash_conv.text = conv_text;
+		TFT_setColor(1, BLACK, -1, -1, -1);
+		TFT_label_display(1, &lbl_dash_conv);
+		TFT_setColor(1, MAIN_BTNTXTCOLOR, MAIN_BTNCOLOR, MAIN_BTNCTSCOLOR, MAIN_BTNGRDCOLOR);
+		TFT_control_display(&btn_convCancel);
+	}
+
+	// Marker button with the selection of type and label of the next marker (only while recording, shows the number of markers set)
+	if(measureMode == measureModeRecording){
+		static char mark_text[12];
+		if(dash_marks == 0)
+			sprintf(mark_text, "Mark");
+		else
+			sprintf(mark_text, "Mark %d", dash_marks);
+		btn_mark.text = mark_text;
+		btn_markType.text = (char*)dash_markTypeNames[dash_markType];
+		btn_markLabel.text = (char*)dash_markLabels[dash_markLabel];
+		TFT_setColor(1, MAIN_BTNTXTCOLOR, MAIN_BTNCOLOR, MAIN_BTNCTSCOLOR, MAIN_BTNGRDCOLOR);
+		TFT_control_display(&btn_markType);
+		TFT_control_display(&btn_markLabel);
+		TFT_control_display(&btn_mark);
+	}
+
+	// Saved conversions
+	menu_display_lazyStats();
+
 	// Debug
 	//TFT_setColor(1, MAIN_TEXTCOLOR, MAIN_BTNCOLOR, MAIN_BTNCTSCOLOR, MAIN_BTNGRDCOLOR);
 	//EVE_cmd_number_burst(470, 10, 26, EVE_OPT_RIGHTX | EVE_OPT_SIGNED, swipeDistance_X);
@@ -1306,8 +1705,10 @@ void menu_touch_1dash(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgress
 					// Set monitoring graph to raw Sensor1
 					menu_monitor_setInput(menuMonitorInputS1Raw);
 
-					// Start recording
+					// Start recording (and a new damping session)
 					measurementCounter = 0;
+					dash_marks = 0;
+					analyze_damping_reset();
 					int8_t res = record_start();
 
 					// Error handling
@@ -1325,19 +1726,49 @@ void menu_touch_1dash(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgress
 						printf("Stop failed\n");
 					}
 					else{
-						// Finish record
+						// Finish record - convert BIN to CSV file in the background (monitoring continues, see record_convertTick)
+						record_convertStart(filename_rec);
+					}
+				}
+			}
+			break;
+		case BTN_CONVCANCEL_TAG:
+			if(*toggle_lock == 0) {
+				printf("Button ConvCancel\n");
+				*toggle_lock = 42;
+
+				// Stop the background conversion (CSV file stays as far as converted)
+				record_convertCancel();
+			}
+			break;
+		case BTN_MARK_TAG:
+			if(*toggle_lock == 0) {
+				printf("Button Mark\n");
+				*toggle_lock = 42;
 
-						// Set text of button to wait, disable button and trigger one last display refresh
-						btn_startRec.mytag = 0;
-						TFT_display();
+				// Set a marker behind the newest recorded sample (written in-band, listed in the .EVT file by the conversion)
+				if(sync_marker(dash_markType, dash_markLabels[dash_markLabel]))
+					dash_marks++;
+				else
+					printf("Marker not set (queue full)\n");
+			}
+			break;
+		case BTN_MARKTYPE_TAG:
+			if(*toggle_lock == 0) {
+				printf("Button marker type\n");
+				*toggle_lock = 42;
 
-						// Start conversion of BIN to CSV file
-						record_convertBinFile(filename_rec, (sensor**)&sensors);
+				// Next type (used by the following markers, kept for later recordings)
+				dash_markType = (dash_markType + 1) % (sizeof(dash_markTypeNames)/sizeof(dash_markTypeNames[0]));
+			}
+			break;
+		case BTN_MARKLABEL_TAG:
+			if(*toggle_lock == 0) {
+				printf("Button marker label\n");
+				*toggle_lock = 42;
 
-						// Enable Button
-						btn_startRec.mytag = BTN_STARTREC_TAG;
-					}
-				}
+				// Next preset label (used by the following markers, kept for later recordings)
+				dash_markLabel = (dash_markLabel + 1) % (sizeof(dash_markLabels)/sizeof(dash_markLabels[0]));
 			}
 			break;
 		default:
@@ -1415,6 +1846,30 @@ void menu_display_2setup1(void){
 	TFT_textbox_display(&tbx_filename);
 	TFT_textbox_display(&tbx_sensor1);
 	TFT_textbox_display(&tbx_sensor2);
+
+	// Health status of the sensors (green if OK, red with the active flags otherwise)
+	static char health_texts[SENSORS_SIZE][32];
+	label* lbl_health[SENSORS_SIZE] = {&lbl_health_S1, &lbl_health_S2};
+	for(uint8_t i = 0; i < SENSORS_SIZE; i++){
+		volatile sensorHealth* health = &sensors[i]->health;
+		if(health->flags == 0){
+			sprintf(health_texts[i], "OK (noise %d)", (int)(health->noiseRms + 0.5f));
+			TFT_setColor(1, GREEN_1, -1, -1, -1);
+		}
+		else{
+			sprintf(health_texts[i], "%s%s%s%s",
+					(health->flags & healthNoise)		? "Noise " : "",
+					(health->flags & healthDropout)		? "Drop " : "",
+					(health->flags & healthStuck)		? "Stuck " : "",
+					(health->flags & healthSaturation)	? "Sat" : "");
+			TFT_setColor(1, RED_1, -1, -1, -1);
+		}
+		lbl_health[i]->text = health_texts[i];
+		TFT_label_display(1, lbl_health[i]);
+	}
+
+	// Saved conversions
+	menu_display_lazyStats();
 }
 void menu_touch_2setup1(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgress, uint8_t *swipeEvokedBy, int32_t *swipeDistance_X, int32_t *swipeDistance_Y){
 	/// Menu specific touch code. This will run if the corresponding menu is active and the main tft_touch() registers an unknown tag value
@@ -1552,9 +2007,11 @@ void menu_display_3setup2(void){
 	/// This menu ...
 
 
-	// Calculate current deflection
-	f_deflection = (float)sensor1.bufConv[sensor1.bufIdx] - sensor1.originPoint - sensor1.operatingPoint;
-	r_deflection = (float)sensor2.bufConv[sensor2.bufIdx] - sensor2.originPoint - sensor2.operatingPoint;
+	// Current deflection is the current converted value (conversion pipeline includes the offsets)
+	measure_lazy_fillRange((sensor*)&sensor1, 1);
+	measure_lazy_fillRange((sensor*)&sensor2, 1);
+	f_deflection = SENS_GET_CONV(&sensor1, sensor1.bufIdx);
+	r_deflection = SENS_GET_CONV(&sensor2, sensor2.bufIdx);
 
 	// Set button color for header
 	TFT_setColor(1, MAIN_BTNTXTCOLOR, MAIN_BTNCOLOR, MAIN_BTNCTSCOLOR, MAIN_BTNGRDCOLOR);
@@ -1572,12 +2029,19 @@ void menu_display_3setup2(void){
 	// Current deflection in sag section
 	TFT_label_display(1, &lbl_f_deflection);
 	TFT_label_display(1, &lbl_r_deflection);
+
+	// Saved conversions
+	menu_display_lazyStats();
 }
 void menu_touch_3setup2(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgress, uint8_t *swipeEvokedBy, int32_t *swipeDistance_X, int32_t *swipeDistance_Y){
 	/// Menu specific touch code. This will run if the corresponding menu is active and the main tft_touch() registers an unknown tag value
 	/// Do not use predefined TAG values! See tft.c "TAG ASSIGNMENT"!
 
 
+	// The sag buttons use the current filtered value (lazy conversion)
+	measure_lazy_fillRange((sensor*)&sensor1, 1);
+	measure_lazy_fillRange((sensor*)&sensor2, 1);
+
 	// Determine which tag was touched
 	switch(tag)
 	{
@@ -1603,8 +2067,10 @@ void menu_touch_3setup2(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgre
 				printf("Button front origin touched\n");
 				*toggle_lock = 42;
 
-				// Set current filtered raw value as origin value
-				sensor1.originPoint = sensor1.bufConv[sensor1.bufIdx];
+				// Set current filtered value, converted up to the offset stage, as origin value and rebuild conversion table
+				sensor1.originPoint = measure_conv_evaluate((sensor*)&sensor1, SENS_GET_FILTER(&sensor1, sensor1.bufIdx), 0);
+				measure_conv_compile((sensor*)&sensor1);
+				measure_tracker_reset((sensor*)&sensor1);
 
 				// Store setup in CAL file
 				record_writeCalFile((sensor*)&sensor1);
@@ -1619,8 +2085,10 @@ void menu_touch_3setup2(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgre
 				printf("Button rear origin touched\n");
 				*toggle_lock = 42;
 
-				// Set current filtered raw value as origin value
-				sensor2.originPoint = sensor2.bufConv[sensor2.bufIdx];
+				// Set current filtered value, converted up to the offset stage, as origin value and rebuild conversion table
+				sensor2.originPoint = measure_conv_evaluate((sensor*)&sensor2, SENS_GET_FILTER(&sensor2, sensor2.bufIdx), 0);
+				measure_conv_compile((sensor*)&sensor2);
+				measure_tracker_reset((sensor*)&sensor2);
 
 				// Store setup in CAL file
 				record_writeCalFile((sensor*)&sensor2);
@@ -1635,9 +2103,11 @@ void menu_touch_3setup2(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgre
 				printf("Button front operating point touched\n");
 				*toggle_lock = 42;
 
-				// Set operating point as offset from origin to current position
-				sensor1.operatingPoint = sensor1.bufConv[sensor1.bufIdx] - sensor1.originPoint;
-				printf("curfil %.2f, orig %.2f \n", sensor1.bufConv[sensor1.bufIdx], sensor1.originPoint);
+				// Set operating point as offset from origin to current position (converted up to the offset stage) and rebuild conversion table
+				sensor1.operatingPoint = measure_conv_evaluate((sensor*)&sensor1, SENS_GET_FILTER(&sensor1, sensor1.bufIdx), 0) - sensor1.originPoint;
+				printf("curfil %.2f, orig %.2f \n", SENS_GET_FILTER(&sensor1, sensor1.bufIdx), sensor1.originPoint);
+				measure_conv_compile((sensor*)&sensor1);
+				measure_tracker_reset((sensor*)&sensor1);
 
 				// Store setup in CAL file
 				record_writeCalFile((sensor*)&sensor1);
@@ -1652,8 +2122,10 @@ void menu_touch_3setup2(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgre
 				printf("Button rear operating point touched\n");
 				*toggle_lock = 42;
 
-				// Set operating point as offset from origin to current position
-				sensor2.operatingPoint = sensor2.bufConv[sensor2.bufIdx] - sensor2.originPoint;
+				// Set operating point as offset from origin to current position (converted up to the offset stage) and rebuild conversion table
+				sensor2.operatingPoint = measure_conv_evaluate((sensor*)&sensor2, SENS_GET_FILTER(&sensor2, sensor2.bufIdx), 0) - sensor2.originPoint;
+				measure_conv_compile((sensor*)&sensor2);
+				measure_tracker_reset((sensor*)&sensor2);
 
 				// Store setup in CAL file
 				record_writeCalFile((sensor*)&sensor2);
@@ -1880,7 +2352,8 @@ void menu_display_curveset(void){
 	// If current data point is in edit mode
 	if(tbx_act.mytag != 0){
 		// Save current nominal value
-		tbx_nom.numSrc.floatSrc[*tbx_nom.numSrc.srcOffset] = (float)curveset_sens->bufFilter[curveset_sens->bufIdx]; //(float)curveset_sens->bufRaw[curveset_sens->bufIdx];//
+		measure_lazy_fillRange(curveset_sens, 1);
+		tbx_nom.numSrc.floatSrc[*tbx_nom.numSrc.srcOffset] = SENS_GET_FILTER(curveset_sens, curveset_sens->bufIdx); //(float)curveset_sens->bufRaw[curveset_sens->bufIdx];//
 		//printf("write %f\n", curveset_sens->bufFilter[curveset_sens->bufIdx]);
 
 		// Sort tbx_act.numSrc.floatSrc & tbx_nom.numSrc.floatSrc based on nomx and change current datapoint if necessary
@@ -1958,6 +2431,10 @@ void menu_touch_curveset(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgr
 				}
 				curveset_sens->fitOrder = fit_order;
 
+				// Rebuild conversion table and restart tracker with new calibration
+				measure_conv_compile(curveset_sens);
+				measure_tracker_reset(curveset_sens);
+
 				// Write CAL file
 				record_writeCalFile(curveset_sens);
 
@@ -2053,7 +2530,8 @@ void menu_touch_curveset(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProgr
 
 						/// Set initial value's
 						// Set initial x value to current sensor value
-						tbx_nom.numSrc.floatSrc[DP_cur] = (float)curveset_sens->bufFilter[curveset_sens->bufIdx];//tbx_act.numSrc.floatSrc[DP_cur+1];
+						measure_lazy_fillRange(curveset_sens, 1);
+						tbx_nom.numSrc.floatSrc[DP_cur] = SENS_GET_FILTER(curveset_sens, curveset_sens->bufIdx);//tbx_act.numSrc.floatSrc[DP_cur+1];
 						// If an OK fit is available set initial y-value to the one corresponding to the current sensor value
 						if(fit_result == 0)
 							tbx_act.numSrc.floatSrc[DP_cur] = poly_calc(tbx_nom.numSrc.floatSrc[DP_cur], &coefficients[0], fit_order);
@@ -2182,12 +2660,15 @@ void filterset_prepare(volatile sensor* sens){
 	// Set current error threshold to retrieved value (we use a separate value in order to modify it dynamically)
 	filter_errorThreshold = filterset_sens->errorThreshold;
 
+	// Set current tracker smoothing (also a separate value, it is only applied when leaving the menu)
+	filter_trackerTheta = filterset_sens->trackerTheta;
+
 	// Change sensor number in header
 	sprintf(lbl_filterset.text, "Filter set - Sensor %d", (filterset_sens->index+1));
 
 }
 void filterset_setEditMode(uint8_t editMode){
-	/// Changes the GUI to error threshold editing mode and back (disable/enable of textboxes and buttons)
+	/// Changes the GUI to error threshold/tracker smoothing editing mode and back (disable/enable of textboxes and buttons)
 
 
 	// Set to edit mode - activate textbox for error threshold
@@ -2196,6 +2677,7 @@ void filterset_setEditMode(uint8_t editMode){
 		btn_filter_setchange.state = EVE_OPT_FLAT;
 		btn_filter_setchange.text = "Save";
 		tbx_error_threshold.mytag = TBX_FILTER_ERROR_THRESHOLD_TAG;
+		tbx_tracker_theta.mytag = TBX_FILTER_TRACKER_THETA_TAG;
 
 	}
 	// Set to view mode - deactivate textbox for error threshold
@@ -2204,6 +2686,7 @@ void filterset_setEditMode(uint8_t editMode){
 		btn_filter_setchange.state = 0;
 		btn_filter_setchange.text = "Change";
 		tbx_error_threshold.mytag = 0;
+		tbx_tracker_theta.mytag = 0;
 
 	}
 
@@ -2221,16 +2704,21 @@ void menu_display_static_filterset(void){
 
 	TFT_textbox_static(1, &tbx_filter_interval);
 	TFT_textbox_static(1, &tbx_error_threshold);
+	TFT_textbox_static(1, &tbx_tracker_theta);
 }
 void menu_display_filterset(void){
 	/// Menu specific display code. This will run if the corresponding menu is active and the main tft_display() is called.
 	/// This menu ...
 
 
+	// Fill the filtered/converted values of the whole buffer (lazy conversion). The graph uses the index the fill ended at
+	uint16_t filledIdx = filterset_sens->bufIdx;
+	measure_lazy_fillRange(filterset_sens, S_BUF_SIZE);
+
 	// If error threshold is in edit mode show current sensor value
 	if(tbx_error_threshold.mytag != 0 && tbx_error_threshold.active == 0 ){
 		// Save current sensor value
-		*tbx_error_threshold.numSrc.intSrc = (int_buffer_t)filterset_sens->bufFilter[filterset_sens->bufIdx];
+		*tbx_error_threshold.numSrc.intSrc = (int_buffer_t)SENS_GET_FILTER(filterset_sens, filterset_sens->bufIdx);
 	}
 
 	//// Get highest y-value and set graph axis boundaries
@@ -2270,15 +2758,15 @@ void menu_display_filterset(void){
 			i = filterset_sens->bufMaxIdx;
 
 		// Convert current unfiltered raw value
-		float_buffer_t curRawConv = poly_calc(filterset_sens->bufRaw[filterset_sens->bufIdx], filterset_sens->fitCoefficients, filterset_sens->fitOrder);
+		float_buffer_t curRawConv = measure_conv(filterset_sens, filterset_sens->bufRaw[filterset_sens->bufIdx]);
 
 		// Calculate error
-		float_buffer_t err = fabsf(fabsf(curRawConv) - fabsf(filterset_sens->bufConv[filterset_sens->bufIdx]));
+		float_buffer_t err = fabsf(curRawConv - SENS_GET_CONV(filterset_sens, filterset_sens->bufIdx));
 
 		// Check if error between converted unfiltered raw value and converted filtered raw value is bigger than the currently highest
 		if(err > filterset_maxError){
 			filterset_maxError = err;
-			printf("NewMax: %.2f, curRC %.2f, curFC %.2f\n", err, curRawConv, filterset_sens->bufConv[filterset_sens->bufIdx]);
+			printf("NewMax: %.2f, curRC %.2f, curFC %.2f\n", err, curRawConv, SENS_GET_CONV(filterset_sens, filterset_sens->bufIdx));
 		}
 	}
 	// Remember the last value that was tested
@@ -2290,7 +2778,7 @@ void menu_display_filterset(void){
 	///// Print dynamic part of the Graph (data & marker)
 	// Current data points and trace
 	TFT_graph_pixeldata_i(&gph_filterset, filterset_sens->bufRaw, filterset_sens->bufMaxIdx, &filterset_sens->bufIdx, GRAPH_DATA2COLORLIGHT);
-	TFT_graph_pixeldata_f(&gph_filterset, filterset_sens->bufFilter, filterset_sens->bufMaxIdx, &filterset_sens->bufIdx, GRAPH_DATA2COLOR);
+	MENU_GRAPH_CONVBUFFER(&gph_filterset, filterset_sens->bufFilter, &filterset_sens->filterFormat, filterset_sens->bufMaxIdx, &filledIdx, GRAPH_DATA2COLOR);
 
 	/// Draw Banner and divider line on top
 	TFT_header_static(1, &menu_filterset);
@@ -2307,6 +2795,7 @@ void menu_display_filterset(void){
 	// Data point controls
 	TFT_textbox_display(&tbx_error_threshold);
 	TFT_textbox_display(&tbx_filter_interval);
+	TFT_textbox_display(&tbx_tracker_theta);
 
 	// Header labels
 	TFT_label_display(1, &lbl_filterset);
@@ -2337,6 +2826,10 @@ void menu_touch_filterset(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProg
 				// Store current error threshold to be used (filter order is changed direct)
 				filterset_sens->errorThreshold = *tbx_error_threshold.numSrc.intSrc;
 
+				// Store tracker smoothing and calculate the resulting gains
+				filterset_sens->trackerTheta = filter_trackerTheta;
+				measure_tracker_setGains(filterset_sens);
+
 				// Write CAL file
 				record_writeCalFile(filterset_sens);
 
@@ -2407,9 +2900,18 @@ void menu_touch_filterset(uint8_t tag, uint8_t* toggle_lock, uint8_t swipeInProg
 					TFT_textbox_setStatus(&tbx_error_threshold, 1, -1);
 				}
 				break;
+		case TBX_FILTER_TRACKER_THETA_TAG:
+				if(*toggle_lock == 0) {
+					printf("Textbox tracker_theta\n");
+					*toggle_lock = 42;
+
+					// Activate Keypad and set cursor to end
+					TFT_textbox_setStatus(&tbx_tracker_theta, 1, -1);
+				}
+				break;
 		default:
-			// Handle textbox and if an OK was pressed an the active keypad stop cell from being updated
-			if(TFT_textbox_touch(&tbx_error_threshold))
+			// Handle textboxes and if an OK was pressed an the active keypad stop cell from being updated
+			if(TFT_textbox_touch(&tbx_error_threshold) || TFT_textbox_touch(&tbx_tracker_theta))
 				filterset_setEditMode(0);
 			break;
 	}
@@ -0,0 +1,585 @@
+/*
+@file    		recfmt.c
+@brief   		Checksums and header check of the .BIN recording format (shared by the firmware and the host tools, see recfmt.h)
+@version 		1.0
+@date    		2021-10-22
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "recfmt.h"
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320) of every nibble. Two lookups per byte - 64 bytes of table instead of 1kB.
+static const uint32_t recfmt_crcTable[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Bit writer/reader of the frame samples (LSB first)
+typedef struct {
+	uint8_t* p;			// Next byte to write
+	uint32_t acc;		// Bits not written yet
+	uint8_t  n;			// Number of bits in acc
+} recfmtBitWriter;
+typedef struct {
+	const uint8_t* p;	// Next byte to read
+	const uint8_t* end;	// End of the frame
+	uint32_t acc;		// Bits read but not used yet
+	uint8_t  n;			// Number of bits in acc
+	uint8_t  overrun;	// 1 if bits behind the end of the frame were requested
+} recfmtBitReader;
+
+#define RECFMT_RD16(p)			((uint16_t)((p)[0] | ((p)[1] << 8)))
+#define RECFMT_WR16(p, v)		{ (p)[0] = (uint8_t)(v); (p)[1] = (uint8_t)((v) >> 8); }
+#define RECFMT_ZIGZAG(d)		((((uint32_t)(d)) << 1) ^ (uint32_t)((int32_t)(d) >> 31))	// Signed difference to unsigned (0,-1,1,-2,... -> 0,1,2,3,...)
+#define RECFMT_UNZIGZAG(z)		((int32_t)((z) >> 1) ^ -(int32_t)((z) & 1))
+#define RECFMT_SAMPLE_BITS		12		// Bits of a sample in the packed modes
+#define RECFMT_WIDTH_BITS		4		// Bits of the width of the differences of a channel (recfmtCodecDelta)
+
+
+
+static inline void recfmt_bitPut(recfmtBitWriter* bw, uint32_t value, uint8_t bits){
+	bw->acc |= value << bw->n;
+	bw->n += bits;
+	while(bw->n >= 8){
+		*bw->p++ = (uint8_t)bw->acc;
+		bw->acc >>= 8;
+		bw->n -= 8;
+	}
+}
+
+static inline uint32_t recfmt_bitGet(recfmtBitReader* br, uint8_t bits){
+	while(br->n < bits){
+		if(br->p < br->end)
+			br->acc |= (uint32_t)(*br->p++) << br->n;
+		else
+			br->overrun = 1;
+		br->n += 8;
+	}
+	uint32_t value = br->acc & ((1UL << bits) - 1);
+	br->acc >>= bits;
+	br->n -= bits;
+	return value;
+}
+
+static inline uint16_t recfmt_eventLines(const recfmtLayout* lay, const uint8_t* line, uint16_t idx){
+	/// Number of lines of the event group starting at line idx (event line and payload lines, limited to the end of the block)
+	uint16_t n = 1 + line[2 + 1]; // Number of payload lines behind marker (16 bit) and type
+	return (idx + n > lay->lines) ? lay->lines - idx : n;
+}
+
+
+
+uint32_t recfmt_crc32(uint32_t crc, const void* data, uint32_t size){
+	/// Continue a CRC-32 over size bytes of data (same result as zlib crc32). Start with crc = 0.
+	///
+	///	crc		... CRC of the preceding bytes (0 for the first call)
+	///	data	... Bytes to add
+	///	size	... Number of bytes
+
+
+	const uint8_t* p = (const uint8_t*)data;
+
+	crc = ~crc;
+	while(size--){
+		crc ^= *p++;
+		crc = (crc >> 4) ^ recfmt_crcTable[crc & 0x0F];
+		crc = (crc >> 4) ^ recfmt_crcTable[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+uint32_t recfmt_chunkCrc(const void* chunk, uint16_t chunkHeaderSize, uint32_t seed){
+	/// CRC of a data chunk - covers the chunk header except its crc field (magic, dataSize, seq and the fields behind crc, e.g. sample)
+	/// and the dataSize bytes behind the header. For chunk headers of version 1 this is magic, dataSize, seq and the lines.
+	/// The seed ties the chunk to its file: a chunk left behind by an older recording at the same place doesn't match (see recfmt_chunkSeed).
+	///
+	///	chunk			... Start of the chunk (magic, dataSize, seq and sample must be set)
+	///	chunkHeaderSize	... Bytes of the chunk header (recfmtFileHeader.chunkHeaderSize)
+	///	seed			... recfmt_chunkSeed of the file header
+
+
+	const uint8_t* p = (const uint8_t*)chunk;
+	recfmtChunkHeader hdr;
+	memcpy(&hdr, p, RECFMT_CHUNK_HEADER_SIZE_V1);
+	uint32_t crc = recfmt_crc32(seed, p, offsetof(recfmtChunkHeader, crc));
+	crc = recfmt_crc32(crc, p + RECFMT_CHUNK_HEADER_SIZE_V1, chunkHeaderSize - RECFMT_CHUNK_HEADER_SIZE_V1);
+	return recfmt_crc32(crc, p + chunkHeaderSize, hdr.dataSize);
+}
+
+uint8_t recfmt_checkHeader(const void* chunk, uint32_t size){
+	/// Check if the first chunk of a file is a valid file header.
+	/// Returns recfmtHeaderNone if the magic doesn't match (file without header), recfmtHeaderOK if the header can be used
+	/// or recfmtHeaderCorrupt if the checksum or the layout is wrong.
+	///
+	///	chunk	... Start of the file
+	///	size	... Bytes available at chunk (at least sizeof(recfmtFileHeader) for a valid header)
+
+
+	const recfmtFileHeader* hdr = (const recfmtFileHeader*)chunk;
+
+	// Magic
+	if(size < sizeof(hdr->magic) || memcmp(hdr->magic, RECFMT_MAGIC, sizeof(hdr->magic)) != 0)
+		return recfmtHeaderNone;
+
+	// Size of the header (a newer writer may have appended fields) and checksum in its last 4 bytes
+	if(size < RECFMT_HEADER_SIZE_V1 || hdr->headerSize < RECFMT_HEADER_SIZE_V1 || hdr->headerSize > size)
+		return recfmtHeaderCorrupt;
+	uint32_t crc;
+	memcpy(&crc, (const uint8_t*)chunk + hdr->headerSize - sizeof(crc), sizeof(crc));
+	if(recfmt_crc32(0, chunk, hdr->headerSize - sizeof(crc)) != crc)
+		return recfmtHeaderCorrupt;
+
+	// Layout - chunks must hold the header and a whole number of lines
+	if(hdr->version == 0 || hdr->channels == 0 || hdr->channels > RECFMT_CHANNELS_MAX || hdr->lineSize == 0 ||
+	   hdr->chunkSize < hdr->headerSize || hdr->chunkHeaderSize < RECFMT_CHUNK_HEADER_SIZE_V1 || hdr->chunkHeaderSize >= hdr->chunkSize ||
+	   (hdr->chunkSize - hdr->chunkHeaderSize) % hdr->lineSize != 0)
+		return recfmtHeaderCorrupt;
+
+	return recfmtHeaderOK;
+}
+
+uint8_t recfmt_codec(const recfmtFileHeader* hdr){
+	/// Codec of the data chunks of a checked file header (recfmtCodecNone for headers written before the field existed).
+
+
+	if(hdr->headerSize < offsetof(recfmtFileHeader, codec) + sizeof(hdr->codec) + sizeof(hdr->crc))
+		return recfmtCodecNone;
+	return hdr->codec;
+}
+
+uint32_t recfmt_chunkSeed(const recfmtFileHeader* hdr){
+	/// Seed of the chunk checksums of a checked file header: the checksum of the header, which covers the nonce of the file
+	/// (0 for headers written before the nonce existed - their chunk checksums aren't seeded).
+
+
+	if(hdr->headerSize < offsetof(recfmtFileHeader, nonce) + sizeof(hdr->nonce) + sizeof(hdr->crc))
+		return 0;
+	return hdr->crc;
+}
+
+uint16_t recfmt_countSamples(const recfmtLayout* lay, const uint8_t* lines){
+	/// Number of measurement lines (lines that don't belong to an event group) of a block.
+	///
+	///	lay		... Layout of the lines
+	///	lines	... Lines of the block (lay->lines * lay->lineSize bytes)
+
+
+	uint16_t count = 0;
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) == lay->eventMarker)
+			l += recfmt_eventLines(lay, line, l);
+		else{
+			count++;
+			l++;
+		}
+	}
+	return count;
+}
+
+uint16_t recfmt_sampleRange(const recfmtLayout* lay, const uint8_t* lines, uint16_t* min, uint16_t* max){
+	/// Number of measurement lines of a block (see recfmt_countSamples) and the smallest and biggest sample of every channel in them.
+	/// min/max are only lowered/raised, so several blocks can be collected (start with 0xFFFF and 0).
+	///
+	///	lay		... Layout of the lines
+	///	lines	... Lines of the block (lay->lines * lay->lineSize bytes)
+	///	min		... Smallest sample of every channel (lay->channels values)
+	///	max		... Biggest sample of every channel (lay->channels values)
+
+
+	uint16_t count = 0;
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) == lay->eventMarker){
+			l += recfmt_eventLines(lay, line, l);
+			continue;
+		}
+		for(uint8_t c = 0; c < lay->channels; c++){
+			uint16_t v = RECFMT_RD16(line + 2*c);
+			if(v < min[c])
+				min[c] = v;
+			if(v > max[c])
+				max[c] = v;
+		}
+		count++;
+		l++;
+	}
+	return count;
+}
+
+uint16_t recfmt_nextSample(const recfmtLayout* lay, const uint8_t* lines, uint16_t l){
+	/// Index of the next measurement line of a block at or behind line l (event groups are skipped). Returns lay->lines if there is none.
+	/// Must be called for l = 0 or a line behind a measurement line (event groups are found from their start).
+	///
+	///	lay		... Layout of the lines
+	///	lines	... Lines of the block (lay->lines * lay->lineSize bytes)
+	///	l		... First line to check
+
+
+	while(l < lay->lines && RECFMT_RD16(lines + l*lay->lineSize) == lay->eventMarker)
+		l += recfmt_eventLines(lay, lines + l*lay->lineSize, l);
+	return (l < lay->lines) ? l : lay->lines;
+}
+
+uint16_t recfmt_countEvents(const recfmtLayout* lay, const uint8_t* lines, uint8_t type){
+	/// Number of event groups of a type in a block (only the event lines are looked at, measurement lines are skipped).
+	///
+	///	lay		... Layout of the lines
+	///	lines	... Lines of the block (lay->lines * lay->lineSize bytes)
+	///	type	... Event type (byte behind the event marker)
+
+
+	uint16_t count = 0;
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) != lay->eventMarker){
+			l++;
+			continue;
+		}
+		if(line[2] == type)
+			count++;
+		l += recfmt_eventLines(lay, line, l);
+	}
+	return count;
+}
+
+uint16_t recfmt_encodeFrame(const recfmtLayout* lay, const uint8_t* lines, uint8_t maxMode, uint8_t* frame){
+	/// Encode the lines of one block to a frame (see recfmt.h) with the mode that gives the smallest frame, using modes up to maxMode.
+	/// Takes two passes over the block and no memory beside the frame. Returns the size of the frame (at most RECFMT_FRAME_SIZE_MAX).
+	///
+	///	lay		... Layout of the lines (channels must not exceed RECFMT_CHANNELS_MAX)
+	///	lines	... Lines of the block (lay->lines * lay->lineSize bytes)
+	///	maxMode	... Highest allowed mode (recfmtCodecs)
+	///	frame	... Output, at least RECFMT_FRAME_SIZE_MAX bytes
+
+
+	uint16_t measLines = 0;				// Lines holding samples
+	uint32_t eventBytes = 0;			// Bytes of all event groups
+	uint16_t events = 0;				// Number of event groups
+	uint8_t  fits = 1;					// 0 if a sample doesn't fit into RECFMT_SAMPLE_BITS
+	uint16_t first[RECFMT_CHANNELS_MAX];// First sample of every channel
+	uint16_t prev[RECFMT_CHANNELS_MAX];	// Previous sample of every channel
+	uint32_t maxZig[RECFMT_CHANNELS_MAX] = {0}; // Biggest zigzag coded difference of every channel
+	uint8_t  width[RECFMT_CHANNELS_MAX];// Bits per difference of every channel
+
+	// Pass 1: Find event groups, check range of the samples and get the biggest difference of every channel
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) == lay->eventMarker){
+			uint16_t n = recfmt_eventLines(lay, line, l);
+			eventBytes += 3 + n*lay->lineSize;
+			events++;
+			l += n;
+			continue;
+		}
+		for(uint8_t c = 0; c < lay->channels; c++){
+			uint16_t v = RECFMT_RD16(line + 2*c);
+			if(v >> RECFMT_SAMPLE_BITS)
+				fits = 0;
+			if(measLines == 0)
+				first[c] = v;
+			else{
+				uint32_t z = RECFMT_ZIGZAG((int32_t)v - (int32_t)prev[c]);
+				if(z > maxZig[c])
+					maxZig[c] = z;
+			}
+			prev[c] = v;
+		}
+		measLines++;
+		l++;
+	}
+
+	// Size of every mode - use the smallest
+	uint32_t bitsWidth = 0;
+	for(uint8_t c = 0; c < lay->channels; c++){
+		width[c] = 0;
+		while(maxZig[c] >> width[c])
+			width[c]++;
+		bitsWidth += width[c];
+	}
+	uint8_t  mode = recfmtCodecNone;
+	uint32_t size = RECFMT_FRAME_SIZE_MAX(lay);
+	if(fits && events <= 0xFF){
+		uint32_t sizePack12 = sizeof(recfmtFrameHeader) + eventBytes + (measLines*lay->channels*RECFMT_SAMPLE_BITS + 7)/8;
+		uint32_t sizeDelta = sizeof(recfmtFrameHeader) + eventBytes +
+							 ((measLines ? lay->channels*(RECFMT_SAMPLE_BITS+RECFMT_WIDTH_BITS) + (measLines-1)*bitsWidth : 0) + 7)/8;
+		if(maxMode >= recfmtCodecPack12 && sizePack12 < size){
+			mode = recfmtCodecPack12;
+			size = sizePack12;
+		}
+		if(maxMode >= recfmtCodecDelta && sizeDelta < size){
+			mode = recfmtCodecDelta;
+			size = sizeDelta;
+		}
+	}
+
+	// Frame header
+	recfmtFrameHeader hdr = {.size = (uint16_t)size, .mode = mode, .events = (mode == recfmtCodecNone) ? 0 : (uint8_t)events};
+	memcpy(frame, &hdr, sizeof(hdr));
+	uint8_t* p = frame + sizeof(hdr);
+
+	// Not smaller encoded - store lines
+	if(mode == recfmtCodecNone){
+		memcpy(p, lines, lay->lines*lay->lineSize);
+		return (uint16_t)size;
+	}
+
+	// Pass 2a: Event groups (line index, number of payload lines and the lines)
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) != lay->eventMarker){
+			l++;
+			continue;
+		}
+		uint16_t n = recfmt_eventLines(lay, line, l);
+		RECFMT_WR16(p, l);
+		p[2] = (uint8_t)(n - 1);
+		memcpy(p + 3, line, n*lay->lineSize);
+		p += 3 + n*lay->lineSize;
+		l += n;
+	}
+
+	// Pass 2b: Samples
+	recfmtBitWriter bw = {.p = p, .acc = 0, .n = 0};
+	if(mode == recfmtCodecDelta){
+		for(uint8_t c = 0; c < lay->channels && measLines > 0; c++){
+			recfmt_bitPut(&bw, first[c], RECFMT_SAMPLE_BITS);
+			recfmt_bitPut(&bw, width[c], RECFMT_WIDTH_BITS);
+		}
+	}
+	uint8_t firstLine = 1;
+	for(uint16_t l = 0; l < lay->lines; ){
+		const uint8_t* line = lines + l*lay->lineSize;
+		if(RECFMT_RD16(line) == lay->eventMarker){
+			l += recfmt_eventLines(lay, line, l);
+			continue;
+		}
+		for(uint8_t c = 0; c < lay->channels; c++){
+			uint16_t v = RECFMT_RD16(line + 2*c);
+			if(mode == recfmtCodecPack12)
+				recfmt_bitPut(&bw, v, RECFMT_SAMPLE_BITS);
+			else if(!firstLine)
+				recfmt_bitPut(&bw, RECFMT_ZIGZAG((int32_t)v - (int32_t)prev[c]), width[c]);
+			prev[c] = v;
+		}
+		firstLine = 0;
+		l++;
+	}
+	if(bw.n > 0)
+		*bw.p++ = (uint8_t)bw.acc;
+
+	return (uint16_t)size;
+}
+
+uint8_t recfmt_decodeFrame(const recfmtLayout* lay, const uint8_t* frame, uint16_t size, uint8_t* lines){
+	/// Decode a frame (see recfmt.h) to the lines of the block. Padding bytes of measurement lines are zero.
+	/// Returns 1 if OK, 0 if the frame doesn't match the layout.
+	///
+	///	lay		... Layout of the lines (same as for encoding)
+	///	frame	... The frame (starting with its header)
+	///	size	... Bytes of the frame
+	///	lines	... Output, lay->lines * lay->lineSize bytes
+
+
+	recfmtFrameHeader hdr;
+	if(size < sizeof(hdr))
+		return 0;
+	memcpy(&hdr, frame, sizeof(hdr));
+	if(hdr.size != size || lay->channels > RECFMT_CHANNELS_MAX)
+		return 0;
+	const uint8_t* p = frame + sizeof(hdr);
+	const uint8_t* end = frame + size;
+
+	// Lines stored verbatim
+	if(hdr.mode == recfmtCodecNone){
+		if(size != RECFMT_FRAME_SIZE_MAX(lay))
+			return 0;
+		memcpy(lines, p, lay->lines*lay->lineSize);
+		return 1;
+	}
+	if(hdr.mode > recfmtCodecDelta)
+		return 0;
+
+	// Skip event groups to find the samples
+	const uint8_t* ev = p;
+	for(uint8_t e = 0; e < hdr.events; e++){
+		if(p + 3 > end)
+			return 0;
+		p += 3 + (p[2] + 1)*lay->lineSize;
+	}
+	if(p > end)
+		return 0;
+
+	// Lines in order: copy event groups, decode samples of the other lines
+	recfmtBitReader br = {.p = p, .end = end, .acc = 0, .n = 0, .overrun = 0};
+	uint16_t prev[RECFMT_CHANNELS_MAX];
+	uint8_t  width[RECFMT_CHANNELS_MAX];
+	uint8_t  nextEvent = 0;
+	uint8_t  firstLine = 1;
+	memset(lines, 0, lay->lines*lay->lineSize);
+	for(uint16_t l = 0; l < lay->lines; ){
+		uint8_t* line = lines + l*lay->lineSize;
+
+		// Event group
+		if(nextEvent < hdr.events && RECFMT_RD16(ev) == l){
+			uint16_t n = ev[2] + 1;
+			if(l + n > lay->lines)
+				return 0;
+			memcpy(line, ev + 3, n*lay->lineSize);
+			ev += 3 + n*lay->lineSize;
+			nextEvent++;
+			l += n;
+			continue;
+		}
+
+		// Samples
+		if(firstLine && hdr.mode == recfmtCodecDelta){
+			for(uint8_t c = 0; c < lay->channels; c++){
+				prev[c] = (uint16_t)recfmt_bitGet(&br, RECFMT_SAMPLE_BITS);
+				width[c] = (uint8_t)recfmt_bitGet(&br, RECFMT_WIDTH_BITS);
+			}
+		}
+		for(uint8_t c = 0; c < lay->channels; c++){
+			uint16_t v;
+			if(hdr.mode == recfmtCodecPack12)
+				v = (uint16_t)recfmt_bitGet(&br, RECFMT_SAMPLE_BITS);
+			else if(firstLine)
+				v = prev[c];
+			else{
+				uint32_t z = recfmt_bitGet(&br, width[c]);
+				v = (uint16_t)(prev[c] + RECFMT_UNZIGZAG(z));
+			}
+			prev[c] = v;
+			RECFMT_WR16(line + 2*c, v);
+		}
+		firstLine = 0;
+		l++;
+	}
+
+	return (!br.overrun && nextEvent == hdr.events) ? 1 : 0;
+}
+
+static uint32_t recfmt_lodFullPages(const recfmtLodHeader* hdr, uint32_t finished, uint8_t level){
+	/// Full pages of a level that are written after 'finished' buckets of level 0 were finished.
+
+
+	for(uint8_t l = 0; l < level; l++)
+		finished /= hdr->factor;
+	return finished / RECFMT_LOD_PAGE_BUCKETS(hdr);
+}
+
+static uint32_t recfmt_lodStreamPages(const recfmtLodHeader* hdr, uint32_t finished){
+	/// Full pages of all levels that are written after 'finished' buckets of level 0 were finished.
+
+
+	uint32_t pages = 0;
+	for(uint8_t l = 0; l < hdr->levels; l++)
+		pages += recfmt_lodFullPages(hdr, finished, l);
+	return pages;
+}
+
+uint8_t recfmt_lodContent(const recfmtLodHeader* hdr, uint32_t pages, recfmtLodContent* content){
+	/// Check the header of a pyramid (see recfmt.h) and get the number of buckets of every level. A complete file holds all buckets of its lines,
+	/// one that wasn't closed (power loss) the full pages up to the last full page of level 0 that is in the file with all pages written before it.
+	/// Returns 1 if OK, 0 if the header is invalid
+	///
+	///	hdr		... Header of the pyramid
+	///	pages	... Pages in the file behind the header ((file size - pageSize) / pageSize)
+	///	content	... Returns the buckets of the levels
+
+
+	memset(content, 0, sizeof(recfmtLodContent));
+	if(memcmp(hdr->magic, RECFMT_LOD_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != RECFMT_LOD_VERSION || hdr->headerSize > hdr->pageSize ||
+	   hdr->levels == 0 || hdr->levels > RECFMT_LOD_LEVELS_MAX || hdr->base == 0 || hdr->factor < 2 || hdr->channels == 0 ||
+	   hdr->channels > RECFMT_CHANNELS_MAX || hdr->bucketSize != hdr->channels*sizeof(recfmtLodValue) || hdr->pageSize < sizeof(recfmtLodPage) + hdr->bucketSize)
+		return 0;
+	uint32_t perPage = RECFMT_LOD_PAGE_BUCKETS(hdr);
+
+	// Complete - the last bucket of every level holds the rest of the lines
+	if(hdr->complete){
+		content->finished = hdr->samples / hdr->base;
+		uint32_t n = hdr->samples / hdr->base + ((hdr->samples % hdr->base) ? 1 : 0);
+		for(uint8_t l = 0; l < hdr->levels; l++){
+			content->buckets[l] = n;
+			n = n / hdr->factor + ((n % hdr->factor) ? 1 : 0);
+		}
+		return 1;
+	}
+
+	// Not closed - most full pages of level 0 whose pages (and those of the other levels written before) are in the file.
+	// The pages of all levels are less than factor/(factor-1) times the ones of level 0, so the search starts close below.
+	uint32_t full0 = pages / hdr->factor * (hdr->factor - 1);
+	while(recfmt_lodStreamPages(hdr, (full0 + 1)*perPage) <= pages)
+		full0++;
+	content->finished = full0*perPage;
+	for(uint8_t l = 0; l < hdr->levels; l++)
+		content->buckets[l] = recfmt_lodFullPages(hdr, content->finished, l)*perPage;
+	return 1;
+}
+
+uint32_t recfmt_lodPage(const recfmtLodHeader* hdr, const recfmtLodContent* content, uint8_t level, uint32_t page){
+	/// Position of a page of a level in the pyramid file (page number, 1 = first page behind the header, offset = position * pageSize).
+	/// Full pages are written in the order they are finished: with the bucket of level 0 that fills a page of level 0 the buckets of the higher
+	/// levels are finished as well, their pages follow in the order of the levels. The last partly filled pages of all levels (written when the file
+	/// is closed) follow behind all full pages in the order of the levels.
+	/// Returns 0 if the page isn't in the file
+	///
+	///	hdr		... Header of the pyramid
+	///	content	... Buckets of the levels (see recfmt_lodContent)
+	///	level	... Level of the page
+	///	page	... Number of the page in its level (bucket / RECFMT_LOD_PAGE_BUCKETS)
+
+
+	uint32_t perPage = RECFMT_LOD_PAGE_BUCKETS(hdr);
+	if(level >= hdr->levels || (uint64_t)page*perPage >= content->buckets[level])
+		return 0;
+
+	// Last page of the level - written at the end, behind the last pages of the lower levels
+	if(page >= recfmt_lodFullPages(hdr, content->finished, level)){
+		uint32_t pos = 1 + recfmt_lodStreamPages(hdr, content->finished);
+		for(uint8_t l = 0; l < level; l++){
+			if(content->buckets[l] > recfmt_lodFullPages(hdr, content->finished, l)*perPage)
+				pos++;
+		}
+		return pos;
+	}
+
+	// Full page - finished with bucket t-1 of level 0. Pages of lower levels finished with it are before it, the ones of higher levels after it.
+	uint64_t t = (uint64_t)(page + 1)*perPage;
+	for(uint8_t l = 0; l < level; l++)
+		t *= hdr->factor;
+	uint32_t pos = 1;
+	uint64_t bucketsPerPage = perPage;
+	for(uint8_t l = 0; l < hdr->levels; l++){
+		pos += (uint32_t)(((l < level) ? t : t - 1) / bucketsPerPage);
+		bucketsPerPage *= hdr->factor;
+	}
+	return pos;
+}
+
+uint8_t recfmt_checkCal(const void* file, uint32_t size){
+	/// Check if a binary calibration file is complete and unchanged (see recfmtCalHeader).
+	/// Returns 1 if it can be used, 0 if the magic, the size or the checksum is wrong.
+	///
+	///	file	... Content of the file
+	///	size	... Bytes of the file
+
+
+	const recfmtCalHeader* hdr = (const recfmtCalHeader*)file;
+
+	// Magic and header (a newer writer may have appended fields)
+	if(size < sizeof(recfmtCalHeader) || memcmp(hdr->magic, RECFMT_CAL_MAGIC, sizeof(hdr->magic)) != 0)
+		return 0;
+	if(hdr->version == 0 || hdr->headerSize < sizeof(recfmtCalHeader) || (hdr->headerSize & 3) != 0 || hdr->points > RECFMT_CAL_POINTS_MAX)
+		return 0;
+
+	// Size of the data points and checksum in the last 4 bytes
+	if(size != RECFMT_CAL_SIZE(hdr->headerSize, hdr->points))
+		return 0;
+	uint32_t crc;
+	memcpy(&crc, (const uint8_t*)file + size - sizeof(crc), sizeof(crc));
+	return recfmt_crc32(0, file, size - sizeof(crc)) == crc;
+}
@@ -0,0 +1,255 @@
+/*
+ * recfmt.h
+ *
+ *  Created on: 22 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef RECFMT_H_
+#define RECFMT_H_
+
+#include <stdint.h>
+
+/// Container format of the .BIN recording. Shared by the firmware (record.c) and the host tools (see Tools/recinfo, codec and sidecars are
+/// checked by Tools/codectest), therefore this file must not depend on DAVE or globals.h. All values are little endian, all structs are
+/// naturally aligned (no implicit padding).
+///
+/// File:  [file header chunk][data chunk 0][data chunk 1]...
+///        Every chunk is recfmtFileHeader.chunkSize bytes (= FIFO_BLOCK_SIZE of the recording firmware). Data chunk n therefore starts at
+///        (n+1)*chunkSize, so every chunk can be checked on its own without reading the rest of the file.
+/// Chunk: [recfmtChunkHeader][padding up to chunkHeaderSize][lines...]
+///        A data chunk is exactly one FIFO block - the measurement handler leaves the first chunkHeaderSize bytes of every block free and
+///        record_block fills in the header right before the block is written. Lines never cross the end of a chunk, events (several
+///        lines) may continue in the next chunk.
+/// Files without header (recorded before this format, magic doesn't match) are converted with the settings of the running firmware.
+///
+/// Compressed files (recfmtFileHeader.codec != recfmtCodecNone) hold packed chunks (RECFMT_CHUNK_MAGIC_PACKED) instead of FIFO blocks:
+/// Packed chunk: [recfmtChunkHeader][padding up to chunkHeaderSize][recfmtPackedPrefix][frames...][zero]
+///        Every FIFO block (its lines, without the chunk header space) is encoded to one frame (recfmt_encodeFrame). Frames are stored one after
+///        another and may continue in the next chunk. recfmtPackedPrefix tells where the first frame starting in the chunk is, so decoding can
+///        restart after a lost chunk. Decoded frames are identical to the FIFO blocks, except that padding bytes of measurement lines are zero.
+/// Frame: [recfmtFrameHeader][event groups][samples]
+///        Event groups (event line and its payload lines, never split over two blocks) are stored verbatim with their line index. The samples of
+///        all other lines are stored by mode: recfmtCodecPack12 = every sample with 12 bit, recfmtCodecDelta = first sample of every channel with
+///        12 bit and the zigzag coded differences to the previous line with the smallest bit width that fits the block (per channel).
+///        Bits are written LSB first. A block that isn't smaller encoded (or has samples above 12 bit) is stored as recfmtCodecNone (lines verbatim).
+#define RECFMT_MAGIC			"DABN"		// First 4 bytes of the file
+#define RECFMT_VERSION			3			// Increment if the meaning of a field changes. New fields are appended (headerSize/chunkHeaderSize grow)
+#define RECFMT_HEADER_SIZE_V1	820			// headerSize of version 1 (without codec) - smallest valid header
+#define RECFMT_CHUNK_MAGIC		0xC4DA		// First 2 bytes of every data chunk (lines, one FIFO block)
+#define RECFMT_CHUNK_MAGIC_PACKED 0xC4DB	// First 2 bytes of every packed data chunk (frames)
+#define RECFMT_NO_FRAME			0xFFFF		// recfmtPackedPrefix.frameStart if no frame starts in the chunk
+#define RECFMT_CHANNELS_MAX		6			// Channels in the file header (used ones see recfmtFileHeader.channels)
+#define RECFMT_STAGES_MAX		4			// Conversion stages per channel. Must not be smaller than CONV_STAGES_MAX!
+#define RECFMT_NAME_LEN			12			// Bytes of a channel name (zero terminated if shorter)
+#define RECFMT_FIRMWARE_LEN		24			// Bytes of the firmware version string (zero terminated if shorter)
+#define RECFMT_INDEX_MAGIC		"DAIX"		// First 4 bytes of the index of a recording (.IDX)
+#define RECFMT_INDEX_VERSION	1			// Increment if the meaning of a field of the index changes
+#define RECFMT_LOD_MAGIC		"DALD"		// First 4 bytes of the min/max/mean pyramid of a recording (.LOD)
+#define RECFMT_LOD_VERSION		1			// Increment if the meaning of a field of the pyramid changes
+#define RECFMT_LOD_LEVELS_MAX	8			// Levels of the pyramid
+#define RECFMT_CAL_MAGIC		"DACL"		// First 4 bytes of a binary calibration file
+#define RECFMT_CAL_VERSION		1			// Increment if the meaning of a field of the calibration file changes
+#define RECFMT_CAL_POINTS_MAX	255			// Data points of a calibration file
+
+// Result of recfmt_checkHeader
+enum recfmtHeaderStates{recfmtHeaderNone=0, recfmtHeaderOK, recfmtHeaderCorrupt};
+
+// Codec of the data chunks (file header) or a frame
+enum recfmtCodecs{recfmtCodecNone=0, recfmtCodecPack12, recfmtCodecDelta};
+
+// Type of the samples of a channel
+enum recfmtSampleTypes{recfmtSampleNone=0, recfmtSampleU16, recfmtSampleI16, recfmtSampleU32};
+
+// Post processing of the recording firmware (compile time options, see POSTPROCESS_ in globals.h)
+enum recfmtPostProcess{recfmtChangeOrderAtErrors=0x01, recfmtInterpolateErrors=0x02, recfmtBuggedValues=0x04};
+
+// Conversion stage (see convStage in globals.h)
+typedef struct {
+	uint8_t  type;					// convStageTypes
+	uint8_t  order;					// Order of the polynomial
+	uint8_t  reserved[2];
+	float    coefficients[4];		// Coefficients of the polynomial
+} recfmtStage;
+
+// Calibration and filter settings of one channel (see sensor in globals.h)
+typedef struct {
+	char     name[RECFMT_NAME_LEN];	// Name of the sensor
+	uint8_t  sampleType;			// recfmtSampleTypes
+	uint8_t  sampleSize;			// Bytes of one sample in a line
+	uint8_t  fitOrder;				// Order of the calibration fit
+	uint8_t  convStages;			// Number of used conversion stages
+	uint16_t avgFilterInterval;		// Size of the moving average filter
+	uint16_t errorThreshold;		// Raw values above are errors
+	float    fitCoefficients[4];	// Coefficients of the calibration fit
+	float    originPoint;			// Offset to the zero point
+	float    operatingPoint;		// Offset from origin to operating point
+	float    trackerTheta;			// Smoothing parameter of the tracker
+	recfmtStage stages[RECFMT_STAGES_MAX]; // Conversion stages after the calibration fit
+} recfmtChannel;
+
+// File header (first chunk of the file, rest of the chunk is zero)
+typedef struct {
+	char     magic[4];				// RECFMT_MAGIC
+	uint16_t version;				// RECFMT_VERSION of the writer
+	uint16_t headerSize;			// sizeof(recfmtFileHeader) of the writer (CRC is in the last 4 bytes)
+	uint16_t chunkSize;				// Bytes of every chunk including its header
+	uint16_t chunkHeaderSize;		// Bytes at the start of a data chunk before the first line
+	uint16_t lineSize;				// Bytes of one line (samples of all channels + padding, also size of event lines)
+	uint16_t linePad;				// Padding bytes at the end of a measurement line
+	uint16_t eventMarker;			// Value of the first sample of an event line
+	uint8_t  channels;				// Number of used channels (order of the samples in a line)
+	uint8_t  postProcess;			// recfmtPostProcess flags
+	float    interval;				// Time between two measurement lines in ms
+	char     firmware[RECFMT_FIRMWARE_LEN]; // Version of the recording firmware
+	recfmtChannel channel[RECFMT_CHANNELS_MAX];
+	uint8_t  codec;					// recfmtCodecs - highest mode used by the frames (since version 2, use recfmt_codec)
+	uint8_t  reserved[3];
+	uint32_t nonce;					// Random number of the recording file - makes the chunk checksums of every file unique (since version 3, see recfmt_chunkSeed)
+	uint32_t crc;					// recfmt_crc32 of all bytes before this field
+} recfmtFileHeader;
+
+// Header of a data chunk
+typedef struct {
+	uint16_t magic;					// RECFMT_CHUNK_MAGIC or RECFMT_CHUNK_MAGIC_PACKED
+	uint16_t dataSize;				// Bytes of lines (or packed data) behind the chunk header (chunkSize - chunkHeaderSize)
+	uint32_t seq;					// Running number of the data chunk (0 = first chunk after the file header)
+	uint32_t crc;					// Checksum of the chunk without this field, seeded with the file header (see recfmt_chunkCrc)
+	uint32_t sample;				// Index of the first measurement line in the chunk (packed: of the frame at frameStart) - since version 2
+} recfmtChunkHeader;
+#define RECFMT_CHUNK_HEADER_SIZE_V1	12	// Size of the chunk header of version 1 (without sample) - smallest valid chunkHeaderSize
+
+// Start of the data of a packed chunk
+typedef struct {
+	uint16_t frameStart;			// Offset of the first frame starting in this chunk (from the start of the chunk data) or RECFMT_NO_FRAME
+	uint16_t used;					// Bytes of the chunk data in use (prefix and frames, the rest is zero)
+	uint32_t frameSeq;				// Running number (FIFO block) of the frame at frameStart
+} recfmtPackedPrefix;
+
+// Header of a frame
+typedef struct {
+	uint16_t size;					// Bytes of the frame including this header
+	uint8_t  mode;					// recfmtCodecs
+	uint8_t  events;				// Number of event groups
+} recfmtFrameHeader;
+
+// Layout of the lines of a block (taken from the file header)
+typedef struct {
+	uint16_t lines;					// Lines per block ((chunkSize - chunkHeaderSize) / lineSize)
+	uint16_t lineSize;				// Bytes of one line
+	uint16_t eventMarker;			// First sample of an event line
+	uint8_t  channels;				// Samples (16 bit, only recfmtSampleU16 can be encoded) at the start of every measurement line
+} recfmtLayout;
+#define RECFMT_FRAME_SIZE_MAX(lay)	(sizeof(recfmtFrameHeader) + (lay)->lines*(lay)->lineSize) // Biggest frame (stored verbatim)
+
+/// Index of a recording: sidecar file with the name of the .BIN file and the extension .IDX (one per segment). Lets readers jump to a sample
+/// and draw an overview without reading the .BIN file. Written while recording, so entries can be missing at the end of a repaired file.
+/// Index: [recfmtIndexHeader][recfmtIndexEntry 0][recfmtIndexEntry 1]...
+///        Entries are in the order of the file. An entry is made at the first block (frame) that starts in a data chunk at or behind the next
+///        multiple of recfmtIndexHeader.chunks, so decoding can start at the beginning of its chunk (packed: at recfmtPackedPrefix.frameStart).
+///        min/max cover all measurement lines up to the next entry (min > max if there are none). marks counts the event groups of the type
+///        recfmtIndexHeader.markType in these lines, so marked positions are found in the index without decoding the .BIN file.
+
+// Header of the index
+typedef struct {
+	char     magic[4];				// RECFMT_INDEX_MAGIC
+	uint16_t version;				// RECFMT_INDEX_VERSION of the writer
+	uint16_t headerSize;			// sizeof(recfmtIndexHeader) of the writer (first entry starts here)
+	uint16_t entrySize;				// sizeof(recfmtIndexEntry) of the writer
+	uint16_t chunks;				// Data chunks between two entries
+	uint16_t chunkSize;				// recfmtFileHeader.chunkSize of the .BIN file
+	uint8_t  channels;				// Used channels of min/max
+	uint8_t  markType;				// Event type counted in recfmtIndexEntry.marks (0 = none, written by firmware before marks existed)
+} recfmtIndexHeader;
+
+// Entry of the index
+typedef struct {
+	uint32_t sample;				// Index of the first measurement line of the entry (= recfmtChunkHeader.sample of its chunk)
+	uint32_t chunk;					// Running number of the data chunk the entry starts in (file offset (chunk+1)*chunkSize)
+	uint16_t min[RECFMT_CHANNELS_MAX];	// Smallest raw value of every channel
+	uint16_t max[RECFMT_CHANNELS_MAX];	// Biggest raw value of every channel
+	uint16_t marks;					// Number of event groups of type markType (see recfmtIndexHeader)
+	uint16_t reserved;
+} recfmtIndexEntry;
+
+/// Pyramid of a recording: sidecar file with the name of the .BIN file and the extension .LOD (one per segment). Holds the smallest, biggest
+/// and mean raw value of every channel for buckets of lines on several levels, so a plot of any time window at any zoom needs about one
+/// bucket per pixel instead of a pass over the .BIN file. Written while recording.
+/// Pyramid: [page: recfmtLodHeader, rest zero][page][page]...
+///        Every page is recfmtLodHeader.pageSize bytes: [recfmtLodPage][bucket][bucket]... and a bucket is recfmtLodValue of every channel.
+///        A bucket of level 0 covers recfmtLodHeader.base measurement lines, a bucket of level n covers factor buckets of level n-1.
+///        Bucket i of a level starts at line i * base * factor^level (counted from the first measurement line of the .BIN file).
+///        Full pages are in the order they were finished (see recfmt_lodPage), so their position is computed instead of being stored.
+///        The last partly filled page of every level follows at the end when the file is closed (complete = 1). A file that wasn't closed
+///        holds full pages only (see recfmt_lodContent).
+
+// Header of the pyramid (start of the first page)
+typedef struct {
+	char     magic[4];				// RECFMT_LOD_MAGIC
+	uint16_t version;				// RECFMT_LOD_VERSION of the writer
+	uint16_t headerSize;			// sizeof(recfmtLodHeader) of the writer
+	uint16_t pageSize;				// Bytes of every page (also of the one holding this header)
+	uint16_t bucketSize;			// Bytes of one bucket (channels * sizeof(recfmtLodValue))
+	uint16_t base;					// Measurement lines of a bucket of level 0
+	uint8_t  factor;				// Buckets of a level in a bucket of the next level
+	uint8_t  levels;				// Number of levels
+	uint8_t  channels;				// Used channels of every bucket
+	uint8_t  complete;				// 1 if the file was closed (samples is valid and the last pages are written)
+	uint8_t  reserved[2];
+	uint32_t samples;				// Measurement lines covered by the pyramid (0 until the file is closed)
+} recfmtLodHeader;
+
+// Header of a page
+typedef struct {
+	uint8_t  level;					// Level of the buckets
+	uint8_t  reserved;
+	uint16_t buckets;				// Buckets in this page (all but the last page of a level are full)
+	uint32_t first;					// Number of the first bucket of the page in its level
+} recfmtLodPage;
+
+// Values of one channel in a bucket
+typedef struct {
+	uint16_t min;					// Smallest raw value
+	uint16_t max;					// Biggest raw value
+	uint16_t mean;					// Mean of the raw values (rounded)
+} recfmtLodValue;
+
+// Buckets of a pyramid file (see recfmt_lodContent)
+typedef struct {
+	uint32_t finished;				// Buckets of level 0 finished while the file was written (gives the order of the full pages)
+	uint32_t buckets[RECFMT_LOD_LEVELS_MAX];	// Buckets of every level in the file
+} recfmtLodContent;
+#define RECFMT_LOD_PAGE_BUCKETS(hdr)	(((hdr)->pageSize - sizeof(recfmtLodPage)) / (hdr)->bucketSize) // Buckets of a full page
+
+/// Calibration of a sensor: binary form of the .CAL text file with the same name (extension see RECORD_CAL_BIN_EXT in globals.h). Loaded
+/// with a single read, the text file is kept as the human readable export.
+/// Calibration: [recfmtCalHeader][float x[points]][float y[points]][uint32_t crc]
+///        The data points start at headerSize. crc is recfmt_crc32 of all bytes before it (see recfmt_checkCal).
+
+// Header of a calibration file
+typedef struct {
+	char     magic[4];				// RECFMT_CAL_MAGIC
+	uint16_t version;				// RECFMT_CAL_VERSION of the writer
+	uint16_t headerSize;			// sizeof(recfmtCalHeader) of the writer (data points start here)
+	uint16_t points;				// Number of data points used for the fit
+	uint16_t reserved;
+	recfmtChannel channel;			// Calibration and filter settings (sampleType/sampleSize of the firmware that wrote the file)
+} recfmtCalHeader;
+#define RECFMT_CAL_SIZE(hdrSize, points)	((hdrSize) + 2*(points)*sizeof(float) + sizeof(uint32_t)) // Bytes of a calibration file
+
+uint32_t recfmt_crc32(uint32_t crc, const void* data, uint32_t size);
+uint32_t recfmt_chunkCrc(const void* chunk, uint16_t chunkHeaderSize, uint32_t seed);
+uint8_t recfmt_checkHeader(const void* chunk, uint32_t size);
+uint8_t recfmt_codec(const recfmtFileHeader* hdr);
+uint32_t recfmt_chunkSeed(const recfmtFileHeader* hdr);
+uint16_t recfmt_countSamples(const recfmtLayout* lay, const uint8_t* lines);
+uint16_t recfmt_sampleRange(const recfmtLayout* lay, const uint8_t* lines, uint16_t* min, uint16_t* max);
+uint16_t recfmt_nextSample(const recfmtLayout* lay, const uint8_t* lines, uint16_t l);
+uint16_t recfmt_countEvents(const recfmtLayout* lay, const uint8_t* lines, uint8_t type);
+uint16_t recfmt_encodeFrame(const recfmtLayout* lay, const uint8_t* lines, uint8_t maxMode, uint8_t* frame);
+uint8_t recfmt_decodeFrame(const recfmtLayout* lay, const uint8_t* frame, uint16_t size, uint8_t* lines);
+uint8_t recfmt_lodContent(const recfmtLodHeader* hdr, uint32_t pages, recfmtLodContent* content);
+uint32_t recfmt_lodPage(const recfmtLodHeader* hdr, const recfmtLodContent* content, uint8_t level, uint32_t page);
+uint8_t recfmt_checkCal(const void* file, uint32_t size);
+
+#endif /* RECFMT_H_ */
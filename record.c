@@ -11,10 +11,33 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <float.h>
 #include <DAVE.h>
 #include "globals.h"
 #include "record.h"
+#include "sync.h"
+#include "recfmt.h"
+#include "sdqueue.h"
+#include "sdwrite.h"
+
+// The file header must be able to describe every sensor and conversion stage
+#if SENSORS_SIZE > RECFMT_CHANNELS_MAX || CONV_STAGES_MAX > RECFMT_STAGES_MAX
+#error "Recording format (recfmt.h) can not describe all sensors or conversion stages"
+#endif
+
+// Every FIFO block and every packed chunk that is waiting to be written must fit into the write queue (see record_writeBlocks)
+#if FIFO_BLOCKS > SDQUEUE_LENGTH || RECORD_PACK_CHUNKS > SDQUEUE_LENGTH
+#error "SDQUEUE_LENGTH must be at least FIFO_BLOCKS and RECORD_PACK_CHUNKS"
+#endif
+
+// Held packed chunks are consecutive buffers and the next chunk is filled while they are written (see record_packWrite)
+#if RECORD_PACK_CHUNKS % RECORD_WRITE_ALIGN_BLOCKS != 0 || RECORD_PACK_CHUNKS < 2*RECORD_WRITE_ALIGN_BLOCKS
+#error "RECORD_PACK_CHUNKS must be a multiple of RECORD_WRITE_ALIGN_BLOCKS and at least twice of it"
+#endif
+#if RECORD_LOD_LEVELS > RECFMT_LOD_LEVELS_MAX || RECORD_LOD_QUEUE < RECORD_LOD_LEVELS + 2
+#error "Pyramid of the recording (RECORD_LOD_...) has too many levels or too few queued pages"
+#endif
 
 //// External variables
 
@@ -31,6 +54,7 @@ extern volatile uint16_t fifo_writeBufIdx;				// index in FIFO buffer
 extern volatile uint8_t fifo_writeBlock;				// current block to write to RAM
 extern volatile uint8_t fifo_recordBlock;				// current block to be recorded to sd-card
 extern volatile uint8_t fifo_finBlock[];				// array of which block is finished an can be recorded
+extern volatile sensor* sensors[];						// all sensors (described in the header of a recording)
 /// Implemented in measure:
 extern void measure_postProcessing(volatile sensor* sens);
 
@@ -40,35 +64,288 @@ extern void measure_postProcessing(volatile sensor* sens);
 /// FATFS variables
 DSTATUS diskStatus;
 static FATFS fs; 	// File system object (volume work area)
-static FIL fil_r; 	// File object used for read only
-static FIL fil_w; 	// File object used for write only
+static uint32_t record_mountSerial;	// Volume serial number of the mounted card (see record_mountDisk)
+static FIL fil_pool[RECORD_FILE_POOL];	// File objects for short file operations (CAL files, screenshot - see record_poolOpen)
+static FIL* fil_bmp = NULL;	// File of the pool used for the screenshot (see record_openBMP)
+static FIL fil_seg[2];	// File objects of the current and the next/finished segment of the recording (used through fil_w and fil_n, see record_swapFile)
+static FIL* fil_w = &fil_seg[0];	// File object used for write only (current segment of the recording)
+static FIL fil_e; 	// File object used for write only (event list written beside the CSV file)
+static FIL fil_cr; 	// File object used for read only (.BIN file of the background conversion)
+static FIL fil_cw; 	// File object used for write only (.CSV file of the background conversion)
+static FIL fil_p; 	// File object of the progress marker of the background conversion
+static FIL fil_o; 	// File object of the marker of the open recording (see record_sync)
+static FIL* fil_n = &fil_seg[1];	// File object of the next segment of the recording (prepared while recording) or of the finished one until it is closed
+static FIL fil_x; 	// File object of the session index (only open while it is accessed)
+static FIL fil_i; 	// File object of the index of the current recording segment (.IDX, see record_indexBlock)
+static FIL fil_s; 	// File object used for read only (.BIN file opened for seeking, see record_seekOpen)
+static FIL fil_si; 	// File object used for read only (index of the .BIN file opened for seeking)
+static FIL fil_lod[2];	// File objects of the pyramids of the current and the next/finished segment (used through fil_l and fil_ln)
+static FIL* fil_l = &fil_lod[0];	// File object of the pyramid of the current recording segment (.LOD, see record_lodBlock)
+static FIL* fil_ln = &fil_lod[1];	// File object of the pyramid of the next segment (prepared with it) or of the finished one until it is closed
+static FIL fil_sl; 	// File object used for read only (pyramid of the .BIN file opened for seeking)
+
+/// Recording variables
+static uint32_t record_fileBlocks = 0;	// Number of FIFO blocks written to the current recording file (used to align the writes)
+static uint32_t record_chunkSeed;		// Seed of the chunk checksums of the current recording file (see recfmt_chunkSeed)
+static uint8_t  record_prealloc = 0;	// 1 if the current recording file was preallocated (contiguous, RECORD_PREALLOC_SIZE) - truncated at stop
+static uint8_t  record_direct = 0;		// 1 if blocks are streamed to the preallocated file with disk_write (until it is full)
+static DWORD    record_directSector;	// First sector of the preallocated file
+static uint32_t record_sampleCount;		// Number of measurement lines in the FIFO blocks processed so far (index of the first line of the next block)
+static char     record_fileName[FILENAME_BUFFER_LENGTH];	// Name of the current recording file (noted in the marker of the open recording)
+#define RECORD_CYCLES_US(cycles)	((cycles) / (SystemCoreClock / 1000000UL))	// CPU cycles (DWT->CYCCNT difference) in us - latencies of the card accesses are measured with the cycle counter, SYSTIMER only counts whole ticks of 1ms
+static uint32_t record_syncTime;		// Time of the last sync of the recording file in us (see record_sync)
+static char     record_backupName[FILENAME_BUFFER_LENGTH];	// New name of the file renamed by the last record_backupFile ('\0' = nothing renamed)
+
+/// Write queue variables (blocks streamed to the preallocated file are written in the background, see record_writeBlocks)
+static sdqueue  record_queue;				// Queued writes of the recording (written by sdwrite, see sdqueue.h)
+static uint8_t  record_writePending = 0;	// Chunks queued and not written yet (FIFO blocks from fifo_recordBlock on or packed chunks, see record_writeDone)
+static uint8_t  record_submitBlock = 0;		// FIFO block submitted next (the ones from fifo_recordBlock up to here are queued)
+
+/// Next free backup number of the base names used last (see record_backupNext)
+typedef struct {
+	char     base[FILENAME_BUFFER_LENGTH];	// Name of the file without extension
+	char     extension[4];			// Extension of the file
+	uint32_t next;					// Next free number (0 = entry unused)
+} recordBackupCache;
+static recordBackupCache record_backupCache[RECORD_BACKUP_CACHE];
+static uint8_t  record_backupCacheIdx;	// Entry used by the last record_backupNext
+static uint8_t  record_backupCacheNext;	// Entry replaced next
+
+/// Segment variables (a recording is split into several .BIN files listed in the session index, see record_segmentSwitch)
+static char     record_sessionName[FILENAME_BUFFER_LENGTH];	// Session index (.SES) of the current recording
+static uint16_t record_segmentNumber;	// Number used for the name of the last segment (base name + 3 digits)
+static uint32_t record_segmentStart;	// record_sampleCount at the start of the current segment
+static uint32_t record_nextTime;		// Time of the last try to prepare the next segment in us
+static uint8_t  record_nextReady = 0;	// 1 if the next segment is prepared (fil_n open, file header written)
+static uint8_t  record_nextStep = 0;		// Next step of the preparation of the next segment (0 = not started, see record_segmentPrepare)
+static char     record_nextName[FILENAME_BUFFER_LENGTH];	// Name of the next segment
+static uint8_t  record_nextPrealloc;	// 1 if the next segment is preallocated
+static DWORD    record_nextSector;		// First sector of the preallocated next segment
+static uint32_t record_nextSeed;		// Seed of the chunk checksums of the next segment
+static uint8_t  record_prevPending = 0;	// 1 if the finished segment (fil_n) still has to be cut and closed (see record_segmentFinish)
+static uint32_t record_prevBlocks;		// Chunks written to the finished segment (including the file header)
+static uint8_t  record_prevPrealloc;	// 1 if the finished segment was preallocated
+recordWriteStats record_writeStats;		// Statistics of the block writes of the current recording (see record_block)
+
+/// Compression variables (only used with RECORD_CODEC, see record_blockPacked)
+static const recfmtLayout record_layout = {	// Layout of the lines of a FIFO block
+	.lines = (FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE) / FIFO_LINE_SIZE,
+	.lineSize = FIFO_LINE_SIZE,
+	.eventMarker = FIFO_EVENT_MARKER,
+	.channels = SENSORS_SIZE
+};
+static uint8_t* record_packBuf = NULL;		// RECORD_PACK_CHUNKS packed chunks (filled one after another, written ones wait in the write queue), followed by the buffer of one encoded frame
+static uint8_t* record_packChunk = NULL;	// Packed chunk being filled (one of record_packBuf)
+static uint16_t record_packPos;				// Next free byte in the data of the packed chunk
+static uint8_t  record_packHeld = 0;		// Full packed chunks behind record_fileBlocks that are held for a coalesced write (see record_packWrite)
+static uint32_t record_packFrameSeq;		// Running number of the next frame (encoded FIFO block)
+static uint32_t record_packSample;			// Index of the first measurement line of the frame at frameStart of the packed chunk
+
+/// Index variables (sidecar .IDX of every segment, see record_indexBlock)
+static recfmtIndexEntry record_idxEntry;	// Entry being collected
+static uint8_t  record_idxOpen = 0;			// 1 if record_idxEntry is being collected
+static recfmtIndexEntry record_idxBuf[RECORD_INDEX_BUFFER];	// Finished entries not written yet
+static uint8_t  record_idxCount = 0;		// Entries in record_idxBuf
+static uint8_t  record_idxPrev = 0;			// Entries at the start of record_idxBuf that belong to the finished segment (see record_segmentSwitch)
+static uint8_t  record_idxReady = 0;		// 1 if the index file of the current segment (fil_i) is open
+
+/// Pyramid variables (sidecar .LOD of every segment, see record_lodBlock)
+typedef struct {
+	uint64_t sum[SENSORS_SIZE];			// Sum of the raw values
+	uint32_t lines;						// Measurement lines in the bucket
+	uint16_t min[SENSORS_SIZE];			// Smallest raw value
+	uint16_t max[SENSORS_SIZE];			// Biggest raw value
+	uint16_t parts;						// Lines (level 0) or buckets of the level below collected
+} recordLodBucket;
+#define RECORD_LOD_PAGE_BUCKETS	((RECORD_LOD_PAGE_SIZE - sizeof(recfmtLodPage)) / (SENSORS_SIZE*sizeof(recfmtLodValue)))	// Buckets of a full page
+static recordLodBucket record_lodBucket[RECORD_LOD_LEVELS];	// Bucket being collected on every level
+static uint32_t record_lodPage[RECORD_LOD_LEVELS][RECORD_LOD_PAGE_SIZE/4];	// Page being filled on every level (words - sectors are written directly from it)
+static uint32_t record_lodQueue[RECORD_LOD_QUEUE][RECORD_LOD_PAGE_SIZE/4];	// Full pages not written yet (in the order of the file)
+static uint8_t  record_lodCount = 0;		// Pages in record_lodQueue
+static uint8_t  record_lodPrev = 0;			// Pages at the start of record_lodQueue that belong to the finished segment (fil_ln, see record_segmentSwitch)
+static uint8_t  record_lodReady = 0;		// 1 if the pyramid of the current segment (fil_l) is open
+static uint8_t  record_lodNextReady = 0;	// 1 if the pyramid of the next or finished segment (fil_ln) is open
+static uint32_t record_lodSamples;			// Measurement lines of the current segment added to the pyramid
+static uint32_t record_lodPrevSamples;		// Measurement lines of the finished segment
+
+/// Seek variables (recording opened for random access, see record_seekOpen)
+static DWORD    record_seekClmt[3][RECORD_SEEK_CLMT_SIZE];	// Cluster link map tables of the .BIN file, its index and its pyramid (fast seek)
+static uint8_t  record_seekReady = 0;		// 1 if a recording is opened for seeking (fil_s)
+static uint16_t record_seekChunkSize;		// Bytes of one chunk of the .BIN file
+static uint16_t record_seekChunkHeaderSize;	// Bytes of the header of a data chunk
+static uint32_t record_seekChunkSeed;		// Seed of the chunk checksums (see recfmt_chunkSeed)
+static uint32_t record_seekChunks;			// Data chunks in the .BIN file
+static uint32_t record_seekEntries;			// Entries of the index (0 = no index, chunk headers are searched)
+static uint16_t record_seekEntryStart;		// Offset of the first entry in the index (header size)
+static uint16_t record_seekEntrySize;		// Bytes of one entry of the index
+static uint8_t  record_seekMarkType;		// Event type counted in the entries of the index (recfmtIndexHeader.markType, 0 = none)
+static recfmtLodHeader record_seekLodHeader;	// Header of the pyramid (levels = 0 if there is none)
+static recfmtLodContent record_seekLodContent;	// Buckets of the levels of the pyramid
+
+/// BIN conversion variables (layout of the file being converted, see record_convertReadLine)
+enum {convChunkEnd=0, convChunkOK, convChunkLost}; // Results of record_convertLoadChunk
+static uint8_t* record_convIn = NULL;		// Input buffer holding several chunks of the .BIN file (followed by frame and decoded block buffer if compressed)
+static uint32_t record_convInSize;			// Bytes read at once (multiple of the chunk size, about RECORD_CONV_READ_SIZE)
+static uint32_t record_convInPos;			// Offset of the next chunk in the input buffer
+static uint32_t record_convInLen;			// Bytes read into the input buffer
+static char*    record_convOut = NULL;		// Output buffer of the CSV file (written in pieces of RECORD_CONV_WRITE_SIZE, see record_convertFlush)
+static uint32_t record_convOutLen;			// Bytes in the output buffer
+static uint8_t* record_convChunk;			// Current chunk (in the input buffer)
+static uint16_t record_convChunkSize;		// Bytes of one chunk
+static uint16_t record_convDataStart;		// Offset of the first line in a chunk (size of the chunk header, 0 for files without header)
+static uint32_t record_convSeed;			// Seed of the chunk checksums (see recfmt_chunkSeed)
+static uint16_t record_convChunkPos;		// Offset of the next unused byte in the current chunk
+static uint16_t record_convChunkEnd;		// End of the used bytes in the current chunk
+static const uint8_t* record_convLineBuf;	// Buffer the lines are taken from (chunk or decoded block)
+static uint16_t record_convPos;				// Offset of the next line in record_convLineBuf
+static uint16_t record_convEnd;				// End of the lines in record_convLineBuf
+static uint8_t  record_convCodec;			// recfmtCodecs of the file (recfmtCodecNone = chunks hold lines)
+static recfmtLayout record_convLayout;		// Layout of the lines of a block (used to decode frames)
+static uint8_t* record_convFrame;			// Frame being assembled (compressed files)
+static uint8_t* record_convBlock;			// Decoded lines of the last frame (compressed files)
+static uint32_t record_convFrameSeq;		// Running number of the next frame
+static uint8_t  record_convResync;			// 1 if decoding must restart at the next frame start (after lost chunks)
+static const char* record_convResyncReason;	// Reason of the lost chunks noted at restart
+static uint16_t record_convLineSize;		// Bytes of one line
+static uint8_t  record_convFramed;			// 1 if the file has a header (every chunk starts with a chunk header)
+static int_buffer_t record_convMarker;		// First raw value of an event line
+static float    record_convInterval;		// Time between two measurement lines in ms
+static uint32_t record_convSeq;				// Expected running number of the next chunk
+static uint32_t record_convLines;			// Number of measurement lines converted so far (= index of the next line)
+static uint32_t record_convLost;			// Number of lost (corrupt or missing) chunks
+static uint8_t  record_convHasSample;		// 1 if the chunk headers hold the index of their first measurement line (version 2)
+static uint32_t record_convChunkSample;		// recfmtChunkHeader.sample of the current chunk
+static FRESULT  record_convRes;				// First read error of the .BIN file (reported at the end of the file)
+
+/// Background conversion variables (see record_convertTick)
+static uint8_t  record_convState = convIdle;	// convStates
+static char     record_convName[FILENAME_BUFFER_LENGTH];	// .BIN file being converted
+static char     record_convQueue[FILENAME_BUFFER_LENGTH];	// .BIN file to be converted next ('\0' = none)
+static sensor   record_convSens[SENSORS_SIZE];	// Private sensors (settings of the recording, own filter state and buffers)
+static sensor*  record_convSensArr[SENSORS_SIZE];	// Pointers to the private sensors
+static void*    record_convSensMem[SENSORS_SIZE];	// Memory of the buffers of the private sensors
+static uint32_t record_convInLines;			// Lines taken from the .BIN file (measurement and event lines) - progress marker
+static uint32_t record_convResumeLines;		// Lines of the .BIN file that are already converted (replayed without output)
+static uint32_t record_convResumeCsv;		// Size of the CSV file at record_convResumeLines
+static uint32_t record_convResumeEvt;		// Size of the EVT file at record_convResumeLines
+static uint32_t record_convCheckpointLines;	// record_convInLines at the last checkpoint
+static uint32_t record_convMeasLines;		// Measurement lines processed by this conversion (throughput)
+static uint32_t record_convTime;			// Time spent in record_convertTick in us (throughput)
+static FSIZE_t  record_convReleasePos;		// Position in the .BIN file while it is closed for a rename (see record_convertRelease)
+static char     record_convSession[FILENAME_BUFFER_LENGTH];	// Session index whose segments are converted one after another ('\0' = none)
+static uint16_t record_convSegment;			// Next segment of record_convSession to be converted
+
+/// Binary calibration files of the sensors (see record_readCalBin)
+typedef struct {
+	uint8_t* file;					// Content of the binary file (malloc, NULL = nothing cached)
+	uint32_t size;					// Bytes of the file
+	uint32_t stamp;					// Date and time of the file (fdate << 16 | ftime) - the file is read again if it changes
+	char     name[FILENAME_BUFFER_LENGTH];	// Name of the file
+} recordCalCache;
+static recordCalCache record_calCache[SENSORS_SIZE];
 
 //// Internal functions
+static DRESULT record_mediaSerial(uint32_t* serial);
+static FIL* record_poolOpen(const char* path, BYTE accessMode);
+static FRESULT record_poolClose(FIL* fp);
 static FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t accessMode);
 static FRESULT record_closeFile(objFIL objFILrw);
 static int8_t record_checkEndOfFile(objFIL objFILrw);
-static uint8_t record_writeCalFile_pair (char* comment, char* val_buff);
+static uint8_t record_writeCalFile_pair (FIL* fp, char* comment, char* val_buff);
+static uint8_t record_readCalText(volatile sensor* sens);
+static uint8_t record_readCalBin(volatile sensor* sens);
+static uint8_t record_writeCalBin(volatile sensor* sens);
+static FRESULT record_calStamp(const char* path, uint32_t* stamp, uint32_t* size);
 static int8_t record_backupFile(const char* path);
+static FRESULT record_backupNext(const char* base, const char* extension, uint8_t rescan, uint32_t* next);
+static void record_convertEvent(sensor** sensArray, const uint8_t* eventLine);
+static const uint8_t* record_convertReadLine(void);
+static uint8_t record_convertLoadChunk(const char** gapReason, uint32_t* gapSeq, uint32_t* gapChunks);
+static uint8_t record_convertNextFrame(void);
+static void record_convertGap(const char* reason, uint32_t seq, uint32_t chunks);
+static FRESULT record_convertFlush(uint8_t all);
+static int8_t record_convertOpen(const char* filename, uint32_t resumeLines, uint32_t csvSize, uint32_t evtSize);
+static FRESULT record_convertMarker(uint32_t lines, uint32_t csvSize, uint32_t evtSize);
+static FRESULT record_convertCheckpoint(void);
+static void record_convertClose(uint8_t keepMarker);
+static uint8_t record_convertRelease(const char* path);
+static void record_convertReacquire(const char* path);
+static void record_channelFromSensor(const sensor* sens, recfmtChannel* ch);
+static void record_channelToSensor(const recfmtChannel* ch, sensor* sens);
+static uint32_t record_buildHeader(uint8_t* buf);
+static FRESULT record_writeHeader(void);
+static void record_startAbort(const char* filename);
+static int8_t record_backupSession(const char* filename_BIN);
+static FRESULT record_sessionAppend(const char* session, const char* filename, uint32_t sample);
+static FRESULT record_sessionSegment(const char* session, uint16_t segment, char* filename);
+static uint8_t record_segmentFull(void);
+static FRESULT record_segmentPrepare(void);
+static uint32_t record_fifoHeadroom(void);
+static FRESULT record_segmentSwitch(void);
+static FRESULT record_segmentFinish(void);
+static FRESULT record_recoverFile(const char* filename, uint32_t* blocks, uint32_t* sample);
+static uint16_t record_indexBlock(uint32_t chunk, const uint8_t* lines);
+static void record_indexPush(void);
+static FRESULT record_indexOpen(const char* filename_BIN);
+static FRESULT record_indexWrite(uint8_t count);
+static FRESULT record_indexClose(uint8_t count);
+static void record_backupSidecar(const char* filename_BIN, const char* ext);
+static FRESULT record_seekEntry(uint32_t entry, recfmtIndexEntry* e);
+static FRESULT record_seekChunk(uint32_t chunk, uint8_t* buf);
+static void record_lodBlock(const uint8_t* lines);
+static void record_lodFinish(uint8_t level);
+static void record_lodQueuePage(const uint8_t* page);
+static void record_lodEnd(void);
+static FRESULT record_lodWrite(uint8_t count);
+static FRESULT record_lodOpen(const char* filename_BIN, uint8_t next);
+static FRESULT record_lodClose(uint8_t prev, uint32_t samples);
+static void record_lodReset(void);
+static void record_lodHeader(recfmtLodHeader* hdr, uint32_t samples, uint8_t complete);
+static void record_swapFile(FIL** a, FIL** b);
+static uint8_t record_blockPacked(uint8_t flush);
+static FRESULT record_packWrite(uint8_t keep);
+static FRESULT record_packFlush(void);
+static void record_writeLatency(uint32_t start);
+static FRESULT record_writeOpenMarker(void);
+static FRESULT record_writeBlocks(const void* buf, uint8_t blocks, uint8_t queue);
+static void record_writeDone(uint8_t chunks);
+static FRESULT record_writeUpdate(void);
+static FRESULT record_writeWait(uint8_t pending);
+static void record_writeReset(void);
 
 
 
 void record_mountDisk(uint8_t mount){
 	/// Used to mount and unmount a disk.
+	/// A mounted card stays mounted (open files - recording, background conversion, pool - stay valid) as long as it is initialized and
+	/// its volume serial number is unchanged (see record_mediaSerial). It is only remounted after an error or a change of the card.
 	///
 	/// mount ... 1 = mount, 0 = unmount SD-Card
 	///
 	/// Uses multiple ff.h defines (FATFS Lib)
-	///	Uses record-global variables: fil_w, fil_r
+	///	Uses record-global variables: fs, fil_pool, record_mountSerial, record_backupCache
 	///	Uses globals variables: sdState
 
 
-	// FATFS result code
+	// FATFS result code and start time (latency of the mount)
 	FRESULT res;
+	uint32_t start = SYSTIMER_GetTime();
 
 	// Get current status of the SD
 	diskStatus = disk_status(fs.pdrv);
 	printf("disk_status = %d\n", diskStatus);
 
+	// Keep the mount if it is the same card (remounting would invalidate all open files)
+	uint32_t serial;
+	if(mount && diskStatus == 0 && (sdState == sdMounted || sdState == sdFileOpen)){
+		if(record_mediaSerial(&serial) == RES_OK && serial == record_mountSerial){
+			printf("Mount kept (%lu us)\n", SYSTIMER_GetTime() - start);
+			return;
+		}
+		printf("Card changed or not readable - remount\n");
+		diskStatus = STA_NOINIT;
+	}
+
 	// Reinitialize disk if there was no disk till now
 	if(diskStatus != 0){ // translation of these codes is a bit hidden in the lib. See "FATFS_statuscodes" array in fatfs.c
 		// Reset SD state
@@ -87,12 +364,17 @@ void record_mountDisk(uint8_t mount){
 		sdState = sdNone;
 	}
 
+	// Files of the pool are invalid now (free them) and the backup numbers might belong to another card
+	for(uint8_t i = 0; i < RECORD_FILE_POOL; i++)
+		fil_pool[i].obj.fs = NULL;
+	memset(record_backupCache, 0, sizeof(record_backupCache));
+
 	// If needed, mount the SD and mark state as mounted or error
 	if(mount){
-		// Register work area
+		// Register work area and remember the card
 		res = f_mount(&fs, "0:", 1);
-		if (res == FR_OK) {
-			printf("Mount OK\n");
+		if (res == FR_OK && record_mediaSerial(&record_mountSerial) == RES_OK) {
+			printf("Mount OK (%lu us)\n", SYSTIMER_GetTime() - start);
 			sdState = sdMounted;
 		}
 		else if (res == FR_NOT_READY){
@@ -119,16 +401,101 @@ void record_mountDisk(uint8_t mount){
 
 }
 
+static DRESULT record_mediaSerial(uint32_t* serial){
+	/// Read the volume serial number of the mounted card from its boot sector (one sector read instead of a remount, see record_mountDisk).
+	/// Returns the result of disk_read (a card that was changed isn't initialized - the read fails)
+	///
+	///	serial	... Returns the volume serial number
+	///
+	///	Uses record-global variables: fs
+
+
+	// Boot sector of the volume (not read through the window of FatFs - its content must not change)
+	uint32_t sector[FF_MAX_SS/sizeof(uint32_t)];
+	DRESULT res = disk_read(fs.pdrv, (BYTE*)sector, fs.volbase, 1);
+
+	// Position of the serial number depends on the file system (BS_VolID, BPB_VolIDEx)
+	uint16_t pos = 39;
+	if(fs.fs_type == FS_FAT32)
+		pos = 67;
+#if FF_FS_EXFAT
+	else if(fs.fs_type == FS_EXFAT)
+		pos = 100;
+#endif
+	memcpy(serial, (uint8_t*)sector + pos, sizeof(uint32_t));
+	return res;
+}
+
+static FIL* record_poolOpen(const char* path, BYTE accessMode){
+	/// Open a file on a free file object of the pool. Used for short file operations beside the recording and the background conversion
+	/// (CAL files, screenshot), so they can't close the files of those.
+	/// Returns the file object (close it with record_poolClose) or NULL if the file can't be opened or all objects are in use
+	///
+	/// path	   ... Path to the file to be opened
+	/// accessMode ... File access mode and open method (see ff.h)
+	///
+	///	Uses record-global variables: fil_pool
+	///	Uses globals variables: sdState, RECORD_FILE_POOL
+
+
+	// Find a free file object
+	uint8_t i;
+	for(i = 0; i < RECORD_FILE_POOL && fil_pool[i].obj.fs != NULL; i++);
+	if(i == RECORD_FILE_POOL){
+		printf("\tFile pool exhausted: %s\n", path);
+		return NULL;
+	}
+
+	// Open file - errors of the card force a remount with the next record_mountDisk
+	FRESULT res = f_open(&fil_pool[i], path, accessMode);
+	if(res != FR_OK){
+		printf("\tFile open error: %d '%s'\n", res, path);
+		if(res == FR_DISK_ERR || res == FR_NOT_READY || res == FR_INT_ERR)
+			sdState = sdError;
+		return NULL;
+	}
+	printf("\tFile opened: %s\n", path);
+	sdState = sdFileOpen;
+	return &fil_pool[i];
+}
+
+static FRESULT record_poolClose(FIL* fp){
+	/// Close a file opened with record_poolOpen and give its file object back to the pool.
+	/// Returns the result of f_close
+	///
+	/// fp	... File object returned by record_poolOpen (NULL is ignored)
+	///
+	///	Uses globals variables: sdState
+
+
+	// Nothing to do if the file wasn't opened (or the pool was freed by a remount)
+	if(fp == NULL || fp->obj.fs == NULL)
+		return FR_INVALID_OBJECT;
+
+	// Close file - the object is free even if that fails
+	FRESULT res = f_close(fp);
+	if(res != FR_OK){
+		printf("\tClose File error: %d\n", res);
+		fp->obj.fs = NULL;
+		if(res == FR_DISK_ERR || res == FR_NOT_READY || res == FR_INT_ERR)
+			sdState = sdError;
+	}
+	else{
+		printf("\tClose File OK\n");
+	}
+	return res;
+}
+
 static FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t accessMode){
-	/// Used to open a file on the read or write FIL struct for read/write access. If another file is still open it will be closed automatically!
-	/// Note: This implementation allows only one read and one write file to be open at the same time!
+	/// Used to open a file on the write FIL struct (recording), the event file or a file of the background conversion. If another file is still open on it, it will be closed automatically!
+	/// Note: Other files are opened on the pool (see record_poolOpen).
 	///
 	/// path	   ... Path to the file to be opened
-	/// objFILrw   ... Choose between read or write file
+	/// objFILrw   ... Choose between write, event or conversion file
 	/// accessMode ... File access mode and open method (see ff.h)
 	///
 	/// Uses multiple ff.h defines (FATFS Lib)
-	///	Uses record-global variables: fil_w, fil_r
+	///	Uses record-global variables: fil_w, fil_e, fil_cr, fil_cw
 	///	Uses globals variables: sdState
 
 	// FATFS result code
@@ -142,11 +509,17 @@ static FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t access
 		res = 127;
 
 		// Close already open file if needed
-		if(objFILrw == objFILread && fil_r.obj.fs != NULL){
-			res = f_close(&fil_r);
+		if(objFILrw == objFILwrite && fil_w->obj.fs != NULL){
+			res = f_close(fil_w);
 		}
-		else if(objFILrw == objFILwrite && fil_w.obj.fs != NULL){
-			res = f_close(&fil_w);
+		else if(objFILrw == objFILevent && fil_e.obj.fs != NULL){
+			res = f_close(&fil_e);
+		}
+		else if(objFILrw == objFILconvRead && fil_cr.obj.fs != NULL){
+			res = f_close(&fil_cr);
+		}
+		else if(objFILrw == objFILconvWrite && fil_cw.obj.fs != NULL){
+			res = f_close(&fil_cw);
 		}
 
 		// Check result if it has changed
@@ -169,10 +542,14 @@ static FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t access
 			accessMode = FA_OPEN_ALWAYS;
 
 		// Open file
-		if(objFILrw == objFILread)
-			res = f_open(&fil_r, path, accessMode | FA_READ);
-		else if (objFILrw == objFILwrite)
-			res = f_open(&fil_w, path, accessMode | FA_WRITE | FA_READ);
+		if (objFILrw == objFILwrite)
+			res = f_open(fil_w, path, accessMode | FA_WRITE | FA_READ);
+		else if (objFILrw == objFILevent)
+			res = f_open(&fil_e, path, accessMode | FA_WRITE);
+		else if (objFILrw == objFILconvRead)
+			res = f_open(&fil_cr, path, accessMode | FA_READ);
+		else if (objFILrw == objFILconvWrite)
+			res = f_open(&fil_cw, path, accessMode | FA_WRITE | FA_READ);
 
 		// Check if open was successful
 		if ((res == FR_OK) || (res == FR_EXIST)){
@@ -194,10 +571,10 @@ static FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t access
 }
 
 static FRESULT record_closeFile(objFIL objFILrw){
-	/// Used to close the file of the write or read FIL struct.
+	/// Used to close the file of the write, event or conversion FIL struct.
 	///
 	/// Uses multiple ff.h defines (FATFS Lib)
-	///	Uses record-global variables: fil_w, fil_r
+	///	Uses record-global variables: fil_w, fil_e, fil_cr, fil_cw
 	///	Uses globals variables: sdState
 
 
@@ -207,20 +584,23 @@ static FRESULT record_closeFile(objFIL objFILrw){
 	// If SD is mounted and the corresponding file is still open close it
 	if(sdState != sdError && sdState != sdNone){
 		// Close already open file if needed
-		if(objFILrw == objFILread && fil_r.obj.fs != NULL){
-			res = f_close(&fil_r);
+		if(objFILrw == objFILwrite && fil_w->obj.fs != NULL){
+			res = f_close(fil_w);
+		}
+		else if(objFILrw == objFILevent && fil_e.obj.fs != NULL){
+			res = f_close(&fil_e);
+		}
+		else if(objFILrw == objFILconvRead && fil_cr.obj.fs != NULL){
+			res = f_close(&fil_cr);
 		}
-		else if(objFILrw == objFILwrite && fil_w.obj.fs != NULL){
-			res = f_close(&fil_w);
+		else if(objFILrw == objFILconvWrite && fil_cw.obj.fs != NULL){
+			res = f_close(&fil_cw);
 		}
 
 		// Check result
 		if (res == FR_OK) {
 			printf("\tClose File OK\n");
 
-			// Check if one of the files is still open, if not mark sd state to "no file open" = "sd mounted"
-			if(fil_r.obj.fs != NULL && fil_w.obj.fs != NULL)
-				sdState = sdMounted;
 		}
 		else if(res == FR_INVALID_OBJECT){ // Note: Unsure if needed - check this again
 			printf("\tFile close warning: %d\n", res);
@@ -240,27 +620,28 @@ static int8_t record_checkEndOfFile(objFIL objFILrw){
 	/// Check and return end of file status of given file
 	/// Returns 1 if EOF is reached, 0 if its not reached and -1 if the requested file is wrong or not open
 	///
-	/// objFILrw	...	Requested file (see objFIL, write or read file)
+	/// objFILrw	...	Requested file (see objFIL, write file)
 
 
 	// Return end of file status of given file
-	if(objFILrw == objFILread && fil_r.obj.fs != NULL)
-		return f_eof(&fil_r);
-	else if(objFILrw == objFILwrite && fil_w.obj.fs != NULL)
-		return f_eof(&fil_w);
+	if(objFILrw == objFILwrite && fil_w->obj.fs != NULL)
+		return f_eof(fil_w);
 
 	// Return error if the requested file is wrong or not open
 	return -1;
 }
 
 static int8_t record_backupFile(const char* path){
-	/// Check if the given file (in root directory) already exists. If yes, it renames the existing file to a pattern "[oldName]00.[fileExtesion]" where 00 is the next not used number between 1 and 99
+	/// Check if the given file (in root directory) already exists. If yes, it renames the existing file to a pattern "[oldName]00.[fileExtesion]" where 00 is
+	/// the number behind the highest one in use (at least two digits, see record_backupNext).
+	/// The new name is noted in record_backupName.
 	/// Limitations: Only use 3 character file extensions! No sub-folders are supported because the length is checked (except LFN (Long File Names -> FF_USE_LFN) are activated)
 	/// Returns 1 if OK, 0 = error
 	///
 	/// path	...	The path/filename to be checked with extension
 	///
-	///	Uses globals variables: FF_USE_LFN, FILENAME_BUFFER_LENGTH
+	///	Uses record-global variables: record_backupName, record_backupCache, record_backupCacheIdx
+	///	Uses globals variables: FF_USE_LFN, FILENAME_BUFFER_LENGTH, RECORD_BACKUP_MAX
 	///
 
 
@@ -268,6 +649,7 @@ static int8_t record_backupFile(const char* path){
 
 	// Initial log line
 	printf("\trecord_backupFile:\n");
+	record_backupName[0] = '\0';
 
 	// Only start if given name is longer than 4 characters (e.g. 'n.csv')
 	if(strlen(path) > 4 && (strlen(path) <= 10 || FF_USE_LFN == 1)){
@@ -295,57 +677,58 @@ static int8_t record_backupFile(const char* path){
 			// Extract base of filename (without extension)
 			snprintf(base_rename, strlen(new_filename)-3, new_filename);
 
-			// Add two numbers '01' and file extension
-			sprintf(new_filename, "%s01.%s", base_rename, extension);
-
-			// Debug message
-			printf("\tFile already exists, try name: %s (%s)\n", new_filename, base_rename);
+			// Highest usable number - 8.3 names hold 8 characters before the extension
+			uint32_t max = RECORD_BACKUP_MAX;
+			if(FF_USE_LFN == 0){
+				uint32_t limit = 1;
+				for(uint8_t d = strlen(base_rename); d < 8; d++)
+					limit *= 10;
+				if(limit - 1 < max)
+					max = limit - 1;
+			}
 
-			// Check if a not yet used name is found - if not (still exists) increase file numbers and try again
-			uint8_t i = 1;
-			do{
-				// Check if file exists
-				res = f_stat(new_filename, NULL);
-				if(res == FR_OK){
-					// File already exists, generate filename with next number and try again
-					i++;
-					sprintf(new_filename, "%s%02d.%s", base_rename, i, extension);
-					printf("\tFile already exists, try name: %s\n", new_filename);
+			// Try the next free number (cached or found with one pass over the directory). If that name is taken anyway, the directory is scanned again
+			for(uint8_t attempt = 0; attempt < 2; attempt++){
+				uint32_t next;
+				res = record_backupNext(base_rename, extension, attempt, &next);
+				if(res != FR_OK){
+					// Actual errors at the directory scan only occur if all is lost - stop
+					printf("\t Check file error: %d\n", res);
+					break;
 				}
-				else if (res == FR_NO_FILE){
-					/// A unique name was found - rename!
-
-					// Add extension to the base name in order to use it for renaming
-					sprintf(&base_rename[strlen(base_rename)], ".%s", extension);
-
-					// Rename file
-					printf("\tNew filename found, rename %s to %s\n", base_rename, new_filename);
-					res = f_rename(base_rename, new_filename);
-					if(res == FR_OK){
-						// Rename successful
-						printf("\t Renamed file\n");
-
-						// The actual new record file shall be named without numbers,
-						// therefore just use the base name as new filename
-						sprintf(new_filename, base_rename);
-
-						// Renaming was successful
-						return 1;
-					}
-					else{
-						// Rename failed - start not successful
-						printf("\t Rename failed %d\n", res);
-					}
-
-					// Tried renaming - now stop while loop
+				if(next > max){
+					printf("\t No backup number left for %s.%s (%lu > %lu)\n", base_rename, extension, next, max);
 					break;
 				}
-				else{
-					// Actual errors at file check only occur if all is lost - stop while loop
-					printf("\t Check file error: %d\n", res);
+				sprintf(new_filename, "%s%02lu.%s", base_rename, next, extension);
+
+				/// A unique name was found - rename!
+				// Add extension to the base name in order to use it for renaming
+				char old_filename[FILENAME_BUFFER_LENGTH];
+				sprintf(old_filename, "%s.%s", base_rename, extension);
+
+				// Rename file (the background conversion follows if it reads this file - open files can't be renamed)
+				printf("\tNew filename found, rename %s to %s\n", old_filename, new_filename);
+				uint8_t convFile = record_convertRelease(old_filename);
+				res = f_rename(old_filename, new_filename);
+				if(convFile)
+					record_convertReacquire((res == FR_OK) ? new_filename : old_filename);
+				if(res == FR_OK){
+					// Rename successful (new name is noted for record_backupSession, the next backup gets the next number)
+					printf("\t Renamed file\n");
+					sprintf(record_backupName, new_filename);
+					record_backupCache[record_backupCacheIdx].next = next + 1;
+
+					// Renaming was successful
+					return 1;
+				}
+				else if(res != FR_EXIST){
+					// Rename failed - start not successful
+					printf("\t Rename failed %d\n", res);
 					break;
 				}
-			}while(i < 100);
+				printf("\tFile already exists: %s\n", new_filename);
+			}
 		}
 		else if(res == FR_NO_FILE){
 			// File doesn't exist - no renaming necessary
@@ -367,13 +750,79 @@ static int8_t record_backupFile(const char* path){
 	return 0;
 }
 
+static FRESULT record_backupNext(const char* base, const char* extension, uint8_t rescan, uint32_t* next){
+	/// Next free number of a backup "[base]00.[extension]" (see record_backupFile): the number behind the highest one in use. It is found with one pass over
+	/// the directory (FF_USE_FIND) instead of an f_stat for every number and cached per base name while the card stays mounted (see record_mountDisk).
+	/// The cache entry is noted in record_backupCacheIdx, so the caller can count it up after the rename.
+	/// Returns the result of the directory scan (FR_OK if the number is taken from the cache)
+	///
+	/// base		... Name of the file without extension
+	/// extension	... Extension of the file (3 characters)
+	/// rescan		... 1 = ignore the cache (the cached name was taken)
+	/// next		... Returns the next free number (at least 1)
+	///
+	///	Uses record-global variables: record_backupCache, record_backupCacheIdx, record_backupCacheNext
+	///	Uses globals variables: RECORD_BACKUP_CACHE, FILENAME_BUFFER_LENGTH
+
+
+	// Look for the base name in the cache
+	uint8_t i;
+	for(i = 0; i < RECORD_BACKUP_CACHE; i++){
+		if(record_backupCache[i].next != 0 && strcmp(record_backupCache[i].base, base) == 0 && strcmp(record_backupCache[i].extension, extension) == 0)
+			break;
+	}
+	if(i < RECORD_BACKUP_CACHE && !rescan){
+		record_backupCacheIdx = i;
+		*next = record_backupCache[i].next;
+		return FR_OK;
+	}
+
+	// One pass over all files matching "[base]*.[extension]" - only the ones with the number as record_backupFile writes it between base and
+	// extension are backups: at least two digits, no leading zero beyond that. Segments of a recording ("[base]001.BIN", three digits, see
+	// record_segmentPrepare) don't count, from the 100th segment on their names can't be told apart (the next backup number is just higher).
+	DIR dir;
+	FILINFO fno;
+	char pattern[FILENAME_BUFFER_LENGTH + 2];
+	sprintf(pattern, "%s*.%s", base, extension);
+	uint32_t highest = 0;
+	uint16_t files = 0;
+	uint32_t start = SYSTIMER_GetTime();
+	FRESULT res = f_findfirst(&dir, &fno, "", pattern);
+	while(res == FR_OK && fno.fname[0] != '\0'){
+		const char* digits = &fno.fname[strlen(base)];
+		char* end;
+		uint32_t number = strtoul(digits, &end, 10);
+		uint8_t len = end - digits;
+		if(digits[0] >= '0' && digits[0] <= '9' && *end == '.' && len >= 2 && (len == 2 || digits[0] != '0') && number > highest)
+			highest = number;
+		files++;
+		res = f_findnext(&dir, &fno);
+	}
+	f_closedir(&dir);
+	if(res != FR_OK)
+		return res;
+	printf("\tBackups of %s.%s: highest %lu (%u files, %lu us)\n", base, extension, highest, files, SYSTIMER_GetTime() - start);
+
+	// Note it in the cache (the entry of the base name or the oldest one)
+	if(i == RECORD_BACKUP_CACHE){
+		i = record_backupCacheNext;
+		record_backupCacheNext = (record_backupCacheNext + 1) % RECORD_BACKUP_CACHE;
+	}
+	strcpy(record_backupCache[i].base, base);
+	strcpy(record_backupCache[i].extension, extension);
+	record_backupCache[i].next = highest + 1;
+	record_backupCacheIdx = i;
+	*next = highest + 1;
+	return FR_OK;
+}
+
 
 
-static uint8_t record_writeCalFile_pair (char* comment, char* val_buff){
+static uint8_t record_writeCalFile_pair (FIL* fp, char* comment, char* val_buff){
 	/// Writes a comment and an actual value as two separate lines to the file
 	/// Returns 1 if there was an error, 0 means success.
 	///
-	///	Uses record-global variables: fil_w
+	///	fp	... CAL file (see record_poolOpen)
 
 
 	// FATFS result code and bytes written
@@ -382,11 +831,11 @@ static uint8_t record_writeCalFile_pair (char* comment, char* val_buff){
 
 	// Write comment
 	printf("Comment: %s", comment);
-	f_printf(&fil_w, comment);
+	f_printf(fp, comment);
 
 	// Write value
 	printf("Value: %s", val_buff);
-	res = f_write(&fil_w, val_buff, strlen(val_buff), &bw);
+	res = f_write(fp, val_buff, strlen(val_buff), &bw);
 
 	// Return 1 if there was an error, else 0
 	if (res != FR_OK || bw <= 0)
@@ -398,6 +847,7 @@ static uint8_t record_writeCalFile_pair (char* comment, char* val_buff){
 void record_writeCalFile(sensor* sens){
 	/// Write the calibration/specification data of the given sensor to the file stated in the sensor struct.
 	/// If the File already exists, the current version will be backed up (means: only 2 version are saved current and last file!)
+	/// The binary file loaded by record_readCalFile is written as well (see record_writeCalBin).
 	/// Returns nothing.
 	///
 	///	sens	...	A struct of type sensor which holds all sensor data
@@ -405,7 +855,6 @@ void record_writeCalFile(sensor* sens){
 	/// dp_y	... A float array holding all y-values (actual value in units e.g mm) used to do the curve fit (corresponding to x-values!)
 	/// dp_size	... Number of data points (elements in dp_x and dp_y)
 	///
-	///	Uses record-global variables: fil_w
 	///	Uses globals variables: sdState
 
 
@@ -435,47 +884,47 @@ void record_writeCalFile(sensor* sens){
 		}
 
 		// Open/Create File
-		record_openFile((char*)&sens->fitFilename[0], objFILwrite, 0);
+		FIL* fp = record_poolOpen((char*)&sens->fitFilename[0], FA_CREATE_ALWAYS | FA_WRITE);
 
 		// If file is ready to be written to ...
-		if(sdState == sdFileOpen){
+		if(fp != NULL){
 			/// ... write comment and content lines alternating to file
 			// Single loop do-while slope to handle errors clean with break; (inspired by Infineon "FATFS_EXAMPLE_XMC47": https://www.infineon.com/cms/en/product/promopages/aim-mc/dave_downloads.html)
 			do{
 				// Write header
-				f_printf(&fil_w, "# Specification of sensor %d '%s'. Odd lines are comments, even lines are values. Float values are converted to 32bit integer hex (memory content). ", (sens->index+1), sens->name);
+				f_printf(fp, "# Specification of sensor %d '%s'. Odd lines are comments, even lines are values. Float values are converted to 32bit integer hex (memory content). ", (sens->index+1), sens->name);
 				printf("Write header\n");
 
 				// Write fit order comment and value in separate lines
 				sprintf(buff,"%d\n", sens->fitOrder);
-				if( record_writeCalFile_pair("Curve fit function order:\n", &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, "Curve fit function order:\n", &buff[0]) ) break;
 
 				// Write coefficients comment and value in separate lines. Note: Floating point precision is taken from FLT_DIG (=here 6). See https://www.h-schmidt.net/FloatConverter/IEEE754.html for an online converter.
 				sprintf(c_buff,"# Coefficients (%.8f, %.8f, %.8f, %.8f):\n", sens->fitCoefficients[0], sens->fitCoefficients[1], sens->fitCoefficients[2], sens->fitCoefficients[3]);
 				sprintf(buff,"%08lX,%08lX,%08lX,%08lX\n", *(unsigned long*)&sens->fitCoefficients[0], *(unsigned long*)&sens->fitCoefficients[1], *(unsigned long*)&sens->fitCoefficients[2], *(unsigned long*)&sens->fitCoefficients[3]);
-				if( record_writeCalFile_pair(&c_buff[0], &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
 
 				// Write avg filter interval comment and value in separate lines
 				sprintf(buff,"%d\n", sens->avgFilterInterval);
-				if( record_writeCalFile_pair("# Average filter interval:\n", &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, "# Average filter interval:\n", &buff[0]) ) break;
 
 				// Write error threshold comment and value in separate lines
 				sprintf(buff,"%d\n", sens->errorThreshold);
-				if( record_writeCalFile_pair("# Error threshold:\n", &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, "# Error threshold:\n", &buff[0]) ) break;
 
 				// Write converted origin point (unloaded) comment and value in separate lines
 				sprintf(c_buff,"# Sensor origin point/unloaded (%.8f):\n", sens->originPoint);
 				sprintf(buff,"%08lX\n", *(unsigned long*)&sens->originPoint);
-				if( record_writeCalFile_pair(&c_buff[0], &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
 
 				// Write converted operating point (offset/sag) comment and value in separate lines
 				sprintf(c_buff,"# Sensor operating point offset/sag (%.8f):\n", sens->operatingPoint);
 				sprintf(buff,"%08lX\n", *(unsigned long*)&sens->operatingPoint);
-				if( record_writeCalFile_pair(&c_buff[0], &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
 
 				// Write numDataPoints comment and value in separate lines
 				sprintf(buff,"%d\n", sens->dp_size);
-				if( record_writeCalFile_pair("# Number of data points:\n", &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, "# Number of data points:\n", &buff[0]) ) break;
 
 				// DataPoints x-value comment
 				sprintf(c_buff,"# Datapoints x (%.8f", sens->dp_x[0]);
@@ -488,7 +937,7 @@ void record_writeCalFile(sensor* sens){
 					sprintf(&buff[0] + (strlen(buff)),",%08lX", *(unsigned long*)&sens->dp_x[i]);
 				sprintf(&buff[0] + (strlen(buff)),"\n%c", '\0');
 				// Write comment and value
-				if( record_writeCalFile_pair(&c_buff[0], &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
 
 				// DataPoints y-value comment
 				sprintf(c_buff,"# Datapoints y (%.8f", sens->dp_y[0]);
@@ -501,17 +950,39 @@ void record_writeCalFile(sensor* sens){
 					sprintf(&buff[0] + (strlen(buff)),",%08lX", *(unsigned long*)&sens->dp_y[i]);
 				sprintf(&buff[0] + (strlen(buff)),"\n%c", '\0');
 				// Write comment and value
-				if( record_writeCalFile_pair(&c_buff[0], &buff[0]) ) break;
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
+
+				// Write tracker smoothing parameter comment and value in separate lines
+				sprintf(c_buff,"# Tracker smoothing theta (%.8f):\n", sens->trackerTheta);
+				sprintf(buff,"%08lX\n", *(unsigned long*)&sens->trackerTheta);
+				if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
+
+				// Write number of conversion stages comment and value in separate lines
+				sprintf(buff,"%d\n", sens->convStages_size);
+				if( record_writeCalFile_pair(fp, "# Number of conversion stages after the fit (type 1=polynomial, 2=origin/operating offset):\n", &buff[0]) ) break;
+
+				// Write every conversion stage comment and value (type, order and coefficients) in separate lines
+				uint8_t s;
+				for (s = 0; s < sens->convStages_size; s++) {
+					convStage* stage = &sens->convStages[s];
+					sprintf(c_buff,"# Conversion stage %d: type %d, order %d (%.8f, %.8f, %.8f, %.8f):\n", s+1, stage->type, stage->order, stage->coefficients[0], stage->coefficients[1], stage->coefficients[2], stage->coefficients[3]);
+					sprintf(buff,"%d,%d,%08lX,%08lX,%08lX,%08lX\n", stage->type, stage->order, *(unsigned long*)&stage->coefficients[0], *(unsigned long*)&stage->coefficients[1], *(unsigned long*)&stage->coefficients[2], *(unsigned long*)&stage->coefficients[3]);
+					if( record_writeCalFile_pair(fp, &c_buff[0], &buff[0]) ) break;
+				}
+				if(s != sens->convStages_size) break;
 
 				printf("Write of CAL file successful!\n");
 			} while(false);
 
 			// Close file
-			record_closeFile(objFILwrite);
+			record_poolClose(fp);
 		}
 		else{
 			printf("Write CAL File not open");
 		}
+
+		// Write the binary file used by record_readCalFile (the CAL file above is the human readable export)
+		record_writeCalBin(sens);
 	}
 
 	// Add a line break to console
@@ -519,22 +990,20 @@ void record_writeCalFile(sensor* sens){
 }
 
 void record_readCalFile(volatile sensor* sens){
-	/// Read the calibration/specification data of the given sensor from the file stated in the sensor struct.
-	/// Note: This function is not optimized for high speed. It should only be used when performance is not top priority (setup before actual start of record, not during).
-	/// On 03.04.2021 this function measured to take about 266ms to complete.
+	/// Read the calibration/specification data of the given sensor. The binary file (RECORD_CAL_BIN_EXT) is used if it is valid and not older
+	/// than the CAL file stated in the sensor struct - it is taken from RAM if it didn't change since it was read last time. Otherwise the CAL
+	/// file is parsed (slow - on 03.04.2021 this measured to take about 266ms) and the binary file is written from it for the next time.
 	///
 	///	sens	...	A struct of type sensor which will get all sensor data
 	/// dp_x	... Optional. A float array holding all x-values (nominal/ ADC output) used to do the curve fit (sorted!)
 	/// dp_y	... Optional. A float array holding all y-values (actual value in units e.g mm) used to do the curve fit (corresponding to x-values!)
 	/// dp_size	... Optional. Number of data points (elements in dp_x and dp_y)
 	///
-	///	Uses record-global variables: fil_r
 	///	Uses globals variables: sdState
 
-	// FATFS result code and two string buffers for comment and values
-	FRESULT res = 0; /* API result code */
-	char buff[400];
-	TCHAR* res_buf;
+
+	// Start time of the load
+	uint32_t start = SYSTIMER_GetTime();
 
 	// Initial log line
 	printf("\nrecord_readSpecFile:\n");
@@ -542,6 +1011,47 @@ void record_readCalFile(volatile sensor* sens){
 	// Try to mount disk
 	record_mountDisk(1);
 
+	// Use the binary file or parse the CAL file and convert it
+	uint8_t binary = 0;
+	if(sdState == sdMounted || sdState == sdFileOpen){
+		binary = record_readCalBin(sens);
+		if(!binary && record_readCalText(sens))
+			record_writeCalBin(sens);
+	}
+	else{
+		printf("SD-Card not ready\n");
+	}
+
+	// Clean update of filter (Interval might be changed)
+	measure_movAvgFilter_clean((sensor*)sens, sens->avgFilterInterval, 0);
+
+	// Rebuild conversion table (calibration, stages or offsets might be changed) and calculate tracker gains and restart it (smoothing
+	// or calibration might be changed) - record_channelToSensor did this already if the binary file was used
+	if(!binary){
+		measure_conv_compile((sensor*)sens);
+		measure_tracker_setGains((sensor*)sens);
+		measure_tracker_reset((sensor*)sens);
+	}
+
+	// Time of the load
+	printf("CAL of sensor %d loaded in %lu us\n\n", sens->index+1, SYSTIMER_GetTime() - start);
+}
+
+static uint8_t record_readCalText(volatile sensor* sens){
+	/// Parse the CAL file (text) stated in the sensor struct. Every value is applied to the sensor as soon as it is read.
+	/// Note: This function is not optimized for high speed (it is only used if the binary file can't be used, see record_readCalFile).
+	/// Returns 1 if the whole file was read, 0 = error
+	///
+	///	sens	...	A struct of type sensor which will get all sensor data
+	///
+	///	Uses globals variables: sdState
+
+	// FATFS result code and two string buffers for comment and values
+	FRESULT res = 0; /* API result code */
+	char buff[400];
+	TCHAR* res_buf;
+	uint8_t ok = 0;
+
 	// If the SD card is ready, backup existing file, try to open the new one and read in data to sensor struct
 	if(sdState == sdMounted || sdState == sdFileOpen){
 
@@ -551,22 +1061,22 @@ void record_readCalFile(volatile sensor* sens){
 		if(res == FR_OK){
 			// Open/Create File
 			printf("Open file\n");
-			record_openFile((char*)&sens->fitFilename[0], objFILread, 0);
+			FIL* fp = record_poolOpen((char*)&sens->fitFilename[0], FA_READ);
 
 			// If file is ready ...
-			if(sdState == sdFileOpen){
+			if(fp != NULL){
 				/// ... read every second line and write it to its corresponding value
 				// Single loop do-while slope to handle errors clean with break (inspired by Infineon "FATFS_EXAMPLE_XMC47": https://www.infineon.com/cms/en/product/promopages/aim-mc/dave_downloads.html)
 				do{
-					res = f_lseek(&fil_r, 0);
+					res = f_lseek(fp, 0);
 					if (res != FR_OK) break;
 
 					/// Read fit order
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					printf("CAL header: %s", buff);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					// Convert read string to unsigned long and write back to sensor struct
 					sens->fitOrder = strtoul(buff, NULL, 10);
@@ -574,8 +1084,8 @@ void record_readCalFile(volatile sensor* sens){
 
 					/// Read coefficients
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 100, &fil_r);
-					res_buf = f_gets(buff, 100, &fil_r);
+					res_buf = f_gets(buff, 100, fp);
+					res_buf = f_gets(buff, 100, fp);
 					if (res_buf == 0) break;
 					// Convert read string to long and write back to sensor struct
 					char *ptr = &buff[0];
@@ -593,8 +1103,8 @@ void record_readCalFile(volatile sensor* sens){
 
 					/// Read filter interval
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 400, &fil_r);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					// Convert read string and write back to sensor struct
 					sens->avgFilterInterval = strtoul(buff, NULL, 10);
@@ -602,8 +1112,8 @@ void record_readCalFile(volatile sensor* sens){
 
 					/// Read error threshold
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 400, &fil_r);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					// Convert read string and write back to sensor struct
 					sens->errorThreshold = strtoul(buff, NULL, 10);
@@ -611,8 +1121,8 @@ void record_readCalFile(volatile sensor* sens){
 
 					/// Read origin point
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 400, &fil_r);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					// Read as hex long
 					unsigned long hexToFloatTmp1 = strtoul(buff, NULL, 16);
@@ -622,8 +1132,8 @@ void record_readCalFile(volatile sensor* sens){
 
 					/// Read operating point
 					// Read comment line (ignore it) then read actual data line into buffer and stop process if the result isn't OK
-					res_buf = f_gets(buff, 400, &fil_r);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
 					if (res_buf == 0) break;
 					// Read as hex long
 					unsigned long hexToFloatTmp2 = strtoul(buff, NULL, 16);
@@ -632,8 +1142,8 @@ void record_readCalFile(volatile sensor* sens){
 					printf("operatingPoint %.8f: %s", sens->operatingPoint, buff);
 
 					// Read numDataPoints
-					res_buf = f_gets(buff, 400, &fil_r);
-					res_buf = f_gets(buff, 400, &fil_r);
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
 					sens->dp_size = (uint8_t)strtoul(buff, NULL, 10);
 					printf("numDataPoints %d: %s\n", sens->dp_size, buff);
 					if (res_buf != 0 && sens->dp_size >= 1){
@@ -648,8 +1158,8 @@ void record_readCalFile(volatile sensor* sens){
 								printf("Read CAL: Memory realloc failed!\n");
 
 							// Read DataPoints x-value
-							res_buf = f_gets(buff, 100, &fil_r);
-							res_buf = f_gets(buff, 100, &fil_r);
+							res_buf = f_gets(buff, 100, fp);
+							res_buf = f_gets(buff, 100, fp);
 							if (res_buf == 0){
 								buff[0] = '-';
 								buff[1] = '1';
@@ -669,8 +1179,8 @@ void record_readCalFile(volatile sensor* sens){
 							}
 
 							// Read DataPoints y-value
-							res_buf = f_gets(buff, 100, &fil_r);
-							res_buf = f_gets(buff, 100, &fil_r);
+							res_buf = f_gets(buff, 100, fp);
+							res_buf = f_gets(buff, 100, fp);
 							if (res_buf == 0){
 								buff[0] = '-';
 								buff[1] = '1';
@@ -695,11 +1205,62 @@ void record_readCalFile(volatile sensor* sens){
 						printf("No num data points in file or no parameters called\n");
 					}
 
+					/// Read tracker smoothing parameter (optional - older files don't have it, then the current value is kept)
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
+					if (res_buf != 0){
+						// Read as hex long
+						unsigned long hexToFloatTmp3 = strtoul(buff, NULL, 16);
+						// Convert to float and write to sensor struct
+						sens->trackerTheta = *(float*)&hexToFloatTmp3;
+						printf("trackerTheta %.8f: %s", sens->trackerTheta, buff);
+					}
+
+					/// Read conversion stages (optional - older files don't have them, then the current stages are kept)
+					// Every value follows its comment line - the first f_gets skips the comment (as for all values of the file)
+					res_buf = f_gets(buff, 400, fp);
+					res_buf = f_gets(buff, 400, fp);
+					if (res_buf != 0){
+						// Read number of stages and limit it to the available space
+						uint8_t stages_size = (uint8_t)strtoul(buff, NULL, 10);
+						if(stages_size > CONV_STAGES_MAX)
+							stages_size = CONV_STAGES_MAX;
+						printf("convStages_size %d: %s", stages_size, buff);
+
+						// Read every stage (type, order and 4 coefficients separated by ','), each after its comment line
+						uint8_t s;
+						for (s = 0; s < stages_size; s++) {
+							res_buf = f_gets(buff, 400, fp);
+							res_buf = f_gets(buff, 400, fp);
+							if (res_buf == 0) break;
+							size_t len = strlen(buff);
+							ptr = &buff[0];
+							sens->convStages[s].type = (uint8_t)strtoul(ptr, &ptr, 10);
+							if( (size_t)(ptr - buff) < len ) ptr++;
+							sens->convStages[s].order = (uint8_t)strtoul(ptr, &ptr, 10);
+							if( (size_t)(ptr - buff) < len ) ptr++;
+							for (uint8_t i = 0; i < 4; i++) {
+								// Read as hex long and convert to float
+								unsigned long tmp = strtoul(ptr, &ptr, 16);
+								sens->convStages[s].coefficients[i] = *(float*)&tmp;
+								// Ignore separator between values
+								if( (size_t)(ptr - buff) < len )
+									ptr++;
+							}
+							// Limit polynomial order to available coefficients
+							if(sens->convStages[s].order > 3)
+								sens->convStages[s].order = 3;
+							printf("convStage %d: type %d, order %d\n", s+1, sens->convStages[s].type, sens->convStages[s].order);
+						}
+						sens->convStages_size = s;
+					}
+
 					printf("Read of CAL file successful!\n");
+					ok = 1;
 				} while(false);
 
 				// Close file
-				record_closeFile(objFILread);
+				record_poolClose(fp);
 
 			} // end of if "file ready"
 			else{
@@ -717,35 +1278,220 @@ void record_readCalFile(volatile sensor* sens){
 		printf("SD-Card not ready: %d", res);
 	}
 
-	// Clean update of filter (Interval might be changed)
-	measure_movAvgFilter_clean((sensor*)sens, sens->avgFilterInterval, 0);
+	return ok;
+}
 
-	// Add a line break to console
-	printf("\n");
+static FRESULT record_calStamp(const char* path, uint32_t* stamp, uint32_t* size){
+	/// Get date and time (fdate << 16 | ftime) and size of a file.
+	/// Returns the result of f_stat (FR_NO_FILE if it doesn't exist)
+	///
+	///	path	... Name of the file
+	///	stamp	... Returns date and time of the last change
+	///	size	... Returns the bytes of the file (optional, NULL = not needed)
+
+
+	FILINFO fno;
+	FRESULT res = f_stat(path, &fno);
+	if(res == FR_OK){
+		*stamp = ((uint32_t)fno.fdate << 16) | fno.ftime;
+		if(size != NULL)
+			*size = (uint32_t)fno.fsize;
+	}
+	return res;
+}
+
+static uint8_t record_readCalBin(volatile sensor* sens){
+	/// Apply the binary calibration file of the sensor (see recfmtCalHeader) if it is valid and not older than the CAL file (that might have
+	/// been edited on a PC). The file is read with a single f_read and kept in RAM - as long as its date, time and size don't change only f_stat
+	/// is needed.
+	/// Returns 1 if the file was applied (including the conversion table and tracker, see record_channelToSensor), 0 = the CAL file must be parsed
+	///
+	///	sens	...	A struct of type sensor which will get all sensor data
+	///
+	///	Uses record-global variables: record_calCache
+	///	Uses globals variables: RECORD_CAL_BIN_EXT, FILENAME_BUFFER_LENGTH
+
+
+	// FATFS result code, cache of the sensor and name of the binary file
+	FRESULT res;
+	UINT br = 0;
+	recordCalCache* cache = &record_calCache[sens->index];
+	char name[FILENAME_BUFFER_LENGTH];
+	sprintf(name, "%.*s.%s", (int)(strlen(sens->fitFilename)-4), sens->fitFilename, RECORD_CAL_BIN_EXT);
+
+	// The binary file must exist and the CAL file must not be newer
+	uint32_t stamp, size, textStamp;
+	if(record_calStamp(name, &stamp, &size) != FR_OK){
+		printf("No binary CAL file %s\n", name);
+		return 0;
+	}
+	if(record_calStamp(sens->fitFilename, &textStamp, NULL) == FR_OK && textStamp > stamp){
+		printf("%s is newer than %s\n", sens->fitFilename, name);
+		return 0;
+	}
+
+	// Read the file if it isn't cached or changed since
+	if(cache->file == NULL || cache->size != size || cache->stamp != stamp || strcmp(cache->name, name) != 0){
+		free(cache->file);
+		cache->file = NULL;
+
+		// Single read of the whole file (a newer writer may have a bigger header)
+		uint8_t* file = NULL;
+		if(size <= RECFMT_CAL_SIZE(4*sizeof(recfmtCalHeader), RECFMT_CAL_POINTS_MAX))
+			file = (uint8_t*)malloc(size);
+		if(file == NULL){
+			printf("Binary CAL file %s too big: %lu\n", name, size);
+			return 0;
+		}
+		FIL* fp = record_poolOpen(name, FA_READ);
+		res = (fp != NULL) ? f_read(fp, file, size, &br) : FR_DENIED;
+		record_poolClose(fp);
+
+		// Check size, layout and checksum
+		if(res != FR_OK || br != size || !recfmt_checkCal(file, size)){
+			printf("Binary CAL file %s not valid: %d\n", name, res);
+			free(file);
+			return 0;
+		}
+
+		// Keep it for the next time
+		cache->file = file;
+		cache->size = size;
+		cache->stamp = stamp;
+		strcpy(cache->name, name);
+	}
+
+	// Data points (one more allocated like the CAL file parser does)
+	const recfmtCalHeader* hdr = (const recfmtCalHeader*)cache->file;
+	float* dp_x = (float*)realloc(sens->dp_x, (hdr->points+1)*sizeof(float));
+	float* dp_y = (float*)realloc(sens->dp_y, (hdr->points+1)*sizeof(float));
+	if(dp_x != NULL)
+		sens->dp_x = dp_x;
+	if(dp_y != NULL)
+		sens->dp_y = dp_y;
+	if(dp_x == NULL || dp_y == NULL){
+		printf("Read CAL: Memory realloc failed!\n");
+		sens->dp_size = 0;
+	}
+	else{
+		memcpy(dp_x, cache->file + hdr->headerSize, hdr->points*sizeof(float));
+		memcpy(dp_y, cache->file + hdr->headerSize + hdr->points*sizeof(float), hdr->points*sizeof(float));
+		sens->dp_size = hdr->points;
+	}
+
+	// Calibration and filter settings
+	record_channelToSensor(&hdr->channel, (sensor*)sens);
+	printf("Binary CAL file %s: fit order %d, %d data points, %d stages\n", name, sens->fitOrder, sens->dp_size, sens->convStages_size);
+	return 1;
+}
+
+static uint8_t record_writeCalBin(volatile sensor* sens){
+	/// Write the binary calibration file of the sensor (see recfmtCalHeader) and keep its content in RAM for record_readCalBin.
+	/// Returns 1 if OK, 0 = error
+	///
+	///	sens	...	A struct of type sensor which holds all sensor data
+	///
+	///	Uses record-global variables: record_calCache
+	///	Uses globals variables: RECORD_CAL_BIN_EXT, FILENAME_BUFFER_LENGTH
+
+
+	// FATFS result code, cache of the sensor and name of the binary file
+	FRESULT res;
+	UINT bw = 0;
+	recordCalCache* cache = &record_calCache[sens->index];
+	char name[FILENAME_BUFFER_LENGTH];
+	sprintf(name, "%.*s.%s", (int)(strlen(sens->fitFilename)-4), sens->fitFilename, RECORD_CAL_BIN_EXT);
+
+	// Build the file - header, data points and checksum
+	uint16_t points = (sens->dp_x == NULL || sens->dp_y == NULL) ? 0 : sens->dp_size;
+	if(points > RECFMT_CAL_POINTS_MAX)
+		points = RECFMT_CAL_POINTS_MAX;
+	uint32_t size = RECFMT_CAL_SIZE(sizeof(recfmtCalHeader), points);
+	uint8_t* file = (uint8_t*)malloc(size);
+	if(file == NULL){
+		printf("Binary CAL file: Memory alloc failed!\n");
+		return 0;
+	}
+	recfmtCalHeader* hdr = (recfmtCalHeader*)file;
+	memset(hdr, 0, sizeof(recfmtCalHeader));
+	memcpy(hdr->magic, RECFMT_CAL_MAGIC, sizeof(hdr->magic));
+	hdr->version = RECFMT_CAL_VERSION;
+	hdr->headerSize = sizeof(recfmtCalHeader);
+	hdr->points = points;
+	record_channelFromSensor((sensor*)sens, &hdr->channel);
+	memcpy(file + sizeof(recfmtCalHeader), sens->dp_x, points*sizeof(float));
+	memcpy(file + sizeof(recfmtCalHeader) + points*sizeof(float), sens->dp_y, points*sizeof(float));
+	uint32_t crc = recfmt_crc32(0, file, size - sizeof(crc));
+	memcpy(file + size - sizeof(crc), &crc, sizeof(crc));
+
+	// Write it with a single f_write (the checksum detects a file cut by a power failure)
+	FIL* fp = record_poolOpen(name, FA_CREATE_ALWAYS | FA_WRITE);
+	res = (fp != NULL) ? f_write(fp, file, size, &bw) : FR_DENIED;
+	FRESULT resClose = record_poolClose(fp);
+	if(res != FR_OK || bw != size || resClose != FR_OK || record_calStamp(name, &cache->stamp, &cache->size) != FR_OK){
+		printf("Write of binary CAL file %s failed: %d\n", name, res);
+		free(file);
+		free(cache->file);
+		cache->file = NULL;
+		return 0;
+	}
+
+	// Replace the cached content
+	free(cache->file);
+	cache->file = file;
+	strcpy(cache->name, name);
+	printf("Write of binary CAL file %s successful!\n", name);
+	return 1;
 }
 
 
 
-uint8_t record_openBMP(const char* path){
-	/// Creates a bitmap file at given path and adds an 480x272 pixel, 32bit header.
+uint8_t record_openBMP(const char* path, uint16_t width, uint16_t height, uint8_t bits){
+	/// Creates a bitmap file at given path and adds a header for a top-down image of the given size (32 bit ARGB8 or 16 bit RGB565 pixels as delivered
+	/// by EVE_cmd_snapshot2). The header fills the first sector of the file, so pixel data written in multiples of the sector size goes directly to the card.
 	/// Returns 1 if OK, 0 = error
 	///
-	/// path ... Path to the bmp-file to be created (with extension)
+	/// path	... Path to the bmp-file to be created (with extension)
+	/// width	... Pixels of a row (width*bits/8 must be a multiple of 4 - rows aren't padded)
+	/// height	... Number of rows
+	/// bits	... 32 = ARGB8 (BI_RGB), 16 = RGB565 (BI_BITFIELDS)
 	///
-	///	Uses globals variables: sdState, fil_w
+	///	Uses record-global variables: fil_bmp
+	///	Uses globals variables: sdState
 
 
-	// FATFS result code and two string buffers for comment and values
+	// FATFS result code and header (rest of the sector is zero)
 	FRESULT res = 0;
 	UINT bw;
-	// The Header of an 480x272 pixel sized 32bit bitmap
-	#define BMP_HEADER_ARGB8_32BIT_SIZE 54
-	const uint8_t bmp_header_argb8_32bit[BMP_HEADER_ARGB8_32BIT_SIZE] =
-	{
-		0x42, 0x4D, 0x38, 0xF8, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x36, 0x00, 0x00, 0x00, // Header itself - 14Byte: 2B FileType, 4B FileSize, 2B Reserved, 2B Reserved, 4B PixelDataOffset
-		0x28, 0x00, 0x00, 0x00,	0xE0, 0x01,	0x00, 0x00, 0xF0, 0xFE, 0xFF, 0xFF, 0x01, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,  // Info Header - 40Byte (see)
-		0x02, 0xF8,	0x07, 0x00, 0x12, 0x0B,	0x00, 0x00,	0x12, 0x0B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-	};
+	#define BMP_HEADER_SIZE 512
+	uint32_t header[BMP_HEADER_SIZE/sizeof(uint32_t)];
+	uint8_t* h = (uint8_t*)header;
+	uint32_t imageSize = (uint32_t)width * height * (bits/8);
+	uint32_t fileSize = BMP_HEADER_SIZE + imageSize;
+	uint32_t infoSize = 40, offset = BMP_HEADER_SIZE, compression = (bits == 16) ? 3 : 0, resolution = 2834; // 72 DPI
+	int32_t topDown = -(int32_t)height;
+	uint16_t planes = 1, bitCount = bits;
+	uint32_t masks[3] = {0xF800, 0x07E0, 0x001F}; // RGB565
+	memset(header, 0, sizeof(header));
+	// File header - 14Byte: 2B FileType, 4B FileSize, 2B Reserved, 2B Reserved, 4B PixelDataOffset
+	h[0] = 'B';
+	h[1] = 'M';
+	memcpy(&h[2], &fileSize, 4);
+	memcpy(&h[10], &offset, 4);
+	// Info header - 40Byte: 4B Size, 4B Width, 4B Height (negative = top-down), 2B Planes, 2B BitCount, 4B Compression, 4B ImageSize, 4B+4B Resolution, 4B+4B Colors
+	memcpy(&h[14], &infoSize, 4);
+	uint32_t w = width;
+	memcpy(&h[18], &w, 4);
+	memcpy(&h[22], &topDown, 4);
+	memcpy(&h[26], &planes, 2);
+	memcpy(&h[28], &bitCount, 2);
+	memcpy(&h[30], &compression, 4);
+	memcpy(&h[34], &imageSize, 4);
+	memcpy(&h[38], &resolution, 4);
+	memcpy(&h[42], &resolution, 4);
+	// Color masks of BI_BITFIELDS
+	if(bits == 16)
+		memcpy(&h[54], masks, sizeof(masks));
 
 	// Initial log line
 	printf("\nrecord_openBMP:\n");
@@ -760,13 +1506,14 @@ uint8_t record_openBMP(const char* path){
 
 		// If everything is OK open file
 		if(fil_OK){
-			// Open/Create File
-			record_openFile(path, objFILwrite, 0);
+			// Open/Create File (a file of the pool - a screenshot doesn't disturb a running recording)
+			record_poolClose(fil_bmp);
+			fil_bmp = record_poolOpen(path, FA_CREATE_ALWAYS | FA_WRITE);
 
 			// If file is ready to be written to ...
-			if(sdState == sdFileOpen){
+			if(fil_bmp != NULL){
 				// Write Header
-				res = f_write(&fil_w, bmp_header_argb8_32bit, BMP_HEADER_ARGB8_32BIT_SIZE, &bw);
+				res = f_write(fil_bmp, header, BMP_HEADER_SIZE, &bw);
 				if (res != FR_OK || bw <= 0)
 					printf("\t BMP write failed %d (bw=%d)\n", res, bw);
 				printf("Write BMP File open\n");
@@ -790,20 +1537,22 @@ uint8_t record_openBMP(const char* path){
 }
 
 void record_writeBMP(uint32_t* data, uint16_t size){
-	/// Fills a bitmap file with 32bit pixels (EVE ARGB8 Format of EVE_cmd_snapshot2).
+	/// Fills a bitmap file with pixels (EVE ARGB8 or RGB565 Format of EVE_cmd_snapshot2, see record_openBMP).
+	/// Write multiples of the sector size (512 bytes) to let them go directly to the card.
 	///
 	/// data ... Array of pixels
 	/// size ... Size of the array in byte
 	///
-	///	Uses globals variables: fil_w
+	///	Uses record-global variables: fil_bmp
 
 
 	// FATFS result code and two string buffers for comment and values
-	FRESULT res = 0;
-	UINT bw;
+	FRESULT res = FR_INVALID_OBJECT;
+	UINT bw = 0;
 
 	// Write pixel
-	res = f_write(&fil_w, data, size, &bw);
+	if(fil_bmp != NULL)
+		res = f_write(fil_bmp, data, size, &bw);
 	if (res != FR_OK || bw <= 0)
 		printf("\t BMP write failed %d (bw=%d)\n", res, bw);
 }
@@ -813,6 +1562,7 @@ void record_closeBMP(){
 	///
 	/// No input
 	///
+	///	Uses record-global variables: fil_bmp
 	///	Uses globals variables: sdState
 
 
@@ -823,7 +1573,8 @@ void record_closeBMP(){
 	if(sdState == sdMounted || sdState == sdFileOpen){
 
 		// Close file
-		record_closeFile(objFILwrite);
+		record_poolClose(fil_bmp);
+		fil_bmp = NULL;
 
 		// Add a line break to console
 		printf("\n");
@@ -832,8 +1583,154 @@ void record_closeBMP(){
 
 
 
+static void record_channelFromSensor(const sensor* sens, recfmtChannel* ch){
+	/// Copy the calibration and filter settings of a sensor to a channel of the file header.
+	///
+	///	sens	... Source sensor
+	///	ch		... Destination channel (completely overwritten)
+	///
+	///	Uses globals variables: SENSOR_RAW_SIZE, CONV_STAGES_MAX
+
+
+	memset(ch, 0, sizeof(recfmtChannel));
+	if(sens->name != NULL)
+		strncpy(ch->name, sens->name, RECFMT_NAME_LEN-1);
+	ch->sampleType = recfmtSampleU16; // int_buffer_t
+	ch->sampleSize = SENSOR_RAW_SIZE;
+	ch->fitOrder = sens->fitOrder;
+	ch->convStages = sens->convStages_size;
+	ch->avgFilterInterval = sens->avgFilterInterval;
+	ch->errorThreshold = sens->errorThreshold;
+	memcpy(ch->fitCoefficients, sens->fitCoefficients, sizeof(ch->fitCoefficients));
+	ch->originPoint = sens->originPoint;
+	ch->operatingPoint = sens->operatingPoint;
+	ch->trackerTheta = sens->trackerTheta;
+	for(uint8_t s = 0; s < CONV_STAGES_MAX; s++){
+		ch->stages[s].type = sens->convStages[s].type;
+		ch->stages[s].order = sens->convStages[s].order;
+		memcpy(ch->stages[s].coefficients, sens->convStages[s].coefficients, sizeof(ch->stages[s].coefficients));
+	}
+}
+
+static void record_channelToSensor(const recfmtChannel* ch, sensor* sens){
+	/// Apply the calibration and filter settings of a channel of a file header to a sensor and rebuild its conversion table and tracker.
+	/// Values that can't be used by this firmware are limited (filter interval, polynomial orders, number of stages).
+	///
+	///	ch		... Source channel
+	///	sens	... Destination sensor
+	///
+	///	Uses globals variables: CONV_STAGES_MAX
+
+
+	sens->fitOrder = (ch->fitOrder > 3) ? 3 : ch->fitOrder;
+	sens->avgFilterInterval = (ch->avgFilterInterval > sens->bufMaxIdx) ? sens->bufMaxIdx : ch->avgFilterInterval;
+	sens->errorThreshold = ch->errorThreshold;
+	memcpy(sens->fitCoefficients, ch->fitCoefficients, sizeof(sens->fitCoefficients));
+	sens->originPoint = ch->originPoint;
+	sens->operatingPoint = ch->operatingPoint;
+	sens->trackerTheta = ch->trackerTheta;
+	sens->convStages_size = (ch->convStages > CONV_STAGES_MAX) ? CONV_STAGES_MAX : ch->convStages;
+	for(uint8_t s = 0; s < CONV_STAGES_MAX; s++){
+		sens->convStages[s].type = ch->stages[s].type;
+		sens->convStages[s].order = (ch->stages[s].order > 3) ? 3 : ch->stages[s].order;
+		memcpy(sens->convStages[s].coefficients, ch->stages[s].coefficients, sizeof(sens->convStages[s].coefficients));
+	}
+
+	// Rebuild conversion table and tracker gains
+	measure_conv_compile(sens);
+	measure_tracker_setGains(sens);
+	measure_tracker_reset(sens);
+}
+
+static uint32_t record_buildHeader(uint8_t* buf){
+	/// Build the file header (see recfmt.h) of a recording file in buf (FIFO_BLOCK_SIZE bytes, the rest is zero).
+	/// Every header gets a new nonce (cycle counter and time of the call), so chunks of an older recording at the same sectors don't pass the checks.
+	/// Returns the seed of the chunk checksums of the file (see recfmt_chunkSeed)
+	///
+	/// buf		... Buffer of the first chunk of the file
+	///
+	///	Uses globals variables: sensors, FIFO_BLOCK_SIZE, FIFO_CHUNK_HEADER_SIZE, FIFO_LINE_SIZE, FIFO_LINE_SIZE_PAD, FIFO_EVENT_MARKER,
+	///							SENSORS_SIZE, MEASUREMENT_INTERVAL, FIRMWARE_VERSION, POSTPROCESS_..., RECORD_CODEC
+
+
+	recfmtFileHeader* hdr = (recfmtFileHeader*)buf;
+
+	// Layout of the file
+	memset(hdr, 0, FIFO_BLOCK_SIZE);
+	memcpy(hdr->magic, RECFMT_MAGIC, sizeof(hdr->magic));
+	hdr->version = RECFMT_VERSION;
+	hdr->headerSize = sizeof(recfmtFileHeader);
+	hdr->chunkSize = FIFO_BLOCK_SIZE;
+	hdr->chunkHeaderSize = FIFO_CHUNK_HEADER_SIZE;
+	hdr->lineSize = FIFO_LINE_SIZE;
+	hdr->linePad = FIFO_LINE_SIZE_PAD;
+	hdr->eventMarker = FIFO_EVENT_MARKER;
+	hdr->channels = SENSORS_SIZE;
+	hdr->postProcess = (POSTPROCESS_CHANGEORDER_AT_ERRORS ? recfmtChangeOrderAtErrors : 0) |
+					   (POSTPROCESS_INTERPOLATE_ERRORS ? recfmtInterpolateErrors : 0) |
+					   (POSTPROCESS_BUGGED_VALUES ? recfmtBuggedValues : 0);
+	hdr->interval = MEASUREMENT_INTERVAL;
+	strncpy(hdr->firmware, FIRMWARE_VERSION, RECFMT_FIRMWARE_LEN-1);
+	hdr->codec = RECORD_CODEC;
+	hdr->nonce = DWT->CYCCNT ^ (SYSTIMER_GetTime() << 7) ^ ((uint32_t)record_segmentNumber << 24);
+
+	// Calibration and filter settings of all sensors
+	for(uint8_t i = 0; i < SENSORS_SIZE; i++)
+		record_channelFromSensor((sensor*)sensors[i], &hdr->channel[i]);
+
+	// Checksum
+	hdr->crc = recfmt_crc32(0, hdr, offsetof(recfmtFileHeader, crc));
+	return recfmt_chunkSeed(hdr);
+}
+
+static FRESULT record_writeHeader(void){
+	/// Build the file header (see recfmt.h) in the first block of the FIFO and write it as first chunk of the recording file.
+	/// Must be called by record_start before the FIFO is used by the measurement handler.
+	/// Returns FR_OK on success
+	///
+	///	Uses record-global variables: record_fileBlocks, record_chunkSeed
+	///	Uses globals variables: fifo_buf, FIFO_BLOCK_SIZE
+
+
+	// Header must fit into the first chunk
+	if(sizeof(recfmtFileHeader) > FIFO_BLOCK_SIZE)
+		return FR_INVALID_PARAMETER;
+
+	// Build and write
+	record_chunkSeed = record_buildHeader((uint8_t*)fifo_buf);
+	FRESULT res = record_writeBlocks((void*)fifo_buf, 1, 0);
+	if(res == FR_OK)
+		record_fileBlocks = 1;
+	return res;
+}
+
+static void record_startAbort(const char* filename){
+	/// Undo a failed record_start after the recording file was opened: free the buffers, cut the (possibly preallocated) file to nothing,
+	/// close and remove it. Otherwise an empty file with all preallocated clusters would be left on the card.
+	///
+	/// filename	... Name of the recording file
+	///
+	///	Uses record-global variables: fil_w, record_packBuf, record_packChunk, record_prealloc, record_direct
+	///	Uses globals variables: fifo_buf
+
+
+	// Buffers (either might be missing)
+	free((uint8_t*)fifo_buf);
+	fifo_buf = NULL;
+	free(record_packBuf);
+	record_packBuf = record_packChunk = NULL;
+
+	// Release the clusters, close and remove the file
+	record_prealloc = record_direct = 0;
+	if(fil_w->obj.fs != NULL && (f_lseek(fil_w, 0) != FR_OK || f_truncate(fil_w) != FR_OK))
+		printf("Truncating the recording file failed!\n");
+	record_closeFile(objFILwrite);
+	if(f_unlink(filename) != FR_OK)
+		printf("Removing the recording file failed!\n");
+}
+
 int8_t record_start(){
-	/// Check if ready for recording, rename existing record file, open new file, allocate memory for the FIFO and change measuring mode.
+	/// Check if ready for recording, rename existing record file, open new file, allocate memory for the FIFO, write the file header and change measuring mode.
 	/// This needs to be executed ONCE before record_block() is used!
 	/// Returns 1 if OK, 0 = error
 	///
@@ -850,8 +1747,8 @@ int8_t record_start(){
 	record_mountDisk(1);
 
 	//// -------------------------------------------------
-	//// If the SD card is ready, backup possible existing file, try to open the new one, allocate fifo_buf and mark everything accordingly
-	if(sdState == sdMounted){
+	//// If the SD card is ready (files of the background conversion might be open), backup possible existing file, try to open the new one, allocate fifo_buf and mark everything accordingly
+	if(sdState == sdMounted || sdState == sdFileOpen){
 
 		// Buffer to store and modify the filename
 		char filename[FILENAME_BUFFER_LENGTH];
@@ -862,8 +1759,9 @@ int8_t record_start(){
 		filename[strlen(filename)-2] = 'I';
 		filename[strlen(filename)-3] = 'B';
 
-		// Check filename for uniqueness and rename existing file if needed
-		int8_t fil_OK = record_backupFile(filename);
+		// Check filename for uniqueness and rename existing file (and its session index) if needed
+		int8_t fil_OK = record_backupSession(filename);
+		sprintf(record_fileName, filename);
 
 		// If the filename was already unique or the existing file was renamed - actually start/init the recording
 		if(fil_OK){
@@ -875,29 +1773,95 @@ int8_t record_start(){
 				// Allocate memory for the log FIFO
 				fifo_buf = (volatile uint8_t volatile * volatile)malloc(FIFO_BLOCK_SIZE*FIFO_BLOCKS);
 
-				// Reset fifo control variables
-				fifo_writeBufIdx = 0;
+				// Reset fifo control variables, write queue, write statistics (and drop events queued before this recording)
+				record_fileBlocks = 0;
+				sdwrite_init();
+				sdqueue_init(&record_queue, &sdwrite_device);
+				record_writePending = record_submitBlock = 0;
+				memset(&record_writeStats, 0, sizeof(record_writeStats));
+
+				// Preallocate a contiguous file. Its clusters are consecutive sectors, so blocks can be written directly to the disk
+				// without FAT updates in the middle of the recording (see record_writeBlocks). Falls back to f_write if not possible.
+				record_prealloc = record_direct = 0;
+				#if FF_USE_EXPAND == 1
+				if(f_expand(fil_w, RECORD_PREALLOC_SIZE, 1) == FR_OK && f_sync(fil_w) == FR_OK){
+					record_directSector = fs.database + (DWORD)fs.csize * (fil_w->obj.sclust - 2);
+					record_prealloc = record_direct = 1;
+					printf("Preallocated %lu bytes at sector %lu\n", (uint32_t)RECORD_PREALLOC_SIZE, record_directSector);
+				}
+				else
+					printf("Preallocation failed - using f_write\n");
+				#endif
+				fifo_eventTail = fifo_eventHead;
+				fifo_writeBufIdx = FIFO_CHUNK_HEADER_SIZE; // First block starts with the chunk header too
 				fifo_writeBlock = 0;
 				fifo_recordBlock = 0;
 				for(uint8_t i = 0; i < FIFO_BLOCKS; i++)
 					fifo_finBlock[i] = 0;
+				record_sampleCount = 0;
+
+				// Buffers of the packed chunks and the encoded frame (compression, see record_blockPacked). Cycle counter measures the encoding and pyramid time.
+				if(RECORD_CODEC != recfmtCodecNone){
+					record_packBuf = record_packChunk = (uint8_t*)malloc(RECORD_PACK_CHUNKS*FIFO_BLOCK_SIZE + RECFMT_FRAME_SIZE_MAX(&record_layout));
+					record_packFrameSeq = 0;
+					record_packPos = record_packHeld = 0;
+				}
+				CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+				DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 
 				// Check for allocation errors
-				if(fifo_buf == NULL){
+				if(fifo_buf == NULL || (RECORD_CODEC != recfmtCodecNone && record_packBuf == NULL)){
 					printf("Memory allocation failed!\n");
+					record_startAbort(filename);
 				}
 				else{
 					printf("Memory allocated!\n");
 
-					// Set whole buffer null to avoid padding bytes being random
-					memset((uint8_t*)fifo_buf, 0, FIFO_BLOCK_SIZE*FIFO_BLOCKS);
-
-					// Everything is OK - change mode (this enables actual storing and flushing of values)
-					measureMode = measureModeRecording;
-
-					// Return 1 - Success!
-					printf("recording started\n");
-					return 1;
+					// Write the file header as first chunk (layout, sensors and calibration - see recfmt.h)
+					if(record_writeHeader() != FR_OK){
+						printf("Write of file header failed!\n");
+						record_startAbort(filename);
+					}
+					else{
+						// Set whole buffer null to avoid padding bytes being random
+						memset((uint8_t*)fifo_buf, 0, FIFO_BLOCK_SIZE*FIFO_BLOCKS);
+
+						// Reset sample count and sync output of the new recording
+						sync_recordStart();
+
+						// Index of the recording (entries are written with the syncs)
+						record_idxOpen = record_idxCount = record_idxPrev = 0;
+						if(record_indexOpen(filename) != FR_OK)
+							printf("Index of the recording failed - recorded without index\n");
+
+						// Pyramid of the recording (full pages are written with the syncs)
+						record_lodCount = record_lodPrev = 0;
+						record_lodReset();
+						if(record_lodOpen(filename, 0) != FR_OK)
+							printf("Pyramid of the recording failed - recorded without pyramid\n");
+
+						// Session index with the first segment (the next one is prepared by record_sync)
+						sprintf(record_sessionName, "%.*s.SES", (int)(strlen(filename)-4), filename);
+						record_segmentNumber = 0;
+						record_segmentStart = 0;
+						record_nextReady = record_nextStep = record_prevPending = 0;
+						if(record_sessionAppend(record_sessionName, filename, 0) != FR_OK)
+							printf("Session index failed!\n");
+
+						// Marker of the open recording - lets record_recover repair the file after a power loss (see record_sync)
+						record_syncTime = record_nextTime = SYSTIMER_GetTime();
+						if(f_open(&fil_o, RECORD_OPEN_FILE, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK || record_writeOpenMarker() != FR_OK)
+							printf("Marker of the open recording failed - no recovery after power loss!\n");
+						printf("Sync every %d ms - at most %lu ms lost at power failure\n", RECORD_SYNC_INTERVAL,
+								(uint32_t)(RECORD_SYNC_INTERVAL + 2*record_layout.lines*MEASUREMENT_INTERVAL));
+
+						// Everything is OK - change mode (this enables actual storing and flushing of values)
+						measureMode = measureModeRecording;
+
+						// Return 1 - Success!
+						printf("recording started\n");
+						return 1;
+					}
 				}
 			}
 		}
@@ -909,84 +1873,1401 @@ int8_t record_start(){
 	return 0;
 }
 
-void record_block(){
-	/// Record the current block (fifo_recordBlock) of the FIFO to the SD-card
-	/// No inputs or output (performance)
+static FRESULT record_writeBlocks(const void* buf, uint8_t blocks, uint8_t queue){
+	/// Write FIFO blocks to the end of the recording file. As long as the preallocated file isn't full, the blocks are written directly to
+	/// its consecutive sectors (no FatFs overhead, no FAT or directory updates) - queued if queue is set (the card writes them in the background
+	/// while the main loop continues, see record_writeUpdate), otherwise with one multi-sector disk_write. Afterwards f_write is used.
+	/// Queued blocks must stay unchanged until they are reported as written (record_writeDone), the others are written on return.
+	/// Returns FR_OK on success
+	///
+	/// buf		... First byte of the blocks
+	/// blocks	... Number of FIFO blocks to be written
+	/// queue	... If 1 blocks of the preallocated file are queued, if 0 all blocks are written before the function returns
 	///
-	///	Uses record-global variables: fil_w
-	///	Uses globals variables: fifo_buf, fifo_recordBlock, FIFO_BLOCK_SIZE
+	///	Uses record-global variables: fs, fil_w, record_fileBlocks, record_direct, record_directSector, record_queue, record_writePending, record_writeStats
+	///	Uses globals variables: FIFO_BLOCK_SIZE, RECORD_PREALLOC_SIZE
 
 
-	FRESULT res = 0; /* API result code */
-	UINT bw; /* Bytes written */
-
-	// Write a FIFO_BLOCK_SIZE sized block to the beginning of the current block
-	res = f_write(
-			&fil_w,
-			(void*)(fifo_buf + (fifo_recordBlock*FIFO_BLOCK_SIZE)),
-			FIFO_BLOCK_SIZE,
-			&bw
-		  );
-
-	// If error occurred or there are less bytes written that should be - stop recording
-	if (res != FR_OK || bw != FIFO_BLOCK_SIZE){
-		printf("Recording of block %d failed! Stopping record\n", fifo_recordBlock);
-		record_stop(0);
+	FRESULT res = FR_OK;
+	UINT bw;
+
+	if(record_direct){
+		// Blocks that still fit into the preallocated file
+		uint32_t fit = RECORD_PREALLOC_SIZE/FIFO_BLOCK_SIZE - record_fileBlocks;
+		if(fit > blocks)
+			fit = blocks;
+
+		// Stream to consecutive sectors - queued (waits for the oldest chunk if the queue is full) or right away after the queued ones
+		if(fit > 0){
+			uint32_t sector = record_directSector + record_fileBlocks*(FIFO_BLOCK_SIZE/FF_MAX_SS);
+			if(queue){
+				uint8_t state = sdqueue_submit(&record_queue, buf, sector, fit*(FIFO_BLOCK_SIZE/FF_MAX_SS));
+				if(state == sdqueueBusy){
+					res = record_writeWait(record_writePending - 1);
+					if(res != FR_OK)
+						return res;
+					state = sdqueue_submit(&record_queue, buf, sector, fit*(FIFO_BLOCK_SIZE/FF_MAX_SS));
+				}
+				if(state != sdqueueIdle)
+					return FR_DISK_ERR;
+				record_writePending += fit;
+				if(record_writePending > record_writeStats.pendingMax)
+					record_writeStats.pendingMax = record_writePending;
+			}
+			else{
+				res = record_writeWait(0);
+				if(res != FR_OK)
+					return res;
+				if(disk_write(fs.pdrv, buf, sector, fit*(FIFO_BLOCK_SIZE/FF_MAX_SS)) != RES_OK)
+					return FR_DISK_ERR;
+			}
+			buf = (const uint8_t*)buf + fit*FIFO_BLOCK_SIZE;
+			blocks -= fit;
+			record_writeStats.streamed += fit;
+		}
+
+		// Preallocated file is full - continue with f_write behind the streamed data
+		if(blocks == 0)
+			return FR_OK;
+		printf("Preallocated file full - using f_write\n");
+		record_direct = 0;
+		res = f_lseek(fil_w, (record_fileBlocks + fit)*FIFO_BLOCK_SIZE);
+		if(res != FR_OK)
+			return res;
 	}
 
+	// Write with FatFs (after the queued blocks - they are in front of these in the file)
+	res = record_writeWait(0);
+	if(res != FR_OK)
+		return res;
+	res = f_write(fil_w, buf, blocks*FIFO_BLOCK_SIZE, &bw);
+	if(res == FR_OK && bw != blocks*FIFO_BLOCK_SIZE)
+		res = FR_DENIED; // Disk full
+	if(res == FR_OK && queue)
+		record_writeDone(blocks);
+	return res;
 }
 
-int8_t record_stop(uint8_t flushData){
-	/// Check if file is open, flush remaining data to SD-card, free memory of the FIFO and change measuring mode.
-	/// This needs to be executed ONCE after the last record_block() execution!
-	/// Returns 1 if OK, 0 = error
+static void record_writeDone(uint8_t chunks){
+	/// The next chunks of the recording are written - without RECORD_CODEC their FIFO blocks are marked as processed (the measurement handler
+	/// may fill them again), packed chunks need nothing (their buffers are reused in order, see record_packWrite).
 	///
-	/// flushData	...	If 1 the remaining finished blocks will be written to the SD-card
+	/// chunks	... Number of written chunks
 	///
-	///	Uses globals variables: sdState, measureMode, fifo_buf, fifo_finBlock, fifo_recordBlock, FIFO_BLOCKS
+	///	Uses globals variables: fifo_finBlock, fifo_recordBlock, FIFO_BLOCKS, RECORD_CODEC
+
+
+	if(RECORD_CODEC != recfmtCodecNone)
+		return;
+	for(uint8_t i = 0; i < chunks; i++){
+		fifo_finBlock[fifo_recordBlock] = 0;
+		fifo_recordBlock = (fifo_recordBlock + 1) % FIFO_BLOCKS;
+	}
+}
+
+static FRESULT record_writeUpdate(void){
+	/// Let the queued writes progress without waiting (see sdqueue_poll) and release the chunks written since the last call.
+	/// Returns FR_OK on success, FR_DISK_ERR if a queued write failed
 	///
+	///	Uses record-global variables: record_queue, record_writePending
+	///	Uses globals variables: FIFO_BLOCK_SIZE
 
 
-	// Initial log line
-	printf("\nrecord_stop(flushData=%d):\n", flushData);
+	uint32_t sectors;
+	uint8_t state = sdqueue_poll(&record_queue, &sectors);
+	uint8_t done = sectors/(FIFO_BLOCK_SIZE/FF_MAX_SS);
+	record_writePending -= done;
+	record_writeDone(done);
+	return (state == sdqueueError) ? FR_DISK_ERR : FR_OK;
+}
 
-	// If a file is open, close it
-	if(sdState == sdFileOpen){
-		// Everything is OK - change mode (this enables actual storing and flushing of values)
-		measureMode = measureModeMonitoring;
+static FRESULT record_writeWait(uint8_t pending){
+	/// Wait until at most pending chunks are left in the write queue (0 = everything written). Needed before the queued data is changed or
+	/// the card is used otherwise (f_write behind the queued blocks, sync, segment switch, stop).
+	/// Returns FR_OK on success, FR_DISK_ERR if a queued write failed, FR_TIMEOUT if no chunk was written for SDWRITE_TIMEOUT ms
+	///
+	///	Uses record-global variables: record_writePending, record_writeStats
+	///	Uses globals variables: SDWRITE_TIMEOUT
 
-		// Flush remaining Blocks and data to SD-card
-		if(flushData){
-			// Write blocks till an unfinished block is found
-			while(1){
-				// No finished block left - stop
-				if(fifo_finBlock[fifo_recordBlock] == 1){
-					printf("Write finished block %d\n", fifo_recordBlock);
-
-					// Record current block
-					record_block();
-
-					// Mark Block as processed (if a block isn't processed before the measurement handler tries to write to it again the record fails)
-					fifo_finBlock[fifo_recordBlock] = 0;
-
-					// Mark next block as current record block
-					fifo_recordBlock++;
-					// Overleap correction of the current block index
-					if(fifo_recordBlock == FIFO_BLOCKS)
-						fifo_recordBlock = 0;
-				}
-				// No finished block left - stop
-				else
-					break;
-			}
 
-		}
+	uint32_t time = SYSTIMER_GetTime();
+	uint8_t left = record_writePending;
+	if(left > pending)
+		record_writeStats.waits++;
 
-		// Free Memory
-		free((uint8_t*)fifo_buf);
+	while(record_writePending > pending){
+		FRESULT res = record_writeUpdate();
+		if(res != FR_OK)
+			return res;
 
-		// Close File
-		record_closeFile(objFILwrite);
+		// Progress resets the timeout (the card might not even take the next write, see sdqueue_poll)
+		if(record_writePending != left){
+			left = record_writePending;
+			time = SYSTIMER_GetTime();
+		}
+		else if(SYSTIMER_GetTime() - time > SDWRITE_TIMEOUT*1000UL)
+			return FR_TIMEOUT;
+	}
+	return FR_OK;
+}
+
+static void record_writeReset(void){
+	/// Drop the chunks left in the write queue and the held packed chunks after a failed write (they are not part of the file, its end is before them).
+	/// The queue itself stays stopped until the next recording (see record_start).
+	///
+	///	Uses record-global variables: record_writePending, record_packHeld, record_submitBlock, record_fileBlocks
+	///	Uses globals variables: fifo_recordBlock
+
+
+	record_fileBlocks -= record_writePending;
+	record_writePending = record_packHeld = 0;
+	record_submitBlock = fifo_recordBlock;
+}
+
+uint8_t record_writePoll(void){
+	/// Let the queued writes of the recording progress (the card writes them in the background, see record_writeBlocks). Only takes the time
+	/// to pass the sectors the SDMMC host can take right now, so call it in every main tick (between the touch and the display work).
+	/// Returns the number of chunks still queued
+	///
+	///	Uses record-global variables: record_writePending
+	///	Uses globals variables: measureMode
+
+
+	// Only while recording and something is queued
+	if(measureMode != measureModeRecording || record_writePending == 0)
+		return 0;
+
+	// If error occurred - stop recording
+	if(record_writeUpdate() != FR_OK){
+		printf("Queued write of the recording failed! Stopping record\n");
+		record_stop(0);
+		return 0;
+	}
+	return record_writePending;
+}
+
+uint8_t record_block(uint8_t flush){
+	/// Record all finished blocks of the FIFO, starting behind the ones already queued (record_submitBlock), to the SD-card.
+	/// Contiguous finished blocks are coalesced into one write (two if they wrap around the end of the FIFO), because bigger writes are far
+	/// cheaper for the SD-card than single sectors. Unless flush is set or the FIFO is getting full, the number of written blocks is chosen so
+	/// the write ends at a multiple of RECORD_WRITE_ALIGN_BLOCKS in the file (the rest is written with the next call).
+	/// The blocks are only queued (see record_writeBlocks) - they are marked as processed when the card wrote them (record_writeDone, checked
+	/// here and by record_writePoll), so the main loop doesn't wait for the card.
+	/// The chunk header (running number and CRC, see recfmt.h) of every block is filled in right before it is queued.
+	/// With RECORD_CODEC the blocks are compressed instead (see record_blockPacked) and the full packed chunks are coalesced the same way (record_packWrite).
+	/// A sync (record_sync) writes the held chunks together with the partly filled one - with the default codec and RECORD_SYNC_INTERVAL a chunk
+	/// takes longer than a sync interval to fill, so most packed chunks are coalesced by the sync and not by the alignment.
+	/// Returns the number of queued blocks (0 if nothing was queued or an error occurred)
+	///
+	/// flush	... If 1 all finished blocks are written regardless of the alignment and the function returns when they are on the card
+	///
+	///	Uses record-global variables: record_fileBlocks, record_chunkSeed, record_submitBlock, record_writePending, record_writeStats
+	///	Uses globals variables: fifo_buf, fifo_finBlock, FIFO_BLOCK_SIZE, FIFO_BLOCKS, FIFO_CHUNK_HEADER_SIZE, RECORD_WRITE_ALIGN_BLOCKS
+
+
+	FRESULT res = 0; /* API result code */
+
+	// Compressed recording - blocks are encoded and packed into chunks instead
+	if(RECORD_CODEC != recfmtCodecNone)
+		return record_blockPacked(flush);
+
+	// Segment full - continue in the prepared next segment
+	if(record_nextReady && record_segmentFull()){
+		res = record_segmentSwitch();
+		if(res != FR_OK){
+			printf("Switch to the next segment failed! Stopping record\n");
+			record_stop(0);
+			return 0;
+		}
+	}
+
+	// Count contiguous finished blocks behind the queued ones (queued blocks stay finished until they are written)
+	uint8_t ready = 0;
+	while(record_writePending + ready < FIFO_BLOCKS && fifo_finBlock[(record_submitBlock + ready) % FIFO_BLOCKS] == 1)
+		ready++;
+
+	// Align end of the write in the file, but never wait if only one free block would be left
+	uint8_t count = ready;
+	if(!flush && record_writePending + ready < FIFO_BLOCKS-1)
+		count -= (record_fileBlocks + ready) % RECORD_WRITE_ALIGN_BLOCKS;
+
+	// Write blocks till the end of the FIFO, then the rest from its beginning (at most two calls)
+	uint8_t written = 0;
+	while(written < count){
+		uint8_t first = (record_submitBlock + written) % FIFO_BLOCKS;
+		uint8_t part = count - written;
+		if(first + part > FIFO_BLOCKS)
+			part = FIFO_BLOCKS - first;
+
+		// Fill in the chunk headers - running number of the data chunk (the file header is the first block of the file), index of its
+		// first measurement line (keeps the time exact after lost chunks) and checksum
+		for(uint8_t i = 0; i < part; i++){
+			recfmtChunkHeader* chunk = (recfmtChunkHeader*)(fifo_buf + ((first+i)*FIFO_BLOCK_SIZE));
+			chunk->magic = RECFMT_CHUNK_MAGIC;
+			chunk->dataSize = FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE;
+			chunk->seq = record_fileBlocks - 1 + i;
+			chunk->sample = record_sampleCount;
+			chunk->crc = recfmt_chunkCrc(chunk, FIFO_CHUNK_HEADER_SIZE, record_chunkSeed);
+			uint16_t samples = record_indexBlock(chunk->seq, (uint8_t*)chunk + FIFO_CHUNK_HEADER_SIZE);
+			record_lodBlock((uint8_t*)chunk + FIFO_CHUNK_HEADER_SIZE);
+			record_sampleCount += samples;
+		}
+
+		// Queue and measure latency (time the main loop is held up, not the time the card needs)
+		uint32_t start = DWT->CYCCNT;
+		res = record_writeBlocks((void*)(fifo_buf + (first*FIFO_BLOCK_SIZE)), part, 1);
+		record_writeLatency(start);
+
+		// If error occurred or there are less bytes written that should be - stop recording
+		if (res != FR_OK){
+			printf("Recording of block %d (+%d) failed! Stopping record\n", first, part-1);
+			record_stop(0);
+			return 0;
+		}
+		record_writeStats.blocks += part;
+		record_writeStats.chunks += part;
+		written += part;
+		record_fileBlocks += part;
+	}
+
+	// Next block to be queued (with overleap correction)
+	record_submitBlock = (record_submitBlock + count) % FIFO_BLOCKS;
+
+	// Let the queue progress (if a block isn't written before the measurement handler tries to write to it again the record fails) - with flush until everything is written
+	res = flush ? record_writeWait(0) : record_writeUpdate();
+	if(res != FR_OK){
+		printf("Queued write of the recording failed (res%d)! Stopping record\n", res);
+		record_stop(0);
+		return 0;
+	}
+
+	return count;
+}
+
+static void record_writeLatency(uint32_t start){
+	/// Add a block write that started at the cycle count start to the write statistics (time the main loop was held up).
+	///
+	///	Uses record-global variables: record_writeStats
+
+
+	uint32_t latency = RECORD_CYCLES_US(DWT->CYCCNT - start);
+	record_writeStats.calls++;
+	record_writeStats.totalTime += latency;
+	if(latency > record_writeStats.maxLatency)
+		record_writeStats.maxLatency = latency;
+}
+
+static FRESULT record_packFlush(void){
+	/// Queue the held full packed chunks (see record_packWrite) with one write. Needed before anything behind them is written or counted
+	/// (sync, marker of the open recording, segment switch, end of the recording). Does nothing without held chunks (always without RECORD_CODEC).
+	/// Returns FR_OK on success
+	///
+	///	Uses record-global variables: record_packBuf, record_packHeld, record_fileBlocks
+	///	Uses globals variables: FIFO_BLOCK_SIZE, RECORD_PACK_CHUNKS
+
+
+	if(record_packHeld == 0)
+		return FR_OK;
+
+	// Held chunks are consecutive buffers (buffer = chunk number modulo RECORD_PACK_CHUNKS, they never wrap, see record_packWrite)
+	uint32_t start = DWT->CYCCNT;
+	FRESULT res = record_writeBlocks(record_packBuf + (record_fileBlocks % RECORD_PACK_CHUNKS)*FIFO_BLOCK_SIZE, record_packHeld, 1);
+	record_writeLatency(start);
+	if(res == FR_OK){
+		record_fileBlocks += record_packHeld;
+		record_packHeld = 0;
+	}
+	return res;
+}
+
+static FRESULT record_packWrite(uint8_t keep){
+	/// Write the packed chunk (frames of compressed FIFO blocks, see recfmt.h) as next data chunk of the recording file. Unused bytes are zero.
+	/// A full chunk is held until the held chunks end at a multiple of RECORD_WRITE_ALIGN_BLOCKS in the file and then queued with one write
+	/// (record_packFlush) - the same coalescing as for uncompressed FIFO blocks (see record_block). Every chunk has its own buffer (chunk number
+	/// modulo RECORD_PACK_CHUNKS), so the held ones are consecutive in memory. If the buffer of the next chunk is still queued, this waits until it is written.
+	/// Returns FR_OK on success
+	///
+	/// keep	... If 1 the (partly filled) chunk is written in place right away (together with the held chunks) and stays the current one - it is
+	///				filled up and written again (see record_sync)
+	///
+	///	Uses record-global variables: record_packBuf, record_packChunk, record_packHeld, record_packPos, record_packSample, record_sampleCount, record_fileBlocks,
+	///								  record_chunkSeed, record_writeStats
+	///	Uses globals variables: FIFO_BLOCK_SIZE, FIFO_CHUNK_HEADER_SIZE, RECORD_PACK_CHUNKS, RECORD_WRITE_ALIGN_BLOCKS
+
+
+	// Used bytes and chunk header (running number and checksum)
+	((recfmtPackedPrefix*)(record_packChunk + FIFO_CHUNK_HEADER_SIZE))->used = record_packPos;
+	recfmtChunkHeader* chunk = (recfmtChunkHeader*)record_packChunk;
+	chunk->magic = RECFMT_CHUNK_MAGIC_PACKED;
+	chunk->dataSize = FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE;
+	chunk->seq = record_fileBlocks + record_packHeld - 1;
+	chunk->sample = (((recfmtPackedPrefix*)(record_packChunk + FIFO_CHUNK_HEADER_SIZE))->frameStart != RECFMT_NO_FRAME) ? record_packSample : record_sampleCount;
+	chunk->crc = recfmt_chunkCrc(chunk, FIFO_CHUNK_HEADER_SIZE, record_chunkSeed);
+
+	// Chunk stays the current one - write it right away, with the held chunks in front of it if it follows them in memory (one write)
+	if(keep){
+		FRESULT res = FR_OK;
+		uint8_t held = record_packHeld;
+		if(held > 0 && record_fileBlocks % RECORD_PACK_CHUNKS + held >= RECORD_PACK_CHUNKS){
+			res = record_packFlush();
+			held = 0;
+		}
+		if(res == FR_OK){
+			uint32_t start = DWT->CYCCNT;
+			res = record_writeBlocks(record_packChunk - held*FIFO_BLOCK_SIZE, held + 1, 0);
+			record_writeLatency(start);
+		}
+		if(res == FR_OK){
+			record_fileBlocks += held;
+			record_packHeld -= held;
+		}
+
+		// Written with f_write - go back to its start (streamed chunks are written at record_fileBlocks anyway)
+		if(res == FR_OK && !record_direct)
+			res = f_lseek(fil_w, record_fileBlocks*FIFO_BLOCK_SIZE);
+		return res;
+	}
+
+	// Full chunk - held, queued when the held chunks end at an aligned position in the file
+	FRESULT res = FR_OK;
+	record_packHeld++;
+	record_writeStats.chunks++;
+	if((record_fileBlocks + record_packHeld) % RECORD_WRITE_ALIGN_BLOCKS == 0)
+		res = record_packFlush();
+
+	// Buffer of the next chunk must be neither held nor queued (the queued chunks are the ones in front of the held ones)
+	if(res == FR_OK)
+		res = record_writeWait(RECORD_PACK_CHUNKS - 1 - record_packHeld);
+
+	// Next chunk starts empty
+	record_packPos = 0;
+	return res;
+}
+
+static uint8_t record_blockPacked(uint8_t flush){
+	/// Compressed version of record_block (RECORD_CODEC). Every finished block of the FIFO is encoded to a frame (recfmt_encodeFrame) and
+	/// marked as processed right away, the frames are packed one after another into a chunk that is queued when it is full (record_packWrite).
+	/// The encoding takes a few hundred us per block, so this can run in the main loop like the uncompressed writing.
+	/// Returns the number of processed blocks (0 if nothing was processed or an error occurred)
+	///
+	/// flush	... If 1 the last (not full) chunk is written as well and the function returns when all chunks are on the card
+	///
+	///	Uses record-global variables: record_layout, record_packBuf, record_packChunk, record_packPos, record_packFrameSeq, record_packSample, record_sampleCount, record_writeStats
+	///	Uses globals variables: fifo_buf, fifo_finBlock, fifo_recordBlock, FIFO_BLOCK_SIZE, FIFO_BLOCKS, FIFO_CHUNK_HEADER_SIZE, RECORD_CODEC
+
+
+	FRESULT res = FR_OK;
+	uint8_t* frame = record_packBuf + RECORD_PACK_CHUNKS*FIFO_BLOCK_SIZE;
+	uint16_t dataSize = FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE;
+	uint8_t count = 0;
+
+	while(res == FR_OK && fifo_finBlock[fifo_recordBlock] == 1){
+		// Segment full - continue in the prepared next segment (the last packed chunk is written, frames don't continue in the next file)
+		if(record_nextReady && record_segmentFull()){
+			res = record_segmentSwitch();
+			if(res != FR_OK)
+				break;
+		}
+
+		// Encode the lines of the block (behind the space of the chunk header) and measure the CPU cycles
+		const uint8_t* lines = (uint8_t*)fifo_buf + fifo_recordBlock*FIFO_BLOCK_SIZE + FIFO_CHUNK_HEADER_SIZE;
+		uint32_t start = DWT->CYCCNT;
+		uint16_t size = recfmt_encodeFrame(&record_layout, lines, RECORD_CODEC, frame);
+		uint32_t cycles = DWT->CYCCNT - start;
+		uint32_t sample = record_sampleCount;
+		record_sampleCount += record_indexBlock(record_fileBlocks + record_packHeld - 1, lines);
+		record_lodBlock(lines);
+		record_writeStats.codecCycles += cycles;
+		if(cycles > record_writeStats.codecMaxCycles)
+			record_writeStats.codecMaxCycles = cycles;
+		record_writeStats.frameBytes += size;
+		record_writeStats.blocks++;
+
+		// Block is encoded - mark it as processed and go to the next one
+		fifo_finBlock[fifo_recordBlock] = 0;
+		fifo_recordBlock = (fifo_recordBlock + 1) % FIFO_BLOCKS;
+		count++;
+
+		// Append the frame to the packed chunk. Continues in the next chunk if it doesn't fit (another buffer, see record_packWrite).
+		const uint8_t* src = frame;
+		while(size > 0){
+			// New chunk - in the buffer of its chunk number (see record_packWrite), no frame starts in it yet
+			if(record_packPos == 0){
+				record_packChunk = record_packBuf + ((record_fileBlocks + record_packHeld) % RECORD_PACK_CHUNKS)*FIFO_BLOCK_SIZE;
+				memset(record_packChunk, 0, FIFO_BLOCK_SIZE);
+				((recfmtPackedPrefix*)(record_packChunk + FIFO_CHUNK_HEADER_SIZE))->frameStart = RECFMT_NO_FRAME;
+				record_packPos = sizeof(recfmtPackedPrefix);
+			}
+			uint8_t* data = record_packChunk + FIFO_CHUNK_HEADER_SIZE;
+			recfmtPackedPrefix* prefix = (recfmtPackedPrefix*)data;
+
+			// Note the first frame that starts in this chunk (decoding restarts here after a lost chunk)
+			if(src == frame && prefix->frameStart == RECFMT_NO_FRAME){
+				prefix->frameStart = record_packPos;
+				prefix->frameSeq = record_packFrameSeq;
+				record_packSample = sample;
+			}
+			uint16_t n = dataSize - record_packPos;
+			if(n > size)
+				n = size;
+			memcpy(data + record_packPos, src, n);
+			record_packPos += n;
+			src += n;
+			size -= n;
+
+			// Chunk full - write it
+			if(record_packPos == dataSize){
+				res = record_packWrite(0);
+				if(res != FR_OK)
+					break;
+			}
+		}
+		record_packFrameSeq++;
+	}
+
+	// Write the rest
+	if(res == FR_OK && flush && record_packPos > 0)
+		res = record_packWrite(0);
+
+	// Let the queue progress - with flush until everything (held chunks included) is written
+	if(res == FR_OK && flush)
+		res = record_packFlush();
+	if(res == FR_OK)
+		res = flush ? record_writeWait(0) : record_writeUpdate();
+
+	// If error occurred - stop recording
+	if(res != FR_OK){
+		printf("Recording of packed chunk or segment switch failed (res%d)! Stopping record\n", res);
+		record_stop(0);
+		return 0;
+	}
+
+	return count;
+}
+
+static uint8_t record_segmentFull(void){
+	/// Returns 1 if the current segment must be ended before the next FIFO blocks are written: a whole FIFO wouldn't fit into RECORD_SEGMENT_SIZE
+	/// anymore (so the preallocated file is never exceeded) or the segment holds RECORD_SEGMENT_DURATION seconds of measurement lines.
+	///
+	///	Uses record-global variables: record_fileBlocks, record_packHeld, record_sampleCount, record_segmentStart
+	///	Uses globals variables: RECORD_SEGMENT_SIZE, RECORD_SEGMENT_DURATION, FIFO_BLOCK_SIZE, FIFO_BLOCKS, MEASUREMENT_INTERVAL
+
+
+	if(record_fileBlocks + record_packHeld + FIFO_BLOCKS > RECORD_SEGMENT_SIZE/FIFO_BLOCK_SIZE)
+		return 1;
+	if(RECORD_SEGMENT_DURATION > 0 && record_sampleCount - record_segmentStart >= (uint32_t)(RECORD_SEGMENT_DURATION*1000.0/MEASUREMENT_INTERVAL))
+		return 1;
+	return 0;
+}
+
+static FRESULT record_segmentPrepare(void){
+	/// Prepare the next segment of the recording while the current one is still written: find a free name (base name of the session + 3 digits),
+	/// create and preallocate the file, write its file header and create its pyramid. The switch itself (record_segmentSwitch) then needs no file
+	/// system operation. One step is done per call (record_sync calls it in free ticks with enough FIFO headroom, see record_fifoHeadroom), so no
+	/// tick holds more than one of these file system operations - the preallocation (f_expand searches the FAT) is the longest of them.
+	/// Returns FR_OK on success (also if steps are left, record_nextReady is set after the last one). On error the next call starts over.
+	///
+	///	Uses record-global variables: fil_n, fs, record_segmentNumber, record_nextName, record_nextStep, record_nextReady, record_nextPrealloc, record_nextSector, record_nextSeed
+	///	Uses globals variables: FIFO_BLOCK_SIZE, RECORD_PREALLOC_SIZE
+
+
+	FRESULT res = FR_OK;
+	switch(record_nextStep){
+		// Free name - the base name is cut to 5 characters to fit 8.3 names (one name per call)
+		case 0:
+		case 1:
+			if(record_segmentNumber >= 999){
+				record_nextStep = 0;
+				return FR_EXIST;
+			}
+			record_segmentNumber++;
+			sprintf(record_nextName, "%.*s%03u.BIN", (int)((strlen(record_sessionName)-4 < 5) ? strlen(record_sessionName)-4 : 5), record_sessionName, record_segmentNumber);
+			res = f_stat(record_nextName, NULL);
+			if(res == FR_OK){
+				record_nextStep = 1;
+				return FR_OK;
+			}
+			record_nextStep = (res == FR_NO_FILE) ? 2 : 0;
+			return (res == FR_NO_FILE) ? FR_OK : res;
+
+		// Create
+		case 2:
+			res = f_open(fil_n, record_nextName, FA_CREATE_NEW | FA_WRITE);
+			record_nextStep = (res == FR_OK) ? 3 : 0;
+			return res;
+
+		// Preallocate (contiguous, blocks are streamed with disk_write like the first segment)
+		case 3:
+			record_nextPrealloc = 0;
+			#if FF_USE_EXPAND == 1
+			if(f_expand(fil_n, RECORD_PREALLOC_SIZE, 1) == FR_OK){
+				record_nextSector = fs.database + (DWORD)fs.csize * (fil_n->obj.sclust - 2);
+				record_nextPrealloc = 1;
+			}
+			#endif
+			record_nextStep = 4;
+			return FR_OK;
+
+		// File header (the settings can't change while recording)
+		case 4:{
+			uint8_t* buf = (uint8_t*)malloc(FIFO_BLOCK_SIZE);
+			UINT bw;
+			if(buf == NULL)
+				res = FR_NOT_ENOUGH_CORE;
+			else{
+				record_nextSeed = record_buildHeader(buf);
+				res = f_write(fil_n, buf, FIFO_BLOCK_SIZE, &bw);
+				res |= f_sync(fil_n);
+				free(buf);
+			}
+			if(res != FR_OK){
+				f_close(fil_n);
+				f_unlink(record_nextName);
+				record_nextStep = 0;
+				return res;
+			}
+			record_nextStep = 5;
+			return FR_OK;
+		}
+
+		// Pyramid of the next segment (its pages are written from the switch on, the segment is recorded without if this fails)
+		default:
+			if(record_lodOpen(record_nextName, 1) != FR_OK)
+				printf("Pyramid of %s failed - recorded without pyramid\n", record_nextName);
+
+			// Ready - the marker names it, so record_recover can clean it up
+			record_nextStep = 0;
+			record_nextReady = 1;
+			printf("Next segment %s prepared (%s)\n", record_nextName, record_nextPrealloc ? "preallocated" : "f_write");
+			return record_writeOpenMarker();
+	}
+}
+
+static uint32_t record_fifoHeadroom(void){
+	/// Measurement time in ms until the FIFO overflows if no block is written from now on (rest of the block being filled and the free blocks).
+	/// File system operations besides the block writes that can take long (see record_segmentPrepare) are only done while this is big enough.
+	///
+	///	Uses globals variables: fifo_finBlock, fifo_writeBufIdx, FIFO_BLOCKS, FIFO_BLOCK_SIZE, FIFO_CHUNK_HEADER_SIZE, FIFO_LINE_SIZE, MEASUREMENT_INTERVAL
+
+
+	// Blocks that are neither finished nor being filled
+	uint8_t free = FIFO_BLOCKS - 1;
+	for(uint8_t i = 0; i < FIFO_BLOCKS && free > 0; i++)
+		free -= fifo_finBlock[i];
+
+	// Lines that fit into them and into the block being filled
+	uint32_t lines = (uint32_t)free*((FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE)/FIFO_LINE_SIZE) + (FIFO_BLOCK_SIZE - (fifo_writeBufIdx & FIFO_BITS_ONE_BLOCK))/FIFO_LINE_SIZE;
+	return (uint32_t)(lines*MEASUREMENT_INTERVAL);
+}
+
+static void record_swapFile(FIL** a, FIL** b){
+	/// Swap two file objects of the recording (only the pointers - the open files stay where they are).
+
+
+	FIL* t = *a;
+	*a = *b;
+	*b = t;
+}
+
+static FRESULT record_segmentSwitch(void){
+	/// End the current segment and continue the recording in the prepared next one (record_segmentPrepare). Called by record_block between two
+	/// FIFO blocks, so no line is lost. Only the last packed chunk is written (and the write queue emptied) here - the files are swapped and the finished segment is cut and
+	/// closed in a later tick (record_segmentFinish), the last pages of its pyramid are queued until then. Every segment is a complete recording file (own header, running numbers start at 0), only
+	/// the sample index in the chunk headers continues, so the CSV time of all segments is the time since the start of the recording.
+	/// Returns FR_OK on success
+	///
+	///	Uses record-global variables: fil_w, fil_n, fil_l, fil_ln, record_fileBlocks, record_prealloc, record_direct, record_directSector, record_chunkSeed, record_next..., record_prev...,
+	///								  record_packPos, record_packFrameSeq, record_sampleCount, record_segmentStart, record_fileName, record_idx..., record_lod...
+
+
+	// Last packed chunk of the segment, then wait for the held and queued chunks (the finished segment is cut behind them)
+	FRESULT res = FR_OK;
+	if(RECORD_CODEC != recfmtCodecNone && record_packPos > 0)
+		res = record_packWrite(0);
+	if(res == FR_OK)
+		res = record_packFlush();
+	if(res == FR_OK)
+		res = record_writeWait(0);
+	if(res != FR_OK)
+		return res;
+
+	// Swap the file objects - fil_n is the finished segment now
+	record_swapFile(&fil_w, &fil_n);
+	record_prevBlocks = record_fileBlocks;
+	record_prevPrealloc = record_prealloc;
+	record_prevPending = 1;
+
+	// Last index entry of the segment (entries of the next one follow in the buffer)
+	record_indexPush();
+	record_idxPrev = record_idxCount;
+
+	// Last buckets of the pyramid of the segment (queued pages of the next one follow) and swap to the pyramid prepared with the next segment
+	record_lodEnd();
+	record_lodPrev = record_lodCount;
+	record_lodPrevSamples = record_lodSamples;
+	record_lodReset();
+	record_swapFile(&fil_l, &fil_ln);
+	uint8_t ready = record_lodReady;
+	record_lodReady = record_lodNextReady;
+	record_lodNextReady = ready;
+
+	// Continue behind the file header of the next segment
+	record_fileBlocks = 1;
+	record_prealloc = record_direct = record_nextPrealloc;
+	record_directSector = record_nextSector;
+	record_chunkSeed = record_nextSeed;
+	record_packFrameSeq = 0;
+	record_segmentStart = record_sampleCount;
+	sprintf(record_fileName, record_nextName);
+	record_nextReady = 0;
+	return FR_OK;
+}
+
+static FRESULT record_segmentFinish(void){
+	/// Cut the unused rest of the finished segment, close it, add the current segment to the session index and update the marker of the open recording.
+	/// The index and the pyramid of the finished segment are completed and the index of the current segment created. Returns FR_OK on success
+	///
+	///	Uses record-global variables: fil_n, record_prevPending, record_prevBlocks, record_prevPrealloc, record_sessionName, record_fileName, record_segmentStart,
+	///								  record_idxPrev, record_lodPrevSamples
+
+
+	FRESULT res = FR_OK;
+	if(record_prevPrealloc)
+		res = f_lseek(fil_n, record_prevBlocks*FIFO_BLOCK_SIZE) | f_truncate(fil_n);
+	res |= f_close(fil_n);
+	record_prevPending = 0;
+	printf("Segment %s started at line %lu\n", record_fileName, record_segmentStart);
+
+	res |= record_sessionAppend(record_sessionName, record_fileName, record_segmentStart);
+	res |= record_writeOpenMarker();
+
+	// Index and pyramid of the finished segment, index of the current segment (not part of the result, the recording works without)
+	record_indexClose(record_idxPrev);
+	record_idxPrev = 0;
+	record_lodClose(1, record_lodPrevSamples);
+	if(record_indexOpen(record_fileName) != FR_OK)
+		printf("Index of %s failed - recorded without index\n", record_fileName);
+	return res;
+}
+
+static uint16_t record_indexBlock(uint32_t chunk, const uint8_t* lines){
+	/// Add a FIFO block to the index of the recording (see recfmt.h). A new entry is started at the first block that starts in a data chunk at or
+	/// behind the next multiple of RECORD_INDEX_CHUNKS, the smallest and biggest raw value of every channel are collected for the entry.
+	/// Finished entries wait in RAM and are written with the next sync (see record_sync). Called for every block instead of recfmt_countSamples.
+	/// Returns the number of measurement lines of the block
+	///
+	/// chunk	... Running number of the data chunk the block starts in (packed: the chunk its frame starts in)
+	/// lines	... Lines of the block (behind the space of the chunk header)
+	///
+	///	Uses record-global variables: record_idxEntry, record_idxOpen, record_sampleCount, record_layout
+	///	Uses globals variables: RECORD_INDEX_CHUNKS
+
+
+	// Next entry
+	if(!record_idxOpen || chunk >= record_idxEntry.chunk - record_idxEntry.chunk % RECORD_INDEX_CHUNKS + RECORD_INDEX_CHUNKS){
+		record_indexPush();
+		record_idxEntry.sample = record_sampleCount;
+		record_idxEntry.chunk = chunk;
+		memset(record_idxEntry.min, 0xFF, sizeof(record_idxEntry.min));
+		memset(record_idxEntry.max, 0, sizeof(record_idxEntry.max));
+		record_idxEntry.marks = 0;
+		record_idxOpen = 1;
+	}
+
+	// Markers in the block (lets record_seekMarker skip the blocks without one)
+	record_idxEntry.marks += recfmt_countEvents(&record_layout, lines, fifoEventMarker);
+
+	// Range of the samples (and number of measurement lines)
+	return recfmt_sampleRange(&record_layout, lines, record_idxEntry.min, record_idxEntry.max);
+}
+static void record_indexPush(void){
+	/// Finish the index entry being collected - it waits in record_idxBuf until it is written. If the buffer is full, the last waiting entry of the
+	/// same segment covers this one as well (the index gets coarser, but stays correct).
+	///
+	///	Uses record-global variables: record_idxEntry, record_idxOpen, record_idxBuf, record_idxCount, record_idxPrev
+	///	Uses globals variables: RECORD_INDEX_BUFFER, SENSORS_SIZE
+
+
+	if(!record_idxOpen)
+		return;
+	record_idxOpen = 0;
+	if(record_idxCount < RECORD_INDEX_BUFFER)
+		record_idxBuf[record_idxCount++] = record_idxEntry;
+	else if(record_idxCount > record_idxPrev){
+		recfmtIndexEntry* last = &record_idxBuf[record_idxCount-1];
+		for(uint8_t c = 0; c < SENSORS_SIZE; c++){
+			if(record_idxEntry.min[c] < last->min[c])
+				last->min[c] = record_idxEntry.min[c];
+			if(record_idxEntry.max[c] > last->max[c])
+				last->max[c] = record_idxEntry.max[c];
+		}
+		last->marks += record_idxEntry.marks;
+	}
+}
+static FRESULT record_indexOpen(const char* filename_BIN){
+	/// Create the index of a recording file (same name with the extension .IDX, see recfmt.h) as fil_i and write its header. A recording
+	/// continues without index if this fails. Returns FR_OK on success
+	///
+	/// filename_BIN	... Name of the .BIN file
+	///
+	///	Uses record-global variables: fil_i, record_idxReady
+	///	Uses globals variables: FILENAME_BUFFER_LENGTH, RECORD_INDEX_CHUNKS, FIFO_BLOCK_SIZE, SENSORS_SIZE
+
+
+	char filename_IDX[FILENAME_BUFFER_LENGTH];
+	UINT bw;
+	recfmtIndexHeader hdr = {
+		.version = RECFMT_INDEX_VERSION,
+		.headerSize = sizeof(recfmtIndexHeader),
+		.entrySize = sizeof(recfmtIndexEntry),
+		.chunks = RECORD_INDEX_CHUNKS,
+		.chunkSize = FIFO_BLOCK_SIZE,
+		.channels = SENSORS_SIZE,
+		.markType = fifoEventMarker
+	};
+	memcpy(hdr.magic, RECFMT_INDEX_MAGIC, sizeof(hdr.magic));
+	sprintf(filename_IDX, "%.*s.IDX", (int)(strlen(filename_BIN)-4), filename_BIN);
+
+	FRESULT res = f_open(&fil_i, filename_IDX, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res == FR_OK){
+		res = f_write(&fil_i, &hdr, sizeof(hdr), &bw);
+		if(res != FR_OK)
+			f_close(&fil_i);
+	}
+	record_idxReady = (res == FR_OK);
+	return res;
+}
+static FRESULT record_indexWrite(uint8_t count){
+	/// Write the first count waiting entries to the index of the current segment (fil_i) and remove them from record_idxBuf. The index is closed
+	/// on error (the recording continues). Returns FR_OK on success
+	///
+	/// count	... Number of entries
+	///
+	///	Uses record-global variables: fil_i, record_idxBuf, record_idxCount, record_idxReady
+
+
+	UINT bw;
+	FRESULT res = FR_OK;
+	if(count == 0)
+		return FR_OK;
+	if(record_idxReady){
+		res = f_write(&fil_i, record_idxBuf, count*sizeof(recfmtIndexEntry), &bw);
+		if(res != FR_OK){
+			printf("Index of the recording failed (res%d) - continued without\n", res);
+			f_close(&fil_i);
+			record_idxReady = 0;
+		}
+	}
+	memmove(record_idxBuf, &record_idxBuf[count], (record_idxCount - count)*sizeof(recfmtIndexEntry));
+	record_idxCount -= count;
+	return res;
+}
+static FRESULT record_indexClose(uint8_t count){
+	/// Write the first count waiting entries and close the index of the current segment (fil_i). Returns FR_OK on success
+	///
+	/// count	... Number of entries (the last ones of the segment)
+	///
+	///	Uses record-global variables: fil_i, record_idxReady
+
+
+	FRESULT res = record_indexWrite(count);
+	if(record_idxReady)
+		res |= f_close(&fil_i);
+	record_idxReady = 0;
+	return res;
+}
+static void record_lodBlock(const uint8_t* lines){
+	/// Add the measurement lines of a FIFO block to the min/max/mean pyramid of the recording segment (see recfmt.h). Every RECORD_LOD_BASE lines a
+	/// bucket of level 0 is finished, with every RECORD_LOD_FACTOR buckets one of the next level (record_lodFinish). Full pages wait in RAM and are
+	/// written with the next sync (see record_sync). Costs a compare and an add per sample plus the finished buckets - the CPU cycles are measured.
+	///
+	/// lines	... Lines of the block (behind the space of the chunk header)
+	///
+	///	Uses record-global variables: record_lodBucket, record_lodSamples, record_layout, record_writeStats
+	///	Uses globals variables: RECORD_LOD_BASE, RECORD_LOD_FACTOR, RECORD_LOD_LEVELS, FIFO_LINE_SIZE, SENSORS_SIZE
+
+
+	uint32_t start = DWT->CYCCNT;
+	recordLodBucket* b = &record_lodBucket[0];
+	for(uint16_t l = recfmt_nextSample(&record_layout, lines, 0); l < record_layout.lines; l = recfmt_nextSample(&record_layout, lines, l + 1)){
+		// Samples of the line
+		const int_buffer_t* line = (const int_buffer_t*)(lines + l*FIFO_LINE_SIZE);
+		for(uint8_t c = 0; c < SENSORS_SIZE; c++){
+			if(line[c] < b->min[c])
+				b->min[c] = line[c];
+			if(line[c] > b->max[c])
+				b->max[c] = line[c];
+			b->sum[c] += line[c];
+		}
+		b->lines++;
+		record_lodSamples++;
+
+		// Bucket full - finish it and the buckets of the higher levels that get full with it
+		if(++b->parts == RECORD_LOD_BASE){
+			for(uint8_t lv = 0; lv < RECORD_LOD_LEVELS && record_lodBucket[lv].parts == ((lv == 0) ? RECORD_LOD_BASE : RECORD_LOD_FACTOR); lv++)
+				record_lodFinish(lv);
+		}
+	}
+
+	// CPU cycles
+	uint32_t cycles = DWT->CYCCNT - start;
+	record_writeStats.lodCycles += cycles;
+	if(cycles > record_writeStats.lodMaxCycles)
+		record_writeStats.lodMaxCycles = cycles;
+}
+static void record_lodFinish(uint8_t level){
+	/// Finish the bucket being collected on a level of the pyramid: append its smallest, biggest and mean value of every channel to the page of the
+	/// level (a full page is queued), add it to the bucket of the next level and start a new one.
+	///
+	/// level	... Level of the bucket
+	///
+	///	Uses record-global variables: record_lodBucket, record_lodPage
+	///	Uses globals variables: RECORD_LOD_LEVELS, SENSORS_SIZE
+
+
+	recordLodBucket* b = &record_lodBucket[level];
+	recfmtLodPage* page = (recfmtLodPage*)record_lodPage[level];
+	recfmtLodValue* val = (recfmtLodValue*)((uint8_t*)page + sizeof(recfmtLodPage)) + page->buckets*SENSORS_SIZE;
+
+	// Values of the bucket
+	for(uint8_t c = 0; c < SENSORS_SIZE; c++){
+		val[c].min = b->min[c];
+		val[c].max = b->max[c];
+		val[c].mean = (uint16_t)((b->sum[c] + b->lines/2) / b->lines);
+	}
+
+	// Page full - queue it, the next page starts with the following bucket
+	if(++page->buckets == RECORD_LOD_PAGE_BUCKETS){
+		record_lodQueuePage((uint8_t*)page);
+		page->first += page->buckets;
+		page->buckets = 0;
+	}
+
+	// Bucket of the next level
+	if(level + 1 < RECORD_LOD_LEVELS){
+		recordLodBucket* up = &record_lodBucket[level + 1];
+		for(uint8_t c = 0; c < SENSORS_SIZE; c++){
+			if(b->min[c] < up->min[c])
+				up->min[c] = b->min[c];
+			if(b->max[c] > up->max[c])
+				up->max[c] = b->max[c];
+			up->sum[c] += b->sum[c];
+		}
+		up->lines += b->lines;
+		up->parts++;
+	}
+
+	// New bucket
+	memset(b, 0, sizeof(recordLodBucket));
+	memset(b->min, 0xFF, sizeof(b->min));
+}
+static void record_lodQueuePage(const uint8_t* page){
+	/// Queue a full page of the pyramid - it is written with the next sync. If the queue is full, the oldest page is written right away.
+	///
+	/// page	... Page (RECORD_LOD_PAGE_SIZE bytes)
+	///
+	///	Uses record-global variables: record_lodQueue, record_lodCount
+	///	Uses globals variables: RECORD_LOD_QUEUE, RECORD_LOD_PAGE_SIZE
+
+
+	if(record_lodCount == RECORD_LOD_QUEUE)
+		record_lodWrite(1);
+	memcpy(record_lodQueue[record_lodCount++], page, RECORD_LOD_PAGE_SIZE);
+}
+static void record_lodEnd(void){
+	/// End the pyramid of a segment: the partly filled buckets of all levels (the last lines) are finished and the partly filled page of every
+	/// level is queued in the order of the levels (they are the end of the file, see recfmt_lodPage).
+	///
+	///	Uses record-global variables: record_lodBucket, record_lodPage
+	///	Uses globals variables: RECORD_LOD_LEVELS
+
+
+	for(uint8_t l = 0; l < RECORD_LOD_LEVELS; l++){
+		if(record_lodBucket[l].parts > 0)
+			record_lodFinish(l);
+		if(((recfmtLodPage*)record_lodPage[l])->buckets > 0)
+			record_lodQueuePage((uint8_t*)record_lodPage[l]);
+	}
+}
+static void record_lodReset(void){
+	/// Start the pyramid of a new segment (no lines, empty buckets and pages). Queued pages are kept.
+	///
+	///	Uses record-global variables: record_lodBucket, record_lodPage, record_lodSamples
+	///	Uses globals variables: RECORD_LOD_LEVELS
+
+
+	memset(record_lodBucket, 0, sizeof(record_lodBucket));
+	for(uint8_t l = 0; l < RECORD_LOD_LEVELS; l++){
+		memset(record_lodBucket[l].min, 0xFF, sizeof(record_lodBucket[l].min));
+		memset(record_lodPage[l], 0, sizeof(recfmtLodPage));
+		((recfmtLodPage*)record_lodPage[l])->level = l;
+	}
+	record_lodSamples = 0;
+}
+static void record_lodHeader(recfmtLodHeader* hdr, uint32_t samples, uint8_t complete){
+	/// Header of the pyramid of a recording written by this firmware (see recfmt.h).
+	///
+	/// hdr			... Returns the header
+	/// samples		... Measurement lines covered
+	/// complete	... 1 if the file is closed
+	///
+	///	Uses globals variables: RECORD_LOD_..., SENSORS_SIZE
+
+
+	memset(hdr, 0, sizeof(recfmtLodHeader));
+	memcpy(hdr->magic, RECFMT_LOD_MAGIC, sizeof(hdr->magic));
+	hdr->version = RECFMT_LOD_VERSION;
+	hdr->headerSize = sizeof(recfmtLodHeader);
+	hdr->pageSize = RECORD_LOD_PAGE_SIZE;
+	hdr->bucketSize = SENSORS_SIZE*sizeof(recfmtLodValue);
+	hdr->base = RECORD_LOD_BASE;
+	hdr->factor = RECORD_LOD_FACTOR;
+	hdr->levels = RECORD_LOD_LEVELS;
+	hdr->channels = SENSORS_SIZE;
+	hdr->complete = complete;
+	hdr->samples = samples;
+}
+static FRESULT record_lodOpen(const char* filename_BIN, uint8_t next){
+	/// Create the pyramid of a recording file (same name with the extension .LOD, see recfmt.h) and write its header page. A recording continues
+	/// without pyramid if this fails. Returns FR_OK on success
+	///
+	/// filename_BIN	... Name of the .BIN file
+	/// next			... 0 = current segment (fil_l), 1 = prepared next segment (fil_ln)
+	///
+	///	Uses record-global variables: fil_l, fil_ln, record_lodReady, record_lodNextReady
+	///	Uses globals variables: FILENAME_BUFFER_LENGTH, RECORD_LOD_PAGE_SIZE
+
+
+	char filename_LOD[FILENAME_BUFFER_LENGTH];
+	FIL* fp = next ? fil_ln : fil_l;
+	uint8_t* ready = next ? &record_lodNextReady : &record_lodReady;
+	UINT bw;
+	sprintf(filename_LOD, "%.*s.LOD", (int)(strlen(filename_BIN)-4), filename_BIN);
+
+	// Header page (rest of the page is zero)
+	uint8_t* buf = (uint8_t*)calloc(1, RECORD_LOD_PAGE_SIZE);
+	FRESULT res = (buf != NULL) ? f_open(fp, filename_LOD, FA_CREATE_ALWAYS | FA_WRITE) : FR_NOT_ENOUGH_CORE;
+	if(res == FR_OK){
+		record_lodHeader((recfmtLodHeader*)buf, 0, 0);
+		res = f_write(fp, buf, RECORD_LOD_PAGE_SIZE, &bw);
+		if(res != FR_OK)
+			f_close(fp);
+	}
+	free(buf);
+	*ready = (res == FR_OK);
+	return res;
+}
+static FRESULT record_lodWrite(uint8_t count){
+	/// Write the first count queued pages of the pyramid and remove them from the queue. Pages of the finished segment (record_lodPrev) are
+	/// written to fil_ln, the others to fil_l. A pyramid is closed on error (the recording continues). Returns FR_OK on success
+	///
+	/// count	... Number of pages
+	///
+	///	Uses record-global variables: fil_l, fil_ln, record_lodQueue, record_lodCount, record_lodPrev, record_lodReady, record_lodNextReady, record_writeStats
+	///	Uses globals variables: RECORD_LOD_PAGE_SIZE
+
+
+	UINT bw;
+	FRESULT res = FR_OK;
+	for(uint8_t i = 0; i < count; i++){
+		FIL* fp = (i < record_lodPrev) ? fil_ln : fil_l;
+		uint8_t* ready = (i < record_lodPrev) ? &record_lodNextReady : &record_lodReady;
+		if(!*ready)
+			continue;
+		FRESULT r = f_write(fp, record_lodQueue[i], RECORD_LOD_PAGE_SIZE, &bw);
+		if(r == FR_OK && bw != RECORD_LOD_PAGE_SIZE)
+			r = FR_DENIED; // Disk full
+		if(r != FR_OK){
+			printf("Pyramid of the recording failed (res%d) - continued without\n", r);
+			f_close(fp);
+			*ready = 0;
+			res = r;
+		}
+		else
+			record_writeStats.lodPages++;
+	}
+	memmove(record_lodQueue, record_lodQueue[count], (record_lodCount - count)*RECORD_LOD_PAGE_SIZE);
+	record_lodCount -= count;
+	record_lodPrev = (record_lodPrev > count) ? record_lodPrev - count : 0;
+	return res;
+}
+static FRESULT record_lodClose(uint8_t prev, uint32_t samples){
+	/// Write the queued pages of a pyramid, mark it complete in its header and close it. Returns FR_OK on success
+	///
+	/// prev		... 1 = pyramid of the finished segment (fil_ln, record_lodPrev pages), 0 = the one of the current segment (fil_l, all pages)
+	/// samples		... Measurement lines of the segment
+	///
+	///	Uses record-global variables: fil_l, fil_ln, record_lodCount, record_lodPrev, record_lodReady, record_lodNextReady
+
+
+	UINT bw;
+	recfmtLodHeader hdr;
+	FIL* fp = prev ? fil_ln : fil_l;
+	uint8_t* ready = prev ? &record_lodNextReady : &record_lodReady;
+	FRESULT res = record_lodWrite(prev ? record_lodPrev : record_lodCount);
+	if(!*ready)
+		return (res != FR_OK) ? res : FR_INVALID_OBJECT;
+
+	// Header with the number of lines (the last pages are written)
+	record_lodHeader(&hdr, samples, 1);
+	res = f_lseek(fp, 0);
+	res |= f_write(fp, &hdr, sizeof(hdr), &bw);
+	res |= f_close(fp);
+	*ready = 0;
+	return res;
+}
+static FRESULT record_sessionAppend(const char* session, const char* filename, uint32_t sample){
+	/// Add a segment to the session index (created with its header if it doesn't exist yet). The segment number is given by the lines of the index.
+	/// Returns FR_OK on success
+	///
+	/// session		... Name of the session index (.SES)
+	/// filename	... Name of the .BIN file of the segment
+	/// sample		... Index of the first measurement line of the segment
+	///
+	///	Uses record-global variables: fil_x
+	///	Uses globals variables: RECORD_SES_HEADER, RECORD_SES_FORMAT, RECORD_SES_LINE_SIZE, MEASUREMENT_INTERVAL
+
+
+	char buff[RECORD_SES_LINE_SIZE + 1];
+	UINT bw;
+	FRESULT res = f_open(&fil_x, session, FA_OPEN_ALWAYS | FA_WRITE);
+	if(res != FR_OK)
+		return res;
+
+	// Header of a new index, segment number from the size of an existing one
+	uint16_t segment = 0;
+	if(f_size(&fil_x) == 0)
+		res = f_write(&fil_x, RECORD_SES_HEADER "\n", strlen(RECORD_SES_HEADER) + 1, &bw);
+	else{
+		segment = (f_size(&fil_x) - strlen(RECORD_SES_HEADER) - 1) / RECORD_SES_LINE_SIZE;
+		res = f_lseek(&fil_x, strlen(RECORD_SES_HEADER) + 1 + segment*RECORD_SES_LINE_SIZE);
+	}
+
+	// Line of the segment
+	sprintf(buff, RECORD_SES_FORMAT "\n", segment, filename, sample, sample * (MEASUREMENT_INTERVAL/1000.0));
+	res |= f_write(&fil_x, buff, RECORD_SES_LINE_SIZE, &bw);
+	res |= f_close(&fil_x);
+	return res;
+}
+
+static FRESULT record_sessionSegment(const char* session, uint16_t segment, char* filename){
+	/// Get the file of a segment from the session index - a single read at the position of its line. Returns FR_OK on success,
+	/// FR_NO_FILE if there is no such segment.
+	///
+	/// session		... Name of the session index (.SES)
+	/// segment		... Number of the segment
+	/// filename	... Name of the .BIN file of the segment (FILENAME_BUFFER_LENGTH bytes)
+	///
+	///	Uses record-global variables: fil_x
+	///	Uses globals variables: RECORD_SES_HEADER, RECORD_SES_LINE_SIZE
+
+
+	char buff[RECORD_SES_LINE_SIZE + 1] = {0};
+	UINT br = 0;
+	unsigned int number;
+	FRESULT res = f_open(&fil_x, session, FA_READ);
+	if(res != FR_OK)
+		return res;
+	res = f_lseek(&fil_x, strlen(RECORD_SES_HEADER) + 1 + segment*RECORD_SES_LINE_SIZE);
+	res |= f_read(&fil_x, buff, RECORD_SES_LINE_SIZE, &br);
+	f_close(&fil_x);
+	if(res == FR_OK && (br != RECORD_SES_LINE_SIZE || sscanf(buff, "%u;%12s", &number, filename) != 2 || number != segment))
+		res = FR_NO_FILE;
+	return res;
+}
+
+static void record_backupSidecar(const char* filename_BIN, const char* ext){
+	/// Give a sidecar file of the .BIN file renamed by the last record_backupFile (same base name, e.g. the index .IDX) the new name as well.
+	/// It is deleted if that fails - it would belong to the wrong recording otherwise.
+	///
+	/// filename_BIN	... Old name of the .BIN file
+	/// ext				... Extension of the sidecar file
+	///
+	///	Uses record-global variables: record_backupName
+	///	Uses globals variables: FILENAME_BUFFER_LENGTH
+
+
+	char sidecar[FILENAME_BUFFER_LENGTH];
+	char renamed[FILENAME_BUFFER_LENGTH];
+	sprintf(sidecar, "%.*s.%s", (int)(strlen(filename_BIN)-4), filename_BIN, ext);
+	sprintf(renamed, "%.*s.%s", (int)(strlen(record_backupName)-4), record_backupName, ext);
+	if(record_backupName[0] == '\0' || f_stat(sidecar, NULL) != FR_OK)
+		return;
+	if(f_rename(sidecar, renamed) != FR_OK){
+		printf("\t%s can't be renamed to %s - deleted\n", sidecar, renamed);
+		f_unlink(sidecar);
+	}
+}
+static int8_t record_backupSession(const char* filename_BIN){
+	/// Backup the first .BIN file of the last recording (see record_backupFile) with its index, its pyramid and its session index, which get the same new name
+	/// (the session index the new name of the .BIN file in its first line as well). The other segments keep their names (they are unique, see record_segmentPrepare).
+	/// Returns 1 if OK, 0 = error
+	///
+	/// filename_BIN	... Name of the first .BIN file of the new recording
+	///
+	///	Uses record-global variables: fil_x, record_backupName, record_convSession
+	///	Uses globals variables: FILENAME_BUFFER_LENGTH, RECORD_SES_HEADER
+
+
+	char session[FILENAME_BUFFER_LENGTH];
+	char renamed[FILENAME_BUFFER_LENGTH];
+	sprintf(session, "%.*s.SES", (int)(strlen(filename_BIN)-4), filename_BIN);
+
+	// First segment and its index
+	int8_t fil_OK = record_backupFile(filename_BIN);
+	if(fil_OK){
+		record_backupSidecar(filename_BIN, "IDX");
+		record_backupSidecar(filename_BIN, "LOD");
+	}
+	if(!fil_OK || f_stat(session, NULL) != FR_OK)
+		return fil_OK;
+
+	// Session index with the same name as the renamed .BIN file (fall back to the next free one)
+	if(record_backupName[0] == '\0')
+		return record_backupFile(session);
+	sprintf(renamed, "%.*s.SES", (int)(strlen(record_backupName)-4), record_backupName);
+	if(f_rename(session, renamed) != FR_OK){
+		printf("\tSession index can't be renamed to %s\n", renamed);
+		return record_backupFile(session);
+	}
+
+	// The background conversion might still follow this session
+	if(strcmp(record_convSession, session) == 0)
+		sprintf(record_convSession, renamed);
+
+	// Name of the first segment (fixed size field of the first line)
+	char field[13];
+	UINT bw;
+	sprintf(field, "%-12s", record_backupName);
+	if(f_open(&fil_x, renamed, FA_OPEN_EXISTING | FA_WRITE) == FR_OK){
+		if(f_lseek(&fil_x, strlen(RECORD_SES_HEADER) + 1 + 4) != FR_OK || f_write(&fil_x, field, 12, &bw) != FR_OK)
+			printf("\tSession index %s not updated\n", renamed);
+		f_close(&fil_x);
+	}
+	return 1;
+}
+
+static FRESULT record_writeOpenMarker(void){
+	/// Write the marker of the open recording (RECORD_OPEN_FILE): name of the .BIN file, the number of chunks written to it including the
+	/// file header and a partly filled packed chunk written in place, the prepared next segment ("-" = none) and the session index (one value
+	/// per line). Synced to the card right away. Writes the held chunks and waits for the write queue first, so the chunks counted are on the card.
+	/// Returns FR_OK on success.
+	///
+	///	Uses record-global variables: fil_o, record_fileName, record_fileBlocks, record_packPos, record_nextName, record_nextReady, record_sessionName
+
+
+	char buff[3*FILENAME_BUFFER_LENGTH + 20];
+	UINT bw;
+	FRESULT res = record_packFlush();
+	if(res == FR_OK)
+		res = record_writeWait(0);
+	if(res != FR_OK)
+		return res;
+	uint32_t chunks = record_fileBlocks + ((RECORD_CODEC != recfmtCodecNone && record_packPos > 0) ? 1 : 0);
+	sprintf(buff, "%s\n%lu\n%s\n%s\n", record_fileName, chunks, record_nextReady ? record_nextName : "-", record_sessionName);
+
+	res = f_lseek(&fil_o, 0);
+	res |= f_write(&fil_o, buff, strlen(buff), &bw);
+	res |= f_truncate(&fil_o);
+	res |= f_sync(&fil_o);
+	return res;
+}
+
+uint8_t record_sync(void){
+	/// Make the written part of the recording crash safe. Every RECORD_SYNC_INTERVAL ms a partly filled packed chunk is written in place, the
+	/// directory entry and FAT are updated if the blocks are written with f_write (streamed blocks of the preallocated file need no update) and
+	/// the marker of the open recording is rewritten. After a power loss record_recover repairs the file at the next startup.
+	/// Call in ticks without a finished FIFO block only (a sync never delays record_block). Everything but the FIFO block being filled and the
+	/// blocks finished since the last sync is safe, so at most RECORD_SYNC_INTERVAL plus two FIFO blocks of measurement time are lost.
+	/// Ticks without sync are used to prepare the next segment and to close the finished one (see record_segmentSwitch).
+	/// Returns 1 if the tick was used in this call, 0 otherwise.
+	///
+	///	Uses record-global variables: fil_w, fil_i, fil_l, record_syncTime, record_nextTime, record_direct, record_packPos, record_idxCount, record_idxReady,
+	///								  record_lodCount, record_lodReady, record_writeStats
+	///	Uses globals variables: measureMode, RECORD_SYNC_INTERVAL, RECORD_CODEC
+
+
+	// Only while recording
+	uint32_t start = SYSTIMER_GetTime();
+	uint32_t startCycles = DWT->CYCCNT;
+	FRESULT res = FR_OK;
+	if(measureMode != measureModeRecording)
+		return 0;
+
+	// Finished segment - cut and close it right after the switch (uses the tick)
+	if(record_prevPending){
+		if(record_segmentFinish() != FR_OK)
+			printf("Closing the finished segment failed!\n");
+		return 1;
+	}
+
+	// Next segment isn't prepared yet - one step of the preparation if no sync is due and the FIFO has enough headroom for it (uses the tick).
+	// A new preparation is started at most once per interval (also after a failed one), the following steps are done in the next free ticks.
+	if(start - record_syncTime < RECORD_SYNC_INTERVAL*1000UL){
+		if(record_nextReady || (record_nextStep == 0 && start - record_nextTime < RECORD_SYNC_INTERVAL*1000UL) || record_fifoHeadroom() < RECORD_PREPARE_HEADROOM)
+			return 0;
+		if(record_nextStep == 0)
+			record_nextTime = start;
+		if(record_segmentPrepare() != FR_OK)
+			printf("Preparing the next segment failed - current one is continued!\n");
+		return 1;
+	}
+	record_syncTime = start;
+
+	// Partly filled packed chunk (otherwise lost with all frames in it, written together with the held chunks if possible)
+	if(RECORD_CODEC != recfmtCodecNone && record_packPos > 0)
+		res = record_packWrite(1);
+
+	// Held and queued chunks (the sync only covers chunks on the card)
+	if(res == FR_OK)
+		res = record_packFlush();
+	if(res == FR_OK)
+		res = record_writeWait(0);
+
+	// Blocks written with f_write - update size in directory entry and FAT
+	if(res == FR_OK && !record_direct)
+		res = f_sync(fil_w);
+
+	// Waiting index entries (they only point to chunks written before, errors just end the index)
+	if(res == FR_OK && record_idxCount > 0 && record_indexWrite(record_idxCount) == FR_OK && record_idxReady)
+		f_sync(&fil_i);
+
+	// Queued pages of the pyramid (same as the index)
+	if(res == FR_OK && record_lodCount > 0 && record_lodWrite(record_lodCount) == FR_OK && record_lodReady)
+		f_sync(fil_l);
+
+	// Marker of the open recording (its sync flushes the disk as well)
+	if(res == FR_OK)
+		res = record_writeOpenMarker();
+
+	// Added latency of the sync
+	uint32_t latency = RECORD_CYCLES_US(DWT->CYCCNT - startCycles);
+	record_writeStats.syncs++;
+	record_writeStats.syncTotalTime += latency;
+	if(latency > record_writeStats.syncMaxLatency)
+		record_writeStats.syncMaxLatency = latency;
+
+	// If error occurred - stop recording
+	if(res != FR_OK){
+		printf("Sync of the recording failed (res%d)! Stopping record\n", res);
+		record_stop(0);
+	}
+	return 1;
+}
+
+int8_t record_stop(uint8_t flushData){
+	/// Check if file is open, flush remaining data to SD-card, free memory of the FIFO and change measuring mode.
+	/// This needs to be executed ONCE after the last record_block() execution!
+	/// Returns 1 if OK, 0 = error
+	///
+	/// flushData	...	If 1 the remaining finished blocks will be written to the SD-card
+	///
+	///	Uses record-global variables: record_queue, record_writePending, record_packBuf, record_packChunk, record_writeStats
+	///	Uses globals variables: sdState, measureMode, fifo_buf, fifo_finBlock, fifo_recordBlock, FIFO_BLOCKS
+	///
+
+
+	// Initial log line
+	printf("\nrecord_stop(flushData=%d):\n", flushData);
+
+	// If a file is open, close it
+	if(sdState == sdFileOpen){
+		// Everything is OK - change mode (this enables actual storing and flushing of values)
+		measureMode = measureModeMonitoring;
+
+		// Flush remaining Blocks and data to SD-card (all finished blocks, without waiting for alignment)
+		if(flushData){
+			printf("Write finished blocks from %d\n", fifo_recordBlock);
+			record_block(1);
+		}
+		// Stopped because of an error - write what is queued if the card still works (dropped otherwise), report finished blocks that are lost
+		else{
+			uint8_t queued = 0;
+			if(record_packFlush() != FR_OK || record_writeWait(0) != FR_OK){
+				queued = record_writePending + record_packHeld;
+				printf("%d queued chunks not written (lost)\n", queued);
+				record_writeReset();
+			}
+			uint8_t lost = 0;
+			for(uint8_t i = 0; i < FIFO_BLOCKS; i++)
+				lost += fifo_finBlock[i];
+			if(RECORD_CODEC == recfmtCodecNone)
+				lost -= queued; // Queued blocks are still marked as finished
+			if(lost > 0)
+				printf("%d finished blocks not written (lost)\n", lost);
+			if(RECORD_CODEC != recfmtCodecNone && record_packChunk != NULL && record_packPos > 0)
+				printf("Packed chunk with %d bytes not written (lost since the last sync)\n", record_packPos);
+		}
+
+		// Close a finished segment and delete the prepared next one (not used, also if its preparation isn't finished yet)
+		if(record_prevPending)
+			record_segmentFinish();
+		if(record_nextReady || record_nextStep > 2){
+			char filename_LOD[FILENAME_BUFFER_LENGTH];
+			f_close(fil_n);
+			f_unlink(record_nextName);
+			if(record_lodNextReady)
+				f_close(fil_ln);
+			record_lodNextReady = 0;
+			sprintf(filename_LOD, "%.*s.LOD", (int)(strlen(record_nextName)-4), record_nextName);
+			f_unlink(filename_LOD);
+			record_nextReady = record_nextStep = 0;
+		}
+
+		// Complete the index with the last entry and the pyramid with the last buckets
+		record_indexPush();
+		if(record_indexClose(record_idxCount) != FR_OK)
+			printf("Index of the recording incomplete\n");
+		record_lodEnd();
+		if(record_lodClose(0, record_lodSamples) != FR_OK)
+			printf("Pyramid of the recording incomplete\n");
+
+		// Write statistics of this recording
+		printf("Write stats: %lu calls, %lu blocks, %lu chunks streamed, max latency %lu us, avg %lu us/call\n",
+				record_writeStats.calls, record_writeStats.blocks, record_writeStats.streamed, record_writeStats.maxLatency,
+				(record_writeStats.calls > 0) ? record_writeStats.totalTime/record_writeStats.calls : 0);
+		printf("Write queue: %lu card writes, max %lu chunks queued, %lu waits, %lu deferred polls\n",
+				record_queue.writes, record_writeStats.pendingMax, record_writeStats.waits, record_queue.deferred);
+
+		// Compression statistics (ratio of the FIFO blocks to the written chunks and CPU cycles per block)
+		if(RECORD_CODEC != recfmtCodecNone && record_writeStats.blocks > 0){
+			printf("Codec: %lu blocks -> %lu chunks (ratio %.2f, frames %.2f), %lu cycles/block avg, %lu max\n",
+					record_writeStats.blocks, record_writeStats.chunks,
+					(record_writeStats.chunks > 0) ? (float)record_writeStats.blocks/record_writeStats.chunks : 0.0f,
+					(float)record_writeStats.blocks*(FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE)/record_writeStats.frameBytes,
+					record_writeStats.codecCycles/record_writeStats.blocks, record_writeStats.codecMaxCycles);
+		}
+
+		// Pyramid statistics (CPU cycles per FIFO block and size compared to the written chunks)
+		if(record_writeStats.blocks > 0 && record_writeStats.chunks > 0){
+			printf("Pyramid: %lu cycles/block avg, %lu max, %lu pages (%.1f%% of the recording)\n",
+					record_writeStats.lodCycles/record_writeStats.blocks, record_writeStats.lodMaxCycles, record_writeStats.lodPages,
+					100.0f*record_writeStats.lodPages*RECORD_LOD_PAGE_SIZE/((float)record_writeStats.chunks*FIFO_BLOCK_SIZE));
+		}
+
+		// Free Memory
+		free((uint8_t*)fifo_buf);
+		free(record_packBuf);
+		record_packBuf = record_packChunk = NULL;
+
+		// Cut the unused rest of a preallocated file (file pointer to the end of the written data)
+		if(record_prealloc){
+			record_prealloc = record_direct = 0;
+			if(f_lseek(fil_w, record_fileBlocks*FIFO_BLOCK_SIZE) != FR_OK || f_truncate(fil_w) != FR_OK)
+				printf("Truncate of preallocated file failed\n");
+		}
+
+		// Sync statistics (added latency of the crash safety, see record_sync)
+		printf("Sync stats: %lu syncs, max latency %lu us, avg %lu us/sync\n", record_writeStats.syncs, record_writeStats.syncMaxLatency,
+				(record_writeStats.syncs > 0) ? record_writeStats.syncTotalTime/record_writeStats.syncs : 0);
+
+		// Close File
+		record_closeFile(objFILwrite);
+
+		// File is complete - delete the marker of the open recording (kept on error, the file is repaired at the next startup)
+		f_close(&fil_o);
+		if(sdState != sdError)
+			f_unlink(RECORD_OPEN_FILE);
 
 		// If everything is OK
 		if(sdState != sdError){
@@ -997,177 +3278,1410 @@ int8_t record_stop(uint8_t flushData){
 
 	}
 
-	// Return 0 - Stop failed!
-	printf("recording stop failed\n");
+	// Return 0 - Stop failed!
+	printf("recording stop failed\n");
+	return 0;
+}
+
+static FRESULT record_recoverFile(const char* filename, uint32_t* blocks, uint32_t* sample){
+	/// Repair a recording file that wasn't closed: keep the synced chunks and the chunks behind them (at most RECORD_RECOVER_SCAN_BLOCKS) as long
+	/// as their framing is valid (magic, CRC and running number) and cut the file behind the last valid chunk, which frees the rest of the preallocation.
+	/// The CRC is seeded with the file header (see recfmt_chunkSeed) and the sample index has to continue the one of the chunk before, so chunks an
+	/// older recording left in the reused preallocation aren't taken for new ones. Index entries of chunks that weren't kept are cut as well.
+	/// Returns FR_OK on success
+	///
+	/// filename	... Name of the .BIN file
+	/// blocks		... Synced chunks including the file header (from the marker) - returns the chunks kept
+	/// sample		... Returns the sample index of the first data chunk (unchanged if there is none, NULL = not needed)
+	///
+	///	Uses record-global variables: fil_w, fil_i, record_layout
+	///	Uses globals variables: RECORD_RECOVER_SCAN_BLOCKS, FIFO_BLOCK_SIZE, FIFO_CHUNK_HEADER_SIZE, FILENAME_BUFFER_LENGTH
+
+
+	// Open the file for reading and cutting
+	UINT br;
+	uint8_t* chunk = (uint8_t*)malloc(FIFO_BLOCK_SIZE);
+	FRESULT res = (chunk != NULL) ? record_openFile(filename, objFILwrite, FA_OPEN_EXISTING | FA_READ) : FR_NOT_ENOUGH_CORE;
+
+	// File header - gives the magic and the checksum seed of the data chunks (the layout must be the one of this firmware, it was written by it)
+	uint16_t magic = 0;
+	uint32_t seed = 0;
+	if(res == FR_OK && f_read(fil_w, chunk, FIFO_BLOCK_SIZE, &br) == FR_OK && recfmt_checkHeader(chunk, br) == recfmtHeaderOK){
+		recfmtFileHeader* hdr = (recfmtFileHeader*)chunk;
+		if(hdr->chunkSize == FIFO_BLOCK_SIZE && hdr->chunkHeaderSize == FIFO_CHUNK_HEADER_SIZE){
+			magic = (recfmt_codec(hdr) != recfmtCodecNone) ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC;
+			seed = recfmt_chunkSeed(hdr);
+		}
+	}
+
+	// Chunks behind the last sync - keep them as long as they are valid and continue the running number and the sample index.
+	// The last synced data chunk is read first to get the sample index the next chunk has to continue with.
+	if(res == FR_OK){
+		uint32_t synced = *blocks;
+		uint32_t fileBlocks = f_size(fil_w) / FIFO_BLOCK_SIZE;
+		uint32_t valid = (synced < fileBlocks) ? synced : fileBlocks;
+		uint32_t pos = (valid > 1) ? valid - 1 : valid;
+		uint8_t  known = 0;		// 1 if 'last' is set by a chunk before
+		uint32_t last = 0;		// Lines: sample index the next chunk starts with, packed: sample index of the chunk before
+		uint32_t step = (uint32_t)record_layout.lines * ((FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE)/sizeof(recfmtFrameHeader) + 1); // Most lines of a packed chunk
+		if(magic != 0 && f_lseek(fil_w, pos*FIFO_BLOCK_SIZE) == FR_OK){
+			for(; pos < fileBlocks && pos < synced + RECORD_RECOVER_SCAN_BLOCKS; pos++){
+				recfmtChunkHeader* ch = (recfmtChunkHeader*)chunk;
+				if(f_read(fil_w, chunk, FIFO_BLOCK_SIZE, &br) != FR_OK || br != FIFO_BLOCK_SIZE || ch->magic != magic ||
+				   ch->dataSize != FIFO_BLOCK_SIZE - FIFO_CHUNK_HEADER_SIZE || ch->seq != pos - 1 || recfmt_chunkCrc(chunk, FIFO_CHUNK_HEADER_SIZE, seed) != ch->crc)
+					break;
+
+				// Sample index - lines: right behind the measurement lines of the chunk before, packed: not back and not further than a chunk of frames holds
+				if(known && ((magic == RECFMT_CHUNK_MAGIC) ? (ch->sample != last) : (ch->sample < last || ch->sample - last > step)))
+					break;
+				known = 1;
+				last = (magic == RECFMT_CHUNK_MAGIC) ? ch->sample + recfmt_countSamples(&record_layout, chunk + FIFO_CHUNK_HEADER_SIZE) : ch->sample;
+				if(pos >= valid)
+					valid = pos + 1;
+			}
+		}
+
+		// Sample index of the first data chunk
+		if(sample != NULL && valid > 1 && f_lseek(fil_w, FIFO_BLOCK_SIZE) == FR_OK && f_read(fil_w, chunk, FIFO_BLOCK_SIZE, &br) == FR_OK)
+			*sample = ((recfmtChunkHeader*)chunk)->sample;
+
+		// Cut behind the last valid chunk
+		res = f_lseek(fil_w, valid*FIFO_BLOCK_SIZE);
+		res |= f_truncate(fil_w);
+		record_closeFile(objFILwrite);
+		printf("Recovered %lu chunks of %s (%lu behind the last sync)\n", valid, filename, (valid > synced) ? valid - synced : 0);
+		*blocks = valid;
+
+		// Cut the index behind the last entry that starts in a kept chunk
+		recfmtIndexEntry entry;
+		char filename_IDX[FILENAME_BUFFER_LENGTH];
+		sprintf(filename_IDX, "%.*s.IDX", (int)(strlen(filename)-4), filename);
+		if(f_open(&fil_i, filename_IDX, FA_OPEN_EXISTING | FA_READ | FA_WRITE) == FR_OK){
+			FSIZE_t end = sizeof(recfmtIndexHeader);
+			if(f_lseek(&fil_i, end) == FR_OK){
+				while(f_read(&fil_i, &entry, sizeof(entry), &br) == FR_OK && br == sizeof(entry) && entry.chunk + 1 < valid)
+					end += sizeof(entry);
+			}
+			if(f_lseek(&fil_i, end) != FR_OK || f_truncate(&fil_i) != FR_OK)
+				printf("Index of %s not repaired\n", filename);
+			f_close(&fil_i);
+		}
+	}
+	free(chunk);
+	return res;
+}
+
+void record_recover(void){
+	/// Repair a recording that wasn't stopped (power loss) - call once at startup. The marker of the open recording (RECORD_OPEN_FILE) names the file,
+	/// the chunks that were complete at the last sync (see record_sync), the prepared next segment and the session index. The file is repaired
+	/// (record_recoverFile). A prepared next segment is deleted - unless the recording was already switched to it, then it is repaired and added to
+	/// the session index as well. All segments of the session (none was converted yet) are converted to CSV in the background.
+	///
+	///	Uses record-global variables: fil_o
+	///	Uses globals variables: sdState, RECORD_OPEN_FILE, FILENAME_BUFFER_LENGTH
+
+
+	// Nothing to do if the last recording was stopped
+	record_mountDisk(1);
+	if((sdState != sdMounted && sdState != sdFileOpen) || f_open(&fil_o, RECORD_OPEN_FILE, FA_READ) != FR_OK)
+		return;
+
+	// Read marker (name, synced chunks including the file header, next segment, session index)
+	char buff[3*FILENAME_BUFFER_LENGTH + 20] = {0};
+	char filename[FILENAME_BUFFER_LENGTH];
+	char next[FILENAME_BUFFER_LENGTH] = "-";
+	char session[FILENAME_BUFFER_LENGTH] = "-";
+	unsigned long blocks;
+	UINT br;
+	f_read(&fil_o, buff, sizeof(buff)-1, &br);
+	f_close(&fil_o);
+	if(sscanf(buff, "%19s %lu %19s %19s", filename, &blocks, next, session) < 2 || blocks == 0){
+		printf("Marker of the open recording corrupt - deleted\n");
+		f_unlink(RECORD_OPEN_FILE);
+		return;
+	}
+	printf("\nrecord_recover: %s wasn't stopped, %lu chunks synced\n", filename, blocks);
+
+	// Repair the file
+	uint32_t valid = blocks;
+	FRESULT res = record_recoverFile(filename, &valid, NULL);
+	if(res != FR_OK)
+		printf("Error: Repair of %s failed (res%d)!\n", filename, res);
+
+	// Prepared next segment - delete it (and its pyramid) if it holds nothing but the file header
+	if(strcmp(next, "-") != 0){
+		uint32_t sample = 0;
+		valid = 1;
+		if(record_recoverFile(next, &valid, &sample) == FR_OK && valid > 1)
+			record_sessionAppend(session, next, sample);
+		else{
+			f_unlink(next);
+			sprintf(buff, "%.*s.LOD", (int)(strlen(next)-4), next);
+			f_unlink(buff);
+		}
+	}
+
+	// Marker is deleted in any case (a file that can't be repaired stays as it is)
+	f_unlink(RECORD_OPEN_FILE);
+
+	// Convert the session from its first segment (just the file if there is no session index)
+	char first[FILENAME_BUFFER_LENGTH];
+	if(strcmp(session, "-") == 0 || record_sessionSegment(session, 0, first) != FR_OK)
+		sprintf(first, filename);
+	record_convertStart(first);
+}
+
+int8_t record_seekOpen(const char* filename_BIN){
+	/// Open a recording (.BIN file, path) for random access (record_seekSample, record_seekRange, record_seekLod) - e.g. to jump to a time of a long
+	/// recording or to plot it. The .BIN file, its index and its pyramid (same name with .IDX and .LOD, see recfmt.h) get a cluster link map table
+	/// (FatFs fast seek), so a seek needs no walk along the FAT. Without index the chunk headers are searched. A recording that is opened is closed first.
+	/// Returns 1 if OK, 0 on error
+	///
+	///	filename_BIN	...	Path to the .BIN file
+	///
+	///	Uses record-global variables: fil_s, fil_si, fil_sl, record_seek...
+	///	Uses globals variables: sdState, FIFO_BLOCK_SIZE, FILENAME_BUFFER_LENGTH, RECORD_SEEK_CLMT_SIZE, SENSORS_SIZE
+
+
+	// Mount disk (kept if other files are open)
+	record_seekClose();
+	record_mountDisk(1);
+	if(sdState != sdMounted && sdState != sdFileOpen)
+		return 0;
+
+	// File header - chunks must hold the index of their first line (version 2) and fit into a FIFO block
+	UINT br;
+	uint8_t* buf = (uint8_t*)malloc(FIFO_BLOCK_SIZE);
+	FRESULT res = (buf != NULL) ? f_open(&fil_s, filename_BIN, FA_READ) : FR_NOT_ENOUGH_CORE;
+	if(res == FR_OK){
+		res = f_read(&fil_s, buf, FIFO_BLOCK_SIZE, &br);
+		recfmtFileHeader* hdr = (recfmtFileHeader*)buf;
+		if(res == FR_OK && (recfmt_checkHeader(buf, br) != recfmtHeaderOK || hdr->version < 2 || hdr->chunkSize > FIFO_BLOCK_SIZE ||
+		   hdr->chunkHeaderSize < sizeof(recfmtChunkHeader)))
+			res = FR_INVALID_OBJECT;
+		record_seekChunkSize = hdr->chunkSize;
+		record_seekChunkHeaderSize = hdr->chunkHeaderSize;
+		record_seekChunkSeed = recfmt_chunkSeed(hdr);
+		if(res != FR_OK)
+			f_close(&fil_s);
+	}
+	free(buf);
+	if(res != FR_OK){
+		printf("Error: %s can't be opened for seeking (res%d)!\n", filename_BIN, res);
+		return 0;
+	}
+	record_seekChunks = f_size(&fil_s) / record_seekChunkSize - 1;
+	record_seekReady = 1;
+
+	// Cluster link map table (a file with more fragments than the table holds is seeked the normal way)
+	fil_s.cltbl = record_seekClmt[0];
+	record_seekClmt[0][0] = RECORD_SEEK_CLMT_SIZE;
+	if(f_lseek(&fil_s, CREATE_LINKMAP) != FR_OK)
+		fil_s.cltbl = NULL;
+
+	// Index (must belong to the same layout)
+	char filename_IDX[FILENAME_BUFFER_LENGTH];
+	recfmtIndexHeader idx;
+	sprintf(filename_IDX, "%.*s.IDX", (int)(strlen(filename_BIN)-4), filename_BIN);
+	record_seekEntries = 0;
+	if(f_open(&fil_si, filename_IDX, FA_READ) == FR_OK){
+		if(f_read(&fil_si, &idx, sizeof(idx), &br) == FR_OK && br == sizeof(idx) && memcmp(idx.magic, RECFMT_INDEX_MAGIC, sizeof(idx.magic)) == 0 &&
+		   idx.version == RECFMT_INDEX_VERSION && idx.chunkSize == record_seekChunkSize && idx.entrySize >= offsetof(recfmtIndexEntry, marks) &&
+		   f_size(&fil_si) >= idx.headerSize){
+			record_seekEntryStart = idx.headerSize;
+			record_seekEntrySize = idx.entrySize;
+			record_seekMarkType = (idx.entrySize >= sizeof(recfmtIndexEntry)) ? idx.markType : 0;
+			record_seekEntries = (f_size(&fil_si) - idx.headerSize) / idx.entrySize;
+			fil_si.cltbl = record_seekClmt[1];
+			record_seekClmt[1][0] = RECORD_SEEK_CLMT_SIZE;
+			if(f_lseek(&fil_si, CREATE_LINKMAP) != FR_OK)
+				fil_si.cltbl = NULL;
+		}
+		else
+			f_close(&fil_si);
+	}
+	// Pyramid (must belong to the same channels, a file that wasn't closed gives its full pages)
+	char filename_LOD[FILENAME_BUFFER_LENGTH];
+	sprintf(filename_LOD, "%.*s.LOD", (int)(strlen(filename_BIN)-4), filename_BIN);
+	record_seekLodHeader.levels = 0;
+	if(f_open(&fil_sl, filename_LOD, FA_READ) == FR_OK){
+		recfmtLodHeader* lod = &record_seekLodHeader;
+		if(f_read(&fil_sl, lod, sizeof(recfmtLodHeader), &br) == FR_OK && br == sizeof(recfmtLodHeader) && lod->pageSize > 0 &&
+		   recfmt_lodContent(lod, f_size(&fil_sl) / lod->pageSize - 1, &record_seekLodContent) && lod->channels == SENSORS_SIZE){
+			fil_sl.cltbl = record_seekClmt[2];
+			record_seekClmt[2][0] = RECORD_SEEK_CLMT_SIZE;
+			if(f_lseek(&fil_sl, CREATE_LINKMAP) != FR_OK)
+				fil_sl.cltbl = NULL;
+		}
+		else{
+			lod->levels = 0;
+			f_close(&fil_sl);
+		}
+	}
+	printf("Opened %s for seeking: %lu chunks, %lu index entries, %d pyramid levels, fast seek %s\n", filename_BIN, record_seekChunks, record_seekEntries,
+			record_seekLodHeader.levels, (fil_s.cltbl != NULL) ? "on" : "off");
+	return 1;
+}
+
+static FRESULT record_seekEntry(uint32_t entry, recfmtIndexEntry* e){
+	/// Read an entry of the index of the recording opened for seeking. Returns FR_OK on success
+	///
+	///	entry	... Number of the entry
+	///	e		... Returns the entry
+	///
+	///	Uses record-global variables: fil_si, record_seekEntryStart, record_seekEntrySize
+
+
+	// Entries of older indexes end before marks (they read as 0)
+	UINT br;
+	UINT size = (record_seekEntrySize < sizeof(recfmtIndexEntry)) ? record_seekEntrySize : sizeof(recfmtIndexEntry);
+	memset(e, 0, sizeof(recfmtIndexEntry));
+	FRESULT res = f_lseek(&fil_si, record_seekEntryStart + (FSIZE_t)entry*record_seekEntrySize);
+	if(res == FR_OK)
+		res = f_read(&fil_si, e, size, &br);
+	return (res == FR_OK && br != size) ? FR_INT_ERR : res;
+}
+
+static FRESULT record_seekChunk(uint32_t chunk, uint8_t* buf){
+	/// Read a data chunk of the recording opened for seeking and check it (magic and CRC). Returns FR_OK on success, FR_INT_ERR if it is corrupt
+	///
+	///	chunk	... Running number of the data chunk
+	///	buf		... Buffer for the chunk (FIFO_BLOCK_SIZE bytes)
+	///
+	///	Uses record-global variables: fil_s, record_seekChunkSize, record_seekChunkHeaderSize, record_seekChunkSeed
+
+
+	UINT br;
+	recfmtChunkHeader* ch = (recfmtChunkHeader*)buf;
+	FRESULT res = f_lseek(&fil_s, (FSIZE_t)(chunk + 1)*record_seekChunkSize);
+	if(res == FR_OK)
+		res = f_read(&fil_s, buf, record_seekChunkSize, &br);
+	if(res == FR_OK && (br != record_seekChunkSize || (ch->magic != RECFMT_CHUNK_MAGIC && ch->magic != RECFMT_CHUNK_MAGIC_PACKED) ||
+	   ch->dataSize != record_seekChunkSize - record_seekChunkHeaderSize || recfmt_chunkCrc(buf, record_seekChunkHeaderSize, record_seekChunkSeed) != ch->crc))
+		res = FR_INT_ERR;
+	return res;
+}
+
+FRESULT record_seekSample(uint32_t sample, uint8_t* chunk, uint32_t* chunkNumber){
+	/// Read the data chunk of the recording opened for seeking at which decoding must start to get measurement line 'sample': the last chunk
+	/// whose first line (packed: first frame, see recfmtPackedPrefix) isn't behind it. The index narrows the search down to RECORD_INDEX_CHUNKS
+	/// chunks (a few reads of it), these are searched binary by their headers - no matter how long the recording is.
+	/// Returns FR_OK on success
+	///
+	///	sample		... Index of the measurement line (time / MEASUREMENT_INTERVAL)
+	///	chunk		... Buffer for the chunk (FIFO_BLOCK_SIZE bytes)
+	///	chunkNumber	... Returns the running number of the chunk (line 'sample' is in it or in one of the following ones)
+	///
+	///	Uses record-global variables: record_seekReady, record_seekChunks, record_seekEntries
+
+
+	if(!record_seekReady || record_seekChunks == 0)
+		return FR_INVALID_OBJECT;
+
+	// Chunks to search - the ones of the last index entry that doesn't start behind the line (whole file without index)
+	uint32_t lo = 0, hi = record_seekChunks;
+	FRESULT res = FR_OK;
+	if(record_seekEntries > 0){
+		recfmtIndexEntry e;
+		uint32_t a = 0, b = record_seekEntries;
+		while(res == FR_OK && b - a > 1){
+			uint32_t m = (a + b) / 2;
+			res = record_seekEntry(m, &e);
+			if(e.sample <= sample)
+				a = m;
+			else
+				b = m;
+		}
+		if(res == FR_OK && record_seekEntry(a, &e) == FR_OK && e.sample <= sample && e.chunk < hi)
+			lo = e.chunk;
+		if(res == FR_OK && b < record_seekEntries && record_seekEntry(b, &e) == FR_OK && e.chunk > lo && e.chunk < hi)
+			hi = e.chunk;
+	}
+
+	// Binary search of the chunk headers (a corrupt chunk is treated like one behind the line)
+	while(res == FR_OK && hi - lo > 1){
+		uint32_t m = (lo + hi) / 2;
+		res = record_seekChunk(m, chunk);
+		if(res == FR_OK && ((recfmtChunkHeader*)chunk)->sample <= sample)
+			lo = m;
+		else
+			hi = m;
+		if(res == FR_INT_ERR)
+			res = FR_OK;
+	}
+
+	// Chunk to start at
+	if(res == FR_OK)
+		res = record_seekChunk(lo, chunk);
+	*chunkNumber = lo;
+	return res;
+}
+
+uint8_t record_seekRange(uint32_t first, uint32_t last, uint16_t* min, uint16_t* max){
+	/// Smallest and biggest raw value of every channel of the measurement lines first to last of the recording opened for seeking - taken from
+	/// the index only (e.g. overview of a long recording). The range covers whole index entries, so it can be a bit bigger.
+	/// Returns the number of index entries used (0 = no index)
+	///
+	///	first	... Index of the first measurement line
+	///	last	... Index of the last measurement line
+	///	min		... Returns the smallest value of every channel (SENSORS_SIZE values, 0xFFFF if there are no lines)
+	///	max		... Returns the biggest value of every channel (SENSORS_SIZE values)
+	///
+	///	Uses record-global variables: record_seekReady, record_seekEntries
+	///	Uses globals variables: SENSORS_SIZE
+
+
+	memset(min, 0xFF, SENSORS_SIZE*sizeof(uint16_t));
+	memset(max, 0, SENSORS_SIZE*sizeof(uint16_t));
+	if(!record_seekReady || record_seekEntries == 0)
+		return 0;
+
+	// Last entry that doesn't start behind the first line
+	recfmtIndexEntry e;
+	uint32_t a = 0, b = record_seekEntries;
+	while(b - a > 1){
+		uint32_t m = (a + b) / 2;
+		if(record_seekEntry(m, &e) != FR_OK)
+			return 0;
+		if(e.sample <= first)
+			a = m;
+		else
+			b = m;
+	}
+
+	// Entries up to the last line (read one after another)
+	uint8_t used = 0;
+	for(uint32_t i = a; i < record_seekEntries && record_seekEntry(i, &e) == FR_OK && (i == a || e.sample <= last); i++){
+		for(uint8_t c = 0; c < SENSORS_SIZE; c++){
+			if(e.min[c] < min[c])
+				min[c] = e.min[c];
+			if(e.max[c] > max[c])
+				max[c] = e.max[c];
+		}
+		if(used < 255)
+			used++;
+	}
+	return used;
+}
+
+uint16_t record_seekMarker(uint32_t from, uint32_t* first, uint32_t* next){
+	/// Find the next part of the recording opened for seeking that holds markers (fifoEventMarker) - taken from the index only, so a long
+	/// recording is searched without decoding it. The markers themselves are read by decoding this part only (start with record_seekSample(first)).
+	/// Returns the number of markers in the part (0 = no marker at or behind the index entry of 'from', or no index with marker counts)
+	///
+	///	from	... Index of the measurement line to start at (the part holding it is found as well)
+	///	first	... Returns the first measurement line of the part
+	///	next	... Returns the first measurement line behind the part (0xFFFFFFFF if it lasts to the end of the file)
+	///
+	///	Uses record-global variables: record_seekReady, record_seekEntries, record_seekMarkType
+
+
+	if(!record_seekReady || record_seekEntries == 0 || record_seekMarkType != fifoEventMarker)
+		return 0;
+
+	// Last entry that doesn't start behind the line
+	recfmtIndexEntry e;
+	uint32_t a = 0, b = record_seekEntries;
+	while(b - a > 1){
+		uint32_t m = (a + b) / 2;
+		if(record_seekEntry(m, &e) != FR_OK)
+			return 0;
+		if(e.sample <= from)
+			a = m;
+		else
+			b = m;
+	}
+
+	// Entries from there on (read one after another) up to the first one with markers
+	for(uint32_t i = a; i < record_seekEntries && record_seekEntry(i, &e) == FR_OK; i++){
+		if(e.marks == 0)
+			continue;
+		*first = e.sample;
+		*next = 0xFFFFFFFF;
+		uint16_t marks = e.marks;
+		if(i + 1 < record_seekEntries && record_seekEntry(i + 1, &e) == FR_OK)
+			*next = e.sample;
+		return marks;
+	}
 	return 0;
 }
 
-void record_convertBinFile(const char* filename, sensor** sensArray){
-	/// Read the .BIN file (path) and write a corresponding .CSV file. The base name of both files will be same (error if not possible).
-	/// Therefore only the base name of 'filename' is used, extensions are changed as needed (a parameter "test.csv" or "test.bin" will lead to the same result!).
-	/// Note: This function is not optimized for high speed. It should only be used when performance is not top priority (after end of record, not during).
-	/// Returns nothing. Note: This would be much faster if used with the FIFO, but for current situation there is no need.
+uint32_t record_seekLodBuckets(uint8_t level, uint32_t* lines){
+	/// Number of buckets of a level of the pyramid of the recording opened for seeking - e.g. to choose the level that gives about one bucket per
+	/// pixel of a plot. Returns 0 if there is no such level
 	///
-	///	filename	...	Path to the .BIN file.
-	/// dp_x		... Optional. A float array holding all x-values (nominal/ ADC output) used to do the curve fit (sorted!)
+	///	level	... Level of the pyramid (0 = smallest buckets)
+	///	lines	... Returns the measurement lines of a bucket of the level
 	///
-	///	Uses record-global variables: objFILread, objFILwrite
-	///	Uses globals variables: sdState, measureMode, CSVLINE_BUFFER_LENGTH, FILENAME_BUFFER_LENGTH, MEASUREMENT_INTERVAL, SENSORS_SIZE, SENSOR_RAW_SIZE, RECORD_CSV_HEADER, RECORD_CSV_FORMAT, RECORD_CSV_ARGUMENTS, FIFO_LINE_SIZE_PAD
+	///	Uses record-global variables: record_seekReady, record_seekLodHeader, record_seekLodContent
 
 
-	// FATFS result code, Bytes written and a string buffer
-	FRESULT res = 0;
+	if(!record_seekReady || level >= record_seekLodHeader.levels)
+		return 0;
+	*lines = record_seekLodHeader.base;
+	for(uint8_t l = 0; l < level; l++)
+		*lines *= record_seekLodHeader.factor;
+	return record_seekLodContent.buckets[level];
+}
+
+uint32_t record_seekLod(uint8_t level, uint32_t first, uint32_t count, recfmtLodValue* values){
+	/// Read buckets of a level of the pyramid of the recording opened for seeking (smallest, biggest and mean raw value of every channel, see recfmt.h).
+	/// Bucket i covers the measurement lines from i * record_seekLodBuckets lines on (counted from the first line of the .BIN file). A window of a plot
+	/// needs one read per page of the pyramid, no matter how long the recording is.
+	/// Returns the number of buckets read (less than count at the end of the level, 0 if there is no pyramid or on error)
+	///
+	///	level	... Level of the pyramid
+	///	first	... Number of the first bucket
+	///	count	... Number of buckets
+	///	values	... Returns the buckets (count * SENSORS_SIZE values, channel after channel for every bucket)
+	///
+	///	Uses record-global variables: fil_sl, record_seekReady, record_seekLodHeader, record_seekLodContent
+	///	Uses globals variables: SENSORS_SIZE
+
+
+	recfmtLodHeader* hdr = &record_seekLodHeader;
+	if(!record_seekReady || level >= hdr->levels || first >= record_seekLodContent.buckets[level])
+		return 0;
+	if(count > record_seekLodContent.buckets[level] - first)
+		count = record_seekLodContent.buckets[level] - first;
+
+	// Buckets page by page (the page header must match, so a broken file can't give values of another level)
+	uint32_t perPage = RECFMT_LOD_PAGE_BUCKETS(hdr);
+	uint32_t done = 0;
+	while(done < count){
+		uint32_t bucket = first + done;
+		uint32_t pos = recfmt_lodPage(hdr, &record_seekLodContent, level, bucket / perPage);
+		uint32_t n = perPage - bucket % perPage;
+		if(n > count - done)
+			n = count - done;
+		recfmtLodPage page;
+		UINT br, br2;
+		if(pos == 0 || f_lseek(&fil_sl, (FSIZE_t)pos*hdr->pageSize) != FR_OK || f_read(&fil_sl, &page, sizeof(page), &br) != FR_OK ||
+		   br != sizeof(page) || page.level != level || page.first != bucket - bucket % perPage || page.buckets <= bucket % perPage)
+			break;
+		if(n > page.buckets - bucket % perPage)
+			n = page.buckets - bucket % perPage;
+		if(f_lseek(&fil_sl, (FSIZE_t)pos*hdr->pageSize + sizeof(page) + (bucket % perPage)*hdr->bucketSize) != FR_OK ||
+		   f_read(&fil_sl, values + done*SENSORS_SIZE, n*hdr->bucketSize, &br2) != FR_OK || br2 != n*hdr->bucketSize)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+void record_seekClose(void){
+	/// Close the recording opened for seeking (record_seekOpen).
+	///
+	///	Uses record-global variables: fil_s, fil_si, fil_sl, record_seekReady, record_seekEntries, record_seekLodHeader
+
+
+	if(!record_seekReady)
+		return;
+	f_close(&fil_s);
+	if(record_seekEntries > 0)
+		f_close(&fil_si);
+	if(record_seekLodHeader.levels > 0)
+		f_close(&fil_sl);
+	record_seekReady = 0;
+	record_seekEntries = 0;
+	record_seekLodHeader.levels = 0;
+}
+
+static uint8_t record_convertLoadChunk(const char** gapReason, uint32_t* gapSeq, uint32_t* gapChunks){
+	/// Take the next chunk of the .BIN file being converted from the input buffer and check its chunk header. The input buffer is refilled with
+	/// one read of record_convInSize bytes when it is used up. Sets record_convChunk and record_convChunkPos/End to the data of the chunk.
+	/// Lost chunks are reported by gapChunks (0 = none), gapSeq (running number of the first lost chunk) and gapReason (see record_convertGap).
+	/// Returns convChunkOK if a chunk was loaded (missing chunks before it are reported), convChunkLost if the chunk was corrupt or cut
+	/// (one chunk reported) or convChunkEnd at the end of the file.
+	///
+	///	Uses record-global variables: fil_cr, record_conv...
+
+
+	UINT br;
+	*gapChunks = 0;
+
+	// Next chunk from the input buffer (refill it if used up)
+	if(record_convInPos >= record_convInLen){
+		FRESULT res = f_read(&fil_cr, record_convIn, record_convInSize, &br);
+		if(res != FR_OK)
+			record_convRes = res;
+		if(res != FR_OK || br == 0)
+			return convChunkEnd;
+		record_convInLen = br;
+		record_convInPos = 0;
+	}
+	record_convChunk = record_convIn + record_convInPos;
+	br = record_convInLen - record_convInPos;
+	if(br > record_convChunkSize)
+		br = record_convChunkSize;
+	record_convInPos += br;
+
+	// File without header - plain lines
+	if(!record_convFramed){
+		record_convChunkPos = 0;
+		record_convChunkEnd = br - (br % record_convLineSize);
+		return convChunkOK;
+	}
+
+	// Incomplete chunk at the end of the file (can't be written by record_block, but the file might have been cut)
+	*gapSeq = record_convSeq;
+	if(br < record_convChunkSize){
+		*gapReason = "CUT";
+		*gapChunks = 1;
+		return convChunkLost;
+	}
+
+	// Check chunk header and checksum - a corrupt chunk is skipped as a whole
+	recfmtChunkHeader hdr;
+	memcpy(&hdr, record_convChunk, sizeof(hdr));
+	if(hdr.magic != (record_convCodec ? RECFMT_CHUNK_MAGIC_PACKED : RECFMT_CHUNK_MAGIC) || hdr.dataSize != record_convChunkSize - record_convDataStart ||
+	   recfmt_chunkCrc(record_convChunk, record_convDataStart, record_convSeed) != hdr.crc){
+		*gapReason = "CRC";
+		*gapChunks = 1;
+		record_convSeq++;
+		return convChunkLost;
+	}
+
+	// Missing chunks (running number jumped)
+	if(hdr.seq > record_convSeq){
+		*gapReason = "SEQ";
+		*gapChunks = hdr.seq - record_convSeq;
+	}
+	else if(hdr.seq < record_convSeq)
+		printf("Chunk %lu out of order (expected %lu)\n", hdr.seq, record_convSeq);
+	record_convSeq = hdr.seq + 1;
+	record_convChunkSample = hdr.sample;
+
+	record_convChunkPos = record_convDataStart;
+	record_convChunkEnd = record_convChunkSize;
+	return convChunkOK;
+}
+
+static uint8_t record_convertNextFrame(void){
+	/// Assemble the next frame from the packed chunks of a compressed file and decode it to record_convBlock (see recfmt.h).
+	/// After lost chunks or a frame that can't be decoded, decoding restarts at the first frame starting in the next chunk (recfmtPackedPrefix)
+	/// and the lost blocks are noted by record_convertGap. Returns 1 if a frame was decoded, 0 at the end of the file.
+	///
+	///	Uses record-global variables: record_conv...
+
+
+	const char* reason;
+	uint32_t seq, chunks;
+	recfmtFrameHeader hdr;
+
+	while(1){
+		// Collect frame header, then the rest of the frame
+		uint16_t have = 0;
+		uint16_t need = sizeof(recfmtFrameHeader);
+		while(have < need){
+			// Next chunk
+			if(record_convChunkPos >= record_convChunkEnd){
+				uint8_t state = record_convertLoadChunk(&reason, &seq, &chunks);
+				if(state == convChunkEnd){
+					if(have > 0)
+						record_convertGap("CUT", record_convFrameSeq, 1);
+					return 0;
+				}
+				if(chunks > 0){
+					record_convResync = 1;
+					record_convResyncReason = reason;
+				}
+				if(state == convChunkLost)
+					continue;
+
+				// Chunk data: prefix and frames
+				recfmtPackedPrefix prefix;
+				memcpy(&prefix, record_convChunk + record_convDataStart, sizeof(prefix));
+				record_convChunkEnd = record_convDataStart + ((prefix.used < record_convChunkSize - record_convDataStart) ? prefix.used : record_convChunkSize - record_convDataStart);
+				record_convChunkPos = record_convDataStart + sizeof(prefix);
+
+				// Restart at the first frame of the chunk (a frame continuing from a lost chunk can't be used)
+				if(record_convResync){
+					if(prefix.frameStart == RECFMT_NO_FRAME){
+						record_convChunkPos = record_convChunkEnd;
+						continue;
+					}
+					record_convChunkPos = record_convDataStart + prefix.frameStart;
+					if(prefix.frameSeq > record_convFrameSeq)
+						record_convertGap(record_convResyncReason, record_convFrameSeq, prefix.frameSeq - record_convFrameSeq);
+					record_convFrameSeq = prefix.frameSeq;
+					if(record_convHasSample)
+						record_convLines = record_convChunkSample;
+					record_convResync = 0;
+					have = 0;
+					need = sizeof(recfmtFrameHeader);
+				}
+			}
+
+			// Copy as much as available
+			uint16_t n = record_convChunkEnd - record_convChunkPos;
+			if(n > need - have)
+				n = need - have;
+			memcpy(record_convFrame + have, record_convChunk + record_convChunkPos, n);
+			record_convChunkPos += n;
+			have += n;
+
+			// Frame header complete - get size of the frame
+			if(have == sizeof(recfmtFrameHeader) && need == sizeof(recfmtFrameHeader)){
+				memcpy(&hdr, record_convFrame, sizeof(hdr));
+				need = hdr.size;
+				if(need <= sizeof(recfmtFrameHeader) || need > RECFMT_FRAME_SIZE_MAX(&record_convLayout)){
+					// Frame boundaries are lost - restart with the next chunk
+					record_convResync = 1;
+					record_convResyncReason = "FRAME";
+					record_convChunkPos = record_convChunkEnd;
+					have = 0;
+					need = sizeof(recfmtFrameHeader);
+				}
+			}
+		}
+
+		// Decode
+		record_convFrameSeq++;
+		if(recfmt_decodeFrame(&record_convLayout, record_convFrame, need, record_convBlock))
+			return 1;
+		record_convertGap("FRAME", record_convFrameSeq - 1, 1);
+	}
+}
+
+static const uint8_t* record_convertReadLine(void){
+	/// Return the next line of the .BIN file being converted (pointer into a buffer, valid until the next call) or NULL at the end of the file.
+	/// Lines are taken from the chunks directly or, for compressed files, from the decoded frames. Lost chunks are noted by record_convertGap.
+	///
+	///	Uses record-global variables: record_conv...
+
+
+	while(record_convPos >= record_convEnd){
+		// Compressed - next decoded frame
+		if(record_convCodec){
+			if(!record_convertNextFrame())
+				return NULL;
+			record_convLineBuf = record_convBlock;
+			record_convPos = 0;
+			record_convEnd = record_convLayout.lines * record_convLineSize;
+			continue;
+		}
+
+		// Lines of the next chunk
+		const char* reason;
+		uint32_t seq, chunks;
+		uint8_t state = record_convertLoadChunk(&reason, &seq, &chunks);
+		if(chunks > 0)
+			record_convertGap(reason, seq, chunks);
+		if(state == convChunkEnd)
+			return NULL;
+		if(state == convChunkOK){
+			if(record_convHasSample)
+				record_convLines = record_convChunkSample;
+			record_convLineBuf = record_convChunk;
+			record_convPos = record_convChunkPos;
+			record_convEnd = record_convChunkEnd;
+		}
+	}
+
+	// Next line
+	const uint8_t* line = record_convLineBuf + record_convPos;
+	record_convPos += record_convLineSize;
+	record_convInLines++;
+	return line;
+}
+
+static void record_convertGap(const char* reason, uint32_t seq, uint32_t chunks){
+	/// Note lost chunks (or frames of a compressed file, each one FIFO block) of the .BIN file in the event file (event GAP, see RECORD_EVT_HEADER)
+	/// and advance the time by the lines they held. The lost blocks are assumed to hold only measurement lines. Files of version 2 correct the
+	/// time with the index of the first measurement line of the next good chunk (recfmtChunkHeader.sample), older files are off by the event lines.
+	///
+	///	reason	... Source column of the event: CRC = corrupt chunk, SEQ = missing chunks, CUT = incomplete chunk at the end of the file,
+	///				FRAME = frame that can't be decoded
+	///	seq		... Running number of the first lost chunk (frame)
+	///	chunks	... Number of lost chunks (frames)
+	///
+	///	Uses record-global variables: fil_e, record_conv...
+	///	Uses globals variables: RECORD_EVT_FORMAT
+
+
+	printf("Chunk %lu: %s - %lu chunk(s) lost\n", seq, reason, chunks);
+	record_convLost += chunks;
+
+	// Write event line (Seq column holds the running number of the chunk) - not while replaying lines that are already converted
+	if(fil_e.obj.fs != NULL && record_convState == convRunning){
+		char evt_line_buff[64];
+		UINT bw;
+		sprintf(evt_line_buff, RECORD_EVT_FORMAT "\n", record_convLines * (record_convInterval/1000.0),
+				"GAP", reason, (int)seq, (unsigned long)record_convLines, 0, "");
+		f_write(&fil_e, evt_line_buff, strlen(evt_line_buff), &bw);
+	}
+
+	// Advance time
+	record_convLines += chunks * ((record_convChunkSize - record_convDataStart) / record_convLineSize);
+}
+
+static FRESULT record_convertFlush(uint8_t all){
+	/// Write the CSV output buffer to the file in pieces that end at multiples of RECORD_CONV_WRITE_SIZE in the file (whole sectors at sector
+	/// aligned offsets, so FatFs writes them directly to the card). The rest stays in the buffer unless all is 1. Returns FR_OK on success.
+	///
+	///	all		... 1 = write everything (end of the conversion or checkpoint)
+	///
+	///	Uses record-global variables: fil_cw, record_convOut, record_convOutLen
+	///	Uses globals variables: RECORD_CONV_WRITE_SIZE
+
+
+	UINT bw;
+	uint32_t align = f_tell(&fil_cw) % RECORD_CONV_WRITE_SIZE;
+	uint32_t size = all ? record_convOutLen : ((align + record_convOutLen) / RECORD_CONV_WRITE_SIZE) * RECORD_CONV_WRITE_SIZE;
+	if(!all && size > 0)
+		size -= align;
+	if(size == 0)
+		return FR_OK;
+
+	FRESULT res = f_write(&fil_cw, record_convOut, size, &bw);
+	if(res == FR_OK && bw != size)
+		res = FR_DENIED; // Disk full
+
+	// Move the rest to the start of the buffer
+	memmove(record_convOut, record_convOut + size, record_convOutLen - size);
+	record_convOutLen -= size;
+	return res;
+}
+
+static void record_convertEvent(sensor** sensArray, const uint8_t* eventLine){
+	/// Read the payload lines of an event from the .BIN file and apply the event to the conversion.
+	/// Sync events and markers are written to the event file (if open and not replaying). Unknown event types are skipped. Used by record_convertTick.
+	///
+	///	eventLine	... First line of the event (marker, type and number of payload lines)
+	///
+	///	Uses record-global variables: fil_e, record_conv...
+	///	Uses globals variables: SENSOR_RAW_SIZE, RECORD_EVT_FORMAT, SENSORS_SIZE
+
+
+	uint8_t payload[16] = {0}; // Bigger than every payload struct
+
+	// Type and number of payload lines
+	uint8_t type = eventLine[SENSOR_RAW_SIZE];
+	uint8_t lines = eventLine[SENSOR_RAW_SIZE + 1];
+
+	// Read payload lines - they hold the payload bytes in order (bytes exceeding the known payloads are skipped)
+	uint16_t size = 0;
+	for(uint8_t l = 0; l < lines; l++){
+		const uint8_t* line = record_convertReadLine();
+		if(line == NULL)
+			return;
+		for(uint16_t b = 0; b < record_convLineSize && size < sizeof(payload); b++)
+			payload[size++] = line[b];
+	}
+
+	// Apply event
+	if(type == fifoEventHealth){
+		fifoEventHealthPayload* health = (fifoEventHealthPayload*)payload;
+		if(health->sensorIdx < SENSORS_SIZE){
+			sensArray[health->sensorIdx]->health.flags = health->flags;
+			sensArray[health->sensorIdx]->health.noiseRms = health->noiseRms / 10.0f;
+			sensArray[health->sensorIdx]->health.errorRate = health->errorRate;
+			sensArray[health->sensorIdx]->health.satRate = health->satRate;
+		}
+	}
+	else if(type == fifoEventSync){
+		// Write event line (see RECORD_EVT_HEADER)
+		fifoEventSyncPayload* sync = (fifoEventSyncPayload*)payload;
+		if(fil_e.obj.fs != NULL && record_convState == convRunning){
+			char evt_line_buff[64];
+			UINT bw;
+			sprintf(evt_line_buff, RECORD_EVT_FORMAT "\n",
+					((double)sync->sample + sync->fraction/65536.0) * (record_convInterval/1000.0),
+					"SYNC", (sync->source == syncSourceInput) ? "IN" : "OUT",
+					sync->seq, (unsigned long)sync->sample, sync->fraction, "");
+			f_write(&fil_e, evt_line_buff, strlen(evt_line_buff), &bw);
+		}
+	}
+	else if(type == fifoEventMarker){
+		// Write event line (see RECORD_EVT_HEADER) - the label is cut to its size, ';' would break the columns
+		fifoEventMarkerPayload* marker = (fifoEventMarkerPayload*)payload;
+		if(fil_e.obj.fs != NULL && record_convState == convRunning){
+			static const char* types[] = {"NOTE", "SECTION", "SETUP"};
+			char label[FIFO_MARKER_LABEL_SIZE + 1];
+			char evt_line_buff[80];
+			UINT bw;
+			for(uint8_t i = 0; i <= FIFO_MARKER_LABEL_SIZE; i++){
+				label[i] = (i < FIFO_MARKER_LABEL_SIZE) ? marker->label[i] : '\0';
+				if(label[i] == ';')
+					label[i] = ',';
+			}
+			sprintf(evt_line_buff, RECORD_EVT_FORMAT "\n",
+					(double)marker->sample * (record_convInterval/1000.0),
+					"MARK", (marker->type <= fifoMarkerSetup) ? types[marker->type] : "?",
+					marker->seq, (unsigned long)marker->sample, 0, label);
+			f_write(&fil_e, evt_line_buff, strlen(evt_line_buff), &bw);
+		}
+	}
+	else{
+		printf("Unknown event type %d skipped\n", type);
+	}
+}
+
+static int8_t record_convertOpen(const char* filename, uint32_t resumeLines, uint32_t csvSize, uint32_t evtSize){
+	/// Open the .BIN file (path) and the corresponding .CSV and .EVT file, read the file header and prepare the private sensors of the background
+	/// conversion (see record_convertTick). The base name of all files will be same, only the base name of 'filename' is used (a parameter "test.csv"
+	/// or "test.bin" will lead to the same result!). New conversions rename existing CSV/EVT files, resumed ones (resumeLines > 0) cut them to the
+	/// size they had at the checkpoint and replay the first resumeLines lines of the .BIN file without output.
+	/// Returns 1 if the conversion is running, 0 on error (everything is closed again).
+	///
+	///	filename	...	Path to the .BIN file
+	///	resumeLines	... Lines of the .BIN file already converted (progress marker, 0 = new conversion)
+	///	csvSize		... Size of the CSV file at the checkpoint (only used if resumeLines > 0)
+	///	evtSize		... Size of the EVT file at the checkpoint (only used if resumeLines > 0)
+	///
+	///	Uses record-global variables: fil_cr, fil_cw, fil_e, fil_p, record_conv...
+	///	Uses globals variables: sensors, sdState, CSVLINE_BUFFER_LENGTH, RECORD_CONV_READ_SIZE, RECORD_CONV_WRITE_SIZE, RECORD_CONV_PROGRESS_FILE, FILENAME_BUFFER_LENGTH,
+	///		MEASUREMENT_INTERVAL, SENSORS_SIZE, SENSOR_RAW_SIZE, RECORD_CSV_HEADER, FIFO_LINE_SIZE, FIFO_EVENT_MARKER
+
+
+	// FATFS result code, Bytes read/written
+	FRESULT res = FR_OK;
 	UINT bw,br;
-	char csv_line_buff[CSVLINE_BUFFER_LENGTH]; // Consideration: dynamic allocation based on line length?
 
 	// Initial log line
-	printf("\nrecord_convertBinFile:\n");
+	printf("\nrecord_convertOpen: %s (resume at line %lu)\n", filename, resumeLines);
+
+	// Mount disk (kept if other files are open)
+	record_mountDisk(1);
+	if(sdState != sdMounted && sdState != sdFileOpen){
+		printf("Error: SD not ready!\n");
+		return 0;
+	}
+
+	/// Determine right .BIN, .CSV and .EVT filename
+	char filename_CSV[FILENAME_BUFFER_LENGTH];
+	char filename_EVT[FILENAME_BUFFER_LENGTH];
+
+	// Copy filename and make sure file extension is .BIN
+	sprintf(record_convName, filename);
+	record_convName[strlen(record_convName)-1] = 'N';
+	record_convName[strlen(record_convName)-2] = 'I';
+	record_convName[strlen(record_convName)-3] = 'B';
+
+	// Copy filename and change file extension to .CSV
+	sprintf(filename_CSV, record_convName);
+	filename_CSV[strlen(filename_CSV)-1] = 'V';
+	filename_CSV[strlen(filename_CSV)-2] = 'S';
+	filename_CSV[strlen(filename_CSV)-3] = 'C';
+
+	// Copy filename and change file extension to .EVT
+	sprintf(filename_EVT, record_convName);
+	filename_EVT[strlen(filename_EVT)-1] = 'T';
+	filename_EVT[strlen(filename_EVT)-2] = 'V';
+	filename_EVT[strlen(filename_EVT)-3] = 'E';
+
+	/// Check filename for uniqueness and rename existing file if needed (not if resumed - the files are continued)
+	int8_t fil_OK = 1;
+	if(resumeLines == 0){
+		fil_OK = record_backupFile(filename_CSV);
+		fil_OK &= record_backupFile(filename_EVT);
+	}
+
+	/// Check if file exists - if not there is nothing to do
+	res = f_stat(record_convName, NULL);
+	printf("Checked if file exists: %d\n", res);
+	if(fil_OK != 1 || res != FR_OK){
+		printf("Error: BIN file not existent or CSV filename not unique/backuped!\n");
+		return 0;
+	}
+
+	// Open/Create Files and the progress marker
+	res = record_openFile(record_convName, objFILconvRead, 0);
+	res |= record_openFile(filename_CSV, objFILconvWrite, 0);
+	res |= record_openFile(filename_EVT, objFILevent, 0);
+	res |= f_open(&fil_p, RECORD_CONV_PROGRESS_FILE, FA_OPEN_ALWAYS | FA_WRITE);
+	printf("Tried open BIN, CSV, EVT and progress file: Error=%d\n", res);
+
+	// Input buffer (replaced when the chunk size of the file is known) and CSV output buffer (space for one more line than written at once)
+	record_convIn = (uint8_t*)malloc(FIFO_BLOCK_SIZE);
+	record_convOut = (char*)malloc(RECORD_CONV_WRITE_SIZE + CSVLINE_BUFFER_LENGTH);
+	record_convOutLen = 0;
+	if(record_convIn == NULL || record_convOut == NULL){
+		printf("Memory allocation failed!\n");
+		res = FR_NOT_ENOUGH_CORE;
+	}
+
+	// Private sensors - copy of the current settings (used as they are for files without header) with their own filter state
+	for(uint8_t i = 0; i < SENSORS_SIZE; i++){
+		memcpy(&record_convSens[i], (const void*)sensors[i], sizeof(sensor));
+		record_convSens[i].bufMaxIdx = S_BUF_SIZE-1;
+		record_convSens[i].history = NULL;
+		record_convSens[i].dp_x = record_convSens[i].dp_y = NULL;
+		record_convSens[i].dp_size = 0;
+		record_convSensArr[i] = &record_convSens[i];
+		record_convSensMem[i] = NULL;
+	}
+
+	// Cut CSV and EVT file to the checkpoint (new conversions start empty)
+	if(res == FR_OK){
+		if(resumeLines > 0 && (f_size(&fil_cw) < csvSize || f_size(&fil_e) < evtSize)){
+			printf("Files shorter than the checkpoint - starting over\n");
+			resumeLines = 0;
+		}
+		if(resumeLines == 0)
+			csvSize = evtSize = 0;
+		res = f_lseek(&fil_cw, csvSize);
+		res |= f_truncate(&fil_cw);
+		res |= f_lseek(&fil_e, evtSize);
+		res |= f_truncate(&fil_e);
+		res |= f_lseek(&fil_cr, 0);
+	}
 
-	// Stop measuring - needed because same buffers are used to convert (also enhances performance a bit)
-	measureMode = measureModeNone;
+	// Read file header. Without header the file was recorded before the recording format (recfmt.h) - assume the settings of this firmware
+	uint8_t layoutOK = 0;
+	if(res == FR_OK){
+		res = f_read(&fil_cr, record_convIn, FIFO_BLOCK_SIZE, &br);
+		recfmtFileHeader* hdr = (recfmtFileHeader*)record_convIn;
+		uint8_t hdrState = recfmt_checkHeader(record_convIn, br);
+		layoutOK = (res == FR_OK && hdrState != recfmtHeaderCorrupt);
+		record_convSeq = record_convLines = record_convLost = record_convFrameSeq = 0;
+		record_convPos = record_convEnd = record_convChunkPos = record_convChunkEnd = 0;
+		record_convInPos = record_convInLen = 0;
+		record_convResync = 1; // Compressed files start at the first frame of the first chunk
+		record_convResyncReason = "SEQ";
+		record_convCodec = recfmtCodecNone;
+		record_convRes = FR_OK;
+		if(hdrState == recfmtHeaderOK){
+			record_convCodec = recfmt_codec(hdr);
+			printf("File header: version %d, %s, %d channels, %.2fms, codec %d\n", hdr->version, hdr->firmware, hdr->channels, hdr->interval, record_convCodec);
+			record_convFramed = 1;
+			record_convChunkSize = hdr->chunkSize;
+			record_convDataStart = hdr->chunkHeaderSize;
+			record_convSeed = recfmt_chunkSeed(hdr);
+			record_convHasSample = (hdr->version >= 2 && hdr->chunkHeaderSize >= sizeof(recfmtChunkHeader));
+			record_convLineSize = hdr->lineSize;
+			record_convMarker = hdr->eventMarker;
+			record_convInterval = hdr->interval;
+			record_convLayout.lines = (hdr->chunkSize - hdr->chunkHeaderSize) / hdr->lineSize;
+			record_convLayout.lineSize = hdr->lineSize;
+			record_convLayout.eventMarker = hdr->eventMarker;
+			record_convLayout.channels = hdr->channels;
+			if(record_convCodec > recfmtCodecDelta)
+				layoutOK = 0;
+
+			// Channels must match the CSV layout (RECORD_CSV_HEADER) and the samples the raw value type
+			if(hdr->channels != SENSORS_SIZE || hdr->lineSize < SENSORS_SIZE*SENSOR_RAW_SIZE)
+				layoutOK = 0;
+			for(uint8_t i = 0; i < hdr->channels && layoutOK; i++){
+				if(hdr->channel[i].sampleType != recfmtSampleU16 || hdr->channel[i].sampleSize != SENSOR_RAW_SIZE)
+					layoutOK = 0;
+			}
+			if((hdr->postProcess & recfmtChangeOrderAtErrors) != (POSTPROCESS_CHANGEORDER_AT_ERRORS ? recfmtChangeOrderAtErrors : 0) ||
+			   (hdr->postProcess & recfmtInterpolateErrors) != (POSTPROCESS_INTERPOLATE_ERRORS ? recfmtInterpolateErrors : 0))
+				printf("Warning: Error handling of the recording differs from this firmware\n");
+
+			// Use calibration and filter settings of the recording for the private sensors
+			if(layoutOK){
+				for(uint8_t i = 0; i < SENSORS_SIZE; i++)
+					record_channelToSensor(&hdr->channel[i], &record_convSens[i]);
+			}
 
-	// Wait a whole interval to make sure the buffers are'nt being written to anymore
-	delay_ms(MEASUREMENT_INTERVAL);
+			// Continue at the first data chunk
+			res = f_lseek(&fil_cr, record_convChunkSize);
+		}
+		else if(hdrState == recfmtHeaderNone){
+			printf("File without header - using settings of this firmware\n");
+			record_convFramed = 0;
+			record_convChunkSize = FIFO_BLOCK_SIZE;
+			record_convDataStart = 0;
+			record_convHasSample = 0;
+			record_convLineSize = FIFO_LINE_SIZE;
+			record_convMarker = FIFO_EVENT_MARKER;
+			record_convInterval = MEASUREMENT_INTERVAL;
+			res = f_lseek(&fil_cr, 0);
+		}
+	}
 
-	// Reset buffers of all sensors
-	for (uint8_t i = 0; i < SENSORS_SIZE; i++){
-		printf("Reset sensor struct %d\n", i);
+	// Input buffer with several chunks (one read per RECORD_CONV_READ_SIZE)
+	if(layoutOK && res == FR_OK){
+		uint32_t frameSize = (record_convCodec != recfmtCodecNone) ? RECFMT_FRAME_SIZE_MAX(&record_convLayout) : 0;
+		record_convInSize = (RECORD_CONV_READ_SIZE / record_convChunkSize) * record_convChunkSize;
+		if(record_convInSize == 0)
+			record_convInSize = record_convChunkSize;
+		free(record_convIn);
+		record_convIn = (uint8_t*)malloc(record_convInSize + 2*frameSize);
+		record_convFrame = record_convIn + record_convInSize;
+		record_convBlock = record_convFrame + frameSize;
+		layoutOK = (record_convIn != NULL);
+	}
 
-		// Reset index counter
-		sensArray[i]->bufIdx = sensArray[i]->bufMaxIdx;
-		sensArray[i]->avgFilterSum = 0;
+	// Buffers of the private sensors - the values of a line are written before the next one is processed, so only the filter interval is needed
+	for(uint8_t i = 0; i < SENSORS_SIZE && layoutOK; i++){
+		sensor* sens = &record_convSens[i];
+		uint16_t size = sens->avgFilterInterval + 1;
+		record_convSensMem[i] = malloc(size * (2*sizeof(float_buffer_t) + 2*sizeof(conv_buffer_t) + sizeof(int_buffer_t)));
+		if(record_convSensMem[i] == NULL){
+			layoutOK = 0;
+			break;
+		}
+		sens->bufVel    = (float_buffer_t*)record_convSensMem[i];
+		sens->bufAcc    = sens->bufVel + size;
+		sens->bufFilter = (conv_buffer_t*)(sens->bufAcc + size);
+		sens->bufConv   = sens->bufFilter + size;
+		sens->bufRaw    = (int_buffer_t*)(sens->bufConv + size);
+		memset(record_convSensMem[i], 0, size * (2*sizeof(float_buffer_t) + 2*sizeof(conv_buffer_t) + sizeof(int_buffer_t)));
+		sens->bufMaxIdx = size - 1;
+		sens->bufIdx = sens->bufMaxIdx;
+		sens->avgFilterSum = 0;
 
 		// Set the current error count to the filter interval. This lets the filter ignore that the entry's before the first one are still empty
-		sensArray[i]->errorOccured = sensArray[i]->avgFilterInterval;
+		sens->errorOccured = sens->avgFilterInterval;
+		measure_tracker_reset(sens);
 
-		// Memset all elements of all buffers to 0
-		memset((int_buffer_t*)sensArray[i]->bufRaw     , 0, (sensArray[i]->bufMaxIdx+1)*sizeof(int_buffer_t));
-		memset((float_buffer_t*)sensArray[i]->bufFilter, 0, (sensArray[i]->bufMaxIdx+1)*sizeof(float_buffer_t));
-		memset((float_buffer_t*)sensArray[i]->bufConv  , 0, (sensArray[i]->bufMaxIdx+1)*sizeof(float_buffer_t));
+		// Health metrics are set by the health events of the recording
+		memset(&sens->health, 0, sizeof(sensorHealth));
 	}
 
-	// Try to mount disk
+	if(!layoutOK || res != FR_OK){
+		printf("Error: Files not ready, file header corrupt or layout not supported!\n");
+		record_convState = convRunning; // Lets record_convertClose clean up
+		record_convSession[0] = '\0';
+		record_convertClose(0);
+		return 0;
+	}
+
+	// Header of the CSV file (first line of the output buffer) and of the event file - new conversions only
+	if(resumeLines == 0){
+		record_convOutLen = sprintf(record_convOut, "Time;"   RECORD_CSV_HEADER     "\n");
+		char evt_line_buff[64];
+		sprintf(evt_line_buff, RECORD_EVT_HEADER "\n");
+		res = f_write(&fil_e, evt_line_buff, strlen(evt_line_buff), &bw);
+	}
+
+	// Segmented recording - a new conversion of the first segment continues with the others listed in the session index (see record_start)
+	if(resumeLines == 0 && record_convSession[0] == '\0'){
+		char segment0[FILENAME_BUFFER_LENGTH];
+		sprintf(record_convSession, "%.*s.SES", (int)(strlen(record_convName)-4), record_convName);
+		record_convSegment = 1;
+		if(record_sessionSegment(record_convSession, 0, segment0) != FR_OK || strcmp(segment0, record_convName) != 0)
+			record_convSession[0] = '\0';
+	}
+
+	// Progress marker (a new conversion is resumed from the start after a power cycle)
+	record_convInLines = 0;
+	record_convResumeLines = record_convCheckpointLines = resumeLines;
+	record_convResumeCsv = csvSize;
+	record_convResumeEvt = evtSize;
+	record_convMeasLines = record_convTime = 0;
+	record_convState = (resumeLines > 0) ? convResuming : convRunning;
+	res |= record_convertMarker(record_convResumeLines, record_convResumeCsv, record_convResumeEvt);
+	if(res != FR_OK){
+		printf("Error: Writing the progress marker failed (res%d)!\n", res);
+		record_convSession[0] = '\0';
+		record_convertClose(0);
+		return 0;
+	}
+	return 1;
+}
+
+static FRESULT record_convertMarker(uint32_t lines, uint32_t csvSize, uint32_t evtSize){
+	/// Write the progress marker of the background conversion (RECORD_CONV_PROGRESS_FILE): name of the .BIN file, lines of it that are converted
+	/// and the size of the CSV and EVT file at that point, the session index and next segment of a segmented recording (one value per line,
+	/// '-' = no session). Synced to the card right away. Returns FR_OK on success.
+	///
+	///	Uses record-global variables: fil_p, record_convName, record_convSession, record_convSegment
+
+
+	char buff[2*FILENAME_BUFFER_LENGTH + 50];
+	UINT bw;
+	sprintf(buff, "%s\n%lu\n%lu\n%lu\n%s\n%u\n", record_convName, lines, csvSize, evtSize,
+			(record_convSession[0] != '\0') ? record_convSession : "-", record_convSegment);
+
+	FRESULT res = f_lseek(&fil_p, 0);
+	res |= f_write(&fil_p, buff, strlen(buff), &bw);
+	res |= f_truncate(&fil_p);
+	res |= f_sync(&fil_p);
+	return res;
+}
+
+static FRESULT record_convertCheckpoint(void){
+	/// Write all converted lines to the CSV and EVT file, sync them and note the current position in the progress marker. Must only be called
+	/// between two lines of the .BIN file (events complete). After a power cycle the conversion continues from here (see record_convertResume).
+	/// While resuming only the marker is rewritten (e.g. with a new name of the .BIN file), the files aren't complete up to this point yet.
+	///
+	///	Uses record-global variables: fil_cw, fil_e, record_conv...
+
+
+	FRESULT res = FR_OK;
+	if(record_convState == convRunning){
+		res = record_convertFlush(1);
+		res |= f_sync(&fil_cw);
+		res |= f_sync(&fil_e);
+		record_convResumeLines = record_convCheckpointLines = record_convInLines;
+		record_convResumeCsv = f_size(&fil_cw);
+		record_convResumeEvt = f_size(&fil_e);
+	}
+	if(res == FR_OK)
+		res = record_convertMarker(record_convResumeLines, record_convResumeCsv, record_convResumeEvt);
+	return res;
+}
+
+static void record_convertClose(uint8_t keepMarker){
+	/// End the background conversion: close all files, free the buffers and delete the progress marker (unless keepMarker is 1 - the conversion
+	/// is then continued after the next power cycle). Continues with the next segment of a session (see record_convertOpen) or starts the next
+	/// queued conversion if there is one.
+	///
+	///	keepMarker	... 1 = keep the progress marker (conversion failed, e.g. card removed), 0 = delete it (done or cancelled)
+	///
+	///	Uses record-global variables: fil_cr, fil_cw, fil_e, fil_p, record_conv...
+	///	Uses globals variables: RECORD_CONV_PROGRESS_FILE
+
+
+	if(record_convState == convIdle)
+		return;
+
+	// Close Files (writes the rest of the file buffers)
+	record_closeFile(objFILconvRead);
+	record_closeFile(objFILconvWrite);
+	record_closeFile(objFILevent);
+	f_close(&fil_p);
+	if(!keepMarker)
+		f_unlink(RECORD_CONV_PROGRESS_FILE);
+
+	// Free input/output buffers and the buffers of the private sensors
+	free(record_convIn);
+	record_convIn = NULL;
+	free(record_convOut);
+	record_convOut = NULL;
+	for(uint8_t i = 0; i < SENSORS_SIZE; i++){
+		free(record_convSensMem[i]);
+		record_convSensMem[i] = NULL;
+	}
+	record_convState = convIdle;
+
+	// Next segment of the session (ends at the first segment missing in the index). Not after an error - the progress marker continues it.
+	char filename[FILENAME_BUFFER_LENGTH];
+	if(!keepMarker && record_convSession[0] != '\0' && record_sessionSegment(record_convSession, record_convSegment, filename) == FR_OK){
+		record_convSegment++;
+		record_convertOpen(filename, 0, 0, 0);
+		return;
+	}
+	record_convSession[0] = '\0';
+
+	// Next queued conversion
+	if(record_convQueue[0] != '\0'){
+		sprintf(filename, record_convQueue);
+		record_convQueue[0] = '\0';
+		record_convertOpen(filename, 0, 0, 0);
+	}
+}
+
+int8_t record_convertStart(const char* filename){
+	/// Start the background conversion of the .BIN file (path) to a .CSV file and a .EVT file listing the events (see record_convertOpen for the names).
+	/// Layout, interval and calibration are taken from the file header (see recfmt.h), so recordings of other settings or firmware versions are converted
+	/// correctly. Chunks are checked by their CRC and running number, lost ones are listed as GAP events. Files without header use the current settings.
+	/// The conversion runs in the main loop (record_convertTick) with its own sensors and buffers, so monitoring and even the next recording continue.
+	/// If a conversion is already running the file is queued (one file, a newer one replaces it) and converted afterwards.
+	/// Returns 1 if the conversion is started or queued, 0 on error.
+	///
+	///	filename	...	Path to the .BIN file
+
+
+	if(record_convState != convIdle){
+		printf("Conversion running - %s queued\n", filename);
+		sprintf(record_convQueue, filename);
+		return 1;
+	}
+	return record_convertOpen(filename, 0, 0, 0);
+}
+
+void record_convertResume(void){
+	/// Continue a conversion that was interrupted by a power cycle (progress marker RECORD_CONV_PROGRESS_FILE exists). Call once at startup.
+	///
+	///	Uses record-global variables: fil_p, record_convSession, record_convSegment
+	///	Uses globals variables: RECORD_CONV_PROGRESS_FILE
+
+
+	// Nothing to do if no conversion was interrupted
 	record_mountDisk(1);
+	if((sdState != sdMounted && sdState != sdFileOpen) || f_open(&fil_p, RECORD_CONV_PROGRESS_FILE, FA_READ) != FR_OK)
+		return;
+
+	// Read marker (name, converted lines, size of CSV and EVT file, session index and next segment)
+	char buff[2*FILENAME_BUFFER_LENGTH + 50] = {0};
+	char filename[FILENAME_BUFFER_LENGTH];
+	char session[FILENAME_BUFFER_LENGTH] = "-";
+	unsigned long lines, csvSize, evtSize;
+	unsigned int segment = 0;
+	UINT br;
+	f_read(&fil_p, buff, sizeof(buff)-1, &br);
+	f_close(&fil_p);
+	if(sscanf(buff, "%19s %lu %lu %lu %19s %u", filename, &lines, &csvSize, &evtSize, session, &segment) < 4){
+		printf("Progress marker corrupt - deleted\n");
+		f_unlink(RECORD_CONV_PROGRESS_FILE);
+		return;
+	}
 
-	// If the SD card is ready, backup existing file, try to open the .BIN and .CSV file and convert data
-	if(sdState == sdMounted || sdState == sdFileOpen){
-		/// Determine right .BIN and .CSV filename
-		// Buffer to store and modify the filename
-		char filename_CSV[FILENAME_BUFFER_LENGTH];
-		char filename_BIN[FILENAME_BUFFER_LENGTH];
+	// Continue (a marker that can't be used is deleted), with the rest of the session afterwards
+	printf("Resuming conversion of %s at line %lu\n", filename, lines);
+	if(strcmp(session, "-") != 0){
+		sprintf(record_convSession, session);
+		record_convSegment = segment;
+	}
+	if(!record_convertOpen(filename, lines, csvSize, evtSize))
+		f_unlink(RECORD_CONV_PROGRESS_FILE);
+}
 
-		// Copy filename and make sure file extension is .BIN
-		sprintf(filename_BIN, filename);
-		filename_BIN[strlen(filename_BIN)-1] = 'N';
-		filename_BIN[strlen(filename_BIN)-2] = 'I';
-		filename_BIN[strlen(filename_BIN)-3] = 'B';
+void record_convertCancel(void){
+	/// Cancel the background conversion (and a queued one or the rest of the session). The CSV and EVT file keep the lines converted so far.
 
-		// Copy filename and change file extension to .CSV
-		sprintf(filename_CSV, filename);
-		filename_CSV[strlen(filename_CSV)-1] = 'V';
-		filename_CSV[strlen(filename_CSV)-2] = 'S';
-		filename_CSV[strlen(filename_CSV)-3] = 'C';
 
-		/// Check filename for uniqueness and rename existing file if needed
-		int8_t fil_OK = record_backupFile(filename_CSV);
+	record_convQueue[0] = '\0';
+	record_convSession[0] = '\0';
+	if(record_convState != convIdle){
+		printf("Conversion of %s cancelled\n", record_convName);
+		record_convertFlush(1);
+		record_convertClose(0);
+	}
+}
 
-		/// Check if file exists - if so, open it
-		res = f_stat(filename_BIN, NULL);
-		printf("Checked if file exists: %d\n", res);
-		if(fil_OK == 1 && res == FR_OK){
-			// Get dynamic line size, line padding size, block size and size of every value to be used while reading binary
-			// Note: This will not be done because we assume that this will run straight after the recording, and therefore the global variables must be equal
+uint8_t record_convertStatus(uint8_t* percent){
+	/// Returns the state of the background conversion (convStates) and the progress in percent of the .BIN file (if percent isn't NULL).
 
-			// Open/Create Files
-			res = record_openFile(filename_BIN, objFILread, 0);
-			printf("Tried open BIN file: Error=%d\n", res);
 
-			res |= record_openFile(filename_CSV, objFILwrite, 0);
-			printf("Tried open CSV file: Error=%d\n", res);
+	if(percent != NULL){
+		*percent = 0;
+		if(record_convState != convIdle && f_size(&fil_cr) > 0)
+			*percent = (uint8_t)((uint64_t)f_tell(&fil_cr) * 100 / f_size(&fil_cr));
+	}
+	return record_convState;
+}
 
-			// If files are ready ...
-			if(res == FR_OK){
-				// Set file cursor
-				res = f_lseek(&fil_r, 0);
-				res |= f_lseek(&fil_w, 0);
-				printf("\tReset file cursors (res%d)\n", res);
-
-				// Generate header string, write it to file and reset buffer
-				sprintf(csv_line_buff, "Time;"   RECORD_CSV_HEADER     "\n");
-				res = f_write(&fil_w, csv_line_buff, strlen(csv_line_buff), &bw);
-				csv_line_buff[0] = '\0';
-
-				// Read line by line and convert to CSV, as long as end of file isn't reached
-				uint16_t linCount = 0;
-				float curTimeO = 0;
-				while(record_checkEndOfFile(objFILread) == 0  ){ //linCount < 10
-					// Reset buff
-					char seperator = ';';
-					int_buffer_t raw = 0;
-
-					// Add current time to buffer
-					sprintf( csv_line_buff, "%.3f;", curTimeO);
-
-					// For each sensor - read corresponding bits to sensor buffer, apply filter, convert value and write to CSV file
-					for (uint8_t i = 0; i < SENSORS_SIZE; i++){
-
-						// Read raw value from file
-						raw = 0;
-						res = f_read(&fil_r, &raw, SENSOR_RAW_SIZE, &br);
-						//printf("\tRead raw %d, read %d (res%d)", raw, br, res);
-
-						// Increment current Buffer index and set back to 0 if greater than size of array
-						sensArray[i]->bufIdx++;
-						if(sensArray[i]->bufIdx > sensArray[i]->bufMaxIdx)
-							sensArray[i]->bufIdx = 0;
-
-						// Set current raw value
-						sensArray[i]->bufRaw[sensArray[i]->bufIdx] = raw;
-
-						// Error handling and calculation of raw/filtered/converted value
-						measure_postProcessing(sensArray[i]);
-
-						// On last value of line - change separator to newline
-						if(i == SENSORS_SIZE-1)
-							seperator = '\n';
-
-						// Write current value to the buffer
-						sprintf(
-							csv_line_buff+strlen(csv_line_buff), // Add sensor data to end of buffer
-							RECORD_CSV_FORMAT     "%c",		// Concatenate format ([values]separator[; or \n])
-							RECORD_CSV_ARGUMENTS, seperator	// Arguments	->	  ([values]separator[; or \n])
-						);
-					}
+static uint8_t record_convertRelease(const char* path){
+	/// Close the .BIN file of the background conversion if it is the given file, so it can be renamed (open files are locked, see FF_FS_LOCK).
+	/// Returns 1 if the file was closed - reopen it with record_convertReacquire.
 
-					// Write Line
-					res = f_write(&fil_w, csv_line_buff, strlen(csv_line_buff), &bw);
 
-					// Read padding bytes to move cursor
-					f_read(&fil_r, &raw, FIFO_LINE_SIZE_PAD, &br);
+	if(record_convState == convIdle || strcmp(path, record_convName) != 0)
+		return 0;
+	record_convReleasePos = f_tell(&fil_cr);
+	record_closeFile(objFILconvRead);
+	return 1;
+}
 
-					// Reset Buffer
-					csv_line_buff[0] = '\0';
+static void record_convertReacquire(const char* path){
+	/// Reopen the .BIN file of the background conversion under its (new) name at the position it was closed by record_convertRelease and note
+	/// the new name in the progress marker. The conversion is cancelled (marker kept) if the file can't be opened.
 
-					// Increment line and time counter
-					curTimeO += (MEASUREMENT_INTERVAL/1000.0);
-					linCount++;
-				}
 
-				printf("End of BIN file! %d lines written = %.2fs\n", linCount, MEASUREMENT_INTERVAL*linCount/1000);
-			}
-			else{
-				printf("Error: Files are not ready or not open!\n");
-			}
+	sprintf(record_convName, path);
+	FRESULT res = record_openFile(record_convName, objFILconvRead, 0);
+	res |= f_lseek(&fil_cr, record_convReleasePos);
+	res |= record_convertCheckpoint();
+	if(res != FR_OK){
+		printf("Error: Reopening %s for the conversion failed (res%d)!\n", record_convName, res);
+		record_convertClose(1);
+	}
+}
+
+void record_convertTick(void){
+	/// Convert the next lines of the background conversion (at most RECORD_CONV_LINES_PER_TICK, or RECORD_CONV_REPLAY_LINES_PER_TICK while
+	/// replaying up to the progress marker). Call once per main loop tick - returns right away if no conversion is running.
+	/// Lines are taken from the input buffer (one read per RECORD_CONV_READ_SIZE) and formatted into the output buffer (one write per RECORD_CONV_WRITE_SIZE).
+	/// A checkpoint is written every RECORD_CONV_CHECKPOINT_LINES lines. At the end the throughput (lines per second of conversion time) is printed.
+	///
+	///	Uses record-global variables: record_conv...
+	///	Uses globals variables: SENSORS_SIZE, SENSOR_RAW_SIZE, RECORD_CSV_FORMAT, RECORD_CSV_ARGUMENTS, RECORD_CONV_...
+
 
-			// Close Files
-			record_closeFile(objFILread);
-			record_closeFile(objFILwrite);
+	if(record_convState == convIdle)
+		return;
+
+	// The private sensors (RECORD_CSV_ARGUMENTS refers to sensArray)
+	sensor** sensArray = record_convSensArr;
+	uint32_t startTime = SYSTIMER_GetTime();
+	FRESULT res = FR_OK;
+	uint8_t end = 0;
+	uint16_t maxLines = (record_convState == convResuming) ? RECORD_CONV_REPLAY_LINES_PER_TICK : RECORD_CONV_LINES_PER_TICK;
+
+	for(uint16_t n = 0; n < maxLines && res == FR_OK; n++){
+		// Lines before the progress marker are only replayed to restore the filter state (no output)
+		record_convState = (record_convInLines < record_convResumeLines) ? convResuming : convRunning;
+
+		// Checkpoint
+		if(record_convState == convRunning && record_convInLines - record_convCheckpointLines >= RECORD_CONV_CHECKPOINT_LINES)
+			res = record_convertCheckpoint();
+
+		// Next line
+		const uint8_t* line = record_convertReadLine();
+		if(line == NULL){
+			end = 1;
+			break;
 		}
-		else{
-			printf("Error: BIN file not existent or CSV filename not unique/backuped!\n");
+
+		// Reset buff
+		char seperator = ';';
+		int_buffer_t raw = 0;
+
+		// First raw value of the line. If it is an event marker, handle the event line (no measurement, time isn't advanced)
+		memcpy(&raw, line, SENSOR_RAW_SIZE);
+		if(raw == record_convMarker){
+			record_convertEvent(sensArray, line);
+			continue;
+		}
+
+		// Add current time to the output buffer (lines of lost chunks are counted as well)
+		char* out = record_convOut + record_convOutLen;
+		if(record_convState == convRunning)
+			out += sprintf(out, "%.3f;", record_convLines * (record_convInterval/1000.0));
+
+		// For each sensor - take corresponding bytes to sensor buffer, apply filter, convert value and add it to the output buffer (padding is ignored)
+		for (uint8_t i = 0; i < SENSORS_SIZE; i++){
+
+			// Raw value of the sensor
+			memcpy(&raw, line + i*SENSOR_RAW_SIZE, SENSOR_RAW_SIZE);
+
+			// Increment current Buffer index and set back to 0 if greater than size of array
+			sensArray[i]->bufIdx++;
+			if(sensArray[i]->bufIdx > sensArray[i]->bufMaxIdx)
+				sensArray[i]->bufIdx = 0;
+
+			// Set current raw value
+			sensArray[i]->bufRaw[sensArray[i]->bufIdx] = raw;
+
+			// Error handling and calculation of raw/filtered/converted value
+			measure_postProcessing(sensArray[i]);
+
+			// On last value of line - change separator to newline
+			if(i == SENSORS_SIZE-1)
+				seperator = '\n';
+
+			// Add current value to the output buffer
+			if(record_convState == convRunning){
+				out += sprintf(
+					out,
+					RECORD_CSV_FORMAT     "%c",		// Concatenate format ([values]separator[; or \n])
+					RECORD_CSV_ARGUMENTS, seperator	// Arguments	->	  ([values]separator[; or \n])
+				);
+			}
 		}
+
+		// Write the output buffer if a whole piece is collected
+		record_convOutLen = out - record_convOut;
+		if(record_convOutLen >= RECORD_CONV_WRITE_SIZE)
+			res = record_convertFlush(0);
+
+		// Increment line counter
+		record_convLines++;
+		record_convMeasLines++;
 	}
+	record_convTime += SYSTIMER_GetTime() - startTime;
+
+	// Write the rest at the end of the file
+	if(end && res == FR_OK && record_convRes == FR_OK)
+		res = record_convertFlush(1);
 
-	// Restart measuring
-	measureMode = measureModeMonitoring;
+	// Error (e.g. card removed) - stop, the progress marker is kept to continue after the next power cycle
+	if(res != FR_OK || record_convRes != FR_OK){
+		printf("Error: Conversion of %s failed (res%d/%d)!\n", record_convName, res, record_convRes);
+		record_convertClose(1);
+	}
+	// Done
+	else if(end){
+		printf("End of BIN file! %lu lines written = %.2fs, %lu chunks lost\n", record_convLines, record_convLines*record_convInterval/1000, record_convLost);
+		printf("Converted %lu lines in %lu ms = %lu lines/s\n", record_convMeasLines, record_convTime/1000,
+				(record_convTime > 0) ? (uint32_t)((uint64_t)record_convMeasLines*1000000/record_convTime) : 0);
+		record_convertClose(0);
+	}
 }
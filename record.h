@@ -8,12 +8,20 @@
 #ifndef RECORD_H_
 #define RECORD_H_
 
+#include "recfmt.h"
 
-enum objFIL{objFILwrite=0, objFILread};
+enum objFIL{objFILwrite=0, objFILevent, objFILconvRead, objFILconvWrite};
 typedef enum objFIL objFIL;
 
+// States of the background conversion (see record_convertTick)
+enum convStates{convIdle=0, convRunning, convResuming};
+
 void record_mountDisk(uint8_t mount);
-void record_convertBinFile(const char* filename_BIN, sensor** sensArray);
+int8_t record_convertStart(const char* filename_BIN);
+void record_convertTick(void);
+void record_convertCancel(void);
+void record_convertResume(void);
+uint8_t record_convertStatus(uint8_t* percent);
 //FRESULT record_openFile(const char* path, objFIL objFILrw, uint8_t accessMode);
 //FRESULT record_closeFile(objFIL objFILrw);
 
@@ -22,14 +30,47 @@ void record_writeCalFile(sensor* sens);
 void record_readCalFile(volatile sensor* sens);
 
 
-uint8_t record_openBMP(const char* path);
+uint8_t record_openBMP(const char* path, uint16_t width, uint16_t height, uint8_t bits);
 void record_writeBMP(uint32_t* data, uint16_t size);
 void record_closeBMP();
 
 
+// Statistics of the block writes of a recording (times in us)
+typedef struct {
+	uint32_t calls;			// Number of block writes (queued or written right away, see record_writeBlocks)
+	uint32_t blocks;		// Number of written FIFO blocks
+	uint32_t streamed;		// Number of chunks streamed to the preallocated file (the rest is written with f_write, see record_writeBlocks)
+	uint32_t maxLatency;	// Longest block write (time the main loop was held up, a queued write returns before the card is done)
+	uint32_t totalTime;		// Sum of the time of all block writes
+	uint32_t chunks;		// Number of written data chunks (equals blocks without RECORD_CODEC)
+	uint32_t frameBytes;	// Sum of the encoded size of all blocks (only with RECORD_CODEC)
+	uint32_t codecCycles;	// Sum of the CPU cycles of the encoding of all blocks (only with RECORD_CODEC)
+	uint32_t codecMaxCycles;// Most CPU cycles needed to encode a block (only with RECORD_CODEC)
+	uint32_t syncs;			// Number of syncs of the file (see record_sync)
+	uint32_t syncMaxLatency;// Longest sync
+	uint32_t syncTotalTime;	// Sum of the time of all syncs
+	uint32_t lodCycles;		// Sum of the CPU cycles of the pyramid of all blocks (see record_lodBlock)
+	uint32_t lodMaxCycles;	// Most CPU cycles needed to add a block to the pyramid
+	uint32_t lodPages;		// Number of written pages of the pyramid
+	uint32_t pendingMax;	// Most chunks in the write queue at once
+	uint32_t waits;			// Number of times the write queue had to be waited for (full, sync, segment switch, stop)
+} recordWriteStats;
+extern recordWriteStats record_writeStats;
+
 int8_t record_start();
-void record_block();
+uint8_t record_block(uint8_t flush);
 int8_t record_stop(uint8_t flushData);
+uint8_t record_sync(void);
+uint8_t record_writePoll(void);
+void record_recover(void);
+
+int8_t record_seekOpen(const char* filename_BIN);
+FRESULT record_seekSample(uint32_t sample, uint8_t* chunk, uint32_t* chunkNumber);
+uint8_t record_seekRange(uint32_t first, uint32_t last, uint16_t* min, uint16_t* max);
+uint16_t record_seekMarker(uint32_t from, uint32_t* first, uint32_t* next);
+uint32_t record_seekLodBuckets(uint8_t level, uint32_t* lines);
+uint32_t record_seekLod(uint8_t level, uint32_t first, uint32_t count, recfmtLodValue* values);
+void record_seekClose(void);
 
 
 #endif /* RECORD_H_ */
@@ -0,0 +1,118 @@
+/*
+@file    		sdqueue.c
+@brief   		Queue of multi-sector SD-card writes executed in the background (shared by the firmware and the host tools, see sdqueue.h)
+@version 		1.0
+@date    		2021-10-26
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "sdqueue.h"
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Write queue         -----------------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// The queue is a ring of requests. Only the oldest one is passed to the device, the next one is started in the poll that finds the
+/// previous one done - the card is kept busy as long as there are requests, while the caller only spends the time of the polls.
+/// A request that continues the last queued one (next sectors on the card and next bytes in memory) is merged with it as long as that one
+/// isn't started yet, so consecutive blocks submitted one after another are still written with a single multi-sector write.
+
+
+
+void sdqueue_init(sdqueue* q, const sdqueueDevice* dev){
+	/// Empty the queue and set the device that writes the requests. Requests that are still queued are dropped - a write the device already
+	/// started is not cancelled (the device itself must wait for it before the card is used otherwise).
+
+
+	memset(q, 0, sizeof(sdqueue));
+	q->dev = dev;
+	q->state = sdqueueIdle;
+}
+
+uint8_t sdqueue_submit(sdqueue* q, const void* buf, uint32_t sector, uint32_t count){
+	/// Queue a write of count sectors from buf to the card, starting at sector. Nothing is written here (see sdqueue_poll).
+	/// Returns sdqueueIdle if queued, sdqueueBusy if the queue is full (poll and submit again), sdqueueError after a failed write
+
+
+	if(q->state == sdqueueError)
+		return sdqueueError;
+
+	// Continues the last request that isn't passed to the device yet - merge
+	if(q->count > 0 && (q->count > 1 || !q->started)){
+		sdqueueRequest* last = &q->req[(q->head + q->count - 1) % SDQUEUE_LENGTH];
+		if(last->sector + last->count == sector && last->buf + last->count*SDQUEUE_SECTOR_SIZE == (const uint8_t*)buf){
+			last->count += count;
+			return sdqueueIdle;
+		}
+	}
+
+	// New request
+	if(q->count == SDQUEUE_LENGTH)
+		return sdqueueBusy;
+	sdqueueRequest* req = &q->req[(q->head + q->count) % SDQUEUE_LENGTH];
+	req->buf = (const uint8_t*)buf;
+	req->sector = sector;
+	req->count = count;
+	q->count++;
+	return sdqueueIdle;
+}
+
+uint8_t sdqueue_poll(sdqueue* q, uint32_t* written){
+	/// Let the queue progress without waiting: check the write of the device and start the next request when it is done.
+	/// The requests are done in the order they were submitted (their buffers can be reused in this order).
+	/// Returns sdqueueIdle if the queue is empty, sdqueueBusy if requests are left, sdqueueError if a write failed
+	///
+	/// written	... Returns the number of sectors of the requests done in this call
+
+
+	*written = 0;
+	while(q->state != sdqueueError && q->count > 0){
+		sdqueueRequest* req = &q->req[q->head];
+
+		// Pass the oldest request to the device (the card might still be busy with the previous one)
+		if(!q->started){
+			uint8_t res = q->dev->start(req->buf, req->sector, req->count);
+			if(res == sdqueueBusy){
+				q->deferred++;
+				return sdqueueBusy;
+			}
+			if(res == sdqueueError){
+				q->state = sdqueueError;
+				break;
+			}
+			q->started = 1;
+			q->writes++;
+		}
+
+		// Still being written - ask again with the next poll
+		uint8_t res = q->dev->poll();
+		if(res == sdqueueBusy)
+			return sdqueueBusy;
+		if(res == sdqueueError){
+			q->state = sdqueueError;
+			break;
+		}
+
+		// Done - continue with the next one
+		*written += req->count;
+		q->head = (q->head + 1) % SDQUEUE_LENGTH;
+		q->count--;
+		q->started = 0;
+	}
+	return q->state;
+}
+
+uint32_t sdqueue_pending(const sdqueue* q){
+	/// Returns the number of sectors queued (not reported as written yet).
+
+
+	uint32_t sectors = 0;
+	for(uint8_t i = 0; i < q->count; i++)
+		sectors += q->req[(q->head + i) % SDQUEUE_LENGTH].count;
+	return sectors;
+}
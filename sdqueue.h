@@ -0,0 +1,52 @@
+/*
+ * sdqueue.h
+ *
+ *  Created on: 26 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef SDQUEUE_H_
+#define SDQUEUE_H_
+
+#include <stdint.h>
+
+/// Queue of multi-sector writes to the SD-card. The requests are written one after another by a device that works in the background
+/// (sdwrite.c on the XMC4700, a simulated card with configurable busy times in Tools/sdqueuetest) - the caller submits requests and polls
+/// the queue, it never waits for the card. Shared by the firmware and the host tools, therefore this file must not depend on DAVE or globals.h.
+/// The data of a request must stay unchanged until it is reported as written by sdqueue_poll.
+#define SDQUEUE_LENGTH			8		// Requests that can be queued (the request being written included)
+#define SDQUEUE_SECTOR_SIZE		512		// Bytes of a sector
+
+// States returned by the device functions and sdqueue_poll
+enum sdqueueStates{sdqueueIdle=0, sdqueueBusy, sdqueueError};
+
+// Device writing the requests
+typedef struct {
+	uint8_t (*start)(const void* buf, uint32_t sector, uint32_t count);	// Start writing count sectors of buf to the card at sector and return at once: sdqueueIdle if started, sdqueueBusy if the card can't take it yet (tried again with the next poll), sdqueueError
+	uint8_t (*poll)(void);													// State of the started write: sdqueueBusy while it is written, sdqueueIdle when it is done, sdqueueError if it failed
+} sdqueueDevice;
+
+// Write of consecutive sectors
+typedef struct {
+	const uint8_t* buf;	// Data
+	uint32_t sector;	// First sector on the card
+	uint32_t count;		// Number of sectors
+} sdqueueRequest;
+
+typedef struct {
+	const sdqueueDevice* dev;
+	sdqueueRequest req[SDQUEUE_LENGTH];	// Ring of the requests (oldest at head)
+	uint8_t  head;		// Oldest request (being written if started)
+	uint8_t  count;		// Queued requests
+	uint8_t  started;	// 1 if the oldest request was passed to the device
+	uint8_t  state;		// sdqueueError after a failed write (the queue stays stopped until sdqueue_init), sdqueueIdle otherwise
+	uint32_t writes;	// Number of writes started on the device
+	uint32_t deferred;	// Polls that found the card unable to take the next request (sdqueueDevice.start returned sdqueueBusy)
+} sdqueue;
+
+void    sdqueue_init(sdqueue* q, const sdqueueDevice* dev);
+uint8_t sdqueue_submit(sdqueue* q, const void* buf, uint32_t sector, uint32_t count);
+uint8_t sdqueue_poll(sdqueue* q, uint32_t* written);
+uint32_t sdqueue_pending(const sdqueue* q);
+
+#endif /* SDQUEUE_H_ */
@@ -0,0 +1,248 @@
+/*
+@file    		sdwrite.c
+@brief   		Non-blocking multi-sector write to the SD-card beside the SDMMC_BLOCK driver (implemented for XMC4700 and DAVE)
+@version 		1.0
+@date    		2021-10-26
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <DAVE.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "SDMMC_BLOCK/sdmmc_block_private_sd.h"
+#include "sdqueue.h"
+#include "sdwrite.h"
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Non-blocking write         ----------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// SDMMC_BLOCK_WriteBlock of the driver spins until the card finished programming - with a slow card several 100ms in which the main loop
+/// stands still. The write here is split into a state machine that is advanced by sdwrite_poll and never waits:
+///   command	CMD25 (write multiple blocks) is sent by sdwrite_start, the poll waits for its response (command complete interrupt)
+///   data		every buffer write ready interrupt the SDMMC host's buffer takes the next sector (128 words written by the CPU)
+///   finish	the host sends CMD12 itself after the last sector (auto CMD12), the transfer complete interrupt follows when the card
+///				releases DAT0 - the programming time of the card passes without any CPU time
+/// The interrupt handler of the driver (SDMMC0_0_IRQHandler -> SDMMC_BLOCK_SD_NormalInterruptHandler/ErrorInterruptHandler) is used as it is,
+/// its flags (isr_context) and results (cmd_int_err, data_int_err, transfer_int_err, acmd_int_err) are read here instead of by its own spinning
+/// transfer functions. The XMC4700 SDMMC host has no DMA, so the sectors are still copied by the CPU (some us per sector) - a poll copies
+/// all sectors the host can take at that moment.
+/// The driver itself must not use the card while a write is running. sdwrite_init therefore puts wrappers into the device functions of the
+/// FATFS APP (FATFS_devicefunc) that wait for a running write first - every FatFs access is safe, it only waits if the queue is busy.
+/// Like sync_init this is done after DAVE_Init, so a regenerated FATFS or SDMMC_BLOCK APP doesn't remove it. Check the flags and results used
+/// here again if the SDMMC_BLOCK APP is updated.
+
+// Card status bits of the response to CMD25 that mean the write wasn't accepted (see sdmmc_block_private_sd.h)
+#define SDWRITE_R1_ERRORS	(SDMMC_BLOCK_SD_CSR_OUT_OF_RANGE_BITMASK | SDMMC_BLOCK_SD_CSR_ADDRESS_ERROR_BITMASK | SDMMC_BLOCK_SD_CSR_BLOCK_LEN_ERROR_BITMASK | \
+							 SDMMC_BLOCK_SD_CSR_WP_VIOLATION_BITMASK | SDMMC_BLOCK_SD_CSR_CARD_IS_LOCKED_BITMASK | SDMMC_BLOCK_SD_CSR_COM_CRC_ERROR_BITMASK | \
+							 SDMMC_BLOCK_SD_CSR_ILLEGAL_COMMAND_BITMASK | SDMMC_BLOCK_SD_CSR_CARD_ECC_FAILED_BITMASK | SDMMC_BLOCK_SD_CSR_CC_ERROR_BITMASK | \
+							 SDMMC_BLOCK_SD_CSR_ERROR_BITMASK)
+
+// States of the write
+enum sdwriteStates{sdwriteIdle=0, sdwriteCommand, sdwriteData, sdwriteFinish, sdwriteFailed};
+
+// Device functions for the write queue of the recording (see sdqueue.h)
+const sdqueueDevice sdwrite_device = {sdwrite_start, sdwrite_poll};
+
+static uint8_t  sdwrite_state = sdwriteIdle;	// sdwriteStates
+static const uint32_t* sdwrite_buf;				// Next sector to be passed to the host
+static uint32_t sdwrite_left;					// Sectors not passed to the host yet
+static uint32_t sdwrite_time;					// Time of the last progress in us (see SDWRITE_TIMEOUT)
+
+// Device functions of the driver (replaced in FATFS_devicefunc by the wrappers below, see sdwrite_init)
+extern FATFS_DEVICEFUNCTYPE_t FATFS_devicefunc;	// Defined in Dave/Generated/FATFS/fatfs.c
+static ReadBlkFunc  sdwrite_driverRead = NULL;
+static WriteBlkFunc sdwrite_driverWrite = NULL;
+static IoctlFunc    sdwrite_driverIoctl = NULL;
+
+
+
+static SDMMC_BLOCK_STATUS_t sdwrite_hookRead(SDMMC_BLOCK_t *const handle, uint8_t* buffer, uint32_t sectnumber, uint8_t count){
+	/// disk_read of FatFs - waits for a running write first (see sdwrite_init).
+
+
+	sdwrite_wait();
+	return sdwrite_driverRead(handle, buffer, sectnumber, count);
+}
+
+static SDMMC_BLOCK_STATUS_t sdwrite_hookWrite(SDMMC_BLOCK_t *const handle, uint8_t* buffer, const uint32_t sectnumber, const uint8_t count){
+	/// disk_write of FatFs - waits for a running write first (see sdwrite_init).
+
+
+	sdwrite_wait();
+	return sdwrite_driverWrite(handle, buffer, sectnumber, count);
+}
+
+static SDMMC_BLOCK_STATUS_t sdwrite_hookIoctl(SDMMC_BLOCK_t *const handle, const uint8_t cmd, void* buffer){
+	/// disk_ioctl of FatFs - waits for a running write first (see sdwrite_init).
+
+
+	sdwrite_wait();
+	return sdwrite_driverIoctl(handle, cmd, buffer);
+}
+
+void sdwrite_init(void){
+	/// Put the wrappers that wait for a running write into the device functions of the FATFS APP. Must be called after DAVE_Init and before
+	/// the first sdwrite_start. Calling it again does nothing.
+	///
+	///	Uses globals variables: FATFS_devicefunc (DAVE)
+
+
+	if(sdwrite_driverWrite != NULL)
+		return;
+	sdwrite_driverRead = FATFS_devicefunc.ReadBlkPtr;
+	sdwrite_driverWrite = FATFS_devicefunc.WriteBlkPtr;
+	sdwrite_driverIoctl = FATFS_devicefunc.IoctlPtr;
+	FATFS_devicefunc.ReadBlkPtr = sdwrite_hookRead;
+	FATFS_devicefunc.WriteBlkPtr = sdwrite_hookWrite;
+	FATFS_devicefunc.IoctlPtr = sdwrite_hookIoctl;
+}
+
+static uint8_t sdwrite_abort(const char* reason){
+	/// End a failed write: reset the command and data line of the host (the next command of the driver starts from a clean state) and
+	/// return sdqueueError. The failure is reported by every poll until the next write is started (also if a FatFs access waited for it).
+	///
+	///	Uses globals variables: SDMMC_BLOCK_0 (DAVE)
+
+
+	SDMMC_BLOCK_t* obj = &SDMMC_BLOCK_0;
+	printf("SD write failed (%s, %lu sectors left)\n", reason, sdwrite_left);
+	XMC_SDMMC_SetSWReset(obj->sdmmc_sd->sdmmc, (uint32_t)XMC_SDMMC_SW_RST_CMD_LINE | (uint32_t)XMC_SDMMC_SW_RST_DAT_LINE);
+	while(XMC_SDMMC_GetSWResetStatus(obj->sdmmc_sd->sdmmc) != 0U);
+	obj->card_state &= (uint8_t)~((uint8_t)SDMMC_BLOCK_CARD_STATE_CMD_ACTIVE | (uint8_t)SDMMC_BLOCK_CARD_STATE_DATA_ACTIVE);
+	obj->sdmmc_sd->isr_context.cmd_flag = obj->sdmmc_sd->isr_context.data_flag = obj->sdmmc_sd->isr_context.transfer_flag = 0U;
+	sdwrite_state = sdwriteFailed;
+	return sdqueueError;
+}
+
+uint8_t sdwrite_start(const void* buf, uint32_t sector, uint32_t count){
+	/// Start writing count sectors of buf (word aligned) to the card at sector and return without waiting (see sdwrite_poll).
+	/// Returns sdqueueIdle if started, sdqueueBusy if a write is running or the card is still busy (try again later), sdqueueError
+	///
+	///	Uses globals variables: SDMMC_BLOCK_0 (DAVE)
+
+
+	SDMMC_BLOCK_t* obj = &SDMMC_BLOCK_0;
+	XMC_SDMMC_t* sdmmc = obj->sdmmc_sd->sdmmc;
+
+	// Previous write not done, card still programming or command line in use - later
+	if((sdwrite_state != sdwriteIdle && sdwrite_state != sdwriteFailed) || XMC_SDMMC_IsDataLineBusy(sdmmc) || XMC_SDMMC_IsCommandLineBusy(sdmmc))
+		return sdqueueBusy;
+
+	// Card not usable, sector count beyond the block count register or buffer not word aligned
+	if((obj->card_state & ((uint8_t)SDMMC_BLOCK_CARD_STATE_NOT_INITIALIZED | (uint8_t)SDMMC_BLOCK_CARD_STATE_LOCKED | (uint8_t)SDMMC_BLOCK_CARD_STATE_WRITE_PROTECTED)) != 0U ||
+	   count == 0 || count > 0xFFFFUL || ((uintptr_t)buf & 3U) != 0)
+		return sdqueueError;
+
+	// Reset the flags and results of the interrupt handler
+	obj->sdmmc_sd->isr_context.cmd_flag = obj->sdmmc_sd->isr_context.data_flag = obj->sdmmc_sd->isr_context.transfer_flag = 0U;
+	obj->sdmmc_sd->cmd_int_err = obj->sdmmc_sd->data_int_err = obj->sdmmc_sd->transfer_int_err = obj->sdmmc_sd->acmd_int_err = SDMMC_BLOCK_MODE_STATUS_FAILURE;
+	obj->card_state |= (uint8_t)SDMMC_BLOCK_CARD_STATE_CMD_ACTIVE | (uint8_t)SDMMC_BLOCK_CARD_STATE_DATA_ACTIVE;
+
+	// Standard capacity cards are addressed in bytes
+	if(((uint32_t)obj->card_type & (uint32_t)SDMMC_BLOCK_CARD_TYPE_BLOCK_ADDRESSING) == 0U)
+		sector *= 512U;
+
+	// Multi block transfer to the card, stopped by the host with CMD12 after the last sector (same setup as the driver)
+	XMC_SDMMC_TRANSFER_MODE_t mode;
+	mode.block_size = SDMMC_BLOCK_TX_BLOCK_SIZE_VALUE;
+	mode.num_blocks = count;
+	mode.type = XMC_SDMMC_TRANSFER_MODE_TYPE_MULTIPLE;
+	mode.auto_cmd = XMC_SDMMC_TRANSFER_MODE_AUTO_CMD_12;
+	mode.direction = XMC_SDMMC_DATA_TRANSFER_HOST_TO_CARD;
+	XMC_SDMMC_SetDataTransferDirection(sdmmc, XMC_SDMMC_DATA_TRANSFER_HOST_TO_CARD);
+	XMC_SDMMC_SetDataTransferMode(sdmmc, &mode);
+	XMC_SDMMC_EnableEvent(sdmmc, (uint32_t)XMC_SDMMC_ACMD_ERR);
+
+	// CMD25 - the response is checked by the next poll
+	sdwrite_buf = (const uint32_t*)buf;
+	sdwrite_left = count;
+	sdwrite_time = SYSTIMER_GetTime();
+	sdwrite_state = sdwriteCommand;
+	if(XMC_SDMMC_SendCommand(sdmmc, &(SDMMC_BLOCK_COMMON_COMMAND(25)), sector) != XMC_SDMMC_STATUS_SUCCESS)
+		return sdwrite_abort("command");
+	return sdqueueIdle;
+}
+
+uint8_t sdwrite_poll(void){
+	/// Advance the running write without waiting: check the response of the command, pass all sectors the host can take right now and check
+	/// the end of the transfer. A write that makes no progress for SDWRITE_TIMEOUT ms is aborted.
+	/// Returns sdqueueIdle if no write is running (the last one is done), sdqueueBusy while it runs, sdqueueError if the last one failed
+	///
+	///	Uses globals variables: SDMMC_BLOCK_0 (DAVE)
+
+
+	SDMMC_BLOCK_t* obj = &SDMMC_BLOCK_0;
+	SDMMC_BLOCK_SD_t* sd = obj->sdmmc_sd;
+	uint32_t now = SYSTIMER_GetTime();
+
+	switch(sdwrite_state){
+		// Response to CMD25 (card status must not report an error)
+		case sdwriteCommand:
+			if(sd->isr_context.cmd_flag == 0U)
+				break;
+			sd->isr_context.cmd_flag = 0U;
+			if(sd->cmd_int_err != SDMMC_BLOCK_MODE_STATUS_COMMAND_COMPLETE || (XMC_SDMMC_GetCommandResponse(sd->sdmmc) & SDWRITE_R1_ERRORS) != 0U)
+				return sdwrite_abort("command");
+			sdwrite_time = now;
+			sdwrite_state = sdwriteData;
+			/* no break */
+
+		// Sectors - the host requests the next one with the buffer write ready interrupt (delayed while the card is busy between two sectors)
+		case sdwriteData:
+			while(sdwrite_left > 0 && sd->isr_context.data_flag != 0U){
+				sd->isr_context.data_flag = 0U;
+				if(sd->data_int_err != SDMMC_BLOCK_MODE_STATUS_BUFFER_READY)
+					return sdwrite_abort("data");
+				for(uint32_t i = 0; i < SDMMC_BLOCK_NUM_QUADLETS_IN_BLOCK; i++)
+					XMC_SDMMC_WriteFIFO(sd->sdmmc, (uint32_t*)sdwrite_buf++);
+				sdwrite_left--;
+				sdwrite_time = now;
+			}
+			if(sdwrite_left > 0)
+				break;
+			sdwrite_state = sdwriteFinish;
+			/* no break */
+
+		// End of the transfer - the card released DAT0 after CMD12 (programming done)
+		case sdwriteFinish:
+			if(sd->isr_context.transfer_flag == 0U){
+				// An error interrupt ends the transfer without transfer complete
+				if(sd->isr_context.data_flag != 0U || sd->acmd_int_err == SDMMC_BLOCK_MODE_STATUS_ACMD12_ERROR)
+					return sdwrite_abort("stop");
+				break;
+			}
+			sd->isr_context.transfer_flag = 0U;
+			if(sd->transfer_int_err != SDMMC_BLOCK_MODE_STATUS_TRANSFER_COMPLETE || sd->acmd_int_err == SDMMC_BLOCK_MODE_STATUS_ACMD12_ERROR)
+				return sdwrite_abort("stop");
+			sdwrite_state = sdwriteIdle;
+			return sdqueueIdle;
+
+		// Last write failed (see sdwrite_abort)
+		case sdwriteFailed:
+			return sdqueueError;
+
+		default:
+			return sdqueueIdle;
+	}
+
+	// Still running - abort if the card stopped making progress
+	if(now - sdwrite_time > SDWRITE_TIMEOUT*1000UL)
+		return sdwrite_abort("timeout");
+	return sdqueueBusy;
+}
+
+uint8_t sdwrite_wait(void){
+	/// Wait until a running write is done (used before any other access to the card).
+	/// Returns sdqueueIdle if the card is free, sdqueueError if the running write failed
+
+
+	uint8_t res;
+	do{
+		res = sdwrite_poll();
+	}while(res == sdqueueBusy);
+	return res;
+}
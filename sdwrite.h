@@ -0,0 +1,26 @@
+/*
+ * sdwrite.h
+ *
+ *  Created on: 26 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef SDWRITE_H_
+#define SDWRITE_H_
+
+#include "sdqueue.h"
+
+/// Non-blocking multi-sector write to the SD-card. sdwrite_start sends the write command and returns, sdwrite_poll passes the sectors to the
+/// SDMMC host as soon as its interrupt reports buffer space and reports the end of the transfer (after the card finished programming) -
+/// the main loop does display and touch work in the meantime. Used as device of the write queue of the recording (see sdqueue.h).
+/// Every other access to the card (FatFs) waits for a running write first. See sdwrite.c for details.
+#define SDWRITE_TIMEOUT			500		// ms without progress of a write until it is aborted (the card holds DAT0 low longer than any normal busy time)
+
+extern const sdqueueDevice sdwrite_device;
+
+void sdwrite_init(void);
+uint8_t sdwrite_start(const void* buf, uint32_t sector, uint32_t count);
+uint8_t sdwrite_poll(void);
+uint8_t sdwrite_wait(void);
+
+#endif /* SDWRITE_H_ */
@@ -0,0 +1,248 @@
+/*
+@file    		sync.c
+@brief   		External sync input/output to align recordings with other loggers or cameras (implemented for XMC4700 and DAVE)
+@version 		1.0
+@date    		2021-10-20
+@author 		Rene Santeler @ MCI 2020/21
+ */
+
+#include <DAVE.h>
+#include <xmc_eru.h>
+#include <xmc4_eru_map.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "globals.h"
+#include "sync.h"
+
+/// Implemented in globals:
+// struct's: fifoEventSyncPayload, fifoEventMarkerPayload
+// #define's: MEASUREMENT_INTERVAL
+extern volatile measureModes measureMode;	// state of the measurement (purpose: none, monitoring or recording)
+
+
+
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+//
+//		Sync input/output         -----------------------------------------------------------------------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+/// The sync input is routed through ERU1 (ETL -> OGU3) to event 0 of the CCU4 slice of TIMER_0, which is the sample clock. An edge
+/// therefore captures the timer value in hardware - the position of the edge inside the sample interval is known with timer resolution,
+/// no matter how late the interrupt is served. The ERU interrupt (same priority as the measurement, so they never interrupt each other)
+/// only determines the sample the capture belongs to and queues a fifoEventSync event. The measurement handler does nothing but writing
+/// the queued event like any other event.
+/// The capture uses the slice of TIMER_0 itself (CCU43 slice 3, see Dave/Generated/TIMER/timer_conf.c), there is no separate capture slice.
+/// This doesn't conflict with the TIMER APP: it only uses the period match (start_control and every external event are disabled), so event 0,
+/// the capture function (CMC.CAP0S) and the capture registers C0V/C1V are free. The period match flag is only read by the ERU interrupt and
+/// cleared by the measurement handler. Configured by sync_init after DAVE_Init, so a regenerated TIMER APP doesn't overwrite it - check this
+/// again if the TIMER APP gets external start/stop or another event in the DAVE configuration.
+/// The sync output is set high at the first recorded sample and low SYNC_OUT_PULSE_SAMPLES later (sync_outputTick). Its rising edge is
+/// recorded as event as well, so the other device can be aligned to it the same way.
+
+// Number of samples of the current recording. Incremented by sync_outputTick once per recorded sample, so it equals the index (line)
+// of the next sample in the recording.
+volatile uint32_t sync_recSamples = 0;
+
+// Running numbers of the sync events (see fifoEventSyncPayload)
+static uint8_t sync_seqIn = 0;
+static uint8_t sync_seqOut = 0;
+
+// Running number of the markers (see fifoEventMarkerPayload) and samples left in which the marker input is ignored
+static uint8_t sync_seqMark = 0;
+static uint8_t sync_markHoldoff = 0;
+
+
+
+void sync_init(void){
+	/// Configure sync output pin, sync input pin, marker input pin, the ERU routing to the capture of TIMER_0 and the ERU interrupt.
+	/// Must be called after DAVE_Init and before TIMER_Start.
+	///
+	///	Uses globals variables: TIMER_0, ADC_MEASUREMENT_0
+
+
+	// Sync output - push pull, low
+	XMC_GPIO_CONFIG_t gpioOut = {
+		.mode = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
+		.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
+		.output_strength = XMC_GPIO_OUTPUT_STRENGTH_STRONG_SOFT_EDGE
+	};
+	XMC_GPIO_Init(SYNC_OUT_PIN, &gpioOut);
+
+	// Sync input - pull down keeps the input quiet if nothing is connected
+	XMC_GPIO_CONFIG_t gpioIn = {
+		.mode = XMC_GPIO_MODE_INPUT_PULL_DOWN
+	};
+	XMC_GPIO_Init(SYNC_IN_PIN, &gpioIn);
+
+	// Marker input - same as the sync input (polled by sync_outputTick, no capture needed)
+	XMC_GPIO_Init(SYNC_MARK_IN_PIN, &gpioIn);
+
+	// ERU1 event trigger logic: rising edge of input A triggers output gating unit 3
+	XMC_ERU_ETL_CONFIG_t etlConfig = {
+		.input_a = SYNC_IN_ERU_INPUT,
+		.source = XMC_ERU_ETL_SOURCE_A,
+		.edge_detection = XMC_ERU_ETL_EDGE_DETECTION_RISING,
+		.status_flag_mode = XMC_ERU_ETL_STATUS_FLAG_MODE_HWCTRL,
+		.enable_output_trigger = XMC_ERU_ETL_OUTPUT_TRIGGER_ENABLED,
+		.output_trigger_channel = XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL3
+	};
+	XMC_ERU_ETL_Init(XMC_ERU1, SYNC_IN_ERU_CHANNEL, &etlConfig);
+
+	// ERU1 output gating unit 3: trigger pulse is available at ERU1.IOUT3 and generates a service request (ERU1_3_IRQHandler)
+	XMC_ERU_OGU_CONFIG_t oguConfig = {
+		.service_request = XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER
+	};
+	XMC_ERU_OGU_Init(XMC_ERU1, 3, &oguConfig);
+
+	// Capture the timer value of the sample clock on ERU1.IOUT3 (event 0 is not used by the TIMER APP, it only uses the period match)
+	XMC_CCU4_SLICE_EVENT_CONFIG_t eventConfig = {
+		.mapped_input = CCU43_IN3_SCU_ERU1_IOUT3,
+		.edge = XMC_CCU4_SLICE_EVENT_EDGE_SENSITIVITY_RISING_EDGE,
+		.level = XMC_CCU4_SLICE_EVENT_LEVEL_SENSITIVITY_ACTIVE_HIGH,
+		.duration = XMC_CCU4_SLICE_EVENT_FILTER_DISABLED
+	};
+	XMC_CCU4_SLICE_ConfigureEvent(TIMER_0.ccu4_slice_ptr, XMC_CCU4_SLICE_EVENT_0, &eventConfig);
+	XMC_CCU4_SLICE_Capture0Config(TIMER_0.ccu4_slice_ptr, XMC_CCU4_SLICE_EVENT_0);
+
+	// ERU interrupt with the same priority as the measurement (see sync_capture_IRQ_handler why this is important)
+	NVIC_SetPriority(ERU1_3_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), ADC_MEASUREMENT_0.req_src_intr_handle->priority, ADC_MEASUREMENT_0.req_src_intr_handle->sub_priority));
+	NVIC_EnableIRQ(ERU1_3_IRQn);
+}
+
+void sync_recordStart(void){
+	/// Reset the sample count and the running numbers of the sync events. Must be called before the measurement mode is changed to recording.
+	///
+	///	Uses globals variables: none
+
+
+	sync_recSamples = 0;
+	sync_seqIn = 0;
+	sync_seqOut = 0;
+	sync_seqMark = 0;
+	sync_markHoldoff = SYNC_MARK_IN_HOLDOFF; // An input that is already high at the start isn't an edge
+	XMC_GPIO_SetOutputLow(SYNC_OUT_PIN);
+}
+
+void sync_outputTick(void){
+	/// Called by the measurement handler once per recorded sample (after the sample is written). Generates the sync output pulse
+	/// and queues its event at the first sample. Sets a marker at a rising edge of the marker input. Takes constant time.
+	///
+	///	Uses globals variables: TIMER_0
+
+
+	// First sample of the recording - start pulse and record its exact position (timer value inside the current sample interval)
+	if(sync_recSamples == 0){
+		XMC_GPIO_SetOutputHigh(SYNC_OUT_PIN);
+		fifoEventSyncPayload payload = {
+			.sample = 0,
+			.fraction = (uint16_t)(((uint32_t)XMC_CCU4_SLICE_GetTimerValue(TIMER_0.ccu4_slice_ptr) << 16) / ((uint32_t)XMC_CCU4_SLICE_GetTimerPeriodMatch(TIMER_0.ccu4_slice_ptr) + 1)),
+			.source = syncSourceOutput,
+			.seq = sync_seqOut++
+		};
+		fifo_event_enqueue(fifoEventSync, &payload, sizeof(payload));
+	}
+	// End of pulse
+	else if(sync_recSamples == SYNC_OUT_PULSE_SAMPLES){
+		XMC_GPIO_SetOutputLow(SYNC_OUT_PIN);
+	}
+
+	sync_recSamples++;
+
+	// Marker input - a marker behind this sample at a rising edge (the input must be low for the hold-off time before)
+	static uint8_t lastLevel = 1;
+	uint8_t level = XMC_GPIO_GetInput(SYNC_MARK_IN_PIN);
+	if(sync_markHoldoff > 0){
+		if(!level)
+			sync_markHoldoff--;
+	}
+	else if(level && !lastLevel){
+		sync_marker(SYNC_MARK_IN_TYPE, SYNC_MARK_IN_LABEL);
+		sync_markHoldoff = SYNC_MARK_IN_HOLDOFF;
+	}
+	lastLevel = level;
+}
+
+uint8_t sync_marker(uint8_t type, const char* label){
+	/// Queue a marker (fifoEventMarker) behind the newest recorded sample. It is written in-band like every event, so it costs nothing
+	/// per sample. Takes constant time and is safe to use from interrupts (the sample count and the running number are taken atomically).
+	/// Returns 1 if the marker was queued, 0 if not recording or the event queue is full.
+	///
+	///	type	... Type of the marker (see fifoMarkerTypes)
+	///	label	... Short text (cut to FIFO_MARKER_LABEL_SIZE characters)
+	///
+	///	Uses globals variables: measureMode
+
+
+	// Only while recording
+	if(measureMode != measureModeRecording)
+		return 0;
+
+	// Payload (label zero padded)
+	fifoEventMarkerPayload payload = {.type = type};
+	strncpy(payload.label, label, FIFO_MARKER_LABEL_SIZE);
+
+	// Position and running number - measurement handler must not run in between (restore previous state afterwards)
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	payload.sample = (sync_recSamples > 0) ? sync_recSamples - 1 : 0;
+	payload.seq = sync_seqMark;
+	uint8_t queued = fifo_event_enqueue(fifoEventMarker, &payload, sizeof(payload));
+	if(queued)
+		sync_seqMark++;
+	__set_PRIMASK(primask);
+
+	return queued;
+}
+
+static void sync_capture_IRQ_handler(void){
+	/// Interrupt handler of the sync input (ERU1 service request 3). Reads the captured timer value and finds the sample it belongs to.
+	/// The capture is C/(PR+1) sample intervals after the period match (= sample) it follows. This sample is the newest one, or the one
+	/// before if the timer overflowed since the capture. The period match flag of the slice tells whether the measurement handler of the
+	/// newest sample is still outstanding (it clears the flag, see measure_IRQ_handler) - set by hardware at the overflow, so there is no
+	/// gap while the ADC conversion is running and nothing to wait for. As this handler has the same priority as the measurement, the
+	/// measurement handler never runs in between.
+	///
+	///	Uses globals variables: TIMER_0, measureMode
+
+
+	XMC_CCU4_SLICE_t* slice = TIMER_0.ccu4_slice_ptr;
+
+	// Only edges during a recording are of interest
+	if(measureMode != measureModeRecording)
+		return;
+
+	// Captured timer value (capture register 1 holds the newest capture)
+	uint32_t capture = XMC_CCU4_SLICE_GetCaptureRegisterValue(slice, 1) & 0xFFFF;
+
+	// Get current timer value and whether the measurement of the newest sample is still outstanding. Read again if the timer
+	// overflowed in between (can only happen once - the reads take far less than a sample interval)
+	uint32_t now = XMC_CCU4_SLICE_GetTimerValue(slice);
+	uint32_t outstanding = XMC_CCU4_SLICE_GetEvent(slice, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	if(XMC_CCU4_SLICE_GetTimerValue(slice) < now){
+		now = XMC_CCU4_SLICE_GetTimerValue(slice);
+		outstanding = XMC_CCU4_SLICE_GetEvent(slice, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	}
+
+	// Index of the newest sample and the one the capture follows
+	int32_t sample = (int32_t)sync_recSamples - 1 + (outstanding ? 1 : 0);
+	if(now < capture)
+		sample--;
+
+	// Edge before the first sample of the recording
+	if(sample < 0)
+		return;
+
+	// Queue event
+	fifoEventSyncPayload payload = {
+		.sample = (uint32_t)sample,
+		.fraction = (uint16_t)((capture << 16) / ((uint32_t)XMC_CCU4_SLICE_GetTimerPeriodMatch(slice) + 1)),
+		.source = syncSourceInput,
+		.seq = sync_seqIn++
+	};
+	fifo_event_enqueue(fifoEventSync, &payload, sizeof(payload));
+}
+
+void ERU1_3_IRQHandler(void){
+	sync_capture_IRQ_handler();
+}
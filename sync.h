@@ -0,0 +1,40 @@
+/*
+ * sync.h
+ *
+ *  Created on: 20 Oct 2021
+ *      Author: RS
+ */
+
+#ifndef SYNC_H_
+#define SYNC_H_
+
+/// External synchronization. Edges on the sync input are timestamped by a hardware capture of the sample clock (TIMER_0) and recorded
+/// as in-band events (fifoEventSync) with the sample index and the sub-sample offset. A pulse on the sync output marks the first sample
+/// of every recording. This allows to align the recording with a second logger or a camera (see Tools/syncalign). See sync.c for details.
+#define SYNC_IN_PIN				P1_15					// Sync input (routed to ERU1 ETL1 input A0, rising edge)
+#define SYNC_IN_ERU_INPUT		ERU1_ETL1_INPUTA_P1_15	// ERU input selection matching SYNC_IN_PIN
+#define SYNC_IN_ERU_CHANNEL		1						// ERU1 event trigger logic (ETL) used by the sync input
+#define SYNC_OUT_PIN			P1_14					// Sync output (high for SYNC_OUT_PULSE_SAMPLES at the start of a recording)
+#define SYNC_OUT_PULSE_SAMPLES	20						// Length of the sync output pulse in samples (20*5ms = 100ms)
+
+/// Markers. A marker (fifoEventMarker) notes a position of the recording with a type and a short label ("start of rock garden", "setup change").
+/// It is stored in-band like the sync events and listed in the .EVT file by the conversion. Markers are set by the dashboard button or by a
+/// rising edge on the marker input (e.g. a handlebar button), see sync_marker.
+#define SYNC_MARK_IN_PIN		P1_13					// Marker input (rising edge sets a marker while recording, sampled with every recorded sample)
+#define SYNC_MARK_IN_HOLDOFF	100						// Samples the marker input must be low after a marker before the next edge counts (100*5ms = 0.5s, bouncing contacts)
+#define SYNC_MARK_IN_TYPE		fifoMarkerSection		// Type of the markers of the marker input (see fifoMarkerTypes)
+#define SYNC_MARK_IN_LABEL		"Input"					// Label of the markers of the marker input (at most FIFO_MARKER_LABEL_SIZE characters)
+#define SYNC_MARK_BTN_TYPE		fifoMarkerSection		// Type of the markers of the dashboard button at startup (cycled with the type button next to it)
+#define SYNC_MARK_BTN_LABELS	{"Button", "Start", "End", "Rock", "Jump", "Drop", "Setup"}	// Labels of the dashboard button to choose from (cycled with the label button next to it, first one at startup)
+
+// Sources of a fifoEventSync event
+enum syncSources{syncSourceInput=0, syncSourceOutput};
+
+extern volatile uint32_t sync_recSamples;
+
+void sync_init(void);
+void sync_recordStart(void);
+void sync_outputTick(void);
+uint8_t sync_marker(uint8_t type, const char* label);
+
+#endif /* SYNC_H_ */
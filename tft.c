@@ -149,6 +149,20 @@ static void str_insert(char* target, uint8_t* len, char ch, int8_t pos){
 	(*len)++;
 }
 
+static float TFT_src_getFloat(srcDefinition* src){
+	/// Get the current value of a float or fixed-point numeric source (with offset if given) as float.
+
+
+	// Index of the value (array source) or 0
+	uint16_t idx = (src->srcOffset == NULL) ? 0 : *src->srcOffset;
+
+	// Fixed-point source is scaled by its format (see fixedFormat)
+	if(src->srcType == srcTypeFixed)
+		return FIXEDPT_TO_FLOAT(*src->fixedFmt, src->fixedSrc[idx]);
+	else
+		return src->floatSrc[idx];
+}
+
 void TFT_keypad_open(uint8_t evokedBy, enum keypadTypes type){
 	/// Open a keypad for the according evoker (control element - e.g. tag of an textbox)
 
@@ -336,12 +350,12 @@ void TFT_graph_static(uint8_t burst, graph* gph, uint32_t axisColor, uint32_t gr
 	// horizontal grid (y)
 	//(*EVE_cmd_dl__fptr_arr[burst])(DL_COLOR_RGB | GRAPH_AXISCOLOR);
 	for(int i=1; i<=(int)floor(gph->h_grid_lines); i++){  // "floor" and "i" at val -> don't print the 0 value
-		// Calc amplitude at current horizontal line
-		float val = (gph->amp_max/gph->h_grid_lines*(float)i);
+		// Calc amplitude at current horizontal line (starting at amp_min, which is 0 for unsigned data)
+		float val = gph->amp_min + ((gph->amp_max - gph->amp_min)/gph->h_grid_lines*(float)i);
 
 		// If its a pure integer write it as number, else convert and write it to string
-		if((val - (float)((uint32_t)val)) == 0){ //val % 1.0 == 0
-			(*EVE_cmd_number__fptr_arr[burst])(gph->x - v_grid_lbl_comp_x	, curY + gph->padding + gph->height - (uint16_t)(heightPerSection*(float)i) + v_grid_lbl_comp_y, grid_lbl_txt_size, 0, (int32_t)val); //EVE_OPT_RIGHTX|
+		if((val - (float)((int32_t)val)) == 0){ //val % 1.0 == 0
+			(*EVE_cmd_number__fptr_arr[burst])(gph->x - v_grid_lbl_comp_x	, curY + gph->padding + gph->height - (uint16_t)(heightPerSection*(float)i) + v_grid_lbl_comp_y, grid_lbl_txt_size, EVE_OPT_SIGNED, (int32_t)val); //EVE_OPT_RIGHTX|
 		}
 		else{
 			char buffer[32]; // buffer for float to string conversion
@@ -457,14 +471,10 @@ void TFT_label_display(uint8_t burst, label* lbl){
 				else
 					(*EVE_cmd_text_var__fptr_arr[burst])(lbl->x, curY, lbl->font, EVE_OPT_FORMAT | lbl->options, lbl->text, 1 ,(int32_t)( lbl->numSrc.intSrc[*lbl->numSrc.srcOffset]) );
 			// ... for floating source
-			else if(lbl->numSrc.srcType == srcTypeFloat){
+			else if(lbl->numSrc.srcType == srcTypeFloat || lbl->numSrc.srcType == srcTypeFixed){
 				// Split float value into integral/fractional part and print them according to lbl->text
 				float intPart, fracPart;
-				/// If the offset is not given use floatSrc directly, else use offset to determine which value is to be used
-				if(lbl->numSrc.srcOffset == NULL)
-					fracPart = modff( *lbl->numSrc.floatSrc, &intPart);
-				else
-					fracPart = modff(lbl->numSrc.floatSrc[*lbl->numSrc.srcOffset], &intPart);
+				fracPart = modff(TFT_src_getFloat(&lbl->numSrc), &intPart);
 				// Print the string while using text as format and raising the fraction to the power of 10 given by fracExp
 				if(lbl->fracExp == 0)
 					(*EVE_cmd_text_var__fptr_arr[burst])(lbl->x, curY, lbl->font, EVE_OPT_FORMAT | lbl->options, lbl->text, 2 ,FLOAT_TO_INT16(intPart) ); //"%d"
@@ -748,14 +758,10 @@ void TFT_textbox_display(textbox* tbx){
 					else
 						EVE_cmd_text_var_burst(tbx->x + tbx->labelOffsetX + TEXTBOX_PAD_H, curY, 26, EVE_OPT_FORMAT, tbx->numSrcFormat, 1 ,(int32_t)( tbx->numSrc.intSrc[*tbx->numSrc.srcOffset]) );
 				// ... for floating source
-				else if(tbx->numSrc.srcType == srcTypeFloat){
+				else if(tbx->numSrc.srcType == srcTypeFloat || tbx->numSrc.srcType == srcTypeFixed){
 					// Split float value into integral/fractional part and print them according to tbx->text
 					float intPart, fracPart;
-					/// If the offset is not given, use floatSrc directly, else use offset to determine which value is to be used
-					if(tbx->numSrc.srcOffset == NULL)
-						fracPart = modff(*tbx->numSrc.floatSrc, &intPart);
-					else
-						fracPart = modff(tbx->numSrc.floatSrc[*tbx->numSrc.srcOffset], &intPart);
+					fracPart = modff(TFT_src_getFloat(&tbx->numSrc), &intPart);
 					// Print the string while using text as format and raising the fraction to the power of 10 given by fracExp
 					EVE_cmd_text_var_burst(tbx->x + tbx->labelOffsetX + TEXTBOX_PAD_H, curY, 26, EVE_OPT_FORMAT, tbx->numSrcFormat, 2 ,FLOAT_TO_INT16(intPart), FLOAT_TO_INT16(fabsf( fracPart*(pow10f((float)tbx->fracExp)))) ); //"%d.%.2d"
 				}
@@ -816,14 +822,10 @@ void TFT_textbox_setStatus(textbox* tbx, uint8_t active, int16_t cursorPos){
 			*tbx->text_curlen = strlen(tbx->text);
 		}
 		// Fractional source
-		else if(tbx->numSrc.srcType == srcTypeFloat){
+		else if(tbx->numSrc.srcType == srcTypeFloat || tbx->numSrc.srcType == srcTypeFixed){
 			// Split float value into integral/fractional part and print them according to tbx->text
 			float intPart, fracPart;
-			/// If the offset is not given, use floatSrc directly, else use offset to determine which value is to be used
-			if(tbx->numSrc.srcOffset == NULL)
-				fracPart = modff( *tbx->numSrc.floatSrc, &intPart);
-			else
-				fracPart = modff(tbx->numSrc.floatSrc[*tbx->numSrc.srcOffset], &intPart);
+			fracPart = modff(TFT_src_getFloat(&tbx->numSrc), &intPart);
 			// Print the string while using text as format and raising the fraction to the power of 10 given by fracExp
 			sprintf(tbx->text, tbx->numSrcFormat, FLOAT_TO_INT16(intPart), FLOAT_TO_INT16(fabsf( fracPart*(pow10f((float)tbx->fracExp)))) ); // string to integer conversion
 			//,FLOAT_TO_INT16(intPart), FLOAT_TO_INT16(fabsf( fracPart*(pow10f((float)tbx->fracExp)))) ); //"%d.%.2d"
@@ -862,6 +864,14 @@ void TFT_textbox_setStatus(textbox* tbx, uint8_t active, int16_t cursorPos){
 				tbx->numSrc.floatSrc[*tbx->numSrc.srcOffset] = atoff(tbx->text);
 
 		}
+		else if(tbx->numSrc.srcType == srcTypeFixed){
+			// Store as fixed-point value (rounded and saturated, see fixedpt.h)
+			int16_t fixedVal = FIXEDPT_FROM_FLOAT(*tbx->numSrc.fixedFmt, atoff(tbx->text));
+			if(tbx->numSrc.srcOffset == NULL)
+				*tbx->numSrc.fixedSrc = fixedVal;
+			else
+				tbx->numSrc.fixedSrc[*tbx->numSrc.srcOffset] = fixedVal;
+		}
 
 		// Reset vertical scroll to normal
 		TFT_cur_ScrollV = 0;
@@ -980,11 +990,15 @@ void TFT_graph_pixeldata_i(graph* gph, int_buffer_t buf[], uint16_t buf_size, ui
 
 void TFT_graph_pixeldata_f(graph* gph, float_buffer_t buf[], uint16_t buf_size, uint16_t *buf_curidx, uint32_t datacolor){
 	/// This is a copy of the above function! It taken a float buffer and will later be merged to its origin.
+	/// In addition this supports signed data by using y_min as lower bound of the y-axis (0 if not set).
 
 
 	// Determine current position (with scroll value)
 	uint16_t curY = gph->y - TFT_cur_ScrollV;
 
+	// Range of the y-axis
+	float y_range = gph->y_max - gph->y_min;
+
 
 	/// Display current DATA as line strip in frame or roll mode
 	EVE_cmd_dl_burst(DL_COLOR_RGB | datacolor);
@@ -993,7 +1007,7 @@ void TFT_graph_pixeldata_f(graph* gph, float_buffer_t buf[], uint16_t buf_size,
 	if(gph->graphmode == 0){
 		// Print values in the order they are stored
 		for (int x_cur = 0; x_cur < buf_size; ++x_cur) {
-			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (uint16_t)(( ((float)buf[x_cur]) / ((float)gph->y_max) )*(float)(gph->height)) )); //if(frameover==1) printf("%lf %lf\n", ((((float)(buf[x_cur]))/((float)gph->y_max))*(float)(gph->height)), (float)buf[gph->x]);
+			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (int16_t)(( ((float)buf[x_cur] - gph->y_min) / y_range )*(float)(gph->height)) )); //if(frameover==1) printf("%lf %lf\n", ((((float)(buf[x_cur]))/((float)gph->y_max))*(float)(gph->height)), (float)buf[gph->x]);
 		}
 	}
 	/// Display graph roll-mode
@@ -1009,7 +1023,7 @@ void TFT_graph_pixeldata_f(graph* gph, float_buffer_t buf[], uint16_t buf_size,
 			if(i < 0){i = buf_size-1;}
 
 			// Send next point for EVE_LINE_STRIP at current x+padding and normalized buffer value
-			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (uint16_t)(( ((float)buf[i]) / ((float)gph->y_max) )*(float)(gph->height)) )); 				// EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, EVE_VSIZE - ((uint16_t)(buf[i]/y_div) + margin + gph->padding)));
+			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (int16_t)(( ((float)buf[i] - gph->y_min) / y_range )*(float)(gph->height)) )); 				// EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, EVE_VSIZE - ((uint16_t)(buf[i]/y_div) + margin + gph->padding)));
 
 			// decrement index
 			i--;
@@ -1031,6 +1045,120 @@ void TFT_graph_pixeldata_f(graph* gph, float_buffer_t buf[], uint16_t buf_size,
 
 }
 
+void TFT_graph_pixeldata_fixed(graph* gph, int16_t buf[], uint16_t buf_size, uint16_t *buf_curidx, fixedFormat* fmt, uint32_t datacolor){
+	/// Fixed-point version of TFT_graph_pixeldata_f. The values are given as int16 with the scale and offset of fmt (see fixedFormat).
+	/// The format is folded into the graph scale, so every point costs one multiplication and addition like the float version.
+
+
+	// Determine current position (with scroll value)
+	uint16_t curY = gph->y - TFT_cur_ScrollV;
+
+	// Pixel height per stored step and pixel position of a stored 0 (measured upwards from the x-axis)
+	float y_gain = fmt->scale * (float)gph->height / (gph->y_max - gph->y_min);
+	float y_zero = (fmt->offset - gph->y_min) * (float)gph->height / (gph->y_max - gph->y_min);
+
+
+	/// Display current DATA as line strip in frame or roll mode
+	EVE_cmd_dl_burst(DL_COLOR_RGB | datacolor);
+	EVE_cmd_dl_burst(DL_BEGIN | EVE_LINE_STRIP);
+	/// Display graph frame-mode
+	if(gph->graphmode == 0){
+		// Print values in the order they are stored
+		for (int x_cur = 0; x_cur < buf_size; ++x_cur) {
+			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (int16_t)(y_zero + (float)buf[x_cur] * y_gain) ));
+		}
+	}
+	/// Display graph roll-mode
+	else {
+		// Print newest value always at the rightmost corner with all older values to the right (see TFT_graph_pixeldata_i)
+		int16_t i = *buf_curidx;
+		for (int16_t x_cur = buf_size-1; x_cur >= 0; x_cur--) {
+			// if index goes below 0 set to highest buffer index
+			if(i < 0){i = buf_size-1;}
+
+			// Send next point for EVE_LINE_STRIP at current x+padding and normalized buffer value
+			EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, curY + gph->padding + gph->height - (int16_t)(y_zero + (float)buf[i] * y_gain) ));
+
+			// decrement index
+			i--;
+		}
+	}
+	// End EVE_LINE_STRIP and therefore DATA
+	EVE_cmd_dl_burst(DL_END);
+
+
+	/// Draw current POSITION MARKER in frame mode
+	if(gph->graphmode == 0){
+		EVE_cmd_dl_burst(DL_COLOR_RGB | 0xff0000);
+		EVE_cmd_dl_burst(DL_BEGIN | EVE_LINE_STRIP);
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + *buf_curidx, curY + gph->padding - 5 ));
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + *buf_curidx, curY + gph->padding + gph->height + 5 ));
+		EVE_cmd_dl_burst(DL_END);
+	}
+	/////////////// GRAPH END
+
+}
+
+void TFT_graph_envelope(graph* gph, historyBucket buf[], uint16_t buf_size, uint16_t *buf_curidx, sensor* convSens, uint32_t rangecolor, uint32_t meancolor){
+	/// Write a decimated history (min/max/mean per bucket, see historyLevel in globals) to an graph. Every bucket is one pixel: the range between min and max
+	/// is drawn as vertical line and the mean as line strip on top of it. Empty buckets (min > max) are left out. Supports frame and roll mode like TFT_graph_pixeldata_f.
+	///
+	///  convSens	... If not NULL the raw values of the buckets are converted with the conversion table of this sensor (see measure_conv), otherwise they are used as they are
+
+
+	// Determine current position (with scroll value)
+	uint16_t curY = gph->y - TFT_cur_ScrollV;
+
+	// Range of the y-axis
+	float y_range = gph->y_max - gph->y_min;
+
+	// Y-coordinate of a bucket value (converted if needed)
+	#define ENVELOPE_Y(val) (curY + gph->padding + gph->height - (int16_t)(( ((convSens ? measure_conv(convSens, (val)) : (float)(val)) - gph->y_min) / y_range )*(float)(gph->height)))
+
+	// Buffer index of the leftmost pixel (frame mode: buffer order, roll mode: oldest bucket left and newest at the rightmost position)
+	int16_t i = (gph->graphmode == 0) ? 0 : *buf_curidx + 1;
+
+	/// Range as vertical lines
+	EVE_cmd_dl_burst(DL_COLOR_RGB | rangecolor);
+	EVE_cmd_dl_burst(DL_BEGIN | EVE_LINES);
+	for (int16_t x_cur = 0, idx = i; x_cur < buf_size; x_cur++, idx++) {
+		if(idx >= buf_size) idx = 0;
+		if(buf[idx].min > buf[idx].max) continue;
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, ENVELOPE_Y(buf[idx].min)));
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, ENVELOPE_Y(buf[idx].max)));
+	}
+	EVE_cmd_dl_burst(DL_END);
+
+	/// Mean as line strip (empty buckets are skipped by restarting the strip)
+	EVE_cmd_dl_burst(DL_COLOR_RGB | meancolor);
+	EVE_cmd_dl_burst(DL_BEGIN | EVE_LINE_STRIP);
+	uint8_t lastEmpty = 0;
+	for (int16_t x_cur = 0, idx = i; x_cur < buf_size; x_cur++, idx++) {
+		if(idx >= buf_size) idx = 0;
+		if(buf[idx].min > buf[idx].max){
+			lastEmpty = 1;
+			continue;
+		}
+		if(lastEmpty){
+			EVE_cmd_dl_burst(DL_END);
+			EVE_cmd_dl_burst(DL_BEGIN | EVE_LINE_STRIP);
+			lastEmpty = 0;
+		}
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + x_cur, ENVELOPE_Y(buf[idx].mean)));
+	}
+	EVE_cmd_dl_burst(DL_END);
+	#undef ENVELOPE_Y
+
+	/// Draw current POSITION MARKER in frame mode
+	if(gph->graphmode == 0){
+		EVE_cmd_dl_burst(DL_COLOR_RGB | 0xff0000);
+		EVE_cmd_dl_burst(DL_BEGIN | EVE_LINE_STRIP);
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + *buf_curidx, curY + gph->padding - 5 ));
+		EVE_cmd_dl_burst(VERTEX2F(gph->x + gph->padding + *buf_curidx, curY + gph->padding + gph->height + 5 ));
+		EVE_cmd_dl_burst(DL_END);
+	}
+}
+
 void TFT_graph_stepdata(graph* gph, int_buffer_t cy_buf[], uint16_t cy_buf_size, float cx_step, uint32_t datacolor){
 	/// Write the dynamic parts of an Graph to the TFT (data and markers). Used at recurring display list build in TFT_display() completely coded by RS 02.01.2021.
 	///
@@ -43,16 +43,18 @@
 
 /// Source definition for display elements: Some Elements can be associated to a source via a pointer. This source might be an integer or an float. This is a way to achieve the possible use of both.
 // Note: int_buffer_t and float_buffer_t is defined in globals files
-enum srcTypes{srcTypeNone=0, srcTypeInt, srcTypeFloat};
+enum srcTypes{srcTypeNone=0, srcTypeInt, srcTypeFloat, srcTypeFixed};
 typedef enum srcTypes srcTypes;
 //#define SRC_MAXSIZE 4 	// The size in bytes of the biggest value used in union below! This will be used to compare
 typedef struct {
-	srcTypes srcType;			// Type of the src union. 0=none (pure text tbx), 1=integer(int_buffer_t), 2=float
+	srcTypes srcType;			// Type of the src union. 0=none (pure text tbx), 1=integer(int_buffer_t), 2=float, 3=fixed-point (int16 with fixedFmt, shown like a float)
 	union {						// A pointer to the numeric source this textbox represents.
 		int_buffer_t* intSrc;
 		float_buffer_t* floatSrc;
+		int16_t* fixedSrc;
 	};
 	uint16_t* srcOffset;		// Offset (index) of src. Only needed for array sources (the actual byte offset will be calculated based on srcType)
+	fixedFormat* fixedFmt;		// Scale and offset of a fixed-point source (only needed for srcTypeFixed)
 	//char lastVal[SRC_MAXSIZE];
 } srcDefinition;
 
@@ -159,6 +161,8 @@ typedef struct {
 	char* y_label;	  // Text that will be written at the top of y Axis (like "y" or "V")
 	float y_max; 	  // Maximum expected value of input (e.g. for 12bit ADC 4095), will represent 100% of y-Axis
 	float amp_max;    // Maximum represented value of amplitude (e.g. 10 Volts), will be used at 100% of y-Axis
+	float y_min; 	  // Minimum expected value of input, will represent 0% of y-Axis. Leave at 0 for unsigned data (only used by TFT_graph_pixeldata_f)
+	float amp_min;    // Minimum represented value of amplitude, will be used at 0% of y-Axis. Leave at 0 for unsigned data
 	float cx_initial; // NOT FULLY USED YET! (works for TFT_graph_stepdata but not TFT_graph_static)
 	float cx_max; 	  // Maximum represented value of x-Axis (e.g. time 2.2 Seconds), will be used at 100% of x-Axis
 	float h_grid_lines; 	// Number of horizontal grid lines
@@ -168,6 +172,8 @@ typedef struct {
 void TFT_graph_static(uint8_t burst, graph* gph, uint32_t axisColor, uint32_t gridColor);
 void TFT_graph_pixeldata_i(graph* gph, int_buffer_t buf[], uint16_t buf_size, uint16_t *buf_curidx, uint32_t datacolor);
 void TFT_graph_pixeldata_f(graph* gph, float_buffer_t buf[], uint16_t buf_size, uint16_t *buf_curidx, uint32_t datacolor);
+void TFT_graph_pixeldata_fixed(graph* gph, int16_t buf[], uint16_t buf_size, uint16_t *buf_curidx, fixedFormat* fmt, uint32_t datacolor);
+void TFT_graph_envelope(graph* gph, historyBucket buf[], uint16_t buf_size, uint16_t *buf_curidx, sensor* convSens, uint32_t rangecolor, uint32_t meancolor);
 void TFT_graph_stepdata(graph* gph, int_buffer_t cy_buf[], uint16_t cy_buf_size, float cx_step, uint32_t datacolor);
 void TFT_graph_XYdata(graph* gph, float cy_buf[], float cx_buf[], uint16_t buf_size, int16_t *buf_curidx, graphTypes gphTyp, uint32_t datacolor);
 void TFT_graph_function(graph* gph, float* f_coefficients, uint8_t order, uint16_t step_divider, graphTypes gphTyp, uint32_t datacolor);